@@ -0,0 +1,415 @@
+#include "channel.hpp"
+#include "iomanager.hpp"
+#include <algorithm>
+#include <time.h>
+
+void sylar::ChannelWaitQueue::push(ChannelWaiter *waiter)
+{
+    waiter->prev = m_tail;
+    waiter->next = nullptr;
+    if (m_tail)
+    {
+        m_tail->next = waiter;
+    }
+    else
+    {
+        m_head = waiter;
+    }
+    m_tail = waiter;
+    waiter->queued = true;
+}
+
+void sylar::ChannelWaitQueue::remove(ChannelWaiter *waiter)
+{
+    if (waiter->prev)
+    {
+        waiter->prev->next = waiter->next;
+    }
+    else
+    {
+        m_head = waiter->next;
+    }
+    if (waiter->next)
+    {
+        waiter->next->prev = waiter->prev;
+    }
+    else
+    {
+        m_tail = waiter->prev;
+    }
+    waiter->prev = waiter->next = nullptr;
+    waiter->queued = false;
+}
+
+sylar::ChannelWaiter *sylar::ChannelWaitQueue::dequeue()
+{
+    while (ChannelWaiter *waiter = m_head)
+    {
+        remove(waiter);
+        if (!waiter->select)
+        {
+            return waiter;
+        }
+        uint32_t expected = 0;
+        if (waiter->select->done.compare_exchange_strong(expected, 1, std::memory_order_acq_rel))
+        {
+            waiter->select->index = waiter->caseIndex;
+            return waiter;
+        }
+    }
+    return nullptr;
+}
+
+bool sylar::ChannelBase::sendLocked(void *elem, bool &ok, ChannelWaiter *&wake)
+{
+    if (m_closed)
+    {
+        ok = false;
+        return true;
+    }
+    // 有等待的接收方，直接交给它
+    if ((wake = m_recvq.dequeue()))
+    {
+        moveElem(wake->elem, elem);
+        wake->ok = true;
+        ok = true;
+        return true;
+    }
+    if (m_count < m_capacity)
+    {
+        moveElem(slot((m_head + m_count) % m_capacity), elem);
+        ++m_count;
+        ok = true;
+        return true;
+    }
+    return false;
+}
+
+bool sylar::ChannelBase::recvLocked(void *elem, bool &ok, ChannelWaiter *&wake)
+{
+    if (m_count > 0)
+    {
+        void *head = slot(m_head);
+        moveElem(elem, head);
+        // 有发送方在等说明缓冲区是满的，它的值放到刚空出来的位置，也就是新的队尾
+        if ((wake = m_sendq.dequeue()))
+        {
+            moveElem(head, wake->elem);
+            wake->ok = true;
+        }
+        else
+        {
+            --m_count;
+        }
+        m_head = (m_head + 1) % m_capacity;
+        ok = true;
+        return true;
+    }
+    if ((wake = m_sendq.dequeue()))
+    {
+        moveElem(elem, wake->elem);
+        wake->ok = true;
+        ok = true;
+        return true;
+    }
+    if (m_closed)
+    {
+        ok = false;
+        return true;
+    }
+    return false;
+}
+
+bool sylar::ChannelBase::sendImpl(void *elem, bool block)
+{
+    FutexMutex::Lock guard(m_guard);
+    bool ok = false;
+    ChannelWaiter *wake = nullptr;
+    if (sendLocked(elem, ok, wake))
+    {
+        guard.unlock();
+        if (wake)
+        {
+            WakeWaiter(wake);
+        }
+        return ok;
+    }
+    if (!block)
+    {
+        return false;
+    }
+    FiberWaiter parker;
+    ChannelWaiter waiter;
+    waiter.elem = elem;
+    waiter.parker = &parker;
+    m_sendq.push(&waiter);
+    FiberWaitQueue::Wait(parker, guard);
+    return waiter.ok;
+}
+
+bool sylar::ChannelBase::recvImpl(void *elem, bool block)
+{
+    FutexMutex::Lock guard(m_guard);
+    bool ok = false;
+    ChannelWaiter *wake = nullptr;
+    if (recvLocked(elem, ok, wake))
+    {
+        guard.unlock();
+        if (wake)
+        {
+            WakeWaiter(wake);
+        }
+        return ok;
+    }
+    if (!block)
+    {
+        return false;
+    }
+    FiberWaiter parker;
+    ChannelWaiter waiter;
+    waiter.elem = elem;
+    waiter.parker = &parker;
+    m_recvq.push(&waiter);
+    FiberWaitQueue::Wait(parker, guard);
+    return waiter.ok;
+}
+
+void sylar::ChannelBase::close()
+{
+    FutexMutex::Lock guard(m_guard);
+    if (m_closed)
+    {
+        return;
+    }
+    m_closed = true;
+    // 先在锁内摘下所有等待者，用next串起来，解锁后再唤醒
+    ChannelWaiter *wakeList = nullptr;
+    for (ChannelWaitQueue *queue : {&m_recvq, &m_sendq})
+    {
+        while (ChannelWaiter *waiter = queue->dequeue())
+        {
+            waiter->ok = false;
+            waiter->next = wakeList;
+            wakeList = waiter;
+        }
+    }
+    guard.unlock();
+    while (wakeList)
+    {
+        ChannelWaiter *next = wakeList->next;
+        WakeWaiter(wakeList);
+        wakeList = next;
+    }
+}
+
+bool sylar::ChannelBase::isClosed()
+{
+    FutexMutex::Lock guard(m_guard);
+    return m_closed;
+}
+
+size_t sylar::ChannelBase::size()
+{
+    FutexMutex::Lock guard(m_guard);
+    return m_count;
+}
+
+namespace sylar
+{
+    /// 每次select检查分支的起点，轮换起点避免排在前面的分支总是优先
+    static thread_local uint32_t t_selectSeq = 0;
+}
+
+void sylar::Select::addCase(ChannelBase *channel, bool send, void *elem)
+{
+    Case c;
+    c.channel = channel;
+    c.send = send;
+    c.elem = elem;
+    m_cases.push_back(c);
+}
+
+void sylar::Select::lockAll()
+{
+    for (ChannelBase *channel : m_order)
+    {
+        channel->m_guard.lock();
+    }
+}
+
+void sylar::Select::unlockAll()
+{
+    for (auto it = m_order.rbegin(); it != m_order.rend(); ++it)
+    {
+        (*it)->m_guard.unlock();
+    }
+}
+
+int sylar::Select::run(bool block, uint64_t timeoutMs)
+{
+    size_t n = m_cases.size();
+    m_ok = false;
+    if (n == 0)
+    {
+        return -1;
+    }
+    // 同一个通道可能出现在多个分支中，按地址顺序加锁避免和其他select死锁
+    m_order.clear();
+    for (Case &c : m_cases)
+    {
+        m_order.push_back(c.channel);
+    }
+    std::sort(m_order.begin(), m_order.end());
+    m_order.erase(std::unique(m_order.begin(), m_order.end()), m_order.end());
+
+    lockAll();
+    uint32_t start = t_selectSeq++;
+    for (size_t k = 0; k < n; ++k)
+    {
+        size_t i = (start + k) % n;
+        Case &c = m_cases[i];
+        ChannelWaiter *wake = nullptr;
+        bool done = c.send ? c.channel->sendLocked(c.elem, m_ok, wake) : c.channel->recvLocked(c.elem, m_ok, wake);
+        if (done)
+        {
+            unlockAll();
+            if (wake)
+            {
+                ChannelBase::WakeWaiter(wake);
+            }
+            return i;
+        }
+    }
+    if (!block)
+    {
+        unlockAll();
+        return -1;
+    }
+
+    // 协程中带超时时定时器可能在select返回之后才触发，状态放在堆上由定时器共同持有
+    bool timed = timeoutMs != ~0ull;
+    IOManager *iom = timed ? IOManager::GetThis() : nullptr;
+    ChannelSelectState local;
+    std::shared_ptr<ChannelSelectState> shared;
+    ChannelSelectState *state = &local;
+    if (iom)
+    {
+        shared = std::make_shared<ChannelSelectState>();
+        state = shared.get();
+    }
+    FiberWaitQueue::Prepare(state->parker);
+    if (timed && state->parker.scheduler && !iom)
+    {
+        // 没有定时器可用，阻塞线程等待
+        state->parker.fiber.reset();
+        state->parker.scheduler = nullptr;
+    }
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        Case &c = m_cases[i];
+        c.waiter.elem = c.elem;
+        c.waiter.parker = &state->parker;
+        c.waiter.select = state;
+        c.waiter.caseIndex = i;
+        c.waiter.ok = false;
+        if (c.send)
+        {
+            c.channel->m_sendq.push(&c.waiter);
+        }
+        else
+        {
+            c.channel->m_recvq.push(&c.waiter);
+        }
+    }
+
+    Timer::ptr timer;
+    if (state->parker.scheduler && timed)
+    {
+        timer = iom->addTimer(timeoutMs, [shared]()
+                              {
+            uint32_t expected = 0;
+            if (shared->done.compare_exchange_strong(expected, 1, std::memory_order_acq_rel))
+            {
+                shared->index = -1;
+                FiberWaitQueue::Wake(&shared->parker);
+            } });
+    }
+    unlockAll();
+
+    if (state->parker.scheduler)
+    {
+        FiberWaitQueue::Suspend(state->parker);
+        if (timer)
+        {
+            timer->cancel();
+        }
+    }
+    else
+    {
+        struct timespec deadline;
+        if (timed)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += timeoutMs / 1000;
+            deadline.tv_nsec += (timeoutMs % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000)
+            {
+                ++deadline.tv_sec;
+                deadline.tv_nsec -= 1000000000;
+            }
+        }
+        while (!state->parker.woken.load(std::memory_order_acquire))
+        {
+            struct timespec timeout;
+            struct timespec *ptimeout = nullptr;
+            if (timed)
+            {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                int64_t ns = (deadline.tv_sec - now.tv_sec) * 1000000000LL + (deadline.tv_nsec - now.tv_nsec);
+                if (ns <= 0)
+                {
+                    uint32_t expected = 0;
+                    if (state->done.compare_exchange_strong(expected, 1, std::memory_order_acq_rel))
+                    {
+                        state->index = -1;
+                        break;
+                    }
+                    // 对端已经抢到这次select，等它唤醒
+                    timed = false;
+                    continue;
+                }
+                timeout.tv_sec = ns / 1000000000LL;
+                timeout.tv_nsec = ns % 1000000000LL;
+                ptimeout = &timeout;
+            }
+            FutexWait(&state->parker.woken, 0, ptimeout);
+        }
+    }
+
+    // 摘掉没有用上的等待者
+    lockAll();
+    for (Case &c : m_cases)
+    {
+        if (c.waiter.queued)
+        {
+            if (c.send)
+            {
+                c.channel->m_sendq.remove(&c.waiter);
+            }
+            else
+            {
+                c.channel->m_recvq.remove(&c.waiter);
+            }
+        }
+    }
+    unlockAll();
+
+    int index = state->index;
+    if (index >= 0)
+    {
+        m_ok = m_cases[index].waiter.ok;
+    }
+    return index;
+}
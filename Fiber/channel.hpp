@@ -0,0 +1,231 @@
+#ifndef __SYLAR_CHANNEL_H__
+#define __SYLAR_CHANNEL_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "fiber_sync.hpp"
+
+namespace sylar
+{
+    /**
+     * @brief 一次select的共享状态
+     * @details select在多个通道上各挂一个等待者，第一个把done从0改成1的一方完成这次select并唤醒它
+     */
+    struct ChannelSelectState
+    {
+        std::atomic<uint32_t> done{0};
+        /// 完成的分支下标，-1表示超时
+        int index = -1;
+        FiberWaiter parker;
+    };
+
+    /**
+     * @brief 通道上的一个等待者，放在等待方的栈上
+     */
+    struct ChannelWaiter
+    {
+        ChannelWaiter *prev = nullptr;
+        ChannelWaiter *next = nullptr;
+        /// 是否还在通道的等待队列中，由通道的锁保护
+        bool queued = false;
+        /// 发送方为要发送的值，接收方为接收值的位置
+        void *elem = nullptr;
+        /// 用来挂起和唤醒等待方
+        FiberWaiter *parker = nullptr;
+        /// 不是select时为空
+        ChannelSelectState *select = nullptr;
+        int caseIndex = -1;
+        /// 是否完成了收发，通道关闭时为false
+        bool ok = false;
+    };
+
+    /**
+     * @brief 通道的等待队列，双向链表，select结束时可以从中间摘掉没用上的等待者
+     */
+    class ChannelWaitQueue
+    {
+    public:
+        void push(ChannelWaiter *waiter);
+
+        void remove(ChannelWaiter *waiter);
+
+        /**
+         * @brief 取出队首可以配对的等待者
+         * @details 属于select的等待者要先抢到select的done，抢不到说明这次select已经在别处完成，丢掉继续找
+         */
+        ChannelWaiter *dequeue();
+
+    private:
+        ChannelWaiter *m_head = nullptr;
+        ChannelWaiter *m_tail = nullptr;
+    };
+
+    /**
+     * @brief 与元素类型无关的通道实现
+     * @details 有等待的对端时直接把值移动到对端，不经过缓冲区；否则放进环形缓冲区，缓冲区满（无缓冲通道总是满的）时排队挂起。
+     *          通道的锁只保护几条指令，等待者的挂起和唤醒都在锁外进行
+     */
+    class ChannelBase : Noncopyable
+    {
+    public:
+        ChannelBase(size_t capacity) : m_capacity(capacity) {}
+        virtual ~ChannelBase() {}
+
+        /**
+         * @brief 关闭通道
+         * @details 挂起的接收方和发送方都被唤醒并返回false，缓冲区中剩下的值仍然可以接收。重复关闭没有效果
+         */
+        void close();
+
+        bool isClosed();
+
+        /// @brief 缓冲区中的值的个数
+        size_t size();
+
+        size_t capacity() const { return m_capacity; }
+
+    protected:
+        bool sendImpl(void *elem, bool block);
+        bool recvImpl(void *elem, bool block);
+
+        /// @brief 缓冲区第index个位置
+        virtual void *slot(size_t index) = 0;
+        /// @brief 把src处的值移动到dst
+        virtual void moveElem(void *dst, void *src) = 0;
+
+    private:
+        friend class Select;
+
+        /**
+         * @brief 在锁内尝试发送
+         * @param[out] ok 是否发送成功，通道已关闭时为false
+         * @param[out] wake 需要在解锁后唤醒的接收方
+         * @return 是否不需要等待
+         */
+        bool sendLocked(void *elem, bool &ok, ChannelWaiter *&wake);
+
+        /// @brief 在锁内尝试接收，参数同sendLocked
+        bool recvLocked(void *elem, bool &ok, ChannelWaiter *&wake);
+
+        static void WakeWaiter(ChannelWaiter *waiter) { FiberWaitQueue::Wake(waiter->parker); }
+
+    private:
+        FutexMutex m_guard;
+        const size_t m_capacity;
+        size_t m_head = 0;
+        size_t m_count = 0;
+        bool m_closed = false;
+        ChannelWaitQueue m_sendq;
+        ChannelWaitQueue m_recvq;
+    };
+
+    /**
+     * @brief 协程通道
+     * @details capacity为0时是无缓冲通道，发送方要等到接收方取走值才返回。
+     *          收发在协程中挂起协程，在普通线程中阻塞线程，协程和线程之间可以共用一个通道。
+     *          T需要可以默认构造和移动赋值
+     */
+    template <class T>
+    class Channel : public ChannelBase
+    {
+    public:
+        typedef std::shared_ptr<Channel> ptr;
+
+        explicit Channel(size_t capacity = 0) : ChannelBase(capacity), m_buffer(capacity) {}
+
+        /**
+         * @brief 发送，缓冲区满时挂起
+         * @return 通道已关闭返回false，值被丢弃
+         */
+        bool send(T value) { return sendImpl(&value, true); }
+
+        /// @brief 不挂起的发送，缓冲区满或通道已关闭返回false
+        bool trySend(T value) { return sendImpl(&value, false); }
+
+        /**
+         * @brief 接收，没有值时挂起
+         * @return 通道已关闭且没有剩下的值时返回false，value不变
+         */
+        bool recv(T &value) { return recvImpl(&value, true); }
+
+        /// @brief 不挂起的接收，没有值或通道已关闭返回false
+        bool tryRecv(T &value) { return recvImpl(&value, false); }
+
+    protected:
+        void *slot(size_t index) override { return &m_buffer[index]; }
+
+        void moveElem(void *dst, void *src) override
+        {
+            *static_cast<T *>(dst) = std::move(*static_cast<T *>(src));
+        }
+
+    private:
+        std::vector<T> m_buffer;
+    };
+
+    /**
+     * @brief 在多个通道上同时等待收发，完成其中一个
+     * @details 先按通道地址顺序锁住所有通道，从轮换的起点开始检查能否立即完成；都不能完成时在每个通道上挂一个等待者，
+     *          第一个完成配对的对端（或超时定时器）唤醒当前协程，其余的等待者随后摘掉。
+     *          分支在多次wait之间保留，循环中可以复用同一个Select对象。
+     *          协程中的超时依赖IOManager的定时器，没有IOManager时和普通线程一样阻塞线程等待
+     */
+    class Select : Noncopyable
+    {
+    public:
+        /// @brief 发送分支，选中且通道未关闭时value被移走
+        template <class T>
+        Select &send(Channel<T> &channel, T &value)
+        {
+            addCase(&channel, true, &value);
+            return *this;
+        }
+
+        /// @brief 接收分支，选中时收到的值放在value中
+        template <class T>
+        Select &recv(Channel<T> &channel, T &value)
+        {
+            addCase(&channel, false, &value);
+            return *this;
+        }
+
+        /// @brief 挂起直到某个分支完成，返回分支下标（按添加顺序从0开始）
+        int wait() { return run(true, ~0ull); }
+
+        /// @brief 最多等待timeoutMs毫秒，超时返回-1
+        int wait(uint64_t timeoutMs) { return run(true, timeoutMs); }
+
+        /// @brief 不挂起，没有可以立即完成的分支返回-1
+        int tryWait() { return run(false, 0); }
+
+        /// @brief 选中的分支是否完成了收发，通道已关闭时为false
+        bool ok() const { return m_ok; }
+
+        void clear() { m_cases.clear(); }
+
+    private:
+        struct Case
+        {
+            ChannelBase *channel;
+            bool send;
+            void *elem;
+            ChannelWaiter waiter;
+        };
+
+        void addCase(ChannelBase *channel, bool send, void *elem);
+        int run(bool block, uint64_t timeoutMs);
+        void lockAll();
+        void unlockAll();
+
+    private:
+        std::vector<Case> m_cases;
+        /// 按地址排序去重后的通道，加锁顺序
+        std::vector<ChannelBase *> m_order;
+        bool m_ok = false;
+    };
+}
+
+#endif
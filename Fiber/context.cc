@@ -0,0 +1,187 @@
+#include "context.hpp"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+
+extern "C" void sylar_context_switch(sylar::FiberContext *from, sylar::FiberContext to);
+extern "C" void sylar_context_trampoline();
+
+// 栈布局（从低地址到高地址）：mxcsr/x87控制字, r12, r13, r14, r15, rbx, rbp, 返回地址
+asm(R"(
+    .text
+    .globl sylar_context_switch
+    .hidden sylar_context_switch
+    .type sylar_context_switch,@function
+    .align 16
+sylar_context_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r15
+    pushq %r14
+    pushq %r13
+    pushq %r12
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r12
+    popq %r13
+    popq %r14
+    popq %r15
+    popq %rbx
+    popq %rbp
+    ret
+    .size sylar_context_switch,.-sylar_context_switch
+
+    .globl sylar_context_trampoline
+    .hidden sylar_context_trampoline
+    .type sylar_context_trampoline,@function
+    .align 16
+sylar_context_trampoline:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size sylar_context_trampoline,.-sylar_context_trampoline
+)");
+
+sylar::FiberContext sylar::MakeFiberContext(void *stack, size_t size, FiberEntry entry, void *arg)
+{
+    uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + size) & ~uintptr_t(15);
+    uint64_t *sp = reinterpret_cast<uint64_t *>(top) - 8;
+    // 跳板开始执行时rsp按16字节对齐，之后的call满足ABI要求
+    uint32_t mxcsr = 0x1F80;
+    uint16_t fpucw = 0x037F;
+    memcpy(&sp[0], &mxcsr, sizeof(mxcsr));
+    memcpy(reinterpret_cast<char *>(&sp[0]) + 4, &fpucw, sizeof(fpucw));
+    sp[1] = reinterpret_cast<uint64_t>(arg);   // r12
+    sp[2] = reinterpret_cast<uint64_t>(entry); // r13
+    sp[3] = 0;                                 // r14
+    sp[4] = 0;                                 // r15
+    sp[5] = 0;                                 // rbx
+    sp[6] = 0;                                 // rbp
+    sp[7] = reinterpret_cast<uint64_t>(&sylar_context_trampoline);
+    return sp;
+}
+
+void sylar::SwitchFiberContext(FiberContext *from, FiberContext to)
+{
+    sylar_context_switch(from, to);
+}
+
+#elif defined(__aarch64__)
+
+extern "C" void sylar_context_switch(sylar::FiberContext *from, sylar::FiberContext to);
+extern "C" void sylar_context_trampoline();
+
+// 栈布局（从低地址到高地址）：d8-d15, x19-x28, x29, x30
+asm(R"(
+    .text
+    .globl sylar_context_switch
+    .hidden sylar_context_switch
+    .type sylar_context_switch,%function
+    .align 4
+sylar_context_switch:
+    sub sp, sp, #160
+    stp d8, d9, [sp, #0]
+    stp d10, d11, [sp, #16]
+    stp d12, d13, [sp, #32]
+    stp d14, d15, [sp, #48]
+    stp x19, x20, [sp, #64]
+    stp x21, x22, [sp, #80]
+    stp x23, x24, [sp, #96]
+    stp x25, x26, [sp, #112]
+    stp x27, x28, [sp, #128]
+    stp x29, x30, [sp, #144]
+    mov x9, sp
+    str x9, [x0]
+    mov sp, x1
+    ldp d8, d9, [sp, #0]
+    ldp d10, d11, [sp, #16]
+    ldp d12, d13, [sp, #32]
+    ldp d14, d15, [sp, #48]
+    ldp x19, x20, [sp, #64]
+    ldp x21, x22, [sp, #80]
+    ldp x23, x24, [sp, #96]
+    ldp x25, x26, [sp, #112]
+    ldp x27, x28, [sp, #128]
+    ldp x29, x30, [sp, #144]
+    add sp, sp, #160
+    ret
+    .size sylar_context_switch,.-sylar_context_switch
+
+    .globl sylar_context_trampoline
+    .hidden sylar_context_trampoline
+    .type sylar_context_trampoline,%function
+    .align 4
+sylar_context_trampoline:
+    mov x0, x19
+    blr x20
+    brk #0
+    .size sylar_context_trampoline,.-sylar_context_trampoline
+)");
+
+sylar::FiberContext sylar::MakeFiberContext(void *stack, size_t size, FiberEntry entry, void *arg)
+{
+    uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + size) & ~uintptr_t(15);
+    uint64_t *sp = reinterpret_cast<uint64_t *>(top) - 20;
+    memset(sp, 0, 20 * sizeof(uint64_t));
+    sp[8] = reinterpret_cast<uint64_t>(arg);    // x19
+    sp[9] = reinterpret_cast<uint64_t>(entry);  // x20
+    sp[19] = reinterpret_cast<uint64_t>(&sylar_context_trampoline); // x30
+    return sp;
+}
+
+void sylar::SwitchFiberContext(FiberContext *from, FiberContext to)
+{
+    sylar_context_switch(from, to);
+}
+
+#else
+
+#include <ucontext.h>
+
+namespace sylar
+{
+    /// 其他架构上上下文指向ucontext_t，初始的ucontext_t放在栈顶
+    struct UcontextFrame
+    {
+        ucontext_t ctx;
+        FiberEntry entry;
+        void *arg;
+    };
+
+    static void UcontextEntry(unsigned int hi, unsigned int lo)
+    {
+        UcontextFrame *frame = reinterpret_cast<UcontextFrame *>((uintptr_t(hi) << 32) | lo);
+        frame->entry(frame->arg);
+    }
+}
+
+sylar::FiberContext sylar::MakeFiberContext(void *stack, size_t size, FiberEntry entry, void *arg)
+{
+    uintptr_t top = (reinterpret_cast<uintptr_t>(stack) + size - sizeof(UcontextFrame)) & ~uintptr_t(15);
+    UcontextFrame *frame = reinterpret_cast<UcontextFrame *>(top);
+    frame->entry = entry;
+    frame->arg = arg;
+    getcontext(&frame->ctx);
+    frame->ctx.uc_link = nullptr;
+    frame->ctx.uc_stack.ss_sp = stack;
+    frame->ctx.uc_stack.ss_size = top - reinterpret_cast<uintptr_t>(stack);
+    uintptr_t p = reinterpret_cast<uintptr_t>(frame);
+    makecontext(&frame->ctx, (void (*)())UcontextEntry, 2, (unsigned int)(p >> 32), (unsigned int)p);
+    return &frame->ctx;
+}
+
+void sylar::SwitchFiberContext(FiberContext *from, FiberContext to)
+{
+    ucontext_t self;
+    *from = &self;
+    swapcontext(&self, static_cast<ucontext_t *>(to));
+}
+
+#endif
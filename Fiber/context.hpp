@@ -0,0 +1,29 @@
+#ifndef __SYLAR_CONTEXT_H__
+#define __SYLAR_CONTEXT_H__
+
+#include <cstddef>
+
+namespace sylar
+{
+    /// @brief 保存的执行上下文，即切换出去时的栈指针，寄存器都保存在栈上
+    typedef void *FiberContext;
+
+    /// @brief 上下文的入口函数，不能返回
+    typedef void (*FiberEntry)(void *arg);
+
+    /**
+     * @brief 在一块新栈上构造初始上下文，第一次切换到它时调用entry(arg)
+     * @param stack 栈的最低地址
+     * @param size 栈大小
+     */
+    FiberContext MakeFiberContext(void *stack, size_t size, FiberEntry entry, void *arg);
+
+    /**
+     * @brief 保存当前上下文到*from并切换到to
+     * @details x86-64和aarch64上是手写汇编，只保存ABI规定的被调用者保存寄存器和浮点控制字，
+     *          不像swapcontext那样每次都调用sigprocmask进入内核；其他架构退化为ucontext
+     */
+    void SwitchFiberContext(FiberContext *from, FiberContext to);
+}
+
+#endif
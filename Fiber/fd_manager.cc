@@ -0,0 +1,133 @@
+#include "fd_manager.hpp"
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "hook.hpp"
+
+sylar::FdCtx::FdCtx(int fd)
+    : m_isInit(false), m_isSocket(false), m_sysNonblock(false), m_userNonblock(false), m_isClosed(false),
+      m_fd(fd), m_recvTimeout(~0ull), m_sendTimeout(~0ull)
+{
+    init();
+}
+
+bool sylar::FdCtx::init()
+{
+    if (m_isInit)
+    {
+        return true;
+    }
+    m_recvTimeout = ~0ull;
+    m_sendTimeout = ~0ull;
+
+    struct stat fd_stat;
+    if (-1 == fstat(m_fd, &fd_stat))
+    {
+        m_isInit = false;
+        m_isSocket = false;
+    }
+    else
+    {
+        m_isInit = true;
+        m_isSocket = S_ISSOCK(fd_stat.st_mode);
+    }
+
+    // socket在系统层面总是设为非阻塞，用户看到的阻塞语义由hook模拟
+    if (m_isSocket)
+    {
+        int flags = fcntl_f(m_fd, F_GETFL, 0);
+        if (!(flags & O_NONBLOCK))
+        {
+            fcntl_f(m_fd, F_SETFL, flags | O_NONBLOCK);
+        }
+        m_sysNonblock = true;
+    }
+    else
+    {
+        m_sysNonblock = false;
+    }
+
+    m_userNonblock = false;
+    m_isClosed = false;
+    return m_isInit;
+}
+
+void sylar::FdCtx::setTimeout(int type, uint64_t v)
+{
+    if (type == SO_RCVTIMEO)
+    {
+        m_recvTimeout = v;
+    }
+    else
+    {
+        m_sendTimeout = v;
+    }
+}
+
+uint64_t sylar::FdCtx::getTimeout(int type)
+{
+    if (type == SO_RCVTIMEO)
+    {
+        return m_recvTimeout;
+    }
+    return m_sendTimeout;
+}
+
+sylar::FdManager::FdManager()
+{
+    m_datas.resize(64);
+}
+
+sylar::FdCtx::ptr sylar::FdManager::get(int fd, bool auto_create)
+{
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if ((int)m_datas.size() > fd)
+        {
+            if (m_datas[fd] || !auto_create)
+            {
+                return m_datas[fd];
+            }
+        }
+        else if (!auto_create)
+        {
+            return nullptr;
+        }
+    }
+
+    RWMutexType::WriteLock lock(m_mutex);
+    if ((int)m_datas.size() <= fd)
+    {
+        m_datas.resize(fd * 1.5 + 1);
+    }
+    if (!m_datas[fd])
+    {
+        m_datas[fd].reset(new FdCtx(fd));
+    }
+    return m_datas[fd];
+}
+
+void sylar::FdManager::del(int fd)
+{
+    RWMutexType::WriteLock lock(m_mutex);
+    if (fd < 0 || (int)m_datas.size() <= fd)
+    {
+        return;
+    }
+    if (m_datas[fd])
+    {
+        // 其他协程手里的FdCtx::ptr可以看到fd已经关闭
+        m_datas[fd]->m_isClosed = true;
+        m_datas[fd].reset();
+    }
+}
+
+sylar::FdManager *sylar::FdMgr::GetInstance()
+{
+    static FdManager *v = new FdManager;
+    return v;
+}
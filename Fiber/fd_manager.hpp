@@ -0,0 +1,90 @@
+#ifndef __SYLAR_FD_MANAGER_H__
+#define __SYLAR_FD_MANAGER_H__
+
+#include <memory>
+#include <vector>
+#include "../Utility/cmutex.hpp"
+
+namespace sylar
+{
+    /**
+     * @brief hook层记录的fd状态
+     * @details 是否socket、用户是否设置了非阻塞、系统层面是否已设为非阻塞以及读写超时
+     */
+    class FdCtx : public std::enable_shared_from_this<FdCtx>
+    {
+        friend class FdManager;
+
+    public:
+        typedef std::shared_ptr<FdCtx> ptr;
+
+        FdCtx(int fd);
+
+        bool isInit() const { return m_isInit; }
+        bool isSocket() const { return m_isSocket; }
+        bool isClose() const { return m_isClosed; }
+
+        /// @brief 用户主动设置的非阻塞
+        void setUserNonblock(bool v) { m_userNonblock = v; }
+        bool getUserNonblock() const { return m_userNonblock; }
+
+        /// @brief 实际设置到fd上的非阻塞，hook的socket总是非阻塞
+        void setSysNonblock(bool v) { m_sysNonblock = v; }
+        bool getSysNonblock() const { return m_sysNonblock; }
+
+        /**
+         * @brief 设置超时
+         * @param type SO_RCVTIMEO或SO_SNDTIMEO
+         * @param v 毫秒，~0ull表示不超时
+         */
+        void setTimeout(int type, uint64_t v);
+        uint64_t getTimeout(int type);
+
+    private:
+        bool init();
+
+    private:
+        bool m_isInit : 1;
+        bool m_isSocket : 1;
+        bool m_sysNonblock : 1;
+        bool m_userNonblock : 1;
+        bool m_isClosed : 1;
+        int m_fd;
+        uint64_t m_recvTimeout;
+        uint64_t m_sendTimeout;
+    };
+
+    /**
+     * @brief fd状态表
+     * @details 以fd为下标的数组，查找只需要一次读锁加下标，不够大时按1.5倍扩容
+     */
+    class FdManager
+    {
+    public:
+        typedef DistributedRWMutex RWMutexType;
+
+        FdManager();
+
+        /**
+         * @brief 获取fd的状态
+         * @param auto_create 不存在时是否创建
+         */
+        FdCtx::ptr get(int fd, bool auto_create = false);
+
+        /// @brief 删除fd的状态并标记为已关闭，在close时调用
+        void del(int fd);
+
+    private:
+        RWMutexType m_mutex;
+        std::vector<FdCtx::ptr> m_datas;
+    };
+
+    /// @brief FdManager单例，故意不析构：退出时其他静态对象的析构函数仍可能调用被hook的close
+    class FdMgr
+    {
+    public:
+        static FdManager *GetInstance();
+    };
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include "fiber.hpp"
+#include "stack_allocator.hpp"
+#include <atomic>
+#include <cassert>
+
+#if defined(__SANITIZE_THREAD__)
+#include <sanitizer/tsan_interface.h>
+#define SYLAR_TSAN_FIBER 1
+#endif
+
+namespace sylar
+{
+    static Logger::ptr g_logger = SYLAR_LOG("system");
+
+    /// 子协程id从1开始，0留给主协程和不在协程中运行的代码
+    static std::atomic<uint64_t> s_fiberId{0};
+    static std::atomic<uint64_t> s_fiberCount{0};
+    static std::atomic<size_t> s_defaultStackSize{128 * 1024};
+
+    /// 当前线程正在运行的协程
+    static thread_local Fiber *t_fiber = nullptr;
+    /// 当前线程的主协程
+    static thread_local Fiber::ptr t_threadFiber = nullptr;
+
+    typedef FiberStackPool StackAllocator;
+}
+
+sylar::Fiber::Fiber()
+{
+    m_state = RUNNING;
+    SetThis(this);
+    ++s_fiberCount;
+#ifdef SYLAR_TSAN_FIBER
+    m_tsanFiber = __tsan_get_current_fiber();
+#endif
+}
+
+sylar::Fiber::Fiber(std::function<void()> cb, size_t stacksize)
+    : m_id(++s_fiberId), m_cb(std::move(cb))
+{
+    ++s_fiberCount;
+    m_stacksize = StackAllocator::RoundSize(stacksize ? stacksize : s_defaultStackSize.load(std::memory_order_relaxed));
+    m_stack = StackAllocator::Alloc(m_stacksize);
+    m_ctx = MakeFiberContext(m_stack, m_stacksize, &Fiber::MainFunc, this);
+#ifdef SYLAR_TSAN_FIBER
+    m_tsanFiber = __tsan_create_fiber(0);
+#endif
+}
+
+sylar::Fiber::~Fiber()
+{
+    --s_fiberCount;
+    if (m_stack)
+    {
+        assert(m_state != RUNNING);
+        StackAllocator::Dealloc(m_stack, m_stacksize);
+#ifdef SYLAR_TSAN_FIBER
+        __tsan_destroy_fiber(m_tsanFiber);
+#endif
+    }
+    else
+    {
+        // 主协程
+        assert(!m_cb);
+        assert(m_state == RUNNING);
+        if (t_fiber == this)
+        {
+            SetThis(nullptr);
+        }
+    }
+}
+
+size_t sylar::Fiber::getStackHighWaterMark() const
+{
+    return m_stack ? StackAllocator::HighWaterMark(m_stack, m_stacksize) : 0;
+}
+
+void sylar::Fiber::reset(std::function<void()> cb)
+{
+    assert(m_stack);
+    assert(m_state == TERM);
+    m_cb = std::move(cb);
+    m_ctx = MakeFiberContext(m_stack, m_stacksize, &Fiber::MainFunc, this);
+    m_state = READY;
+}
+
+void sylar::Fiber::switchTo(Fiber *to)
+{
+    SetThis(to);
+    SetFiberId(to->m_id);
+    TraceContext::Switch(m_trace, to->m_trace);
+#ifdef SYLAR_TSAN_FIBER
+    __tsan_switch_to_fiber(to->m_tsanFiber, 0);
+#endif
+    SwitchFiberContext(&m_ctx, to->m_ctx);
+}
+
+sylar::Fiber::State sylar::Fiber::resume()
+{
+    assert(m_state == READY);
+    Fiber *cur = GetThisRaw();
+    assert(cur != this);
+    m_resumer = cur;
+    m_state = RUNNING;
+    cur->switchTo(this);
+    // 回到这里时本协程的上下文已经保存，可以交给其他线程resume
+    State state = m_state.load(std::memory_order_relaxed);
+    if (state == RUNNING)
+    {
+        state = READY;
+        m_state.store(READY, std::memory_order_release);
+    }
+    return state;
+}
+
+void sylar::Fiber::yield()
+{
+    assert(t_fiber == this);
+    assert(m_resumer);
+    Fiber *to = m_resumer;
+    m_resumer = nullptr;
+    switchTo(to);
+}
+
+void sylar::Fiber::SetThis(Fiber *fiber)
+{
+    t_fiber = fiber;
+}
+
+sylar::Fiber *sylar::Fiber::GetThisRaw()
+{
+    if (!t_fiber)
+    {
+        t_threadFiber.reset(new Fiber);
+    }
+    return t_fiber;
+}
+
+sylar::Fiber::ptr sylar::Fiber::GetThis()
+{
+    return GetThisRaw()->shared_from_this();
+}
+
+uint64_t sylar::Fiber::TotalFibers()
+{
+    return s_fiberCount;
+}
+
+uint64_t sylar::Fiber::GetFiberId()
+{
+    return t_fiber ? t_fiber->m_id : 0;
+}
+
+size_t sylar::Fiber::GetDefaultStackSize()
+{
+    return s_defaultStackSize;
+}
+
+void sylar::Fiber::SetDefaultStackSize(size_t size)
+{
+    s_defaultStackSize = size;
+}
+
+void sylar::Fiber::MainFunc(void *arg)
+{
+    Fiber *cur = static_cast<Fiber *>(arg);
+    try
+    {
+        cur->m_cb();
+    }
+    catch (std::exception &ex)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "Fiber Except: " << ex.what() << " fiber_id=" << cur->getId();
+    }
+    catch (...)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "Fiber Except fiber_id=" << cur->getId();
+    }
+    cur->m_cb = nullptr;
+    cur->m_state = TERM;
+    cur->yield();
+    // 结束的协程不会再被切换回来
+    abort();
+}
@@ -0,0 +1,111 @@
+#ifndef __SYLAR_FIBER_H__
+#define __SYLAR_FIBER_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "context.hpp"
+#include "../Logger/log.hpp"
+
+namespace sylar
+{
+    /**
+     * @brief 协程
+     * @details 非对称协程：resume()从当前协程切换到目标协程，目标协程yield()时切回resume它的协程。
+     *          每个线程第一次调用GetThis()时创建一个没有独立栈的主协程代表线程本身。
+     *          切换时同时切换日志的跟踪上下文和GetFiberId()的返回值
+     */
+    class Fiber : public std::enable_shared_from_this<Fiber>
+    {
+    public:
+        typedef std::shared_ptr<Fiber> ptr;
+
+        /// @brief 协程状态
+        enum State
+        {
+            /// 可以运行，刚创建或者yield出来
+            READY,
+            /// 正在运行
+            RUNNING,
+            /// 执行函数已经返回
+            TERM
+        };
+
+    private:
+        /// @brief 构造线程的主协程
+        Fiber();
+
+    public:
+        /// @brief 构造子协程
+        /// @param cb 协程执行函数
+        /// @param stacksize 栈大小，0表示使用默认大小
+        Fiber(std::function<void()> cb, size_t stacksize = 0);
+
+        ~Fiber();
+
+        /// @brief 复用已结束协程的栈，重新设置执行函数
+        void reset(std::function<void()> cb);
+
+        /**
+         * @brief 从当前协程切换到本协程执行
+         * @return 切回时本协程的状态，READY表示yield出来，TERM表示已经执行完。
+         *         yield出来的协程返回后可能已经被其他线程resume甚至执行完，不能再用getState()判断
+         */
+        State resume();
+
+        /// @brief 本协程让出执行权，切回resume它的协程
+        void yield();
+
+        uint64_t getId() const { return m_id; }
+
+        State getState() const { return m_state.load(std::memory_order_acquire); }
+
+        /// @brief 栈的最大使用量，见FiberStackPool::HighWaterMark，主协程返回0
+        size_t getStackHighWaterMark() const;
+
+    public:
+        /// @brief 设置当前线程正在运行的协程
+        static void SetThis(Fiber *fiber);
+
+        /// @brief 返回当前线程正在运行的协程，没有时创建主协程
+        static Fiber::ptr GetThis();
+
+        /// @brief 当前存在的协程总数
+        static uint64_t TotalFibers();
+
+        /// @brief 当前协程的id，主协程为0
+        static uint64_t GetFiberId();
+
+        /// @brief 默认栈大小
+        static size_t GetDefaultStackSize();
+        static void SetDefaultStackSize(size_t size);
+
+    private:
+        /// @brief 协程入口，执行完后切回resume它的协程
+        static void MainFunc(void *arg);
+
+        /// @brief 当前线程正在运行的协程，没有时创建主协程
+        static Fiber *GetThisRaw();
+
+        /// @brief 切换到to，保存当前上下文
+        void switchTo(Fiber *to);
+
+    private:
+        uint64_t m_id = 0;
+        uint32_t m_stacksize = 0;
+        /// 在resume返回、上下文已经保存之后才变为READY，其他线程看到READY时可以安全地resume它
+        std::atomic<State> m_state{READY};
+        FiberContext m_ctx = nullptr;
+        void *m_stack = nullptr;
+        std::function<void()> m_cb;
+        /// resume本协程的协程，yield时切回它
+        Fiber *m_resumer = nullptr;
+        /// 本协程换出时的日志跟踪上下文
+        TraceContext::State m_trace;
+        /// ThreadSanitizer的协程句柄，开启TSan时切换栈需要告诉它
+        void *m_tsanFiber = nullptr;
+    };
+}
+
+#endif
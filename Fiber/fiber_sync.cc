@@ -0,0 +1,429 @@
+#include "fiber_sync.hpp"
+#include "scheduler.hpp"
+#include "../Utility/util.h"
+
+void sylar::FiberWaitQueue::push(FiberWaiter *waiter)
+{
+    waiter->next = nullptr;
+    if (m_tail)
+    {
+        m_tail->next = waiter;
+    }
+    else
+    {
+        m_head = waiter;
+    }
+    m_tail = waiter;
+}
+
+void sylar::FiberWaitQueue::pushFront(FiberWaiter *waiter)
+{
+    waiter->next = m_head;
+    m_head = waiter;
+    if (!m_tail)
+    {
+        m_tail = waiter;
+    }
+}
+
+sylar::FiberWaiter *sylar::FiberWaitQueue::pop()
+{
+    FiberWaiter *waiter = m_head;
+    if (waiter)
+    {
+        m_head = waiter->next;
+        if (!m_head)
+        {
+            m_tail = nullptr;
+        }
+        waiter->next = nullptr;
+    }
+    return waiter;
+}
+
+void sylar::FiberWaitQueue::Prepare(FiberWaiter &waiter)
+{
+    // 调度循环本身不能yield，和普通线程一样在futex上等待
+    Scheduler *scheduler = Scheduler::GetThis();
+    if (scheduler)
+    {
+        Fiber::ptr fiber = Fiber::GetThis();
+        if (fiber.get() != Scheduler::GetMainFiber())
+        {
+            waiter.fiber = std::move(fiber);
+            waiter.scheduler = scheduler;
+        }
+    }
+}
+
+void sylar::FiberWaitQueue::Suspend(FiberWaiter &waiter)
+{
+    if (waiter.scheduler)
+    {
+        // 唤醒可能发生在yield之前，调度器看到协程还在运行会稍后再试
+        Fiber::GetThis()->yield();
+        return;
+    }
+    while (!waiter.woken.load(std::memory_order_acquire))
+    {
+        FutexWait(&waiter.woken, 0, nullptr);
+    }
+}
+
+void sylar::FiberWaitQueue::Wake(FiberWaiter *waiter)
+{
+    if (waiter->cb)
+    {
+        if (waiter->scheduler)
+        {
+            waiter->scheduler->schedule(waiter->cb);
+        }
+        else
+        {
+            std::function<void()> cb = waiter->cb;
+            cb();
+        }
+        return;
+    }
+    if (waiter->scheduler)
+    {
+        Scheduler *scheduler = waiter->scheduler;
+        Fiber::ptr fiber = std::move(waiter->fiber);
+        scheduler->schedule(std::move(fiber));
+        return;
+    }
+    waiter->woken.store(1, std::memory_order_release);
+    FutexWake(&waiter->woken, 1);
+}
+
+namespace sylar
+{
+    /// @brief 把一串用next连起来的等待者逐个唤醒
+    static void WakeAll(FiberWaiter *waiter)
+    {
+        while (waiter)
+        {
+            FiberWaiter *next = waiter->next;
+            FiberWaitQueue::Wake(waiter);
+            waiter = next;
+        }
+    }
+}
+
+void sylar::FiberMutex::lockSlow()
+{
+    // 持有者通常很快释放，先自旋一会儿
+    int spins = AdaptiveSpinCount();
+    for (int i = 0; i < spins; ++i)
+    {
+        CpuRelax();
+        if (m_state.load(std::memory_order_relaxed) == 0 && tryLock())
+        {
+            return;
+        }
+    }
+
+    uint64_t start = 0;
+    bool requeue = false;
+    while (true)
+    {
+        FiberWaiter waiter;
+        FiberWaitQueue::Prepare(waiter);
+        if (lockOrEnqueue(waiter, requeue, start))
+        {
+            return;
+        }
+        FiberWaitQueue::Suspend(waiter);
+        if (waiter.handoff)
+        {
+            return;
+        }
+        // 被唤醒后和新来的协程一起抢锁
+        requeue = true;
+    }
+}
+
+bool sylar::FiberMutex::lockOrEnqueue(FiberWaiter &waiter, bool requeue, uint64_t &start)
+{
+    FutexMutex::Lock guard(m_guard);
+    // 标记有等待者，原来未加锁则直接拿到锁
+    if (m_state.exchange(2, std::memory_order_acquire) == 0)
+    {
+        return true;
+    }
+    if (!start)
+    {
+        start = GetCoarseMS();
+    }
+    else if (GetCoarseMS() - start >= kStarvationMs)
+    {
+        m_starving = true;
+    }
+
+    if (requeue)
+    {
+        m_waiters.pushFront(&waiter);
+    }
+    else
+    {
+        m_waiters.push(&waiter);
+    }
+    return false;
+}
+
+void sylar::FiberMutex::unlockSlow()
+{
+    FutexMutex::Lock guard(m_guard);
+    FiberWaiter *waiter = m_waiters.pop();
+    if (waiter && m_starving)
+    {
+        // 饥饿模式：锁保持加锁状态直接交给队首
+        waiter->handoff = true;
+        if (m_waiters.empty())
+        {
+            m_starving = false;
+            m_state.store(1, std::memory_order_relaxed);
+        }
+        guard.unlock();
+        FiberWaitQueue::Wake(waiter);
+        return;
+    }
+    if (!waiter)
+    {
+        m_starving = false;
+    }
+    m_state.store(0, std::memory_order_release);
+    guard.unlock();
+    if (waiter)
+    {
+        FiberWaitQueue::Wake(waiter);
+    }
+}
+
+bool sylar::FiberSemaphore::tryWait()
+{
+    uint32_t count = m_count.load(std::memory_order_relaxed);
+    while (count > 0)
+    {
+        if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void sylar::FiberSemaphore::wait()
+{
+    if (tryWait())
+    {
+        return;
+    }
+    int spins = AdaptiveSpinCount();
+    for (int i = 0; i < spins; ++i)
+    {
+        CpuRelax();
+        if (m_count.load(std::memory_order_relaxed) && tryWait())
+        {
+            return;
+        }
+    }
+
+    FiberWaiter waiter;
+    FiberWaitQueue::Prepare(waiter);
+    if (!waitOrEnqueue(waiter))
+    {
+        // notify已经替我们扣掉了计数
+        FiberWaitQueue::Suspend(waiter);
+    }
+}
+
+bool sylar::FiberSemaphore::waitOrEnqueue(FiberWaiter &waiter)
+{
+    FutexMutex::Lock guard(m_guard);
+    // 先登记再检查计数，和notify中先加计数再检查等待者配对，不会丢失唤醒
+    m_waiterCount.fetch_add(1, std::memory_order_seq_cst);
+    if (tryWait())
+    {
+        m_waiterCount.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    m_waiters.push(&waiter);
+    return false;
+}
+
+void sylar::FiberSemaphore::notify(uint32_t n)
+{
+    m_count.fetch_add(n, std::memory_order_seq_cst);
+    if (m_waiterCount.load(std::memory_order_seq_cst) == 0)
+    {
+        return;
+    }
+
+    FiberWaiter *woken = nullptr;
+    FiberWaiter **tail = &woken;
+    {
+        FutexMutex::Lock guard(m_guard);
+        while (!m_waiters.empty() && tryWait())
+        {
+            FiberWaiter *waiter = m_waiters.pop();
+            m_waiterCount.fetch_sub(1, std::memory_order_relaxed);
+            *tail = waiter;
+            tail = &waiter->next;
+        }
+    }
+    WakeAll(woken);
+}
+
+void sylar::FiberCondition::wait(FiberMutex &mutex)
+{
+    FiberWaiter waiter;
+    // 入队后才释放mutex，持有mutex修改条件再notify的一方一定能看到我们
+    FiberWaitQueue::Prepare(waiter);
+    {
+        FutexMutex::Lock guard(m_guard);
+        m_waiters.push(&waiter);
+    }
+    mutex.unlock();
+    FiberWaitQueue::Suspend(waiter);
+    mutex.lock();
+}
+
+void sylar::FiberCondition::notify()
+{
+    FiberWaiter *waiter;
+    {
+        FutexMutex::Lock guard(m_guard);
+        waiter = m_waiters.pop();
+    }
+    if (waiter)
+    {
+        FiberWaitQueue::Wake(waiter);
+    }
+}
+
+void sylar::FiberCondition::notifyAll()
+{
+    FiberWaiter *woken = nullptr;
+    FiberWaiter **tail = &woken;
+    {
+        FutexMutex::Lock guard(m_guard);
+        while (FiberWaiter *waiter = m_waiters.pop())
+        {
+            *tail = waiter;
+            tail = &waiter->next;
+        }
+    }
+    WakeAll(woken);
+}
+
+bool sylar::FiberRWMutex::tryRdlock()
+{
+    FutexMutex::Lock guard(m_guard);
+    if (!m_writer && !m_waitingWriters)
+    {
+        ++m_readers;
+        return true;
+    }
+    return false;
+}
+
+bool sylar::FiberRWMutex::tryWrlock()
+{
+    FutexMutex::Lock guard(m_guard);
+    if (!m_writer && !m_readers)
+    {
+        m_writer = true;
+        return true;
+    }
+    return false;
+}
+
+void sylar::FiberRWMutex::rdlock()
+{
+    int spins = AdaptiveSpinCount();
+    for (int i = 0; i < spins; ++i)
+    {
+        if (tryRdlock())
+        {
+            return;
+        }
+        CpuRelax();
+    }
+
+    FutexMutex::Lock guard(m_guard);
+    if (!m_writer && !m_waitingWriters)
+    {
+        ++m_readers;
+        return;
+    }
+    FiberWaiter waiter;
+    m_readWaiters.push(&waiter);
+    FiberWaitQueue::Wait(waiter, guard);
+    // 唤醒方已经替我们加上了读者计数
+}
+
+void sylar::FiberRWMutex::wrlock()
+{
+    int spins = AdaptiveSpinCount();
+    for (int i = 0; i < spins; ++i)
+    {
+        if (tryWrlock())
+        {
+            return;
+        }
+        CpuRelax();
+    }
+
+    FutexMutex::Lock guard(m_guard);
+    if (!m_writer && !m_readers)
+    {
+        m_writer = true;
+        return;
+    }
+    ++m_waitingWriters;
+    FiberWaiter waiter;
+    m_writeWaiters.push(&waiter);
+    FiberWaitQueue::Wait(waiter, guard);
+    // 唤醒方已经把写锁交给了我们
+}
+
+void sylar::FiberRWMutex::unlock()
+{
+    FiberWaiter *woken = nullptr;
+    FiberWaiter **tail = &woken;
+    {
+        FutexMutex::Lock guard(m_guard);
+        bool wasWriter = m_writer;
+        if (m_writer)
+        {
+            m_writer = false;
+        }
+        else
+        {
+            --m_readers;
+        }
+        if (m_readers)
+        {
+            return;
+        }
+
+        if (wasWriter && !m_readWaiters.empty())
+        {
+            // 写阶段结束，放行所有排队的读者
+            while (FiberWaiter *waiter = m_readWaiters.pop())
+            {
+                ++m_readers;
+                *tail = waiter;
+                tail = &waiter->next;
+            }
+        }
+        else if (FiberWaiter *waiter = m_writeWaiters.pop())
+        {
+            --m_waitingWriters;
+            m_writer = true;
+            woken = waiter;
+        }
+    }
+    WakeAll(woken);
+}
@@ -0,0 +1,225 @@
+#ifndef __SYLAR_FIBER_SYNC_H__
+#define __SYLAR_FIBER_SYNC_H__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "fiber.hpp"
+#include "../Utility/cmutex.hpp"
+
+namespace sylar
+{
+    class Scheduler;
+
+    /**
+     * @brief 等待队列中的一个等待者，放在等待方的栈上
+     * @details 在调度器的协程中等待时保存协程，唤醒时把协程重新交给调度器；
+     *          在普通线程（或调度循环本身）中等待时在futex上睡眠；
+     *          设置了cb时（无栈协程）唤醒时把cb交给调度器，没有调度器时直接调用
+     */
+    struct FiberWaiter
+    {
+        FiberWaiter *next = nullptr;
+        Fiber::ptr fiber;
+        Scheduler *scheduler = nullptr;
+        std::function<void()> cb;
+        std::atomic<uint32_t> woken{0};
+        /// 唤醒方是否已经把锁直接交给了等待者
+        bool handoff = false;
+    };
+
+    /**
+     * @brief FIFO等待队列，调用方持有保护它的锁
+     */
+    class FiberWaitQueue
+    {
+    public:
+        bool empty() const { return !m_head; }
+
+        void push(FiberWaiter *waiter);
+
+        /// @brief 插到队首，用于被唤醒后没抢到锁的等待者
+        void pushFront(FiberWaiter *waiter);
+
+        FiberWaiter *pop();
+
+        /**
+         * @brief 挂起当前协程或线程直到被wake()
+         * @details 调用前waiter已经入队，lock是保护队列的锁，在挂起前释放
+         */
+        template <class LockType>
+        static void Wait(FiberWaiter &waiter, LockType &lock)
+        {
+            Prepare(waiter);
+            lock.unlock();
+            Suspend(waiter);
+        }
+
+        /// @brief 记录当前的协程和调度器
+        static void Prepare(FiberWaiter &waiter);
+
+        /// @brief 挂起直到被唤醒
+        static void Suspend(FiberWaiter &waiter);
+
+        /// @brief 唤醒等待者，之后不能再访问waiter
+        static void Wake(FiberWaiter *waiter);
+
+    private:
+        FiberWaiter *m_head = nullptr;
+        FiberWaiter *m_tail = nullptr;
+    };
+
+    /**
+     * @brief 协程互斥量
+     * @details 等待时挂起协程而不是阻塞线程，同一线程上的其他协程可以继续运行。
+     *          无竞争时加锁解锁各一次原子操作；有竞争时先短暂自旋，仍拿不到锁再排队挂起。
+     *          解锁时释放锁并唤醒队首，被唤醒的协程和新来的协程一起抢锁：如果总是把锁直接交给排队的协程，
+     *          每次加锁都要等它被调度到，锁竞争会退化成排队。没抢到的协程回到队首，
+     *          等待超过kStarvationMs后进入饥饿模式，解锁时直接把锁交给队首，保证不会饿死。
+     *          状态：0 未加锁，1 加锁无等待者，2 加锁且可能有等待者
+     */
+    class FiberMutex : Noncopyable
+    {
+    public:
+        typedef ScopedLockImpl<FiberMutex> Lock;
+
+        void lock()
+        {
+            uint32_t expected = 0;
+            if (!m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                lockSlow();
+            }
+        }
+
+        bool tryLock()
+        {
+            uint32_t expected = 0;
+            return m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        void unlock()
+        {
+            uint32_t expected = 1;
+            if (!m_state.compare_exchange_strong(expected, 0, std::memory_order_release, std::memory_order_relaxed))
+            {
+                unlockSlow();
+            }
+        }
+
+        /**
+         * @brief 加锁，拿不到时把waiter放进等待队列
+         * @details 供自己挂起的等待方（如无栈协程）使用，waiter需要事先设置好唤醒方式。
+         *          被唤醒后如果waiter->handoff为true说明已经拿到锁，否则再次调用，requeue传true
+         * @param start 开始等待的时间，第一次调用前置0
+         * @return 是否拿到了锁
+         */
+        bool lockOrEnqueue(FiberWaiter &waiter, bool requeue, uint64_t &start);
+
+    private:
+        void lockSlow();
+        void unlockSlow();
+
+    private:
+        /// 等待者等待超过这个时间后进入饥饿模式，毫秒
+        static const uint64_t kStarvationMs = 1;
+
+        std::atomic<uint32_t> m_state{0};
+        FutexMutex m_guard;
+        /// 饥饿模式，由m_guard保护
+        bool m_starving = false;
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程信号量
+     * @details 有计数时wait只有一次CAS，没有等待者时notify只有一次原子加；
+     *          有等待者时notify把计数直接交给排队的等待者
+     */
+    class FiberSemaphore : Noncopyable
+    {
+    public:
+        FiberSemaphore(uint32_t count = 0) : m_count(count) {}
+
+        void wait();
+
+        bool tryWait();
+
+        /**
+         * @brief 拿到计数或者把waiter放进等待队列，供自己挂起的等待方使用
+         * @return 是否拿到了计数，没拿到时被唤醒说明notify已经替waiter扣掉了计数
+         */
+        bool waitOrEnqueue(FiberWaiter &waiter);
+
+        void notify(uint32_t n = 1);
+
+    private:
+        std::atomic<uint32_t> m_count;
+        std::atomic<uint32_t> m_waiterCount{0};
+        FutexMutex m_guard;
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程条件变量，配合FiberMutex使用
+     */
+    class FiberCondition : Noncopyable
+    {
+    public:
+        /// @brief 释放mutex并挂起，被唤醒后重新加锁。调用前必须持有mutex
+        void wait(FiberMutex &mutex);
+
+        template <class Predicate>
+        void wait(FiberMutex &mutex, Predicate pred)
+        {
+            while (!pred())
+            {
+                wait(mutex);
+            }
+        }
+
+        /// @brief 唤醒一个等待者
+        void notify();
+
+        /// @brief 唤醒所有等待者
+        void notifyAll();
+
+    private:
+        FutexMutex m_guard;
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程读写锁，读写阶段交替
+     * @details 有写者在等时新的读者排队，最后一个读者解锁时把锁交给排队的写者；
+     *          写者解锁时先唤醒所有排队的读者，没有读者才交给下一个写者，读者和写者都不会饿死。
+     *          状态的修改都在内部锁中进行，临界区只有几条指令
+     */
+    class FiberRWMutex : Noncopyable
+    {
+    public:
+        typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+        typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+
+        void rdlock();
+        void wrlock();
+        void unlock();
+
+    private:
+        bool tryRdlock();
+        bool tryWrlock();
+
+    private:
+        FutexMutex m_guard;
+        /// 持有读锁的读者数
+        uint32_t m_readers = 0;
+        /// 是否有写者持有锁
+        bool m_writer = false;
+        /// 排队的写者数
+        uint32_t m_waitingWriters = 0;
+        FiberWaitQueue m_readWaiters;
+        FiberWaitQueue m_writeWaiters;
+    };
+}
+
+#endif
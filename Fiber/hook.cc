@@ -0,0 +1,558 @@
+#include "hook.hpp"
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdarg.h>
+#include "fd_manager.hpp"
+#include "iomanager.hpp"
+
+namespace sylar
+{
+    static Logger::ptr g_logger = SYLAR_LOG("system");
+
+    static thread_local bool t_hook_enable = false;
+
+#define HOOK_FUN(XX) \
+    XX(sleep)        \
+    XX(usleep)       \
+    XX(nanosleep)    \
+    XX(socket)       \
+    XX(connect)      \
+    XX(accept)       \
+    XX(read)         \
+    XX(readv)        \
+    XX(recv)         \
+    XX(recvfrom)     \
+    XX(recvmsg)      \
+    XX(write)        \
+    XX(writev)       \
+    XX(send)         \
+    XX(sendto)       \
+    XX(sendmsg)      \
+    XX(close)        \
+    XX(fcntl)        \
+    XX(ioctl)        \
+    XX(getsockopt)   \
+    XX(setsockopt)
+
+    /// @brief 取得所有原函数
+    static void hook_init()
+    {
+#define XX(name) name##_f = (name##_fun)dlsym(RTLD_NEXT, #name);
+        HOOK_FUN(XX);
+#undef XX
+    }
+
+    struct _HookIniter
+    {
+        _HookIniter()
+        {
+            if (!sleep_f)
+            {
+                hook_init();
+            }
+        }
+    };
+
+    static _HookIniter s_hook_initer;
+
+    bool is_hook_enable()
+    {
+        return t_hook_enable;
+    }
+
+    void set_hook_enable(bool flag)
+    {
+        t_hook_enable = flag;
+    }
+
+    /**
+     * @brief 当前调用是否可以挂起：开启了hook、在IOManager中、并且在调度的协程里而不是调度循环本身
+     * @return 可以挂起时返回IOManager，否则返回nullptr
+     */
+    static IOManager *GetHookIOManager()
+    {
+        if (!t_hook_enable)
+        {
+            return nullptr;
+        }
+        IOManager *iom = IOManager::GetThis();
+        if (!iom || Fiber::GetThis().get() == Scheduler::GetMainFiber())
+        {
+            return nullptr;
+        }
+        return iom;
+    }
+}
+
+/// 动态库的初始化可能早于本文件的静态初始化，此时先取得原函数
+#define HOOK_ENSURE_INIT(name) \
+    if (!name##_f)             \
+    {                          \
+        sylar::hook_init();    \
+    }
+
+struct timer_info
+{
+    int cancelled = 0;
+};
+
+/**
+ * @brief 以非阻塞方式执行IO，EAGAIN时挂起协程等待事件或超时
+ * @param event 等待的IO事件
+ * @param timeout_so 使用的超时类型，SO_RCVTIMEO或SO_SNDTIMEO
+ */
+template <typename OriginFun, typename... Args>
+static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name, uint32_t event, int timeout_so, Args &&...args)
+{
+    sylar::IOManager *iom = sylar::GetHookIOManager();
+    if (!iom)
+    {
+        return fun(fd, std::forward<Args>(args)...);
+    }
+
+    sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+    if (!ctx)
+    {
+        return fun(fd, std::forward<Args>(args)...);
+    }
+    if (ctx->isClose())
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (!ctx->isSocket() || ctx->getUserNonblock())
+    {
+        return fun(fd, std::forward<Args>(args)...);
+    }
+
+    uint64_t to = ctx->getTimeout(timeout_so);
+    std::shared_ptr<timer_info> tinfo(new timer_info);
+
+retry:
+    ssize_t n = fun(fd, std::forward<Args>(args)...);
+    while (n == -1 && errno == EINTR)
+    {
+        n = fun(fd, std::forward<Args>(args)...);
+    }
+    if (n == -1 && errno == EAGAIN)
+    {
+        std::weak_ptr<timer_info> winfo(tinfo);
+        sylar::Timer::ptr timer;
+        if (to != ~0ull)
+        {
+            timer = iom->addConditionTimer(to, [winfo, fd, iom, event]()
+                                           {
+                auto t = winfo.lock();
+                if (!t || t->cancelled)
+                {
+                    return;
+                }
+                t->cancelled = ETIMEDOUT;
+                iom->cancelEvent(fd, (sylar::IOManager::Event)(event)); }, winfo);
+        }
+
+        int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
+        if (rt)
+        {
+            SYLAR_LOG_ERROR(sylar::g_logger) << hook_fun_name << " addEvent(" << fd << ", " << event << ")";
+            if (timer)
+            {
+                timer->cancel();
+            }
+            return -1;
+        }
+
+        sylar::Fiber::GetThis()->yield();
+        if (timer)
+        {
+            timer->cancel();
+        }
+        if (tinfo->cancelled)
+        {
+            errno = tinfo->cancelled;
+            return -1;
+        }
+        goto retry;
+    }
+    return n;
+}
+
+/// @brief 挂起当前协程ms毫秒
+static void fiber_sleep(sylar::IOManager *iom, uint64_t ms)
+{
+    sylar::Fiber::ptr fiber = sylar::Fiber::GetThis();
+    iom->addTimer(ms, [iom, fiber]()
+                  { iom->schedule(fiber); });
+    fiber->yield();
+}
+
+extern "C"
+{
+#define XX(name) name##_fun name##_f = nullptr;
+    HOOK_FUN(XX);
+#undef XX
+
+    unsigned int sleep(unsigned int seconds)
+    {
+        HOOK_ENSURE_INIT(sleep);
+        sylar::IOManager *iom = sylar::GetHookIOManager();
+        if (!iom)
+        {
+            return sleep_f(seconds);
+        }
+        fiber_sleep(iom, seconds * 1000ull);
+        return 0;
+    }
+
+    int usleep(useconds_t usec)
+    {
+        HOOK_ENSURE_INIT(usleep);
+        sylar::IOManager *iom = sylar::GetHookIOManager();
+        if (!iom)
+        {
+            return usleep_f(usec);
+        }
+        fiber_sleep(iom, usec / 1000);
+        return 0;
+    }
+
+    int nanosleep(const struct timespec *req, struct timespec *rem)
+    {
+        HOOK_ENSURE_INIT(nanosleep);
+        sylar::IOManager *iom = sylar::GetHookIOManager();
+        if (!iom)
+        {
+            return nanosleep_f(req, rem);
+        }
+        fiber_sleep(iom, req->tv_sec * 1000ull + req->tv_nsec / 1000000);
+        return 0;
+    }
+
+    int socket(int domain, int type, int protocol)
+    {
+        HOOK_ENSURE_INIT(socket);
+        int fd = socket_f(domain, type, protocol);
+        if (fd == -1 || !sylar::t_hook_enable)
+        {
+            return fd;
+        }
+        sylar::FdMgr::GetInstance()->get(fd, true);
+        return fd;
+    }
+
+    int connect_with_timeout(int fd, const struct sockaddr *addr, socklen_t addrlen, uint64_t timeout_ms)
+    {
+        HOOK_ENSURE_INIT(connect);
+        sylar::IOManager *iom = sylar::GetHookIOManager();
+        if (!iom)
+        {
+            return connect_f(fd, addr, addrlen);
+        }
+        sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+        if (!ctx || ctx->isClose())
+        {
+            errno = EBADF;
+            return -1;
+        }
+        if (!ctx->isSocket() || ctx->getUserNonblock())
+        {
+            return connect_f(fd, addr, addrlen);
+        }
+
+        int n = connect_f(fd, addr, addrlen);
+        if (n == 0)
+        {
+            return 0;
+        }
+        else if (n != -1 || errno != EINPROGRESS)
+        {
+            return n;
+        }
+
+        std::shared_ptr<timer_info> tinfo(new timer_info);
+        std::weak_ptr<timer_info> winfo(tinfo);
+        sylar::Timer::ptr timer;
+        if (timeout_ms != ~0ull)
+        {
+            timer = iom->addConditionTimer(timeout_ms, [winfo, fd, iom]()
+                                           {
+                auto t = winfo.lock();
+                if (!t || t->cancelled)
+                {
+                    return;
+                }
+                t->cancelled = ETIMEDOUT;
+                iom->cancelEvent(fd, sylar::IOManager::WRITE); }, winfo);
+        }
+
+        int rt = iom->addEvent(fd, sylar::IOManager::WRITE);
+        if (rt == 0)
+        {
+            sylar::Fiber::GetThis()->yield();
+            if (timer)
+            {
+                timer->cancel();
+            }
+            if (tinfo->cancelled)
+            {
+                errno = tinfo->cancelled;
+                return -1;
+            }
+        }
+        else
+        {
+            if (timer)
+            {
+                timer->cancel();
+            }
+            SYLAR_LOG_ERROR(sylar::g_logger) << "connect addEvent(" << fd << ", WRITE) error";
+        }
+
+        int error = 0;
+        socklen_t len = sizeof(int);
+        if (-1 == getsockopt_f(fd, SOL_SOCKET, SO_ERROR, &error, &len))
+        {
+            return -1;
+        }
+        if (!error)
+        {
+            return 0;
+        }
+        errno = error;
+        return -1;
+    }
+
+    int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
+    {
+        return connect_with_timeout(sockfd, addr, addrlen, ~0ull);
+    }
+
+    int accept(int s, struct sockaddr *addr, socklen_t *addrlen)
+    {
+        HOOK_ENSURE_INIT(accept);
+        int fd = do_io(s, accept_f, "accept", sylar::IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+        if (fd >= 0 && sylar::t_hook_enable)
+        {
+            sylar::FdMgr::GetInstance()->get(fd, true);
+        }
+        return fd;
+    }
+
+    ssize_t read(int fd, void *buf, size_t count)
+    {
+        HOOK_ENSURE_INIT(read);
+        return do_io(fd, read_f, "read", sylar::IOManager::READ, SO_RCVTIMEO, buf, count);
+    }
+
+    ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+    {
+        HOOK_ENSURE_INIT(readv);
+        return do_io(fd, readv_f, "readv", sylar::IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
+    }
+
+    ssize_t recv(int sockfd, void *buf, size_t len, int flags)
+    {
+        HOOK_ENSURE_INIT(recv);
+        return do_io(sockfd, recv_f, "recv", sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
+    }
+
+    ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen)
+    {
+        HOOK_ENSURE_INIT(recvfrom);
+        return do_io(sockfd, recvfrom_f, "recvfrom", sylar::IOManager::READ, SO_RCVTIMEO, buf, len, flags, src_addr, addrlen);
+    }
+
+    ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
+    {
+        HOOK_ENSURE_INIT(recvmsg);
+        return do_io(sockfd, recvmsg_f, "recvmsg", sylar::IOManager::READ, SO_RCVTIMEO, msg, flags);
+    }
+
+    ssize_t write(int fd, const void *buf, size_t count)
+    {
+        HOOK_ENSURE_INIT(write);
+        return do_io(fd, write_f, "write", sylar::IOManager::WRITE, SO_SNDTIMEO, buf, count);
+    }
+
+    ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+    {
+        HOOK_ENSURE_INIT(writev);
+        return do_io(fd, writev_f, "writev", sylar::IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
+    }
+
+    ssize_t send(int s, const void *msg, size_t len, int flags)
+    {
+        HOOK_ENSURE_INIT(send);
+        return do_io(s, send_f, "send", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags);
+    }
+
+    ssize_t sendto(int s, const void *msg, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
+    {
+        HOOK_ENSURE_INIT(sendto);
+        return do_io(s, sendto_f, "sendto", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags, to, tolen);
+    }
+
+    ssize_t sendmsg(int s, const struct msghdr *msg, int flags)
+    {
+        HOOK_ENSURE_INIT(sendmsg);
+        return do_io(s, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
+    }
+
+    int close(int fd)
+    {
+        HOOK_ENSURE_INIT(close);
+        // 不论是否开启hook都要删除fd状态，否则fd复用时会拿到旧的状态
+        sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+        if (ctx)
+        {
+            sylar::IOManager *iom = sylar::IOManager::GetThis();
+            if (iom)
+            {
+                iom->cancelAll(fd);
+            }
+            sylar::FdMgr::GetInstance()->del(fd);
+        }
+        return close_f(fd);
+    }
+
+    int fcntl(int fd, int cmd, ... /* arg */)
+    {
+        HOOK_ENSURE_INIT(fcntl);
+        va_list va;
+        va_start(va, cmd);
+        switch (cmd)
+        {
+        case F_SETFL:
+        {
+            int arg = va_arg(va, int);
+            va_end(va);
+            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+            if (!ctx || ctx->isClose() || !ctx->isSocket())
+            {
+                return fcntl_f(fd, cmd, arg);
+            }
+            // 记录用户的设置，系统层面保持hook需要的非阻塞
+            ctx->setUserNonblock(arg & O_NONBLOCK);
+            if (ctx->getSysNonblock())
+            {
+                arg |= O_NONBLOCK;
+            }
+            else
+            {
+                arg &= ~O_NONBLOCK;
+            }
+            return fcntl_f(fd, cmd, arg);
+        }
+        case F_GETFL:
+        {
+            va_end(va);
+            int arg = fcntl_f(fd, cmd);
+            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
+            if (arg == -1 || !ctx || ctx->isClose() || !ctx->isSocket())
+            {
+                return arg;
+            }
+            // 返回用户看到的阻塞状态
+            if (ctx->getUserNonblock())
+            {
+                return arg | O_NONBLOCK;
+            }
+            return arg & ~O_NONBLOCK;
+        }
+        case F_DUPFD:
+        case F_DUPFD_CLOEXEC:
+        case F_SETFD:
+        case F_SETOWN:
+        case F_SETSIG:
+        case F_SETLEASE:
+        case F_NOTIFY:
+#ifdef F_SETPIPE_SZ
+        case F_SETPIPE_SZ:
+#endif
+        {
+            int arg = va_arg(va, int);
+            va_end(va);
+            return fcntl_f(fd, cmd, arg);
+        }
+        case F_GETFD:
+        case F_GETOWN:
+        case F_GETSIG:
+        case F_GETLEASE:
+#ifdef F_GETPIPE_SZ
+        case F_GETPIPE_SZ:
+#endif
+        {
+            va_end(va);
+            return fcntl_f(fd, cmd);
+        }
+        case F_SETLK:
+        case F_SETLKW:
+        case F_GETLK:
+        {
+            struct flock *arg = va_arg(va, struct flock *);
+            va_end(va);
+            return fcntl_f(fd, cmd, arg);
+        }
+        case F_GETOWN_EX:
+        case F_SETOWN_EX:
+        {
+            struct f_owner_exlock *arg = va_arg(va, struct f_owner_exlock *);
+            va_end(va);
+            return fcntl_f(fd, cmd, arg);
+        }
+        default:
+        {
+            // 其余命令按指针参数透传
+            void *arg = va_arg(va, void *);
+            va_end(va);
+            return fcntl_f(fd, cmd, arg);
+        }
+        }
+    }
+
+    int ioctl(int d, unsigned long int request, ...)
+    {
+        HOOK_ENSURE_INIT(ioctl);
+        va_list va;
+        va_start(va, request);
+        void *arg = va_arg(va, void *);
+        va_end(va);
+
+        if (FIONBIO == request)
+        {
+            bool user_nonblock = !!*(int *)arg;
+            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(d);
+            if (!ctx || ctx->isClose() || !ctx->isSocket())
+            {
+                return ioctl_f(d, request, arg);
+            }
+            // 系统层面保持非阻塞，只记录用户的设置
+            ctx->setUserNonblock(user_nonblock);
+            return 0;
+        }
+        return ioctl_f(d, request, arg);
+    }
+
+    int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optlen)
+    {
+        HOOK_ENSURE_INIT(getsockopt);
+        return getsockopt_f(sockfd, level, optname, optval, optlen);
+    }
+
+    int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen)
+    {
+        HOOK_ENSURE_INIT(setsockopt);
+        if (level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO) && optval)
+        {
+            sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(sockfd);
+            if (ctx)
+            {
+                const timeval *v = (const timeval *)optval;
+                uint64_t ms = v->tv_sec * 1000ull + v->tv_usec / 1000;
+                // 0表示不超时
+                ctx->setTimeout(optname, ms ? ms : ~0ull);
+            }
+        }
+        return setsockopt_f(sockfd, level, optname, optval, optlen);
+    }
+}
@@ -0,0 +1,477 @@
+#include "iomanager.hpp"
+#include <algorithm>
+#include <cassert>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace sylar
+{
+    static Logger::ptr g_logger = SYLAR_LOG("system");
+
+    /// 一次epoll_wait最多取出的事件数
+    static const int kMaxEvents = 256;
+    /// epoll_wait的最长等待时间，毫秒
+    static const int kMaxTimeout = 3000;
+
+    /// @brief 写入eventfd，唤醒在它所在epoll上等待的线程
+    static void WakeEventFd(int fd)
+    {
+        uint64_t one = 1;
+        ssize_t rt = write(fd, &one, sizeof(one));
+        (void)rt;
+    }
+}
+
+sylar::IOManager::FdContext::EventContext &sylar::IOManager::FdContext::getContext(Event event)
+{
+    switch (event)
+    {
+    case READ:
+        return read;
+    case WRITE:
+        return write;
+    default:
+        assert(false);
+    }
+    throw std::invalid_argument("getContext invalid event");
+}
+
+void sylar::IOManager::FdContext::resetContext(EventContext &ctx)
+{
+    ctx.scheduler = nullptr;
+    ctx.fiber.reset();
+    ctx.cb = nullptr;
+    ctx.resultCb = nullptr;
+}
+
+void sylar::IOManager::FdContext::triggerEvent(Event event, bool ready)
+{
+    assert(events & event);
+    events = (Event)(events & ~event);
+    EventContext &ctx = getContext(event);
+    if (ctx.resultCb)
+    {
+        std::function<void(bool)> cb = std::move(ctx.resultCb);
+        ctx.scheduler->schedule([cb, ready]()
+                                { cb(ready); });
+    }
+    else if (ctx.cb)
+    {
+        ctx.scheduler->schedule(std::move(ctx.cb));
+    }
+    else
+    {
+        ctx.scheduler->schedule(std::move(ctx.fiber));
+    }
+    resetContext(ctx);
+}
+
+sylar::IOManager::IOManager(size_t threads, bool use_caller, const std::string &name, bool hook)
+    : Scheduler(threads, use_caller, name)
+{
+    m_hookEnable = hook;
+
+    m_epfd = epoll_create1(EPOLL_CLOEXEC);
+    assert(m_epfd >= 0);
+
+    for (size_t i = 0; i < m_threadCount; ++i)
+    {
+        std::unique_ptr<IdleWaiter> waiter(new IdleWaiter);
+        waiter->epfd = epoll_create1(EPOLL_CLOEXEC);
+        assert(waiter->epfd >= 0);
+        waiter->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        assert(waiter->eventFd >= 0);
+
+        // 都用水平触发，eventfd没有读空或者共享的epoll中还有事件时epoll_wait立即返回，不会错过唤醒
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = waiter->eventFd;
+        int rt = epoll_ctl(waiter->epfd, EPOLL_CTL_ADD, waiter->eventFd, &event);
+        assert(!rt);
+        event.data.fd = m_epfd;
+        rt = epoll_ctl(waiter->epfd, EPOLL_CTL_ADD, m_epfd, &event);
+        assert(!rt);
+        (void)rt;
+        m_waiters.push_back(std::move(waiter));
+    }
+
+    contextResize(32);
+    start();
+}
+
+sylar::IOManager::~IOManager()
+{
+    stop();
+    for (auto &i : m_waiters)
+    {
+        close(i->epfd);
+        close(i->eventFd);
+    }
+    close(m_epfd);
+    for (size_t i = 0; i < m_fdContexts.size(); ++i)
+    {
+        delete m_fdContexts[i];
+    }
+}
+
+void sylar::IOManager::contextResize(size_t size)
+{
+    size_t old = m_fdContexts.size();
+    m_fdContexts.resize(size);
+    for (size_t i = old; i < size; ++i)
+    {
+        m_fdContexts[i] = new FdContext;
+        m_fdContexts[i]->fd = i;
+    }
+}
+
+sylar::IOManager::FdContext *sylar::IOManager::getFdContext(int fd, bool create)
+{
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if ((int)m_fdContexts.size() > fd)
+        {
+            return m_fdContexts[fd];
+        }
+    }
+    if (!create)
+    {
+        return nullptr;
+    }
+    RWMutexType::WriteLock lock(m_mutex);
+    if ((int)m_fdContexts.size() <= fd)
+    {
+        contextResize(fd * 1.5 + 1);
+    }
+    return m_fdContexts[fd];
+}
+
+int sylar::IOManager::addEvent(int fd, Event event, std::function<void()> cb)
+{
+    return doAddEvent(fd, event, std::move(cb), nullptr);
+}
+
+int sylar::IOManager::addEvent(int fd, Event event, std::function<void(bool)> cb)
+{
+    return doAddEvent(fd, event, nullptr, std::move(cb));
+}
+
+int sylar::IOManager::doAddEvent(int fd, Event event, std::function<void()> cb, std::function<void(bool)> resultCb)
+{
+    FdContext *fd_ctx = getFdContext(fd, true);
+    if (!fd_ctx)
+    {
+        return -1;
+    }
+
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (fd_ctx->events & event)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "addEvent assert fd=" << fd << " event=" << (EPOLL_EVENTS)event
+                                  << " fd_ctx.event=" << (EPOLL_EVENTS)fd_ctx->events;
+        return -1;
+    }
+
+    int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epevent));
+    epevent.events = EPOLLET | static_cast<uint32_t>(fd_ctx->events | event);
+    epevent.data.ptr = fd_ctx;
+    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+    if (rt)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events
+                                  << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+        return -1;
+    }
+
+    ++m_pendingEventCount;
+    fd_ctx->events = (Event)(fd_ctx->events | event);
+    FdContext::EventContext &event_ctx = fd_ctx->getContext(event);
+    assert(!event_ctx.scheduler && !event_ctx.fiber && !event_ctx.cb && !event_ctx.resultCb);
+
+    Scheduler *scheduler = Scheduler::GetThis();
+    event_ctx.scheduler = scheduler ? scheduler : this;
+    if (resultCb)
+    {
+        event_ctx.resultCb.swap(resultCb);
+    }
+    else if (cb)
+    {
+        event_ctx.cb.swap(cb);
+    }
+    else
+    {
+        event_ctx.fiber = Fiber::GetThis();
+        assert(event_ctx.fiber->getState() == Fiber::RUNNING);
+    }
+    return 0;
+}
+
+bool sylar::IOManager::delEvent(int fd, Event event)
+{
+    FdContext *fd_ctx = getFdContext(fd, false);
+    if (!fd_ctx)
+    {
+        return false;
+    }
+
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (!(fd_ctx->events & event))
+    {
+        return false;
+    }
+
+    Event new_events = (Event)(fd_ctx->events & ~event);
+    int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epevent));
+    epevent.events = EPOLLET | static_cast<uint32_t>(new_events);
+    epevent.data.ptr = fd_ctx;
+    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+    if (rt)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events
+                                  << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+        return false;
+    }
+
+    --m_pendingEventCount;
+    fd_ctx->events = new_events;
+    FdContext::EventContext &event_ctx = fd_ctx->getContext(event);
+    fd_ctx->resetContext(event_ctx);
+    return true;
+}
+
+bool sylar::IOManager::cancelEvent(int fd, Event event)
+{
+    FdContext *fd_ctx = getFdContext(fd, false);
+    if (!fd_ctx)
+    {
+        return false;
+    }
+
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (!(fd_ctx->events & event))
+    {
+        return false;
+    }
+
+    Event new_events = (Event)(fd_ctx->events & ~event);
+    int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epevent));
+    epevent.events = EPOLLET | static_cast<uint32_t>(new_events);
+    epevent.data.ptr = fd_ctx;
+    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+    if (rt)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events
+                                  << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+        return false;
+    }
+
+    fd_ctx->triggerEvent(event, false);
+    --m_pendingEventCount;
+    return true;
+}
+
+bool sylar::IOManager::cancelAll(int fd)
+{
+    FdContext *fd_ctx = getFdContext(fd, false);
+    if (!fd_ctx)
+    {
+        return false;
+    }
+
+    FdContext::MutexType::Lock lock(fd_ctx->mutex);
+    if (!fd_ctx->events)
+    {
+        return false;
+    }
+
+    int op = EPOLL_CTL_DEL;
+    epoll_event epevent;
+    memset(&epevent, 0, sizeof(epevent));
+    epevent.events = 0;
+    epevent.data.ptr = fd_ctx;
+    int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+    if (rt)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events
+                                  << "):" << rt << " (" << errno << ") (" << strerror(errno) << ")";
+        return false;
+    }
+
+    if (fd_ctx->events & READ)
+    {
+        fd_ctx->triggerEvent(READ, false);
+        --m_pendingEventCount;
+    }
+    if (fd_ctx->events & WRITE)
+    {
+        fd_ctx->triggerEvent(WRITE, false);
+        --m_pendingEventCount;
+    }
+    assert(fd_ctx->events == 0);
+    return true;
+}
+
+void sylar::IOManager::onTimerInsertedAtFront()
+{
+    tickle();
+}
+
+sylar::IOManager *sylar::IOManager::GetThis()
+{
+    return dynamic_cast<IOManager *>(Scheduler::GetThis());
+}
+
+void sylar::IOManager::tickle()
+{
+    // 与idle()中标记睡眠后再检查任务配对，保证要么看到睡眠的线程，要么它看到新任务
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!hasIdleThreads())
+    {
+        return;
+    }
+    size_t start = m_tickleCursor.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < m_waiters.size(); ++i)
+    {
+        IdleWaiter &waiter = *m_waiters[(start + i) % m_waiters.size()];
+        // 清除标记表示认领了这个线程，连续的tickle()会唤醒不同的线程
+        if (waiter.sleeping.load(std::memory_order_relaxed) && waiter.sleeping.exchange(false, std::memory_order_relaxed))
+        {
+            WakeEventFd(waiter.eventFd);
+            return;
+        }
+    }
+}
+
+void sylar::IOManager::tickleWorker(int index)
+{
+    IdleWaiter &waiter = *m_waiters[index];
+    // 与idle()中标记睡眠后再检查收件箱配对，没有睡眠标记时目标线程会自己看到新任务
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter.sleeping.load(std::memory_order_relaxed) && waiter.sleeping.exchange(false, std::memory_order_relaxed))
+    {
+        WakeEventFd(waiter.eventFd);
+    }
+}
+
+bool sylar::IOManager::stopping()
+{
+    return m_pendingEventCount == 0 && !hasTimer() && Scheduler::stopping();
+}
+
+void sylar::IOManager::idle()
+{
+    IdleWaiter &waiter = *m_waiters[getCurrentWorkerIndex()];
+    waiter.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (hasWork() || stopping())
+    {
+        waiter.sleeping.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    // 自己的epoll中只有eventfd和共享的epoll两个fd
+    epoll_event events[kMaxEvents];
+    int rt = 0;
+    do
+    {
+        uint64_t next_timeout = std::min(getNextTimer(), (uint64_t)kMaxTimeout);
+        rt = epoll_wait(waiter.epfd, events, 2, (int)next_timeout);
+    } while (rt < 0 && errno == EINTR);
+    waiter.sleeping.store(false, std::memory_order_relaxed);
+
+    bool io = false;
+    for (int i = 0; i < rt; ++i)
+    {
+        if (events[i].data.fd == waiter.eventFd)
+        {
+            // 读空后之后的写入才会再次唤醒本线程
+            uint64_t value;
+            while (read(waiter.eventFd, &value, sizeof(value)) > 0)
+                ;
+        }
+        else
+        {
+            io = true;
+        }
+    }
+    // 共享的epoll中有事件时不阻塞地取出，同时醒来的其他线程可能已经取走
+    rt = 0;
+    if (io)
+    {
+        do
+        {
+            rt = epoll_wait(m_epfd, events, kMaxEvents, 0);
+        } while (rt < 0 && errno == EINTR);
+    }
+
+    std::vector<std::function<void()>> cbs;
+    listExpiredCb(cbs);
+    if (!cbs.empty())
+    {
+        schedule(cbs.begin(), cbs.end());
+    }
+
+    for (int i = 0; i < rt; ++i)
+    {
+        epoll_event &event = events[i];
+        FdContext *fd_ctx = (FdContext *)event.data.ptr;
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        if (event.events & (EPOLLERR | EPOLLHUP))
+        {
+            event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->events;
+        }
+        int real_events = NONE;
+        if (event.events & EPOLLIN)
+        {
+            real_events |= READ;
+        }
+        if (event.events & EPOLLOUT)
+        {
+            real_events |= WRITE;
+        }
+
+        if ((fd_ctx->events & real_events) == NONE)
+        {
+            continue;
+        }
+
+        // 剩余的事件重新注册，没有剩余事件时从epoll中删除
+        int left_events = (fd_ctx->events & ~real_events);
+        int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+        event.events = EPOLLET | left_events;
+
+        int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
+        if (rt2)
+        {
+            SYLAR_LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", " << op << ", " << fd_ctx->fd << ", " << (EPOLL_EVENTS)event.events
+                                      << "):" << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
+            continue;
+        }
+
+        if (real_events & READ)
+        {
+            fd_ctx->triggerEvent(READ);
+            --m_pendingEventCount;
+        }
+        if (real_events & WRITE)
+        {
+            fd_ctx->triggerEvent(WRITE);
+            --m_pendingEventCount;
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#ifndef __SYLAR_IOMANAGER_H__
+#define __SYLAR_IOMANAGER_H__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "scheduler.hpp"
+#include "timer.hpp"
+
+namespace sylar
+{
+    /**
+     * @brief 基于epoll的IO协程调度器
+     * @details 在Scheduler的基础上，空闲线程在epoll_wait中等待IO事件。事件以边缘触发方式注册，
+     *          每个事件只触发一次：触发后从epoll中移除并调度等待它的协程或回调，需要继续等待时重新addEvent。
+     *          fd上下文保存在以fd为下标的数组中。每个工作线程在自己的epoll上等待，其中有共享的epoll和
+     *          本线程的eventfd，写入某个线程的eventfd只唤醒这个线程。
+     *          同时是定时器管理器，epoll_wait的超时取下一个定时器的到期时间
+     */
+    class IOManager : public Scheduler, public TimerManager
+    {
+    public:
+        typedef std::shared_ptr<IOManager> ptr;
+        typedef DistributedRWMutex RWMutexType;
+
+        /// @brief IO事件，取值与epoll一致
+        enum Event
+        {
+            NONE = 0x0,
+            READ = 0x1,
+            WRITE = 0x4,
+        };
+
+    private:
+        /// @brief fd上下文
+        struct FdContext
+        {
+            typedef Mutex MutexType;
+
+            /// @brief 事件上下文，协程和回调二选一
+            struct EventContext
+            {
+                /// 执行事件的调度器
+                Scheduler *scheduler = nullptr;
+                Fiber::ptr fiber;
+                std::function<void()> cb;
+                /// 带结果的回调，参数为false表示事件被取消
+                std::function<void(bool)> resultCb;
+            };
+
+            /// @brief 获取事件对应的上下文
+            EventContext &getContext(Event event);
+
+            /// @brief 重置事件上下文
+            void resetContext(EventContext &ctx);
+
+            /// @brief 触发事件，调度等待的协程或回调并清除该事件
+            /// @param ready 事件就绪为true，被cancelEvent()/cancelAll()取消为false
+            void triggerEvent(Event event, bool ready = true);
+
+            EventContext read;
+            EventContext write;
+            int fd = 0;
+            /// 已注册的事件
+            Event events = NONE;
+            MutexType mutex;
+        };
+
+        /// @brief 工作线程在idle()中的等待点
+        struct IdleWaiter
+        {
+            /// 本线程等待的epoll，包含共享的epoll和本线程的eventfd
+            int epfd = -1;
+            /// 只唤醒本线程的eventfd
+            int eventFd = -1;
+            /// 是否在epoll_wait中睡眠，tickle()据此挑选唤醒的线程
+            std::atomic<bool> sleeping{false};
+        };
+
+    public:
+        /**
+         * @brief 构造函数
+         * @param threads 线程数
+         * @param use_caller 是否把调用线程也作为工作线程
+         * @param name 名称
+         * @param hook 工作线程是否开启系统调用hook，见hook.hpp
+         */
+        IOManager(size_t threads = 1, bool use_caller = true, const std::string &name = "", bool hook = false);
+
+        ~IOManager();
+
+        /**
+         * @brief 注册事件
+         * @param cb 事件回调，为空时事件发生后恢复当前协程
+         * @return 成功返回0，失败返回-1
+         */
+        int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+
+        /**
+         * @brief 注册事件，回调能区分事件就绪和被取消
+         * @param cb 事件回调，参数为true表示事件就绪，false表示被cancelEvent()/cancelAll()取消
+         * @return 成功返回0，失败返回-1
+         */
+        int addEvent(int fd, Event event, std::function<void(bool)> cb);
+
+        /// @brief 删除事件，不触发
+        bool delEvent(int fd, Event event);
+
+        /// @brief 取消事件，如果事件已注册则触发一次
+        bool cancelEvent(int fd, Event event);
+
+        /// @brief 取消fd上的所有事件
+        bool cancelAll(int fd);
+
+        /// @brief 当前线程的IOManager
+        static IOManager *GetThis();
+
+    protected:
+        void tickle() override;
+        void tickleWorker(int index) override;
+        bool stopping() override;
+        void idle() override;
+        void onTimerInsertedAtFront() override;
+
+        /// @brief 扩充fd上下文数组
+        void contextResize(size_t size);
+
+        /// @brief 取出fd对应的上下文，create为true时按需扩容
+        FdContext *getFdContext(int fd, bool create);
+
+        /// @brief 注册事件，cb和resultCb最多一个非空，都为空时事件发生后恢复当前协程
+        int doAddEvent(int fd, Event event, std::function<void()> cb, std::function<void(bool)> resultCb);
+
+    private:
+        /// 注册IO事件的epoll文件描述符，所有线程共享
+        int m_epfd = 0;
+        /// 下标为工作线程下标
+        std::vector<std::unique_ptr<IdleWaiter>> m_waiters;
+        /// tickle()挑选睡眠线程的起始位置，轮流从不同线程开始
+        std::atomic<size_t> m_tickleCursor{0};
+        /// 等待中的事件数
+        std::atomic<size_t> m_pendingEventCount{0};
+        RWMutexType m_mutex;
+        /// 下标为fd
+        std::vector<FdContext *> m_fdContexts;
+    };
+}
+
+#endif
@@ -0,0 +1,435 @@
+#include "scheduler.hpp"
+#include <cassert>
+#include "hook.hpp"
+
+namespace sylar
+{
+    static Logger::ptr g_logger = SYLAR_LOG("system");
+
+    /// 当前线程的调度器
+    static thread_local Scheduler *t_scheduler = nullptr;
+    /// 当前线程的调度协程
+    static thread_local Fiber *t_schedulerFiber = nullptr;
+    /// 当前线程在调度器中的下标，不在调度循环中时为-1
+    static thread_local int t_workerIndex = -1;
+    /// 选择窃取对象的随机数状态
+    static thread_local uint64_t t_stealRandom = 0;
+
+    /// 从注入队列一次取出的最大任务数
+    static const size_t kInjectBatch = 32;
+}
+
+sylar::Scheduler::Scheduler(size_t threads, bool use_caller, const std::string &name)
+    : m_name(name)
+{
+    assert(threads > 0);
+    m_injectMutex.setName("Scheduler::m_injectMutex");
+    m_threadCount = threads;
+    for (size_t i = 0; i < threads; ++i)
+    {
+        m_workers.emplace_back(new Worker);
+    }
+    m_activeThreadCount = threads;
+
+    if (use_caller)
+    {
+        Fiber::GetThis();
+        assert(GetThis() == nullptr);
+        t_scheduler = this;
+        // 调用线程的调度循环在m_rootFiber中执行，stop()时由主协程resume它
+        m_rootFiber.reset(new Fiber(std::bind(&Scheduler::run, this)));
+        Thread::SetName(m_name);
+        t_schedulerFiber = m_rootFiber.get();
+        m_rootThread = GetThreadId();
+        m_threadIds.push_back(m_rootThread);
+    }
+    else
+    {
+        m_rootThread = -1;
+    }
+}
+
+sylar::Scheduler::~Scheduler()
+{
+    assert(m_stopping);
+    if (GetThis() == this)
+    {
+        t_scheduler = nullptr;
+    }
+}
+
+sylar::Scheduler *sylar::Scheduler::GetThis()
+{
+    return t_scheduler;
+}
+
+sylar::Fiber *sylar::Scheduler::GetMainFiber()
+{
+    return t_schedulerFiber;
+}
+
+void sylar::Scheduler::setThis()
+{
+    t_scheduler = this;
+}
+
+void sylar::Scheduler::start()
+{
+    if (m_stopping || !m_threads.empty())
+    {
+        return;
+    }
+    size_t begin = m_rootFiber ? 1 : 0;
+    // 线程id在Thread构造函数返回时已经可用
+    m_threadIds.resize(m_threadCount);
+    for (size_t i = begin; i < m_threadCount; ++i)
+    {
+        int index = static_cast<int>(i);
+        m_threads.emplace_back(new Thread([this, index]()
+                                          {
+            t_workerIndex = index;
+            run(); }, m_name + "_" + std::to_string(i - begin)));
+        m_threadIds[i] = m_threads.back()->getId();
+    }
+}
+
+void sylar::Scheduler::stop()
+{
+    if (m_rootFiber)
+    {
+        assert(GetThis() == this);
+    }
+    else
+    {
+        assert(GetThis() != this);
+    }
+    m_stopping = true;
+    for (size_t i = 0; i < m_threadCount; ++i)
+    {
+        tickle();
+    }
+
+    if (m_rootFiber && m_rootFiber->getState() != Fiber::TERM)
+    {
+        m_rootFiber->resume();
+        SYLAR_LOG_DEBUG(g_logger) << "root fiber end";
+    }
+
+    std::vector<Thread::ptr> threads;
+    threads.swap(m_threads);
+    for (auto &i : threads)
+    {
+        i->join();
+    }
+}
+
+int sylar::Scheduler::getCurrentWorkerIndex() const
+{
+    return t_scheduler == this ? t_workerIndex : -1;
+}
+
+int sylar::Scheduler::getWorkerIndex(int thread) const
+{
+    for (size_t i = 0; i < m_threadIds.size(); ++i)
+    {
+        if (m_threadIds[i] == thread)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void sylar::Scheduler::scheduleTask(ScheduleTask *task)
+{
+    if (task->thread != -1)
+    {
+        int index = getWorkerIndex(task->thread);
+        if (index >= 0)
+        {
+            Worker &worker = *m_workers[index];
+            worker.inboxSize.fetch_add(1, std::memory_order_relaxed);
+            worker.inbox.push(task);
+            // 只有目标线程能执行收件箱中的任务，唤醒其他线程没有用
+            tickleWorker(index);
+            return;
+        }
+        task->thread = -1;
+    }
+    if (t_scheduler == this && t_workerIndex >= 0)
+    {
+        m_workers[t_workerIndex]->local.push(task);
+    }
+    else
+    {
+        MutexType::Lock lock(m_injectMutex);
+        m_inject.push_back(task);
+        m_injectSize.fetch_add(1, std::memory_order_release);
+    }
+    tickle();
+}
+
+void sylar::Scheduler::scheduleBatch(const std::vector<ScheduleTask *> &tasks)
+{
+    if (tasks.empty())
+    {
+        return;
+    }
+    {
+        MutexType::Lock lock(m_injectMutex);
+        m_inject.insert(m_inject.end(), tasks.begin(), tasks.end());
+        m_injectSize.fetch_add(tasks.size(), std::memory_order_release);
+    }
+    size_t n = tasks.size() < m_threadCount ? tasks.size() : m_threadCount;
+    for (size_t i = 0; i < n; ++i)
+    {
+        tickle();
+    }
+}
+
+sylar::Scheduler::ScheduleTask *sylar::Scheduler::takeInjected(int index)
+{
+    if (m_injectSize.load(std::memory_order_acquire) == 0)
+    {
+        return nullptr;
+    }
+    ScheduleTask *batch[kInjectBatch];
+    size_t count = 0;
+    {
+        MutexType::Lock lock(m_injectMutex);
+        // 按线程数平分注入队列，避免一个线程拿走所有任务
+        size_t n = m_inject.size() / m_threadCount + 1;
+        n = n < kInjectBatch ? n : kInjectBatch;
+        while (count < n && !m_inject.empty())
+        {
+            batch[count++] = m_inject.front();
+            m_inject.pop_front();
+        }
+        m_injectSize.fetch_sub(count, std::memory_order_relaxed);
+    }
+    if (count == 0)
+    {
+        return nullptr;
+    }
+    for (size_t i = 1; i < count; ++i)
+    {
+        m_workers[index]->local.push(batch[i]);
+    }
+    if (count > 1)
+    {
+        tickle();
+    }
+    return batch[0];
+}
+
+sylar::Scheduler::ScheduleTask *sylar::Scheduler::steal(int index)
+{
+    uint64_t &state = t_stealRandom;
+    if (state == 0)
+    {
+        state = 0x9E3779B97F4A7C15ULL * (GetThreadId() | 1);
+    }
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    size_t start = state % m_threadCount;
+    ScheduleTask *task = nullptr;
+    for (size_t i = 0; i < m_threadCount; ++i)
+    {
+        size_t victim = (start + i) % m_threadCount;
+        if (static_cast<int>(victim) != index && m_workers[victim]->local.steal(task))
+        {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+sylar::Scheduler::ScheduleTask *sylar::Scheduler::take(int index)
+{
+    Worker &worker = *m_workers[index];
+    ScheduleTask *task = nullptr;
+    if (worker.inboxSize.load(std::memory_order_relaxed) && worker.inbox.pop(task))
+    {
+        worker.inboxSize.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+    }
+    // 所有者也从顶部取，本地队列按先进先出执行，反复调度自己的协程不会饿死队列里的其他任务
+    if (worker.local.steal(task))
+    {
+        return task;
+    }
+    if ((task = takeInjected(index)))
+    {
+        return task;
+    }
+    return steal(index);
+}
+
+bool sylar::Scheduler::hasWork()
+{
+    if (m_injectSize.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+    if (t_workerIndex >= 0 && m_workers[t_workerIndex]->inboxSize.load(std::memory_order_relaxed))
+    {
+        return true;
+    }
+    for (auto &i : m_workers)
+    {
+        if (!i->local.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void sylar::Scheduler::tickle()
+{
+    // 与idle()中标记睡眠后再检查任务配对，保证要么看到睡眠的线程，要么它看到新任务
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!hasIdleThreads())
+    {
+        return;
+    }
+    size_t start = m_tickleCursor.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < m_threadCount; ++i)
+    {
+        Worker &worker = *m_workers[(start + i) % m_threadCount];
+        // 清除标记表示认领了这个线程，连续的tickle()会唤醒不同的线程
+        if (worker.sleeping.load(std::memory_order_relaxed) && worker.sleeping.exchange(false, std::memory_order_relaxed))
+        {
+            worker.event.notify();
+            return;
+        }
+    }
+}
+
+void sylar::Scheduler::tickleWorker(int index)
+{
+    Worker &worker = *m_workers[index];
+    worker.sleeping.store(false, std::memory_order_relaxed);
+    worker.event.notify();
+}
+
+bool sylar::Scheduler::stopping()
+{
+    if (!m_stopping || m_activeThreadCount.load() != 0 || m_injectSize.load() != 0)
+    {
+        return false;
+    }
+    for (auto &i : m_workers)
+    {
+        if (!i->local.empty() || i->inboxSize.load())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void sylar::Scheduler::idle()
+{
+    Worker &worker = *m_workers[t_workerIndex];
+    worker.sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    EventCount::Key key = worker.event.prepareWait();
+    if (hasWork() || stopping())
+    {
+        worker.event.cancelWait();
+        worker.sleeping.store(false, std::memory_order_relaxed);
+        return;
+    }
+    worker.event.wait(key);
+    worker.sleeping.store(false, std::memory_order_relaxed);
+}
+
+void sylar::Scheduler::run()
+{
+    setThis();
+    if (GetThreadId() != m_rootThread)
+    {
+        t_schedulerFiber = Fiber::GetThis().get();
+    }
+    else
+    {
+        t_workerIndex = 0;
+    }
+    int index = t_workerIndex;
+    set_hook_enable(m_hookEnable);
+
+    Fiber::ptr cbFiber;
+    while (true)
+    {
+        ScheduleTask *task = take(index);
+        if (task)
+        {
+            if (task->fiber)
+            {
+                Fiber::State state = task->fiber->getState();
+                if (state == Fiber::RUNNING)
+                {
+                    // 协程先调度自己再yield，还没有切换出去，稍后再试。
+                    // 指定线程的任务放回收件箱，放入本地队列会被其他线程窃取
+                    Worker &worker = *m_workers[index];
+                    if (task->thread != -1)
+                    {
+                        worker.inboxSize.fetch_add(1, std::memory_order_relaxed);
+                        worker.inbox.push(task);
+                    }
+                    else
+                    {
+                        worker.local.push(task);
+                    }
+                    continue;
+                }
+                if (state == Fiber::READY)
+                {
+                    task->fiber->resume();
+                }
+            }
+            else if (task->direct)
+            {
+                task->direct(task->arg);
+            }
+            else if (task->cb)
+            {
+                if (cbFiber)
+                {
+                    cbFiber->reset(std::move(task->cb));
+                }
+                else
+                {
+                    cbFiber.reset(new Fiber(std::move(task->cb)));
+                }
+                // 回调yield了，协程由回调自己保存并重新调度，这里不再复用。
+                // 要用resume()的返回值判断，之后其他线程可能已经把它执行完
+                if (cbFiber->resume() != Fiber::TERM)
+                {
+                    cbFiber.reset();
+                }
+            }
+            delete task;
+            continue;
+        }
+
+        --m_activeThreadCount;
+        if (stopping())
+        {
+            // 让其他在idle()中睡眠的线程也看到可以停止
+            for (size_t i = 0; i < m_threadCount; ++i)
+            {
+                tickle();
+            }
+            break;
+        }
+        ++m_idleThreadCount;
+        idle();
+        --m_idleThreadCount;
+        ++m_activeThreadCount;
+    }
+    set_hook_enable(false);
+    t_workerIndex = -1;
+}
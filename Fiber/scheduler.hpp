@@ -0,0 +1,198 @@
+#ifndef __SYLAR_SCHEDULER_H__
+#define __SYLAR_SCHEDULER_H__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "fiber.hpp"
+#include "../Utility/cmutex.hpp"
+#include "../Utility/event_count.hpp"
+#include "../Utility/lockfree_queue.hpp"
+#include "../Utility/thread.hpp"
+
+namespace sylar
+{
+    /**
+     * @brief N:M协程调度器
+     * @details 在一组线程上调度协程和回调。每个工作线程有一个可被窃取的本地队列和一个只属于自己的收件箱：
+     *          工作线程内调度的任务进入本地队列，指定线程的任务进入目标线程的收件箱，
+     *          其他线程调度的任务进入全局注入队列。线程没有任务时依次尝试收件箱、本地队列、注入队列，
+     *          再随机窃取其他线程的本地队列，都失败后调用idle()睡眠。
+     *          回调在线程缓存的协程里执行，可以在回调里yield
+     */
+    class Scheduler
+    {
+    public:
+        typedef std::shared_ptr<Scheduler> ptr;
+        typedef Mutex MutexType;
+
+        /**
+         * @brief 构造函数
+         * @param threads 线程数
+         * @param use_caller 是否把调用构造函数的线程也作为工作线程，此时它在stop()中参与调度
+         * @param name 调度器名称
+         */
+        Scheduler(size_t threads = 1, bool use_caller = true, const std::string &name = "");
+
+        virtual ~Scheduler();
+
+        const std::string &getName() const { return m_name; }
+
+        /// @brief 当前线程所属的调度器
+        static Scheduler *GetThis();
+
+        /// @brief 当前线程的调度协程
+        static Fiber *GetMainFiber();
+
+        /// @brief 启动工作线程
+        void start();
+
+        /// @brief 等待所有任务执行完后停止调度器，use_caller时必须在构造调度器的线程调用
+        void stop();
+
+        /**
+         * @brief 调度协程或回调
+         * @param fc 协程或者回调
+         * @param thread 指定执行的线程id，-1表示任意线程；指定线程的任务不会被窃取
+         */
+        template <class FiberOrCb>
+        void schedule(FiberOrCb fc, int thread = -1)
+        {
+            ScheduleTask *task = new ScheduleTask(std::move(fc), thread);
+            scheduleTask(task);
+        }
+
+        /**
+         * @brief 调度一个直接在调度协程上执行的函数
+         * @details 不切换到回调协程，用于恢复无栈协程。fn中不能yield，也不应该做阻塞调用
+         */
+        void scheduleDirect(void (*fn)(void *), void *arg, int thread = -1)
+        {
+            scheduleTask(new ScheduleTask(fn, arg, thread));
+        }
+
+        /// @brief 批量调度，只加一次锁
+        template <class InputIterator>
+        void schedule(InputIterator begin, InputIterator end)
+        {
+            std::vector<ScheduleTask *> tasks;
+            for (; begin != end; ++begin)
+            {
+                tasks.push_back(new ScheduleTask(std::move(*begin), -1));
+            }
+            scheduleBatch(tasks);
+        }
+
+        /// @brief 调度器的工作线程数，包括use_caller时的调用线程
+        size_t getThreadCount() const { return m_threadCount; }
+
+    protected:
+        /// @brief 通知有新任务，默认唤醒一个在idle()中睡眠的线程
+        virtual void tickle();
+
+        /// @brief 通知指定的工作线程收件箱中有任务，默认只唤醒这个线程
+        virtual void tickleWorker(int index);
+
+        /// @brief 调度循环
+        void run();
+
+        /// @brief 是否可以停止：已经调用stop()、没有任务并且所有线程都已空闲
+        virtual bool stopping();
+
+        /// @brief 没有任务时调用，阻塞直到可能有新任务或者可以停止
+        virtual void idle();
+
+        /// @brief 设置当前线程的调度器
+        void setThis();
+
+        /// @brief 是否有线程在idle()中
+        bool hasIdleThreads() { return m_idleThreadCount > 0; }
+
+        /// @brief 当前线程能执行的任务是否存在
+        bool hasWork();
+
+        /// @brief 当前线程在本调度器中的下标，不在调度循环中时返回-1
+        int getCurrentWorkerIndex() const;
+
+    private:
+        /// @brief 调度任务，协程、回调和直接执行的函数三选一
+        struct ScheduleTask : public MPSCNode
+        {
+            ScheduleTask(Fiber::ptr f, int thr) : fiber(std::move(f)), thread(thr) {}
+            template <class Func, class = typename std::enable_if<!std::is_convertible<Func, Fiber::ptr>::value>::type>
+            ScheduleTask(Func f, int thr) : cb(std::move(f)), thread(thr) {}
+            ScheduleTask(void (*fn)(void *), void *a, int thr) : direct(fn), arg(a), thread(thr) {}
+
+            Fiber::ptr fiber;
+            std::function<void()> cb;
+            void (*direct)(void *) = nullptr;
+            void *arg = nullptr;
+            /// 指定的线程id，-1表示任意线程
+            int thread;
+        };
+
+        struct Worker
+        {
+            /// 可被窃取的本地队列
+            ChaseLevDeque<ScheduleTask *> local;
+            /// 指定由本线程执行的任务
+            MPSCQueue<ScheduleTask> inbox;
+            /// 收件箱中的任务数，供其他线程判断
+            std::atomic<size_t> inboxSize{0};
+            /// 默认idle()的睡眠点，每个线程一个，可以只唤醒指定的线程
+            EventCount event;
+            /// 是否在默认idle()中睡眠，tickle()据此挑选唤醒的线程
+            std::atomic<bool> sleeping{false};
+        };
+
+        void scheduleTask(ScheduleTask *task);
+
+        void scheduleBatch(const std::vector<ScheduleTask *> &tasks);
+
+        /// @brief 取出一个任务，没有时返回nullptr
+        ScheduleTask *take(int index);
+
+        /// @brief 从注入队列取一批任务，第一个返回，其余放入本地队列
+        ScheduleTask *takeInjected(int index);
+
+        /// @brief 从随机位置开始窃取其他线程的本地队列
+        ScheduleTask *steal(int index);
+
+        /// @brief 线程id对应的工作线程下标，不是本调度器的线程返回-1
+        int getWorkerIndex(int thread) const;
+
+    protected:
+        /// 工作线程的线程id
+        std::vector<int> m_threadIds;
+        /// 工作线程数，包括use_caller时的调用线程
+        size_t m_threadCount = 0;
+        /// 没有在idle()中的工作线程数
+        std::atomic<size_t> m_activeThreadCount{0};
+        /// 在idle()中的线程数
+        std::atomic<size_t> m_idleThreadCount{0};
+        /// 是否已经调用stop()
+        std::atomic<bool> m_stopping{false};
+        /// use_caller时调用线程的id
+        int m_rootThread = 0;
+        /// 工作线程是否开启系统调用hook，在start()之前设置
+        bool m_hookEnable = false;
+
+    private:
+        std::string m_name;
+        std::vector<Thread::ptr> m_threads;
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        /// 其他线程调度的任务
+        MutexType m_injectMutex;
+        std::deque<ScheduleTask *> m_inject;
+        std::atomic<size_t> m_injectSize{0};
+        /// tickle()挑选睡眠线程的起始位置，轮流从不同线程开始
+        std::atomic<size_t> m_tickleCursor{0};
+        /// use_caller时调用线程中执行调度循环的协程
+        Fiber::ptr m_rootFiber;
+    };
+}
+
+#endif
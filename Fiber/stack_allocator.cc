@@ -0,0 +1,397 @@
+#include "stack_allocator.hpp"
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#include "../Logger/log.hpp"
+#include "../Utility/cmutex.hpp"
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define SYLAR_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define SYLAR_NO_SANITIZE_ADDRESS
+#endif
+
+namespace sylar
+{
+    static Logger::ptr g_logger = SYLAR_LOG("system");
+
+    /// 最小分级16KB，最大分级16MB
+    static const int kMinShift = 14;
+    static const int kMaxShift = 24;
+    static const int kClasses = kMaxShift - kMinShift + 1;
+    /// 每个分级全局仓库最多保留的栈数
+    static const size_t kMaxDepotStacks = 1024;
+    static const size_t kHugePageSize = 2 * 1024 * 1024;
+    static const uint64_t kCanary = 0x5a5aa5a5deadbeefull;
+
+    static std::atomic<bool> s_guardPage{true};
+    static std::atomic<bool> s_hugePage{false};
+    static std::atomic<bool> s_canary{false};
+    static std::atomic<bool> s_decommitCold{true};
+    static std::atomic<size_t> s_threadCacheSize{16};
+
+    static std::atomic<size_t> s_mappedStacks{0};
+    static std::atomic<size_t> s_mappedBytes{0};
+    static std::atomic<uint64_t> s_allocs{0};
+    static std::atomic<uint64_t> s_reuses{0};
+    static std::atomic<size_t> s_maxHighWater{0};
+
+    static size_t PageSize()
+    {
+        static size_t s_pageSize = sysconf(_SC_PAGESIZE);
+        return s_pageSize;
+    }
+
+    static size_t GuardSize()
+    {
+        return s_guardPage.load(std::memory_order_relaxed) ? PageSize() : 0;
+    }
+
+    /// @brief 分级下标，不属于任何分级返回-1
+    static int SizeClass(size_t size)
+    {
+        if (size > (1ul << kMaxShift) || (size & (size - 1)))
+        {
+            return -1;
+        }
+        int shift = __builtin_ctzl(size);
+        return shift < kMinShift ? -1 : shift - kMinShift;
+    }
+
+    /// @brief 哨兵的填充和扫描会读写ASan标记过的已结束栈帧，不做检查
+    SYLAR_NO_SANITIZE_ADDRESS static void FillCanary(void *begin, void *end)
+    {
+        for (uint64_t *p = (uint64_t *)begin; p < (uint64_t *)end; ++p)
+        {
+            *p = kCanary;
+        }
+    }
+
+    /// @brief 第一个被改写的哨兵的位置
+    SYLAR_NO_SANITIZE_ADDRESS static uint64_t *FindDirty(void *stack, size_t size)
+    {
+        uint64_t *p = (uint64_t *)stack;
+        uint64_t *end = (uint64_t *)((char *)stack + size);
+        while (p < end && *p == kCanary)
+        {
+            ++p;
+        }
+        return p;
+    }
+
+    static void *MapStack(size_t size)
+    {
+        size_t guard = GuardSize();
+        bool huge = s_hugePage.load(std::memory_order_relaxed) && size >= kHugePageSize;
+        size_t slack = huge ? kHugePageSize : 0;
+        size_t len = guard + size + slack;
+        char *base = (char *)mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            SYLAR_LOG_ERROR(g_logger) << "mmap fiber stack size=" << size << " failed, errno=" << errno
+                                      << " mapped stacks=" << s_mappedStacks;
+            throw std::bad_alloc();
+        }
+
+        char *stack = base + guard;
+        if (huge)
+        {
+            // 栈按大页对齐，切掉前后多余的部分
+            stack = (char *)(((uintptr_t)stack + kHugePageSize - 1) & ~(kHugePageSize - 1));
+            size_t front = stack - guard - base;
+            size_t back = base + len - (stack + size);
+            if (front)
+            {
+                munmap(base, front);
+            }
+            if (back)
+            {
+                munmap(stack + size, back);
+            }
+            madvise(stack, size, MADV_HUGEPAGE);
+        }
+        if (guard)
+        {
+            mprotect(stack - guard, guard, PROT_NONE);
+        }
+        if (s_canary.load(std::memory_order_relaxed))
+        {
+            FillCanary(stack, stack + size);
+        }
+        ++s_mappedStacks;
+        s_mappedBytes += size;
+        return stack;
+    }
+
+    static void UnmapStack(void *stack, size_t size)
+    {
+        size_t guard = GuardSize();
+        munmap((char *)stack - guard, size + guard);
+        --s_mappedStacks;
+        s_mappedBytes -= size;
+    }
+
+    /// @brief 全局仓库，保存线程缓存溢出的冷栈
+    class StackDepot
+    {
+    public:
+        /// @brief 放入一批栈，超出上限的解除映射
+        void put(int cls, void *const *stacks, size_t n)
+        {
+            size_t size = 1ul << (cls + kMinShift);
+            bool decommit = s_decommitCold.load(std::memory_order_relaxed) && !s_canary.load(std::memory_order_relaxed);
+            size_t i = 0;
+            {
+                Mutex::Lock lock(m_mutex);
+                for (; i < n && m_stacks[cls].size() < kMaxDepotStacks; ++i)
+                {
+                    if (decommit)
+                    {
+                        madvise(stacks[i], size, MADV_DONTNEED);
+                    }
+                    m_stacks[cls].push_back(stacks[i]);
+                }
+                m_count += i;
+            }
+            for (; i < n; ++i)
+            {
+                UnmapStack(stacks[i], size);
+            }
+        }
+
+        /// @brief 取出最多n个栈
+        size_t take(int cls, void **stacks, size_t n)
+        {
+            Mutex::Lock lock(m_mutex);
+            std::vector<void *> &list = m_stacks[cls];
+            n = std::min(n, list.size());
+            std::copy(list.end() - n, list.end(), stacks);
+            list.resize(list.size() - n);
+            m_count -= n;
+            return n;
+        }
+
+        void trim()
+        {
+            std::vector<void *> stacks[kClasses];
+            {
+                Mutex::Lock lock(m_mutex);
+                for (int i = 0; i < kClasses; ++i)
+                {
+                    stacks[i].swap(m_stacks[i]);
+                }
+                m_count = 0;
+            }
+            for (int i = 0; i < kClasses; ++i)
+            {
+                for (void *stack : stacks[i])
+                {
+                    UnmapStack(stack, 1ul << (i + kMinShift));
+                }
+            }
+        }
+
+        size_t count()
+        {
+            Mutex::Lock lock(m_mutex);
+            return m_count;
+        }
+
+    private:
+        Mutex m_mutex;
+        std::vector<void *> m_stacks[kClasses];
+        size_t m_count = 0;
+    };
+
+    /// @brief 全局仓库，故意不析构：线程退出时还要把缓存交给它
+    static StackDepot *GetDepot()
+    {
+        static StackDepot *v = new StackDepot;
+        return v;
+    }
+
+    /// 线程缓存析构后置位，之后释放的栈直接交给全局仓库
+    static thread_local bool t_cacheDestroyed = false;
+
+    /// @brief 线程本地的空闲栈，每个分级一个栈式链表
+    struct ThreadStackCache
+    {
+        std::vector<void *> lists[kClasses];
+
+        ~ThreadStackCache()
+        {
+            for (int i = 0; i < kClasses; ++i)
+            {
+                if (!lists[i].empty())
+                {
+                    GetDepot()->put(i, lists[i].data(), lists[i].size());
+                }
+            }
+            t_cacheDestroyed = true;
+        }
+    };
+
+    static thread_local ThreadStackCache t_cache;
+}
+
+size_t sylar::FiberStackPool::RoundSize(size_t size)
+{
+    if (size <= (1ul << kMinShift))
+    {
+        return 1ul << kMinShift;
+    }
+    if (size <= (1ul << kMaxShift))
+    {
+        return 1ul << (64 - __builtin_clzl(size - 1));
+    }
+    return (size + PageSize() - 1) & ~(PageSize() - 1);
+}
+
+void *sylar::FiberStackPool::Alloc(size_t size)
+{
+    ++s_allocs;
+    int cls = SizeClass(size);
+    if (cls < 0 || t_cacheDestroyed)
+    {
+        return MapStack(size);
+    }
+
+    std::vector<void *> &list = t_cache.lists[cls];
+    if (list.empty())
+    {
+        // 从全局仓库批量取回一半的缓存上限
+        size_t n = std::max<size_t>(s_threadCacheSize.load(std::memory_order_relaxed) / 2, 1);
+        list.resize(n);
+        list.resize(GetDepot()->take(cls, list.data(), n));
+        if (list.empty())
+        {
+            return MapStack(size);
+        }
+    }
+    ++s_reuses;
+    void *stack = list.back();
+    list.pop_back();
+    return stack;
+}
+
+void sylar::FiberStackPool::Dealloc(void *stack, size_t size)
+{
+#if defined(__SANITIZE_ADDRESS__)
+    // 协程结束时栈帧的标记还在，复用前清掉
+    ASAN_UNPOISON_MEMORY_REGION(stack, size);
+#endif
+    if (s_canary.load(std::memory_order_relaxed))
+    {
+        // 记录使用量后只重新填充被改写的部分
+        uint64_t *dirty = FindDirty(stack, size);
+        size_t used = (char *)stack + size - (char *)dirty;
+        size_t old = s_maxHighWater.load(std::memory_order_relaxed);
+        while (used > old && !s_maxHighWater.compare_exchange_weak(old, used, std::memory_order_relaxed))
+            ;
+        FillCanary(dirty, (char *)stack + size);
+    }
+
+    int cls = SizeClass(size);
+    if (cls < 0)
+    {
+        UnmapStack(stack, size);
+        return;
+    }
+    if (t_cacheDestroyed)
+    {
+        GetDepot()->put(cls, &stack, 1);
+        return;
+    }
+
+    std::vector<void *> &list = t_cache.lists[cls];
+    list.push_back(stack);
+    size_t limit = s_threadCacheSize.load(std::memory_order_relaxed);
+    if (list.size() > limit)
+    {
+        // 一半移到全局仓库，保留最近释放的热栈
+        size_t n = list.size() - limit / 2;
+        GetDepot()->put(cls, list.data(), n);
+        list.erase(list.begin(), list.begin() + n);
+    }
+}
+
+size_t sylar::FiberStackPool::HighWaterMark(void *stack, size_t size)
+{
+    if (s_canary.load(std::memory_order_relaxed))
+    {
+        return (char *)stack + size - (char *)FindDirty(stack, size);
+    }
+    size_t page = PageSize();
+    size_t pages = size / page;
+    std::vector<unsigned char> vec(pages);
+    if (mincore(stack, size, vec.data()))
+    {
+        return 0;
+    }
+    // 从栈底向上找第一个驻留的页
+    size_t i = 0;
+    while (i < pages && !(vec[i] & 1))
+    {
+        ++i;
+    }
+    return (pages - i) * page;
+}
+
+void sylar::FiberStackPool::Trim()
+{
+    if (!t_cacheDestroyed)
+    {
+        for (int i = 0; i < kClasses; ++i)
+        {
+            for (void *stack : t_cache.lists[i])
+            {
+                UnmapStack(stack, 1ul << (i + kMinShift));
+            }
+            t_cache.lists[i].clear();
+        }
+    }
+    GetDepot()->trim();
+}
+
+sylar::FiberStackPool::Stats sylar::FiberStackPool::GetStats()
+{
+    Stats stats;
+    stats.mappedStacks = s_mappedStacks;
+    stats.mappedBytes = s_mappedBytes;
+    stats.depotStacks = GetDepot()->count();
+    stats.allocs = s_allocs;
+    stats.reuses = s_reuses;
+    stats.maxHighWater = s_maxHighWater;
+    return stats;
+}
+
+void sylar::FiberStackPool::SetGuardPage(bool v)
+{
+    s_guardPage = v;
+}
+
+void sylar::FiberStackPool::SetHugePage(bool v)
+{
+    s_hugePage = v;
+}
+
+void sylar::FiberStackPool::SetCanary(bool v)
+{
+    s_canary = v;
+}
+
+void sylar::FiberStackPool::SetThreadCacheSize(size_t n)
+{
+    s_threadCacheSize = n;
+}
+
+void sylar::FiberStackPool::SetDecommitCold(bool v)
+{
+    s_decommitCold = v;
+}
@@ -0,0 +1,77 @@
+#ifndef __SYLAR_STACK_ALLOCATOR_H__
+#define __SYLAR_STACK_ALLOCATOR_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sylar
+{
+    /**
+     * @brief 协程栈池
+     * @details 栈用mmap分配，下方有一个PROT_NONE的保护页，栈溢出时立即段错误而不是改写相邻内存。
+     *          栈大小按2的幂分级（16KB~16MB），释放的栈先放入线程本地的空闲链表，
+     *          超出上限时一半移到全局仓库，仓库中的栈是冷的，用MADV_DONTNEED归还物理内存但保留地址空间。
+     *          分配时依次从线程缓存、全局仓库取，都没有时才mmap。
+     *          选项需要在创建第一个协程之前设置
+     */
+    class FiberStackPool
+    {
+    public:
+        /// @brief 统计信息
+        struct Stats
+        {
+            /// 已映射的栈数和字节数（不含保护页）
+            size_t mappedStacks;
+            size_t mappedBytes;
+            /// 全局仓库中的栈数
+            size_t depotStacks;
+            /// 分配次数、其中复用缓存的次数
+            uint64_t allocs;
+            uint64_t reuses;
+            /// 开启栈哨兵时，释放过的栈中观察到的最大使用量
+            size_t maxHighWater;
+        };
+
+        /// @brief 把栈大小向上取整到分级大小，大于16MB的按页取整
+        static size_t RoundSize(size_t size);
+
+        /**
+         * @brief 分配栈
+         * @param size 栈大小，必须是RoundSize()的结果
+         * @return 栈的最低地址，栈顶是返回值加size
+         */
+        static void *Alloc(size_t size);
+
+        /// @brief 释放栈，放回缓存
+        static void Dealloc(void *stack, size_t size);
+
+        /**
+         * @brief 栈的最大使用量，字节
+         * @details 开启栈哨兵时从栈底向上找第一个被改写的哨兵，精确到8字节；
+         *          否则用mincore统计驻留的页，精确到页，包括栈被复用前留下的页
+         */
+        static size_t HighWaterMark(void *stack, size_t size);
+
+        /// @brief 把当前线程缓存和全局仓库中的栈全部解除映射
+        static void Trim();
+
+        static Stats GetStats();
+
+        /// @brief 是否在栈下方放置保护页，默认开启。每个带保护页的栈占两个VMA，受vm.max_map_count限制
+        static void SetGuardPage(bool v);
+
+        /// @brief 2MB及以上的栈按2MB对齐并用透明大页，减少缺页和TLB未命中，但首次访问就会驻留整个大页
+        static void SetHugePage(bool v);
+
+        /// @brief 新映射的栈填充哨兵值用于统计使用量，会让整个栈驻留内存，用于调整栈大小
+        static void SetCanary(bool v);
+
+        /// @brief 每个线程每个分级缓存的栈数上限，默认16
+        static void SetThreadCacheSize(size_t n);
+
+        /// @brief 移入全局仓库的栈是否用MADV_DONTNEED归还物理内存，默认开启，开启哨兵时不生效
+        static void SetDecommitCold(bool v);
+    };
+}
+
+#endif
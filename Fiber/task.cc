@@ -0,0 +1,227 @@
+#include "task.hpp"
+#include <cassert>
+#include <new>
+
+namespace sylar
+{
+    static Logger::ptr g_logger = SYLAR_LOG("system");
+
+    static const size_t kFrameClasses = TaskFrameAllocator::kMaxSize / TaskFrameAllocator::kClassSize;
+
+    /**
+     * @brief 线程缓存的空闲帧，空闲帧的开头存放下一个空闲帧的指针
+     */
+    struct FrameCache
+    {
+        void *head[kFrameClasses] = {};
+        size_t count[kFrameClasses] = {};
+
+        ~FrameCache() { release(); }
+
+        void release()
+        {
+            for (size_t i = 0; i < kFrameClasses; ++i)
+            {
+                while (head[i])
+                {
+                    void *next = *static_cast<void **>(head[i]);
+                    ::operator delete(head[i]);
+                    head[i] = next;
+                }
+                count[i] = 0;
+            }
+        }
+    };
+
+    static thread_local FrameCache t_frameCache;
+}
+
+void *sylar::TaskFrameAllocator::Alloc(size_t size)
+{
+    if (size > kMaxSize)
+    {
+        return ::operator new(size);
+    }
+    size_t index = (size - 1) / kClassSize;
+    FrameCache &cache = t_frameCache;
+    if (void *frame = cache.head[index])
+    {
+        cache.head[index] = *static_cast<void **>(frame);
+        --cache.count[index];
+        return frame;
+    }
+    return ::operator new((index + 1) * kClassSize);
+}
+
+void sylar::TaskFrameAllocator::Dealloc(void *ptr, size_t size)
+{
+    if (size > kMaxSize)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+    size_t index = (size - 1) / kClassSize;
+    FrameCache &cache = t_frameCache;
+    if (cache.count[index] >= kCacheLimit)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+    *static_cast<void **>(ptr) = cache.head[index];
+    cache.head[index] = ptr;
+    ++cache.count[index];
+}
+
+void sylar::TaskFrameAllocator::Trim()
+{
+    t_frameCache.release();
+}
+
+void sylar::TaskPromiseBase::onDetachedDone()
+{
+    if (m_exception)
+    {
+        try
+        {
+            std::rethrow_exception(m_exception);
+        }
+        catch (const std::exception &e)
+        {
+            SYLAR_LOG_ERROR(g_logger) << "detached task exception: " << e.what();
+        }
+        catch (...)
+        {
+            SYLAR_LOG_ERROR(g_logger) << "detached task unknown exception";
+        }
+    }
+}
+
+namespace sylar
+{
+    static void ResumeHandle(void *address)
+    {
+        std::coroutine_handle<>::from_address(address).resume();
+    }
+}
+
+void sylar::ScheduleResume(Scheduler *scheduler, std::coroutine_handle<> handle)
+{
+    if (scheduler)
+    {
+        // 无栈协程不需要自己的栈，直接在调度协程上恢复
+        scheduler->scheduleDirect(&ResumeHandle, handle.address());
+    }
+    else
+    {
+        handle.resume();
+    }
+}
+
+void sylar::Spawn(Task<void> task, Scheduler *scheduler)
+{
+    if (!scheduler)
+    {
+        scheduler = Scheduler::GetThis();
+    }
+    ScheduleResume(scheduler, task.detach());
+}
+
+void sylar::YieldAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    ScheduleResume(Scheduler::GetThis(), handle);
+}
+
+void sylar::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    IOManager *iom = IOManager::GetThis();
+    assert(iom);
+    // 定时器到期时回调在调度器中执行，直接恢复协程
+    iom->addTimer(m_ms, [handle]()
+                  { handle.resume(); });
+}
+
+bool sylar::IOAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    IOManager *iom = IOManager::GetThis();
+    assert(iom);
+    if (m_timeoutMs != ~0ull)
+    {
+        m_state = std::make_shared<TimeoutState>();
+        std::weak_ptr<TimeoutState> weak(m_state);
+        int fd = m_fd;
+        IOManager::Event event = m_event;
+        m_timer = iom->addConditionTimer(m_timeoutMs, [weak, fd, event, iom]()
+                                         {
+            auto state = weak.lock();
+            if (!state || state->cancelled)
+            {
+                return;
+            }
+            state->cancelled = ETIMEDOUT;
+            iom->cancelEvent(fd, event); }, weak);
+    }
+    // 回调在恢复协程之前写入结果，此时等待体还在协程帧中
+    if (iom->addEvent(m_fd, m_event, [this, handle](bool ready)
+                      {
+        m_cancelled = !ready;
+        handle.resume(); }))
+    {
+        m_failed = true;
+        if (m_timer)
+        {
+            m_timer->cancel();
+        }
+        return false;
+    }
+    // 事件可能已经在其他线程触发并恢复了协程，这里不能再访问成员
+    return true;
+}
+
+bool sylar::IOAwaiter::await_resume()
+{
+    if (m_failed)
+    {
+        return false;
+    }
+    if (m_timer)
+    {
+        m_timer->cancel();
+    }
+    if (m_state && m_state->cancelled)
+    {
+        errno = m_state->cancelled;
+        return false;
+    }
+    if (m_cancelled)
+    {
+        errno = ECANCELED;
+        return false;
+    }
+    return true;
+}
+
+bool sylar::MutexAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_handle = handle;
+    m_waiter.scheduler = Scheduler::GetThis();
+    m_waiter.cb = [this]()
+    { retry(); };
+    // 入队后锁可能马上被释放并在其他线程调用retry()，返回true之后不能再访问成员
+    return !m_mutex.lockOrEnqueue(m_waiter, false, m_start);
+}
+
+void sylar::MutexAwaiter::retry()
+{
+    if (m_waiter.handoff || m_mutex.lockOrEnqueue(m_waiter, true, m_start))
+    {
+        m_handle.resume();
+    }
+}
+
+bool sylar::SemaphoreAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_waiter.scheduler = Scheduler::GetThis();
+    m_waiter.cb = [handle]()
+    { handle.resume(); };
+    return !m_semaphore.waitOrEnqueue(m_waiter);
+}
@@ -0,0 +1,323 @@
+#ifndef __SYLAR_TASK_H__
+#define __SYLAR_TASK_H__
+
+#if __cplusplus < 202002L
+#error "task.hpp requires C++20, configure with -DSYLAR_CXX20=ON"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "fiber_sync.hpp"
+#include "iomanager.hpp"
+
+namespace sylar
+{
+    /**
+     * @brief 无栈协程帧的分配器
+     * @details 按64字节分级，每个线程缓存空闲的帧，分配和释放只是链表操作。
+     *          帧可能在另一个线程结束，释放时放进当前线程的缓存；缓存满了或者帧超过最大分级时交给operator new/delete
+     */
+    class TaskFrameAllocator
+    {
+    public:
+        static void *Alloc(size_t size);
+        static void Dealloc(void *ptr, size_t size);
+
+        /// @brief 释放当前线程缓存的帧
+        static void Trim();
+
+        /// 分级粒度
+        static const size_t kClassSize = 64;
+        /// 最大分级，更大的帧不缓存
+        static const size_t kMaxSize = 2048;
+        /// 每个线程每个分级最多缓存的帧数
+        static const size_t kCacheLimit = 1024;
+    };
+
+    template <class T>
+    class Task;
+
+    /**
+     * @brief 协程承诺对象中与返回值类型无关的部分
+     * @details 协程创建后先挂起，被co_await或Spawn时才开始执行；结束时用对称转移直接恢复等待它的协程，
+     *          被Spawn的协程没有等待者，结束时自己销毁帧
+     */
+    class TaskPromiseBase
+    {
+    public:
+        static void *operator new(size_t size) { return TaskFrameAllocator::Alloc(size); }
+        static void operator delete(void *ptr, size_t size) { TaskFrameAllocator::Dealloc(ptr, size); }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            template <class Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                TaskPromiseBase &promise = handle.promise();
+                if (promise.m_continuation)
+                {
+                    return promise.m_continuation;
+                }
+                if (promise.m_detached)
+                {
+                    promise.onDetachedDone();
+                    handle.destroy();
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { m_exception = std::current_exception(); }
+
+    protected:
+        /// @brief 被Spawn的协程结束，有未捕获的异常时写日志
+        void onDetachedDone();
+
+        template <class T>
+        friend class Task;
+
+        /// 等待本协程结束的协程
+        std::coroutine_handle<> m_continuation;
+        std::exception_ptr m_exception;
+        bool m_detached = false;
+    };
+
+    template <class T>
+    class TaskPromise : public TaskPromiseBase
+    {
+    public:
+        Task<T> get_return_object();
+
+        template <class U>
+        void return_value(U &&value) { m_value.emplace(std::forward<U>(value)); }
+
+        T result()
+        {
+            if (m_exception)
+            {
+                std::rethrow_exception(m_exception);
+            }
+            return std::move(*m_value);
+        }
+
+    private:
+        std::optional<T> m_value;
+    };
+
+    template <>
+    class TaskPromise<void> : public TaskPromiseBase
+    {
+    public:
+        Task<void> get_return_object();
+
+        void return_void() {}
+
+        void result()
+        {
+            if (m_exception)
+            {
+                std::rethrow_exception(m_exception);
+            }
+        }
+    };
+
+    /**
+     * @brief 无栈协程
+     * @details 协程的局部变量放在池化分配的帧里，挂起时不占用栈，适合大量长时间空闲的连接。
+     *          在调度器中恢复时借用线程缓存的回调协程的栈执行，因此不能调用会挂起协程的阻塞接口（hook的IO、FiberMutex::lock等），
+     *          需要等待时使用下面的等待体：WaitEvent、SleepFor、Yield、AwaitLock、AwaitSemaphore。
+     *          Task本身也可以co_await，结果或异常传给等待方
+     */
+    template <class T = void>
+    class [[nodiscard]] Task
+    {
+    public:
+        typedef TaskPromise<T> promise_type;
+        typedef std::coroutine_handle<promise_type> handle_type;
+
+        Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        bool await_ready() const noexcept { return false; }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+        {
+            m_handle.promise().m_continuation = caller;
+            return m_handle;
+        }
+
+        T await_resume() { return m_handle.promise().result(); }
+
+        /// @brief 交出协程帧的所有权，协程结束时自己销毁
+        handle_type detach()
+        {
+            m_handle.promise().m_detached = true;
+            return std::exchange(m_handle, nullptr);
+        }
+
+    private:
+        friend class TaskPromise<T>;
+
+        explicit Task(handle_type handle) : m_handle(handle) {}
+
+    private:
+        handle_type m_handle;
+    };
+
+    template <class T>
+    Task<T> TaskPromise<T>::get_return_object()
+    {
+        return Task<T>(Task<T>::handle_type::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object()
+    {
+        return Task<void>(Task<void>::handle_type::from_promise(*this));
+    }
+
+    /// @brief 在调度器中恢复协程
+    void ScheduleResume(Scheduler *scheduler, std::coroutine_handle<> handle);
+
+    /**
+     * @brief 在调度器中启动协程，不等待它结束
+     * @param scheduler 为空时使用当前线程的调度器
+     */
+    void Spawn(Task<void> task, Scheduler *scheduler = nullptr);
+
+    /**
+     * @brief 让出执行权，重新排到调度器队尾
+     */
+    class YieldAwaiter
+    {
+    public:
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+    };
+
+    inline YieldAwaiter Yield() { return YieldAwaiter(); }
+
+    /**
+     * @brief 等待一段时间，依赖当前线程的IOManager
+     */
+    class SleepAwaiter
+    {
+    public:
+        explicit SleepAwaiter(uint64_t ms) : m_ms(ms) {}
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+
+    private:
+        uint64_t m_ms;
+    };
+
+    inline SleepAwaiter SleepFor(uint64_t ms) { return SleepAwaiter(ms); }
+
+    /**
+     * @brief 等待fd上的IO事件，依赖当前线程的IOManager
+     * @details co_await的结果：事件就绪为true；超时、事件被取消或者添加事件失败为false，
+     *          超时时errno为ETIMEDOUT，被cancelEvent()/cancelAll()（例如hook的close）取消时为ECANCELED
+     */
+    class IOAwaiter
+    {
+    public:
+        IOAwaiter(int fd, IOManager::Event event, uint64_t timeoutMs) : m_fd(fd), m_event(event), m_timeoutMs(timeoutMs) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        bool await_resume();
+
+    private:
+        /// 超时定时器和等待体共享的状态，定时器可能在等待体销毁之后才触发
+        struct TimeoutState
+        {
+            std::atomic<int> cancelled{0};
+        };
+
+        int m_fd;
+        IOManager::Event m_event;
+        uint64_t m_timeoutMs;
+        bool m_failed = false;
+        /// 事件被取消，由事件回调在恢复协程前设置
+        bool m_cancelled = false;
+        std::shared_ptr<TimeoutState> m_state;
+        Timer::ptr m_timer;
+    };
+
+    /**
+     * @param timeoutMs 超时时间，~0ull表示不超时
+     */
+    inline IOAwaiter WaitEvent(int fd, IOManager::Event event, uint64_t timeoutMs = ~0ull)
+    {
+        return IOAwaiter(fd, event, timeoutMs);
+    }
+
+    /**
+     * @brief 等待FiberMutex，co_await返回时已经持有锁，之后调用unlock()释放
+     * @details 和挂起协程的lock()共用一个等待队列，协程和无栈协程可以竞争同一把锁
+     */
+    class MutexAwaiter
+    {
+    public:
+        explicit MutexAwaiter(FiberMutex &mutex) : m_mutex(mutex) {}
+
+        bool await_ready() { return m_mutex.tryLock(); }
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+
+    private:
+        /// @brief 被唤醒后重新抢锁，抢到了才恢复协程
+        void retry();
+
+    private:
+        FiberMutex &m_mutex;
+        FiberWaiter m_waiter;
+        std::coroutine_handle<> m_handle;
+        uint64_t m_start = 0;
+    };
+
+    inline MutexAwaiter AwaitLock(FiberMutex &mutex) { return MutexAwaiter(mutex); }
+
+    /**
+     * @brief 等待FiberSemaphore的计数
+     */
+    class SemaphoreAwaiter
+    {
+    public:
+        explicit SemaphoreAwaiter(FiberSemaphore &semaphore) : m_semaphore(semaphore) {}
+
+        bool await_ready() { return m_semaphore.tryWait(); }
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+
+    private:
+        FiberSemaphore &m_semaphore;
+        FiberWaiter m_waiter;
+    };
+
+    inline SemaphoreAwaiter AwaitSemaphore(FiberSemaphore &semaphore) { return SemaphoreAwaiter(semaphore); }
+}
+
+#endif
@@ -0,0 +1,371 @@
+#include "timer.hpp"
+#include <algorithm>
+#include <cstring>
+#include "../Utility/util.h"
+
+namespace sylar
+{
+    /// @brief 在位图中从from开始查找第一个置位的位，没有返回-1
+    static int FindFirstSet(const uint64_t *bitmap, int bits, int from)
+    {
+        while (from < bits)
+        {
+            uint64_t word = bitmap[from >> 6] & (~0ull << (from & 63));
+            if (word)
+            {
+                return (from & ~63) + __builtin_ctzll(word);
+            }
+            from = (from & ~63) + 64;
+        }
+        return -1;
+    }
+
+    /// @brief 条件定时器的回调：条件对象还存在时才执行
+    static void OnTimer(std::weak_ptr<void> weak_cond, std::function<void()> cb)
+    {
+        std::shared_ptr<void> tmp = weak_cond.lock();
+        if (tmp)
+        {
+            cb();
+        }
+    }
+}
+
+sylar::Timer::Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager *manager)
+    : m_recurring(recurring), m_ms(ms), m_cb(cb), m_manager(manager)
+{
+    m_next = GetCoarseMS() + m_ms;
+}
+
+bool sylar::Timer::cancel()
+{
+    // 在锁外释放自身引用
+    Timer::ptr self;
+    TimerManager *manager = m_manager.load(std::memory_order_acquire);
+    if (!manager)
+    {
+        return false;
+    }
+    TimerManager::MutexType::Lock lock(manager->m_mutex);
+    if (!m_cb)
+    {
+        return false;
+    }
+    m_cb = nullptr;
+    m_manager.store(nullptr, std::memory_order_relaxed);
+    manager->unlink(this);
+    --manager->m_count;
+    self.swap(m_self);
+    return true;
+}
+
+bool sylar::Timer::refresh()
+{
+    TimerManager *manager = m_manager.load(std::memory_order_acquire);
+    if (!manager)
+    {
+        return false;
+    }
+    TimerManager::MutexType::Lock lock(manager->m_mutex);
+    if (!m_cb)
+    {
+        return false;
+    }
+    manager->unlink(this);
+    m_next = GetCoarseMS() + m_ms;
+    manager->link(this);
+    return true;
+}
+
+bool sylar::Timer::reset(uint64_t ms, bool from_now)
+{
+    TimerManager *manager = m_manager.load(std::memory_order_acquire);
+    if (!manager)
+    {
+        return false;
+    }
+    if (ms == m_ms && !from_now)
+    {
+        return true;
+    }
+    bool at_front;
+    {
+        TimerManager::MutexType::Lock lock(manager->m_mutex);
+        if (!m_cb)
+        {
+            return false;
+        }
+        manager->unlink(this);
+        uint64_t start = from_now ? GetCoarseMS() : m_next - m_ms;
+        m_ms = ms;
+        m_next = start + m_ms;
+        at_front = manager->insert(this);
+    }
+    if (at_front)
+    {
+        manager->onTimerInsertedAtFront();
+    }
+    return true;
+}
+
+sylar::TimerManager::TimerManager()
+    : m_current(GetCoarseMS())
+{
+    memset(m_wheel0, 0, sizeof(m_wheel0));
+    memset(m_wheels, 0, sizeof(m_wheels));
+    memset(m_bitmap0, 0, sizeof(m_bitmap0));
+    memset(m_bitmaps, 0, sizeof(m_bitmaps));
+}
+
+sylar::TimerManager::~TimerManager()
+{
+    // 断开定时器对自身的引用并和本管理器脱离，用户手里的Timer::ptr之后cancel()等返回false，不会再访问本管理器
+    std::vector<Timer::ptr> timers;
+    MutexType::Lock lock(m_mutex);
+    for (int level = 0; level <= kWheelLevels; ++level)
+    {
+        int slots = level ? kWheelSize : kWheel0Size;
+        for (int slot = 0; slot < slots; ++slot)
+        {
+            Timer *&head = slotHead(level, slot);
+            while (head)
+            {
+                Timer *timer = head;
+                unlink(timer);
+                timer->m_cb = nullptr;
+                timer->m_manager.store(nullptr, std::memory_order_release);
+                timers.push_back(std::move(timer->m_self));
+            }
+        }
+    }
+    m_count = 0;
+}
+
+sylar::Timer::ptr sylar::TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring)
+{
+    Timer::ptr timer(new Timer(ms, cb, recurring, this));
+    timer->m_self = timer;
+    bool at_front;
+    {
+        MutexType::Lock lock(m_mutex);
+        ++m_count;
+        at_front = insert(timer.get());
+    }
+    if (at_front)
+    {
+        onTimerInsertedAtFront();
+    }
+    return timer;
+}
+
+sylar::Timer::ptr sylar::TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> weak_cond, bool recurring)
+{
+    return addTimer(ms, std::bind(&OnTimer, weak_cond, cb), recurring);
+}
+
+uint64_t sylar::TimerManager::getNextTimer()
+{
+    uint64_t next = ~0ull;
+    {
+        MutexType::Lock lock(m_mutex);
+        if (!m_count)
+        {
+            m_nextHint = ~0ull;
+            return ~0ull;
+        }
+        int index = m_current & (kWheel0Size - 1);
+        uint64_t base = m_current - index;
+        int pos = FindFirstSet(m_bitmap0, kWheel0Size, index);
+        if (pos >= 0)
+        {
+            next = base + pos;
+        }
+        else if ((pos = FindFirstSet(m_bitmap0, kWheel0Size, 0)) >= 0)
+        {
+            next = base + kWheel0Size + pos;
+        }
+        // 高层有定时器时，最晚在下一圈开始重新分配时醒来
+        for (int level = 0; level < kWheelLevels; ++level)
+        {
+            if (m_bitmaps[level])
+            {
+                next = std::min(next, base + kWheel0Size);
+                break;
+            }
+        }
+        m_nextHint = next;
+    }
+    uint64_t now = GetCoarseMS();
+    return next <= now ? 0 : next - now;
+}
+
+void sylar::TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs)
+{
+    uint64_t now = GetCoarseMS();
+    MutexType::Lock lock(m_mutex);
+    if (!m_count)
+    {
+        m_current = std::max(m_current, now + 1);
+        return;
+    }
+
+    std::vector<Timer *> recurring;
+    while (m_current <= now)
+    {
+        int index = m_current & (kWheel0Size - 1);
+        if (index == 0)
+        {
+            // 第0层转完一圈，依次把上层当前槽位的定时器分配下来，上层也转完一圈时继续往上
+            for (int level = 1; level <= kWheelLevels; ++level)
+            {
+                int slot = (m_current >> (kWheel0Bits + kWheelBits * (level - 1))) & (kWheelSize - 1);
+                cascade(level, slot);
+                if (slot)
+                {
+                    break;
+                }
+            }
+        }
+
+        // 整个槽位一次摘下，每个定时器只访问一次
+        Timer *timer = m_wheel0[index];
+        m_wheel0[index] = nullptr;
+        m_bitmap0[index >> 6] &= ~(1ull << (index & 63));
+        while (timer)
+        {
+            Timer *next = timer->m_nextNode;
+            timer->m_prevNode = nullptr;
+            timer->m_nextNode = nullptr;
+            if (timer->m_recurring)
+            {
+                cbs.push_back(timer->m_cb);
+                recurring.push_back(timer);
+            }
+            else
+            {
+                cbs.push_back(std::move(timer->m_cb));
+                timer->m_cb = nullptr;
+                timer->m_manager.store(nullptr, std::memory_order_release);
+                --m_count;
+                // 回调已经移走，趁定时器还在缓存里释放自身引用
+                timer->m_self.reset();
+            }
+            timer = next;
+        }
+
+        // 跳过空槽，但不越过下一圈的起点（需要分配上层定时器）和现在
+        int pos = FindFirstSet(m_bitmap0, kWheel0Size, index + 1);
+        uint64_t next = m_current - index + (pos >= 0 ? pos : kWheel0Size);
+        m_current = std::min(next, now + 1);
+    }
+
+    // 时间轮推进到now之后再重新挂上循环定时器，否则超时为0的定时器会在同一槽位里反复触发
+    for (Timer *timer : recurring)
+    {
+        timer->m_next = now + timer->m_ms;
+        link(timer);
+    }
+}
+
+bool sylar::TimerManager::hasTimer()
+{
+    MutexType::Lock lock(m_mutex);
+    return m_count > 0;
+}
+
+sylar::Timer *&sylar::TimerManager::slotHead(int level, int slot)
+{
+    return level ? m_wheels[level - 1][slot] : m_wheel0[slot];
+}
+
+uint64_t &sylar::TimerManager::slotBitmap(int level, int slot)
+{
+    return level ? m_bitmaps[level - 1] : m_bitmap0[slot >> 6];
+}
+
+void sylar::TimerManager::link(Timer *timer)
+{
+    // 已经过期的定时器放到当前槽位，下一次推进时触发
+    uint64_t expires = std::max(timer->m_next, m_current);
+    uint64_t delta = expires - m_current;
+    int level = 0;
+    int slot;
+    if (delta < (uint64_t)kWheel0Size)
+    {
+        slot = expires & (kWheel0Size - 1);
+    }
+    else
+    {
+        level = 1;
+        while (level < kWheelLevels && delta >= (1ull << (kWheel0Bits + kWheelBits * level)))
+        {
+            ++level;
+        }
+        // 超出时间轮范围的放在最高层最远的槽位，分配下来时再按真实的到期时间放置
+        if (delta >= (1ull << (kWheel0Bits + kWheelBits * kWheelLevels)))
+        {
+            expires = m_current + (1ull << (kWheel0Bits + kWheelBits * kWheelLevels)) - 1;
+        }
+        slot = (expires >> (kWheel0Bits + kWheelBits * (level - 1))) & (kWheelSize - 1);
+    }
+
+    Timer *&head = slotHead(level, slot);
+    timer->m_level = level;
+    timer->m_slot = slot;
+    timer->m_prevNode = nullptr;
+    timer->m_nextNode = head;
+    if (head)
+    {
+        head->m_prevNode = timer;
+    }
+    head = timer;
+    slotBitmap(level, slot) |= 1ull << (slot & 63);
+}
+
+void sylar::TimerManager::unlink(Timer *timer)
+{
+    Timer *&head = slotHead(timer->m_level, timer->m_slot);
+    if (timer->m_prevNode)
+    {
+        timer->m_prevNode->m_nextNode = timer->m_nextNode;
+    }
+    else
+    {
+        head = timer->m_nextNode;
+    }
+    if (timer->m_nextNode)
+    {
+        timer->m_nextNode->m_prevNode = timer->m_prevNode;
+    }
+    if (!head)
+    {
+        slotBitmap(timer->m_level, timer->m_slot) &= ~(1ull << (timer->m_slot & 63));
+    }
+    timer->m_prevNode = nullptr;
+    timer->m_nextNode = nullptr;
+}
+
+void sylar::TimerManager::cascade(int level, int slot)
+{
+    Timer *&head = slotHead(level, slot);
+    Timer *timer = head;
+    head = nullptr;
+    slotBitmap(level, slot) &= ~(1ull << (slot & 63));
+    while (timer)
+    {
+        Timer *next = timer->m_nextNode;
+        link(timer);
+        timer = next;
+    }
+}
+
+bool sylar::TimerManager::insert(Timer *timer)
+{
+    link(timer);
+    if (timer->m_next < m_nextHint)
+    {
+        m_nextHint = timer->m_next;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,151 @@
+#ifndef __SYLAR_TIMER_H__
+#define __SYLAR_TIMER_H__
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../Utility/cmutex.hpp"
+
+namespace sylar
+{
+    class TimerManager;
+
+    /**
+     * @brief 定时器
+     * @details 由TimerManager创建。挂在时间轮上期间定时器持有自身的引用，取消或触发（非循环）后释放。
+     *          取消、触发（非循环）或TimerManager析构后定时器和管理器脱离，之后cancel()、refresh()、reset()都返回false；
+     *          这三个函数不能与TimerManager的析构并发调用
+     */
+    class Timer : public std::enable_shared_from_this<Timer>
+    {
+        friend class TimerManager;
+
+    public:
+        typedef std::shared_ptr<Timer> ptr;
+
+        /// @brief 取消定时器，已经触发或取消过返回false
+        bool cancel();
+
+        /// @brief 从现在开始重新计时，已经触发或取消过返回false
+        bool refresh();
+
+        /**
+         * @brief 重新设置定时器的时间
+         * @param ms 新的超时时间
+         * @param from_now 是否从现在开始计时，否则从上次开始计时的时间算起
+         * @return 已经触发或取消过返回false
+         */
+        bool reset(uint64_t ms, bool from_now);
+
+    private:
+        Timer(uint64_t ms, std::function<void()> cb, bool recurring, TimerManager *manager);
+
+    private:
+        /// 是否循环
+        bool m_recurring = false;
+        /// 超时时间
+        uint64_t m_ms = 0;
+        /// 到期的绝对时间，GetCoarseMS()
+        uint64_t m_next = 0;
+        std::function<void()> m_cb;
+        /// 所属的管理器，和管理器脱离后为空，只在管理器的锁内修改
+        std::atomic<TimerManager *> m_manager{nullptr};
+
+        /// 时间轮槽位中的双向链表
+        Timer *m_prevNode = nullptr;
+        Timer *m_nextNode = nullptr;
+        /// 所在的层和槽位
+        uint8_t m_level = 0;
+        uint16_t m_slot = 0;
+        /// 挂在时间轮上期间持有自身
+        Timer::ptr m_self;
+    };
+
+    /**
+     * @brief 定时器管理器，分层时间轮实现
+     * @details 第0层256个槽，每槽1ms；往上4层各64个槽，每层一槽覆盖下一层一整圈，共覆盖2^32ms。
+     *          定时器按到期时间与当前时间的差放入对应层的槽位（槽内是侵入式双向链表），
+     *          添加、取消、刷新都是O(1)。时间走到高层槽位的起点时把它的定时器重新分配到下层。
+     *          每层有占用位图，推进时间和计算下一个到期时间时跳过空槽。
+     *          时间取自GetCoarseMS()，定时精度为一个时钟节拍
+     */
+    class TimerManager
+    {
+        friend class Timer;
+
+    public:
+        typedef Mutex MutexType;
+
+        TimerManager();
+
+        virtual ~TimerManager();
+
+        /**
+         * @brief 添加定时器
+         * @param ms 超时时间，毫秒
+         * @param cb 回调
+         * @param recurring 是否循环
+         */
+        Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false);
+
+        /**
+         * @brief 添加条件定时器，触发时weak_cond指向的对象已经释放则不执行回调
+         */
+        Timer::ptr addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> weak_cond, bool recurring = false);
+
+        /**
+         * @brief 距离下一个定时器到期的毫秒数
+         * @details 没有定时器时返回~0ull。高层槽位中的定时器以该槽位开始重新分配的时间计算，结果不会晚于真实的到期时间
+         */
+        uint64_t getNextTimer();
+
+        /// @brief 取出所有已到期定时器的回调，循环定时器重新计时
+        void listExpiredCb(std::vector<std::function<void()>> &cbs);
+
+        /// @brief 是否有定时器
+        bool hasTimer();
+
+    protected:
+        /// @brief 新添加的定时器比上一次getNextTimer()的结果更早到期时调用，用于唤醒等待中的线程重新计算超时
+        virtual void onTimerInsertedAtFront() = 0;
+
+    private:
+        /// @brief 把定时器挂到时间轮上，调用时持有锁
+        void link(Timer *timer);
+
+        /// @brief 把定时器从时间轮上摘下，调用时持有锁
+        void unlink(Timer *timer);
+
+        /// @brief 把第level层（1开始）slot槽位的定时器重新分配到下层
+        void cascade(int level, int slot);
+
+        /// @brief 挂上定时器，返回是否需要调用onTimerInsertedAtFront()，调用时持有锁
+        bool insert(Timer *timer);
+
+        Timer *&slotHead(int level, int slot);
+        uint64_t &slotBitmap(int level, int slot);
+
+    private:
+        static const int kWheel0Bits = 8;
+        static const int kWheel0Size = 1 << kWheel0Bits;
+        static const int kWheelBits = 6;
+        static const int kWheelSize = 1 << kWheelBits;
+        static const int kWheelLevels = 4;
+
+        MutexType m_mutex;
+        /// 时间轮当前处理到的时间，毫秒
+        uint64_t m_current;
+        /// 定时器数量
+        size_t m_count = 0;
+        /// 上一次getNextTimer()算出的到期时间，更早的定时器加入时需要通知
+        uint64_t m_nextHint = ~0ull;
+        Timer *m_wheel0[kWheel0Size];
+        Timer *m_wheels[kWheelLevels][kWheelSize];
+        uint64_t m_bitmap0[kWheel0Size / 64];
+        uint64_t m_bitmaps[kWheelLevels];
+    };
+}
+
+#endif
@@ -1,5 +1,8 @@
 #include "log.hpp"
+#include <algorithm>
 #include <cstdarg>
+#include <cstring>
+#include <csignal>
 namespace sylar
 {
 
@@ -48,6 +51,45 @@ namespace sylar
         return LogLevel::NOTSET;
     }
 
+    thread_local bool TraceContext::s_forceDebug = false;
+    static thread_local std::string t_traceId;
+
+    void TraceContext::Set(const std::string &traceId, bool forceDebug)
+    {
+        t_traceId = traceId;
+        s_forceDebug = forceDebug;
+    }
+
+    void TraceContext::Clear()
+    {
+        t_traceId.clear();
+        s_forceDebug = false;
+    }
+
+    const std::string &TraceContext::GetTraceId()
+    {
+        return t_traceId;
+    }
+
+    void TraceContext::Switch(State &from, State &to)
+    {
+        from.traceId.swap(t_traceId);
+        from.forceDebug = s_forceDebug;
+        t_traceId.swap(to.traceId);
+        s_forceDebug = to.forceDebug;
+    }
+
+    TraceScope::TraceScope(const std::string &traceId, bool forceDebug)
+        : m_prevTraceId(TraceContext::GetTraceId()), m_prevForceDebug(TraceContext::IsForceDebug())
+    {
+        TraceContext::Set(traceId, forceDebug);
+    }
+
+    TraceScope::~TraceScope()
+    {
+        TraceContext::Set(m_prevTraceId, m_prevForceDebug);
+    }
+
     LogEvent::LogEvent(const std::string &loggerName, LogLevel::Level level,
                        const char *file, int32_t line,
                        uint64_t elapse, uint64_t threadId,
@@ -55,11 +97,41 @@ namespace sylar
                        time_t time) : m_loggerName(loggerName), m_level(level),
                                       m_file(file), m_line(line), m_elapse(elapse),
                                       m_threadId(threadId), m_fiberId(fiberId),
-                                      m_threadName(threadName), m_time(time)
+                                      m_threadName(threadName), m_time(time),
+                                      m_traceId(TraceContext::GetTraceId()),
+                                      m_forceDebug(TraceContext::IsForceDebug())
 
     {
     }
 
+    namespace
+    {
+        /// 通过派生类访问stringbuf受保护的缓冲区指针
+        struct StringBufAccess : public std::stringbuf
+        {
+            static std::string_view View(const std::stringbuf *buf)
+            {
+                typedef char *(std::stringbuf::*Getter)() const;
+                Getter pbaseGetter = &StringBufAccess::pbase;
+                Getter pptrGetter = &StringBufAccess::pptr;
+                Getter egptrGetter = &StringBufAccess::egptr;
+                const char *begin = (buf->*pbaseGetter)();
+                if (!begin)
+                {
+                    return std::string_view();
+                }
+                // 和str()一样取写指针和读区末尾中较大的一个
+                const char *end = std::max((buf->*pptrGetter)(), (buf->*egptrGetter)());
+                return std::string_view(begin, end - begin);
+            }
+        };
+    }
+
+    std::string_view LogEvent::getContentView() const
+    {
+        return StringBufAccess::View(m_ss.rdbuf());
+    }
+
     void LogEvent::printf(const char *fmt, ...)
     {
         va_list ap;
@@ -196,6 +268,16 @@ namespace sylar
         }
     };
 
+    class TraceIdFormatItem : public LogFormatter::FormatterItem
+    {
+    public:
+        TraceIdFormatItem(const std::string &str = "") {}
+        void format(std::ostream &os, LogEvent::ptr event) override
+        {
+            os << event->getTraceId();
+        }
+    };
+
     class PercentSignFormatItem : public LogFormatter::FormatterItem
     {
     public:
@@ -355,6 +437,7 @@ namespace sylar
             XX(t, ThreadIdFormatItem),    // t:编程号
             XX(F, FiberIdFormatItem),     // F:协程号
             XX(N, ThreadNameFormatItem),  // N:线程名称
+            XX(X, TraceIdFormatItem),     // X:跟踪id
             XX(%, PercentSignFormatItem), // %:百分号
             XX(T, TabFormatItem),         // T:制表符
             XX(n, NewLineFormatItem),     // n:换行符
@@ -413,6 +496,7 @@ namespace sylar
     LogAppender::LogAppender(LogFormatter::ptr default_formatter)
         : m_defaultFormatter(default_formatter)
     {
+        m_mutex.setName("LogAppender::m_mutex");
     }
 
     void LogAppender::setFormatter(LogFormatter::ptr val)
@@ -427,21 +511,27 @@ namespace sylar
         return m_formatter ? m_formatter : m_defaultFormatter;
     }
 
+    void LogAppender::log(LogEvent::ptr event)
+    {
+        if (event->getLevel() > m_level && !event->isForceDebug())
+        {
+            return;
+        }
+        write(event, getFormatter()->format(event));
+    }
+
     StdoutLogAppender::StdoutLogAppender()
         : LogAppender(LogFormatter::ptr(new LogFormatter))
     {
     }
-    void StdoutLogAppender::log(LogEvent::ptr event)
+
+    void StdoutLogAppender::write(LogEvent::ptr, const std::string &formatted)
     {
-        if (m_formatter)
-        {
-            m_formatter->format(std::cout, event);
-        }
-        else
-        {
-            m_defaultFormatter->format(std::cout, event);
-        }
+        MutexType::Lock lock(m_mutex);
+        std::cout.write(formatted.data(), formatted.size());
+        std::cout.flush();
     }
+
     std::string StdoutLogAppender::toYamlString()
     {
         // TODO 后续加入配置模块
@@ -458,7 +548,7 @@ namespace sylar
         }
     }
 
-    void FileLogAppender::log(LogEvent::ptr event)
+    void FileLogAppender::write(LogEvent::ptr event, const std::string &formatted)
     {
         uint64_t now = event->getTime();
         if (now >= (m_lastTime + 3))
@@ -476,19 +566,9 @@ namespace sylar
         }
 
         MutexType::Lock lock(m_mutex);
-        if (m_formatter)
+        if (!m_filestream.write(formatted.data(), formatted.size()).flush())
         {
-            if (!m_formatter->format(m_filestream, event))
-            {
-                std::cout << "[ERROR] FileLogAppender::log() format error" << std::endl;
-            }
-        }
-        else
-        {
-            if (!m_defaultFormatter->format(m_filestream, event))
-            {
-                std::cout << "[ERROR] FileLogAppender::log() format error" << std::endl;
-            }
+            std::cout << "[ERROR] FileLogAppender::write() write error" << std::endl;
         }
     }
 
@@ -510,9 +590,191 @@ namespace sylar
         return !m_reopenError;
     }
 
+    AsyncLogAppender::AsyncLogAppender(LogAppender::ptr sink, size_t workers, size_t capacity, OverflowPolicy overflow)
+        : LogAppender(sink->getFormatter()), m_sink(sink), m_capacity(capacity ? capacity : 1), m_overflow(overflow)
+    {
+        m_queueMutex.setName("AsyncLogAppender::m_queueMutex");
+        m_reorderMutex.setName("AsyncLogAppender::m_reorderMutex");
+        if (workers == 0)
+        {
+            workers = 1;
+        }
+        for (size_t i = 0; i < workers; ++i)
+        {
+            m_workers.emplace_back(new Thread(std::bind(&AsyncLogAppender::run, this), "log_async_" + std::to_string(i)));
+        }
+    }
+
+    AsyncLogAppender::~AsyncLogAppender()
+    {
+        {
+            QueueMutexType::Lock lock(m_queueMutex);
+            m_stopping = true;
+        }
+        m_queueEvent.notifyAll();
+        for (auto &i : m_workers)
+        {
+            i->join();
+        }
+    }
+
+    void AsyncLogAppender::log(LogEvent::ptr event)
+    {
+        if (event->getLevel() > m_level && !event->isForceDebug())
+        {
+            return;
+        }
+        while (true)
+        {
+            EventCount::Key key;
+            {
+                QueueMutexType::Lock lock(m_queueMutex);
+                bool full = m_nextSeq - m_written.load(std::memory_order_acquire) >= m_capacity;
+                if (full && m_overflow == DROP)
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                if (full)
+                {
+                    // 登记后再检查一次，之后写入下游的日志一定会唤醒本线程
+                    key = m_writtenEvent.prepareWait();
+                    full = m_nextSeq - m_written.load(std::memory_order_acquire) >= m_capacity;
+                    if (!full)
+                    {
+                        m_writtenEvent.cancelWait();
+                    }
+                }
+                if (!full)
+                {
+                    m_queue.push_back(Pending{m_nextSeq++, event});
+                    break;
+                }
+            }
+            m_writtenEvent.wait(key);
+        }
+        m_queueEvent.notify();
+    }
+
+    void AsyncLogAppender::write(LogEvent::ptr event, const std::string &formatted)
+    {
+        m_sink->write(event, formatted);
+    }
+
+    std::string AsyncLogAppender::toYamlString()
+    {
+        return m_sink->toYamlString();
+    }
+
+    void AsyncLogAppender::setFormatter(LogFormatter::ptr formatter)
+    {
+        m_sink->setFormatter(formatter);
+    }
+
+    LogFormatter::ptr AsyncLogAppender::getFormatter()
+    {
+        return m_sink->getFormatter();
+    }
+
+    void AsyncLogAppender::flush()
+    {
+        uint64_t target;
+        {
+            QueueMutexType::Lock lock(m_queueMutex);
+            target = m_nextSeq;
+        }
+        m_writtenEvent.await([this, target]()
+                             { return m_written.load(std::memory_order_acquire) >= target; });
+    }
+
+    bool AsyncLogAppender::takePending(Pending &pending, bool &stopping)
+    {
+        QueueMutexType::Lock lock(m_queueMutex);
+        stopping = m_stopping;
+        if (m_queue.empty())
+        {
+            return false;
+        }
+        pending = std::move(m_queue.front());
+        m_queue.pop_front();
+        return true;
+    }
+
+    void AsyncLogAppender::run()
+    {
+        while (true)
+        {
+            Pending pending;
+            bool stopping = false;
+            if (!takePending(pending, stopping))
+            {
+                if (stopping)
+                {
+                    return;
+                }
+                // 登记后再检查一次，之后提交的日志一定会唤醒本线程
+                EventCount::Key key = m_queueEvent.prepareWait();
+                if (!takePending(pending, stopping))
+                {
+                    if (stopping)
+                    {
+                        m_queueEvent.cancelWait();
+                        return;
+                    }
+                    m_queueEvent.wait(key);
+                    continue;
+                }
+                m_queueEvent.cancelWait();
+            }
+            std::string formatted = m_sink->getFormatter()->format(pending.event);
+            complete(pending.seq, pending.event, std::move(formatted));
+        }
+    }
+
+    void AsyncLogAppender::complete(uint64_t seq, LogEvent::ptr event, std::string &&formatted)
+    {
+        QueueMutexType::Lock lock(m_reorderMutex);
+        size_t index = seq - m_nextWrite;
+        if (index >= m_reorder.size())
+        {
+            m_reorder.resize(index + 1);
+        }
+        Slot &slot = m_reorder[index];
+        slot.ready = true;
+        slot.event = std::move(event);
+        slot.formatted = std::move(formatted);
+
+        // 已经有线程在按序写入，由它负责写出这条日志
+        if (m_draining)
+        {
+            return;
+        }
+        m_draining = true;
+        while (!m_reorder.empty() && m_reorder.front().ready)
+        {
+            Slot ready = std::move(m_reorder.front());
+            m_reorder.pop_front();
+            ++m_nextWrite;
+            lock.unlock();
+            m_sink->write(ready.event, ready.formatted);
+            m_written.fetch_add(1, std::memory_order_release);
+            m_writtenEvent.notifyAll();
+            lock.lock();
+        }
+        m_draining = false;
+    }
+
     Logger::Logger(const std::string &name)
         : m_name(name), m_level(LogLevel::INFO), m_createTime(GetElapsedMS())
     {
+#ifdef SYLAR_LOCK_PROFILE
+        m_mutex.setName("Logger::m_mutex(" + name + ")");
+#endif
+    }
+
+    Logger::~Logger()
+    {
+        flushRepeated();
     }
 
     void Logger::addAppender(LogAppender::ptr appender)
@@ -540,13 +802,165 @@ namespace sylar
         m_appenders.clear();
     }
 
+    /// 同一条日志在多个输出目标上的格式化结果缓存
+    /// 格式器指针相同或者模板相同的输出目标产生的字节完全一致，只需格式化一次
+    /// 输出目标数量通常很少，线性查找即可，超出容量的格式不再缓存
+    struct FormattedCache
+    {
+        static const size_t kCapacity = 8;
+
+        const std::string *find(const LogFormatter::ptr &formatter) const
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                if (formatters[i] == formatter || formatters[i]->getPattern() == formatter->getPattern())
+                {
+                    return &results[i];
+                }
+            }
+            return nullptr;
+        }
+
+        LogFormatter::ptr formatters[kCapacity];
+        std::string results[kCapacity];
+        size_t size = 0;
+    };
+
     void Logger::log(LogEvent::ptr event)
     {
-        if (event->getLevel() <= m_level)
+        if (event->getLevel() > m_level && !event->isForceDebug())
+        {
+            return;
+        }
+
+        if (event->getLevel() <= LogLevel::ERROR && FlightRecorder::IsEnabled())
+        {
+            FlightRecorder::Dump(*this);
+        }
+
+        if (m_dedupWindow)
+        {
+            // 调用位置用文件名指针和行号表示，__FILE__是字符串常量，比较指针即可
+            std::string_view content = event->getContentView();
+            uint64_t site = reinterpret_cast<uintptr_t>(event->getFile()) ^ (static_cast<uint64_t>(event->getLine()) << 32) ^ event->getLevel();
+            uint64_t hash = HashBytes(content.data(), content.size(), site);
+            uint64_t now = GetElapsedMS();
+
+            RepeatedSummary summary;
+            {
+                MutexType::Lock lock(m_mutex);
+                if (m_lastEvent && hash == m_lastHash && now < m_dedupStart + m_dedupWindow)
+                {
+                    ++m_repeatCount;
+                    return;
+                }
+                summary = takeRepeatedLocked();
+                m_lastEvent = event;
+                m_lastHash = hash;
+                m_dedupStart = now;
+            }
+            logRepeated(summary);
+        }
+        doLog(event);
+    }
+
+    void Logger::setDedupWindow(uint64_t ms)
+    {
+        if (ms == 0)
+        {
+            flushRepeated();
+        }
+        else
+        {
+            LoggerMgr::GetInstance()->startRepeatFlusher();
+        }
+        MutexType::Lock lock(m_mutex);
+        m_dedupWindow = ms;
+        m_lastEvent.reset();
+    }
+
+    void Logger::flushRepeated()
+    {
+        RepeatedSummary summary;
         {
-            for (auto &i : m_appenders)
+            MutexType::Lock lock(m_mutex);
+            summary = takeRepeatedLocked();
+        }
+        logRepeated(summary);
+    }
+
+    void Logger::flushExpiredRepeated(uint64_t now)
+    {
+        RepeatedSummary summary;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (!m_repeatCount || now < m_dedupStart + m_dedupWindow)
+            {
+                return;
+            }
+            summary = takeRepeatedLocked();
+            // 窗口已经结束，之后相同的日志重新开始一个窗口
+            m_lastEvent.reset();
+        }
+        logRepeated(summary);
+    }
+
+    Logger::RepeatedSummary Logger::takeRepeatedLocked()
+    {
+        RepeatedSummary summary;
+        if (!m_lastEvent || m_repeatCount == 0)
+        {
+            return summary;
+        }
+        summary.count = m_repeatCount;
+        summary.level = m_lastEvent->getLevel();
+        summary.file = m_lastEvent->getFile();
+        summary.line = m_lastEvent->getLine();
+        m_repeatCount = 0;
+        return summary;
+    }
+
+    void Logger::logRepeated(const RepeatedSummary &summary)
+    {
+        if (!summary.count)
+        {
+            return;
+        }
+        LogEvent::ptr event = LogEvent::Create(m_name, summary.level, summary.file, summary.line,
+                                               GetElapsedMS() - m_createTime, GetThreadId(), GetFiberId(), GetThreadName(), time(0));
+        event->getSS() << "last message repeated " << summary.count << " times";
+        doLog(event);
+    }
+
+    void Logger::doLog(LogEvent::ptr event)
+    {
+        FormattedCache cache;
+        for (auto &i : m_appenders)
+        {
+            if (i->isAsync())
             {
                 i->log(event);
+                continue;
+            }
+            if (event->getLevel() > i->getLevel() && !event->isForceDebug())
+            {
+                continue;
+            }
+            LogFormatter::ptr formatter = i->getFormatter();
+            const std::string *formatted = cache.find(formatter);
+            if (formatted)
+            {
+                i->write(event, *formatted);
+            }
+            else if (cache.size < FormattedCache::kCapacity)
+            {
+                cache.formatters[cache.size] = formatter;
+                cache.results[cache.size] = formatter->format(event);
+                i->write(event, cache.results[cache.size++]);
+            }
+            else
+            {
+                i->write(event, formatter->format(event));
             }
         }
     }
@@ -573,14 +987,222 @@ namespace sylar
         m_logger->log(m_event);
     }
 
+    /// 飞行记录，定长256字节，内容超出部分截断
+    struct FlightRecord
+    {
+        const char *file;
+        int32_t line;
+        LogLevel::Level level;
+        uint64_t elapse;
+        time_t time;
+        uint16_t length;
+        char loggerName[26];
+        char content[192];
+    };
+    static_assert(sizeof(FlightRecord) == 256, "FlightRecord should be 256 bytes");
+
+    /// 直接写入记录槽位的流缓冲，写满后丢弃剩余内容
+    class FlightStreamBuf : public std::streambuf
+    {
+    public:
+        void reset(char *buf, size_t size) { setp(buf, buf + size); }
+        size_t size() const { return pptr() - pbase(); }
+
+    protected:
+        int_type overflow(int_type ch) override { return traits_type::not_eof(ch); }
+    };
+
+    /// 线程局部的环形缓冲区
+    struct FlightRing
+    {
+        FlightRing() : os(&buf) {}
+
+        std::vector<FlightRecord> records;
+        /// 下一条记录写入的位置
+        size_t head = 0;
+        /// 有效记录条数
+        size_t count = 0;
+        /// 正在写入的记录，嵌套的记录直接丢弃
+        FlightRecord *current = nullptr;
+        FlightStreamBuf buf;
+        std::ostream os;
+    };
+
+    std::atomic<bool> FlightRecorder::s_enabled{false};
+    static std::atomic<size_t> s_flightCapacity{256};
+    static thread_local FlightRing t_flightRing;
+    static Logger::ptr s_crashLogger;
+
+    void FlightRecorder::SetEnabled(bool enabled)
+    {
+        s_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void FlightRecorder::SetCapacity(size_t capacity)
+    {
+        s_flightCapacity.store(capacity ? capacity : 1, std::memory_order_relaxed);
+    }
+
+    std::ostream *FlightRecorder::Begin(const Logger::ptr &logger, LogLevel::Level level, const char *file, int32_t line)
+    {
+        FlightRing &ring = t_flightRing;
+        if (ring.current)
+        {
+            return nullptr;
+        }
+        if (ring.records.empty())
+        {
+            ring.records.resize(s_flightCapacity.load(std::memory_order_relaxed));
+        }
+        FlightRecord &record = ring.records[ring.head];
+        record.file = file;
+        record.line = line;
+        record.level = level;
+        record.elapse = GetElapsedMS() - logger->getCreateTime();
+        record.time = time(0);
+        size_t nameLen = std::min(logger->getName().size(), sizeof(record.loggerName) - 1);
+        memcpy(record.loggerName, logger->getName().data(), nameLen);
+        record.loggerName[nameLen] = '\0';
+
+        ring.current = &record;
+        ring.buf.reset(record.content, sizeof(record.content));
+        ring.os.clear();
+        return &ring.os;
+    }
+
+    void FlightRecorder::Commit()
+    {
+        FlightRing &ring = t_flightRing;
+        if (!ring.current)
+        {
+            return;
+        }
+        ring.current->length = ring.buf.size();
+        ring.current = nullptr;
+        ring.head = (ring.head + 1) % ring.records.size();
+        if (ring.count < ring.records.size())
+        {
+            ++ring.count;
+        }
+    }
+
+    void FlightRecorder::Dump(Logger &logger)
+    {
+        FlightRing &ring = t_flightRing;
+        if (ring.count == 0 || ring.current)
+        {
+            return;
+        }
+        size_t count = ring.count;
+        size_t index = (ring.head + ring.records.size() - count) % ring.records.size();
+        ring.count = 0;
+
+        pid_t threadId = GetThreadId();
+        std::string threadName = GetThreadName();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const FlightRecord &record = ring.records[(index + i) % ring.records.size()];
+            LogEvent::ptr event = LogEvent::Create(record.loggerName, record.level, record.file, record.line, record.elapse,
+                                                   threadId, GetFiberId(), threadName, record.time);
+            event->getSS().write(record.content, record.length);
+            logger.doLog(event);
+        }
+    }
+
+    void FlightRecorder::Clear()
+    {
+        t_flightRing.count = 0;
+    }
+
+    static void FlightCrashHandler(int sig)
+    {
+        if (s_crashLogger)
+        {
+            FlightRecorder::Dump(*s_crashLogger);
+        }
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+
+    void FlightRecorder::InstallCrashHandler(Logger::ptr logger)
+    {
+        s_crashLogger = logger;
+        for (int sig : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT})
+        {
+            signal(sig, FlightCrashHandler);
+        }
+    }
+
+    FlightRecordWrap::FlightRecordWrap(const Logger::ptr &logger, LogLevel::Level level, const char *file, int32_t line)
+        : m_os(FlightRecorder::Begin(logger, level, file, line)), m_active(m_os != nullptr)
+    {
+        if (!m_active)
+        {
+            // 没有缓冲区的流，写入直接失败
+            static thread_local std::ostream s_discard(nullptr);
+            m_os = &s_discard;
+        }
+    }
+
+    FlightRecordWrap::~FlightRecordWrap()
+    {
+        if (m_active)
+        {
+            FlightRecorder::Commit();
+        }
+    }
+
     LogManager::LogManager()
     {
+        m_mutex.setName("LogManager::m_mutex");
         m_root.reset(new Logger("root"));
         m_root->addAppender(LogAppender::ptr(new StdoutLogAppender));
         m_loggers[m_root->getName()] = m_root;
         init();
     }
 
+    LogManager::~LogManager()
+    {
+        if (m_repeatFlusher)
+        {
+            m_stopFlusher.store(1, std::memory_order_release);
+            FutexWake(&m_stopFlusher, 1);
+            m_repeatFlusher->join();
+        }
+    }
+
+    void LogManager::startRepeatFlusher()
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_repeatFlusher)
+        {
+            return;
+        }
+        m_repeatFlusher.reset(new Thread([this]()
+                                         {
+            struct timespec interval;
+            interval.tv_sec = kRepeatFlushIntervalMs / 1000;
+            interval.tv_nsec = (kRepeatFlushIntervalMs % 1000) * 1000000;
+            while (!m_stopFlusher.load(std::memory_order_acquire))
+            {
+                FutexWait(&m_stopFlusher, 0, &interval);
+                // 复制一份日志器列表，输出时不持有管理器的锁
+                std::vector<Logger::ptr> loggers;
+                {
+                    MutexType::Lock lock(m_mutex);
+                    for (auto &i : m_loggers)
+                    {
+                        loggers.push_back(i.second);
+                    }
+                }
+                uint64_t now = GetElapsedMS();
+                for (auto &i : loggers)
+                {
+                    i->flushExpiredRepeated(now);
+                }
+            } }, "log_repeat"));
+    }
+
     Logger::ptr LogManager::getLogger(const std::string &name)
     {
         MutexType::Lock lock(m_mutex);
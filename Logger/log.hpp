@@ -3,11 +3,16 @@
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <string_view>
 #include <fstream>
 #include <vector>
 #include <unordered_map>
 #include <map>
+#include <deque>
 #include "../Utility/cmutex.hpp"
+#include "../Utility/event_count.hpp"
+#include "../Utility/object_pool.hpp"
+#include "../Utility/thread.hpp"
 #include "../Utility/singleton.h"
 #include "../Utility/util.h"
 // 获取root日志器
@@ -18,15 +23,20 @@
 /**
  * @brief 使用流式方式将日志级别level的日志写入到logger
  * @details 构造一个LoggerWrap对象，包裹包含日志器和日志事件，在对象析构时调用日志器写日志事件
- * @todo 协程id未实现，暂时写0
+ *          当前线程的跟踪上下文设置了强制调试标志时，忽略日志器级别
+ *          低于日志器级别的日志在开启飞行记录器时写入线程局部的环形缓冲区，不构造日志事件也不格式化
  */
-#define SYLAR_LOG_LEVEL(logger, level)                                                                                                               \
-    if (level <= logger->getLevel())                                                                                                                 \
-    sylar::LoggerWrap(logger, sylar::LogEvent::ptr(new sylar::LogEvent(logger->getName(),                                                            \
-                                                                       level, __FILE__, __LINE__, sylar::GetElapsedMS() - logger->getCreateTime(),   \
-                                                                       sylar::GetThreadId(), sylar::GetFiberId(), sylar::GetThreadName(), time(0)))) \
-        .getLogEvent()                                                                                                                               \
-        ->getSS()
+#define SYLAR_LOG_LEVEL(logger, level)                                                                                                                   \
+    if (bool sylar_log_enabled = (level <= logger->getLevel() || sylar::TraceContext::IsForceDebug());                                                   \
+        sylar_log_enabled || sylar::FlightRecorder::IsEnabled())                                                                                         \
+    (sylar_log_enabled ? sylar::LoggerWrap(logger, sylar::LogEvent::Create(logger->getName(),                                                            \
+                                                                           level, __FILE__, __LINE__,                                                    \
+                                                                           sylar::GetElapsedMS() - logger->getCreateTime(),                              \
+                                                                           sylar::GetThreadId(), sylar::GetFiberId(),                                    \
+                                                                           sylar::GetThreadName(), time(0)))                                             \
+                             .getLogEvent()                                                                                                              \
+                             ->getSS()                                                                                                                   \
+                       : sylar::FlightRecordWrap(logger, level, __FILE__, __LINE__).getStream())
 
 #define SYLAR_LOG_FATAL(logger) SYLAR_LOG_LEVEL(logger, sylar::LogLevel::FATAL)
 
@@ -83,6 +93,56 @@ namespace sylar
         static LogLevel::Level FromString(const std::string &str);
     };
 
+    /**
+     * @brief 请求跟踪上下文
+     * @details 线程局部保存跟踪id和强制调试标志。设置强制调试后，该线程上的所有日志都会输出，
+     *          不受日志器和输出目标级别的限制，用于在线上只针对单个请求打开DEBUG日志。
+     *          强制调试标志是一个线程局部bool，宏里的检查只有一次TLS读取。
+     *          协程切换时通过Switch()把线程上的上下文换出到协程自己的State里，因此上下文实际是协程局部的
+     */
+    class TraceContext
+    {
+    public:
+        /// @brief 换出的跟踪上下文
+        struct State
+        {
+            std::string traceId;
+            bool forceDebug = false;
+        };
+
+        /// @brief 协程切换时调用，把当前上下文保存到from，再从to恢复
+        static void Switch(State &from, State &to);
+
+        /// @brief 设置当前线程的跟踪上下文
+        /// @param traceId 跟踪id
+        /// @param forceDebug 是否强制输出所有级别的日志
+        static void Set(const std::string &traceId, bool forceDebug = false);
+
+        /// @brief 清空当前线程的跟踪上下文
+        static void Clear();
+
+        /// @brief 获取当前线程的跟踪id
+        static const std::string &GetTraceId();
+
+        /// @brief 当前线程是否强制输出所有级别的日志
+        static bool IsForceDebug() { return s_forceDebug; }
+
+    private:
+        static thread_local bool s_forceDebug;
+    };
+
+    /// @brief 跟踪上下文的RAII封装，析构时恢复之前的上下文
+    class TraceScope : Noncopyable
+    {
+    public:
+        TraceScope(const std::string &traceId, bool forceDebug = false);
+        ~TraceScope();
+
+    private:
+        std::string m_prevTraceId;
+        bool m_prevForceDebug;
+    };
+
     /**
      * @brief 日志事件
      */
@@ -105,6 +165,13 @@ namespace sylar
                  uint64_t threadId, uint32_t fiberId,
                  const std::string &threadName, time_t time);
 
+        /// @brief 从对象池构造，控制块和事件在同一个槽位里
+        template <class... Args>
+        static ptr Create(Args &&...args)
+        {
+            return MakePoolShared<LogEvent>(std::forward<Args>(args)...);
+        }
+
         const std::string &getLoggerName() const { return m_loggerName; }
         const LogLevel::Level &getLoggerLevel() const { return m_level; }
         const char *getFile() const { return m_file; }
@@ -112,9 +179,14 @@ namespace sylar
         const uint64_t &getElapse() const { return m_elapse; }
         const uint64_t &getThreadId() const { return m_threadId; }
         std::string getContent() const { return m_ss.str(); }
+        /// @brief 日志内容的只读视图，直接指向stringstream的缓冲区，不复制；继续写入后失效
+        std::string_view getContentView() const;
         const uint32_t &getFiberId() const { return m_fiberId; }
         const std::string &getThreadName() const { return m_threadName; }
         const time_t &getTime() const { return m_time; }
+        const std::string &getTraceId() const { return m_traceId; }
+        /// @brief 是否忽略级别过滤，构造时从跟踪上下文中获取
+        bool isForceDebug() const { return m_forceDebug; }
         const int32_t &getLine() const { return m_line; }
         const LogLevel::Level &getLevel() { return m_level; }
         const std::stringstream &getStringStream() { return m_ss; };
@@ -148,6 +220,10 @@ namespace sylar
         std::string m_threadName;
         // UTC时间
         time_t m_time;
+        // 跟踪id
+        std::string m_traceId;
+        // 忽略级别过滤
+        bool m_forceDebug;
         // 日志内容，使用stringstream存储，便于流式写入日志
         std::stringstream m_ss;
     };
@@ -171,6 +247,7 @@ namespace sylar
          * - %%t 线程id
          * - %%F 协程id
          * - %%N 线程名称
+         * - %%X 跟踪id
          * - %%% 百分号
          * - %%T 制表符
          * - %%n 换行
@@ -181,6 +258,8 @@ namespace sylar
          */
         LogFormatter(const std::string &pattern = "%d{%Y-%m-%d %H:%M:%S} [%rms]%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n");
 
+        virtual ~LogFormatter() {}
+
         /// @brief 初始化，解析格式模板，提取模板项
         void init();
 
@@ -189,9 +268,10 @@ namespace sylar
         bool isError() const { return m_error; }
 
         /// @brief 对日志事件进行格式化，返回字符串
+        /// @details Logger对同一条日志的每种格式只调用一次，派生类可以在这里统计或改写输出
         /// @param  event 日志事件
         /// @return 格式化日志字符串
-        std::string format(LogEvent::ptr even);
+        virtual std::string format(LogEvent::ptr even);
 
         /// @brief 对日志事件进行格式化，返回格式化日志流
         /// @param os 日志输出流
@@ -201,7 +281,7 @@ namespace sylar
 
         /// @brief 获取格式模板
         /// @return 格式模板字符串
-        std::string getPattern() const { return m_pattern; }
+        const std::string &getPattern() const { return m_pattern; }
 
     public:
         /// @brief 日志内容格式化项， 虚基类，用于派生不同的格式项
@@ -237,15 +317,35 @@ namespace sylar
 
         /// @brief 析构函数
         virtual ~LogAppender() {};
-        void setFormatter(LogFormatter::ptr formatter);
-        LogFormatter::ptr getFormatter();
+        virtual void setFormatter(LogFormatter::ptr formatter);
+        virtual LogFormatter::ptr getFormatter();
 
-        virtual void log(LogEvent::ptr event) = 0;
+        /// @brief 获取输出目标的日志级别
+        LogLevel::Level getLevel() const { return m_level; }
+
+        /// @brief 设置输出目标的日志级别，高于该级别的日志事件在格式化之前就被丢弃
+        void setLevel(LogLevel::Level level) { m_level = level; }
+
+        /// @brief 格式化日志事件并输出
+        /// @param event 日志事件
+        virtual void log(LogEvent::ptr event);
+
+        /// @brief 输出已经格式化好的日志
+        /// @details Logger对使用相同格式的输出目标只格式化一次，再把同一份结果交给每个输出目标
+        /// @param event 日志事件
+        /// @param formatted 格式化后的日志内容
+        virtual void write(LogEvent::ptr event, const std::string &formatted) = 0;
+
+        /// @brief 是否在自己的线程中格式化
+        /// @details 返回true时Logger直接调用log()，不在调用线程中格式化
+        virtual bool isAsync() const { return false; }
 
         virtual std::string toYamlString() = 0;
 
     protected:
         MutexType m_mutex;
+        /// 日志级别，默认不过滤
+        LogLevel::Level m_level = LogLevel::DEBUG;
         LogFormatter::ptr m_defaultFormatter;
         LogFormatter::ptr m_formatter;
     };
@@ -262,7 +362,7 @@ namespace sylar
         /// @brief 析构函数
         virtual ~StdoutLogAppender() {};
 
-        void log(LogEvent::ptr event) override;
+        void write(LogEvent::ptr event, const std::string &formatted) override;
 
         std::string toYamlString() override;
     };
@@ -277,7 +377,7 @@ namespace sylar
         /// @param path 文件路径
         FileLogAppender(const std::string &path);
 
-        void log(LogEvent::ptr event) override;
+        void write(LogEvent::ptr event, const std::string &formatted) override;
 
         std::string toYamlString() override;
 
@@ -294,6 +394,110 @@ namespace sylar
         bool m_reopenError = false;
     };
 
+    /**
+     * @brief 多线程格式化的异步输出目标
+     * @details 日志事件进入时分配递增的序号并放入待格式化队列，由若干个工作线程并行格式化，
+     *          格式化结果放入重排缓冲区，按序号顺序交给下游输出目标写入，保证输出顺序与提交顺序一致。
+     *          同一时刻只有一个工作线程负责按序写入，其他线程只负责格式化。
+     *          已提交但还没有写入下游的日志最多capacity条，超出时按OverflowPolicy阻塞调用线程或者丢弃并计数。
+     *          BLOCK时下游输出目标不能再向同一个AsyncLogAppender写日志，否则会等待自己
+     */
+    class AsyncLogAppender : public LogAppender
+    {
+    public:
+        typedef std::shared_ptr<AsyncLogAppender> ptr;
+        typedef Mutex QueueMutexType;
+
+        /// @brief 在途日志达到上限时的处理方式
+        enum OverflowPolicy
+        {
+            /// 阻塞调用线程直到有日志写入下游（背压），不丢日志
+            BLOCK,
+            /// 丢弃新日志并计数，调用线程不等待
+            DROP
+        };
+
+        /// 默认的在途日志上限
+        static const size_t kDefaultCapacity = 8192;
+
+        /// @brief 构造函数
+        /// @param sink 下游输出目标，使用它的格式器格式化
+        /// @param workers 格式化工作线程数
+        /// @param capacity 已提交但还没有写入下游的日志上限
+        /// @param overflow 达到上限时的处理方式
+        AsyncLogAppender(LogAppender::ptr sink, size_t workers = 1, size_t capacity = kDefaultCapacity, OverflowPolicy overflow = BLOCK);
+
+        /// @brief 析构函数，输出所有已提交的日志后退出工作线程
+        ~AsyncLogAppender();
+
+        void log(LogEvent::ptr event) override;
+
+        void write(LogEvent::ptr event, const std::string &formatted) override;
+
+        bool isAsync() const override { return true; }
+
+        std::string toYamlString() override;
+
+        /// @brief 设置下游输出目标的格式器，工作线程用它格式化
+        void setFormatter(LogFormatter::ptr formatter) override;
+
+        /// @brief 下游输出目标的格式器
+        LogFormatter::ptr getFormatter() override;
+
+        /// @brief 阻塞直到调用前已提交的日志全部写入下游
+        void flush();
+
+        /// @brief DROP策略下丢弃的日志数
+        uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        /// @brief 工作线程主函数
+        void run();
+
+        /// @brief 提交格式化结果，按序写入已就绪的日志
+        void complete(uint64_t seq, LogEvent::ptr event, std::string &&formatted);
+
+    private:
+        struct Pending
+        {
+            uint64_t seq;
+            LogEvent::ptr event;
+        };
+        struct Slot
+        {
+            bool ready = false;
+            LogEvent::ptr event;
+            std::string formatted;
+        };
+
+        /// @brief 取出一条待格式化的日志，队列为空时返回false并通过stopping返回是否正在析构
+        bool takePending(Pending &pending, bool &stopping);
+
+    private:
+        LogAppender::ptr m_sink;
+        std::vector<Thread::ptr> m_workers;
+
+        /// 待格式化队列
+        QueueMutexType m_queueMutex;
+        EventCount m_queueEvent;
+        std::list<Pending> m_queue;
+        uint64_t m_nextSeq = 0;
+        bool m_stopping = false;
+        size_t m_capacity;
+        OverflowPolicy m_overflow;
+        std::atomic<uint64_t> m_dropped{0};
+
+        /// 重排缓冲区，下标为 seq - m_nextWrite
+        QueueMutexType m_reorderMutex;
+        std::deque<Slot> m_reorder;
+        uint64_t m_nextWrite = 0;
+        bool m_draining = false;
+        /// 已写入下游的日志数，m_nextSeq - m_written是在途日志数
+        std::atomic<uint64_t> m_written{0};
+        /// 有日志写入下游时通知，flush()和被阻塞的调用线程在这里等待
+        EventCount m_writtenEvent;
+    };
+
     /// @brief 日志器
     class Logger
     {
@@ -305,6 +509,9 @@ namespace sylar
         /// @param name 日志名称
         Logger(const std::string &name = "root");
 
+        /// @brief 析构函数，输出尚未汇总的重复日志
+        ~Logger();
+
         /// @brief 获取日志器创建时间
         /// @return 时间戳
         const uint64_t &getCreateTime() const { return m_createTime; }
@@ -331,11 +538,51 @@ namespace sylar
         /// @brief 清空日志输出目标
         void clearAppenders();
         /// @brief 写日志
+        /// @details 先按输出目标的级别过滤，再按格式器分组，同一格式只格式化一次
         /// @param event 事件
         void log(LogEvent::ptr event);
 
+        /// @brief 设置重复日志抑制窗口
+        /// @details 窗口内连续出现的相同日志（内容和调用位置都相同）只输出第一条，
+        ///          窗口结束或者出现不同的日志时输出一条"last message repeated N times"汇总。
+        ///          窗口结束后没有新日志时，由LogManager的后台线程在kRepeatFlushIntervalMs内输出汇总，
+        ///          不是从LogManager获取的日志器没有后台线程，需要自己调用flushRepeated()
+        /// @param ms 窗口长度，单位毫秒，0表示关闭（默认）
+        void setDedupWindow(uint64_t ms);
+
+        /// @brief 获取重复日志抑制窗口
+        uint64_t getDedupWindow() const { return m_dedupWindow; }
+
+        /// @brief 立即输出尚未汇总的重复日志计数
+        void flushRepeated();
+
+        /// @brief 抑制窗口已经结束时输出汇总，由LogManager的后台线程定期调用
+        /// @param now 当前时间，GetElapsedMS()
+        void flushExpiredRepeated(uint64_t now);
+
         std::string toYamlString();
 
+    private:
+        /// @brief 将日志事件分发给各个输出目标
+        void doLog(LogEvent::ptr event);
+
+        /// @brief 被抑制的日志的汇总信息，在锁内取出，解锁后再构造事件
+        struct RepeatedSummary
+        {
+            uint64_t count = 0;
+            LogLevel::Level level = LogLevel::NOTSET;
+            const char *file = nullptr;
+            int32_t line = 0;
+        };
+
+        /// @brief 取出并清零重复计数，需要持有m_mutex
+        RepeatedSummary takeRepeatedLocked();
+
+        /// @brief 输出汇总事件，不能持有m_mutex
+        void logRepeated(const RepeatedSummary &summary);
+
+        friend class FlightRecorder;
+
     private:
         /// mutex
         MutexType m_mutex;
@@ -347,6 +594,16 @@ namespace sylar
         std::list<LogAppender::ptr> m_appenders;
         /// 日志创建时间
         uint64_t m_createTime;
+        /// 重复日志抑制窗口（毫秒），0表示关闭
+        uint64_t m_dedupWindow = 0;
+        /// 上一条日志的哈希值
+        uint64_t m_lastHash = 0;
+        /// 当前抑制窗口的开始时间
+        uint64_t m_dedupStart = 0;
+        /// 当前窗口内被抑制的日志条数
+        uint64_t m_repeatCount = 0;
+        /// 上一条日志事件
+        LogEvent::ptr m_lastEvent;
     };
 
     /// @brief 日志事件包装器，方便宏定义，内部包含日志事件和日志器
@@ -369,15 +626,78 @@ namespace sylar
         LogEvent::ptr m_event;
     };
 
+    /**
+     * @brief 飞行记录器
+     * @details 每个线程一个定长环形缓冲区，记录被日志器级别过滤掉的低级别日志（DEBUG/INFO等）。
+     *          记录时只把文件名指针、行号、时间和流式写入的内容直接写进环形缓冲区的槽位，
+     *          不分配日志事件，不经过格式器。当该线程输出ERROR及以上级别的日志或者进程崩溃时，
+     *          把最近的N条记录格式化后输出到日志器的输出目标，为错误现场提供DEBUG级别的上下文。
+     *          默认关闭
+     */
+    class FlightRecorder
+    {
+    public:
+        /// @brief 开启或关闭飞行记录器
+        static void SetEnabled(bool enabled);
+
+        /// @brief 是否开启
+        static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        /// @brief 设置每个线程保留的记录条数，只对之后创建缓冲区的线程生效
+        static void SetCapacity(size_t capacity);
+
+        /// @brief 开始一条记录，返回写入内容的流，记录过程中嵌套的记录被丢弃，返回nullptr
+        static std::ostream *Begin(const Logger::ptr &logger, LogLevel::Level level, const char *file, int32_t line);
+
+        /// @brief 提交Begin开始的记录
+        static void Commit();
+
+        /// @brief 把当前线程的记录按时间顺序输出到logger的输出目标，并清空记录
+        static void Dump(Logger &logger);
+
+        /// @brief 清空当前线程的记录
+        static void Clear();
+
+        /// @brief 安装崩溃信号处理函数，崩溃时把崩溃线程的记录输出到logger
+        /// @details 信号处理函数中格式化日志并不是异步信号安全的，只能尽力而为
+        static void InstallCrashHandler(Logger::ptr logger);
+
+    private:
+        static std::atomic<bool> s_enabled;
+    };
+
+    /// @brief 飞行记录包装器，方便宏定义，在对象析构时提交记录
+    class FlightRecordWrap
+    {
+    public:
+        FlightRecordWrap(const Logger::ptr &logger, LogLevel::Level level, const char *file, int32_t line);
+        ~FlightRecordWrap();
+
+        std::ostream &getStream() { return *m_os; }
+
+    private:
+        std::ostream *m_os;
+        /// 是否开始了一条记录
+        bool m_active;
+    };
+
     /// @brief 日志管理器
     class LogManager
     {
     public:
         typedef Spinlock MutexType;
+        /// 后台线程检查重复日志抑制窗口的间隔（毫秒）
+        static const uint64_t kRepeatFlushIntervalMs = 100;
+
         /// @brief 构造函数
         LogManager();
+        /// @brief 析构函数，停止后台线程
+        ~LogManager();
         Logger::ptr getLogger(const std::string &name);
 
+        /// @brief 启动后台线程，定期输出抑制窗口已经结束的重复日志汇总，开启重复日志抑制时调用，重复调用无效
+        void startRepeatFlusher();
+
         /// @brief 初始化，从配置文件中加载日志配置
         void init();
         std::string toYamlString();
@@ -389,6 +709,9 @@ namespace sylar
         std::unordered_map<std::string, Logger::ptr> m_loggers;
         /// 根日志器
         Logger::ptr m_root;
+        /// 输出重复日志汇总的后台线程
+        Thread::ptr m_repeatFlusher;
+        std::atomic<uint32_t> m_stopFlusher{0};
     };
 
     /// 日志器管理类单例
@@ -0,0 +1,529 @@
+#include "alloc.hpp"
+#include "cmutex.hpp"
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+#include <sys/mman.h>
+
+namespace sylar
+{
+    /// 保留的地址空间，只占虚拟地址，不占物理内存
+    static const size_t kArenaSize = (size_t)16 << 30;
+    static const size_t kMaxSpans = kArenaSize / Alloc::kSpanSize;
+    /// 每个分级的传输缓存最多保存的批数
+    static const size_t kTransferSlots = 64;
+
+    /**
+     * @brief span描述符，以span在保留区中的序号为下标存放在数组中
+     * @details span中的对象先用指针碰撞切出，释放回来的对象挂在freelist上
+     */
+    struct Span
+    {
+        Span *prev;
+        Span *next;
+        void *freelist;
+        /// 已经交出去的对象数
+        uint32_t allocated;
+        /// 已经切出的对象数
+        uint32_t carved;
+        uint32_t capacity;
+        uint32_t cls;
+        /// 是否在中心空闲链表中
+        bool listed;
+        /// 空闲时是否已经归还物理内存
+        bool released;
+    };
+
+    /**
+     * @brief 一个分级的中心缓存，独占缓存行
+     */
+    struct alignas(64) CentralClass
+    {
+        /// 传输缓存，每一项是用对象首个字长串起来的BatchSize个对象
+        FutexMutex transferLock;
+        size_t transferCount = 0;
+        void *batches[kTransferSlots];
+
+        /// 还有空闲对象的span
+        FutexMutex spanLock;
+        Span *nonempty = nullptr;
+    };
+
+    /// 保留区起点和span数组，在AllocState构造时设置，之后不变。没有初始化时为空，任何指针都不属于保留区
+    static char *g_arenaBase = nullptr;
+    static Span *g_spans = nullptr;
+
+    /**
+     * @brief 分配器的全局状态，第一次使用时构造，永不析构
+     * @details 全局operator new可能在任何静态对象构造之前被调用，不能依赖静态初始化顺序
+     */
+    struct AllocState
+    {
+        FutexMutex pageLock;
+        /// 已经切出的span数
+        size_t spanCount = 0;
+        size_t spansInUse = 0;
+        /// 空闲的span，用next串起来
+        Span *freeSpans = nullptr;
+        size_t freeSpanCount = 0;
+
+        CentralClass central[Alloc::kClasses];
+
+        AllocState()
+        {
+            void *arena = mmap(nullptr, kArenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            void *spanArray = mmap(nullptr, kMaxSpans * sizeof(Span), PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (arena != MAP_FAILED && spanArray != MAP_FAILED)
+            {
+                g_arenaBase = static_cast<char *>(arena);
+                g_spans = static_cast<Span *>(spanArray);
+            }
+        }
+
+        /// @brief 取一个空闲span，保留区用完返回nullptr
+        Span *newSpan(uint32_t cls)
+        {
+            Span *span = nullptr;
+            {
+                FutexMutex::Lock lock(pageLock);
+                if (freeSpans)
+                {
+                    span = freeSpans;
+                    freeSpans = span->next;
+                    --freeSpanCount;
+                }
+                else if (g_arenaBase && spanCount < kMaxSpans)
+                {
+                    span = &g_spans[spanCount++];
+                }
+                else
+                {
+                    return nullptr;
+                }
+                ++spansInUse;
+            }
+            span->prev = span->next = nullptr;
+            span->freelist = nullptr;
+            span->allocated = 0;
+            span->carved = 0;
+            span->capacity = Alloc::kSpanSize / Alloc::ClassSize(cls);
+            span->cls = cls;
+            span->listed = false;
+            span->released = false;
+            return span;
+        }
+
+        void deleteSpan(Span *span)
+        {
+            FutexMutex::Lock lock(pageLock);
+            span->next = freeSpans;
+            freeSpans = span;
+            ++freeSpanCount;
+            --spansInUse;
+        }
+    };
+
+    static AllocState *State()
+    {
+        alignas(AllocState) static char storage[sizeof(AllocState)];
+        static AllocState *state = new (storage) AllocState();
+        return state;
+    }
+
+    static inline Span *SpanOf(const void *ptr)
+    {
+        return &g_spans[(static_cast<const char *>(ptr) - g_arenaBase) >> Alloc::kSpanShift];
+    }
+
+    static inline char *SpanStart(Span *span)
+    {
+        return g_arenaBase + ((size_t)(span - g_spans) << Alloc::kSpanShift);
+    }
+
+    static inline void *&NextOf(void *obj)
+    {
+        return *static_cast<void **>(obj);
+    }
+
+    static void Link(CentralClass &central, Span *span)
+    {
+        span->prev = nullptr;
+        span->next = central.nonempty;
+        if (central.nonempty)
+        {
+            central.nonempty->prev = span;
+        }
+        central.nonempty = span;
+        span->listed = true;
+    }
+
+    static void Unlink(CentralClass &central, Span *span)
+    {
+        if (span->prev)
+        {
+            span->prev->next = span->next;
+        }
+        else
+        {
+            central.nonempty = span->next;
+        }
+        if (span->next)
+        {
+            span->next->prev = span->prev;
+        }
+        span->prev = span->next = nullptr;
+        span->listed = false;
+    }
+
+    /**
+     * @brief 从span中取最多n个对象串成链表
+     * @return 取到的个数，保留区用完时可能为0
+     */
+    static size_t FetchFromSpans(size_t cls, size_t n, void *&head)
+    {
+        AllocState *state = State();
+        CentralClass &central = state->central[cls];
+        size_t size = Alloc::ClassSize(cls);
+        size_t count = 0;
+        head = nullptr;
+        FutexMutex::Lock lock(central.spanLock);
+        while (count < n)
+        {
+            Span *span = central.nonempty;
+            if (!span)
+            {
+                span = state->newSpan(cls);
+                if (!span)
+                {
+                    break;
+                }
+                Link(central, span);
+            }
+            while (count < n && span->freelist)
+            {
+                void *obj = span->freelist;
+                span->freelist = NextOf(obj);
+                NextOf(obj) = head;
+                head = obj;
+                ++span->allocated;
+                ++count;
+            }
+            if (count < n && span->carved < span->capacity)
+            {
+                char *start = SpanStart(span);
+                while (count < n && span->carved < span->capacity)
+                {
+                    void *obj = start + span->carved * size;
+                    ++span->carved;
+                    NextOf(obj) = head;
+                    head = obj;
+                    ++span->allocated;
+                    ++count;
+                }
+            }
+            if (!span->freelist && span->carved == span->capacity)
+            {
+                Unlink(central, span);
+            }
+        }
+        return count;
+    }
+
+    /// @brief 把一串对象还给各自的span，span空了还给页堆
+    static void ReleaseToSpans(size_t cls, void *head)
+    {
+        AllocState *state = State();
+        CentralClass &central = state->central[cls];
+        FutexMutex::Lock lock(central.spanLock);
+        while (head)
+        {
+            void *obj = head;
+            head = NextOf(obj);
+            Span *span = SpanOf(obj);
+            NextOf(obj) = span->freelist;
+            span->freelist = obj;
+            if (!span->listed)
+            {
+                Link(central, span);
+            }
+            if (--span->allocated == 0)
+            {
+                Unlink(central, span);
+                state->deleteSpan(span);
+            }
+        }
+    }
+
+    /// @brief 从中心缓存取一批对象，优先取传输缓存中的整批
+    static size_t FetchBatch(size_t cls, void *&head)
+    {
+        CentralClass &central = State()->central[cls];
+        {
+            FutexMutex::Lock lock(central.transferLock);
+            if (central.transferCount)
+            {
+                head = central.batches[--central.transferCount];
+                return Alloc::BatchSize(cls);
+            }
+        }
+        return FetchFromSpans(cls, Alloc::BatchSize(cls), head);
+    }
+
+    /// @brief 把n个对象还给中心缓存，整批且传输缓存没满时只放进传输缓存
+    static void ReleaseBatch(size_t cls, void *head, size_t n)
+    {
+        CentralClass &central = State()->central[cls];
+        if (n == Alloc::BatchSize(cls))
+        {
+            FutexMutex::Lock lock(central.transferLock);
+            if (central.transferCount < kTransferSlots)
+            {
+                central.batches[central.transferCount++] = head;
+                return;
+            }
+        }
+        ReleaseToSpans(cls, head);
+    }
+
+    static thread_local bool t_cacheDestroyed = false;
+
+    /**
+     * @brief 线程缓存，每个分级一个空闲链表
+     * @details 链表长度超过两批时把一批还给中心缓存。
+     *          没有构造和析构函数，访问时不需要检查线程局部变量是否已经初始化；第一次从中心缓存取对象或第一次释放对象时注册ThreadCacheCleaner，
+     *          线程退出时全部归还，只释放其他线程分配的对象的线程也不会泄漏
+     */
+    struct ThreadCache
+    {
+        struct FreeList
+        {
+            void *head;
+            uint32_t length;
+        };
+
+        FreeList lists[Alloc::kClasses];
+        bool registered;
+
+        /// @brief 确保线程退出时会归还缓存，对象进入链表之前调用
+        void ensureRegistered();
+
+        void *refill(size_t cls);
+
+        void shrink(size_t cls)
+        {
+            FreeList &list = lists[cls];
+            size_t n = Alloc::BatchSize(cls);
+            void *head = list.head;
+            void *tail = head;
+            for (size_t i = 1; i < n; ++i)
+            {
+                tail = NextOf(tail);
+            }
+            list.head = NextOf(tail);
+            list.length -= n;
+            NextOf(tail) = nullptr;
+            ReleaseBatch(cls, head, n);
+        }
+
+        void flush()
+        {
+            for (size_t cls = 0; cls < Alloc::kClasses; ++cls)
+            {
+                FreeList &list = lists[cls];
+                if (list.head)
+                {
+                    ReleaseToSpans(cls, list.head);
+                    list.head = nullptr;
+                    list.length = 0;
+                }
+            }
+        }
+    };
+
+    static thread_local ThreadCache t_cache;
+
+    struct ThreadCacheCleaner
+    {
+        ~ThreadCacheCleaner()
+        {
+            t_cache.flush();
+            t_cacheDestroyed = true;
+        }
+    };
+
+    static thread_local ThreadCacheCleaner t_cleaner;
+
+    void ThreadCache::ensureRegistered()
+    {
+        if (!registered)
+        {
+            // 使用线程局部变量才会注册它的析构函数
+            (void)&t_cleaner;
+            registered = true;
+        }
+    }
+
+    void *ThreadCache::refill(size_t cls)
+    {
+        ensureRegistered();
+        void *head;
+        size_t n = FetchBatch(cls, head);
+        if (n == 0)
+        {
+            return nullptr;
+        }
+        FreeList &list = lists[cls];
+        list.head = NextOf(head);
+        list.length = n - 1;
+        return head;
+    }
+}
+
+void *sylar::Alloc::AllocateClass(size_t cls)
+{
+    if (!t_cacheDestroyed)
+    {
+        ThreadCache::FreeList &list = t_cache.lists[cls];
+        if (void *obj = list.head)
+        {
+            list.head = NextOf(obj);
+            --list.length;
+            return obj;
+        }
+        if (void *obj = t_cache.refill(cls))
+        {
+            return obj;
+        }
+    }
+    else
+    {
+        void *obj;
+        if (FetchFromSpans(cls, 1, obj))
+        {
+            return obj;
+        }
+    }
+    // 保留区用完
+    return malloc(ClassSize(cls));
+}
+
+void *sylar::Alloc::Allocate(size_t size)
+{
+    if (size > kMaxSmallSize)
+    {
+        return malloc(size);
+    }
+    return AllocateClass(SizeClass(size));
+}
+
+void sylar::Alloc::DeallocateClass(void *ptr, size_t cls)
+{
+    if (!Owns(ptr))
+    {
+        free(ptr);
+        return;
+    }
+    if (t_cacheDestroyed)
+    {
+        NextOf(ptr) = nullptr;
+        ReleaseToSpans(cls, ptr);
+        return;
+    }
+    t_cache.ensureRegistered();
+    ThreadCache::FreeList &list = t_cache.lists[cls];
+    NextOf(ptr) = list.head;
+    list.head = ptr;
+    if (++list.length > 2 * BatchSize(cls))
+    {
+        t_cache.shrink(cls);
+    }
+}
+
+void sylar::Alloc::Deallocate(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (!Owns(ptr))
+    {
+        free(ptr);
+        return;
+    }
+    DeallocateClass(ptr, SpanOf(ptr)->cls);
+}
+
+void sylar::Alloc::Deallocate(void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (size > kMaxSmallSize)
+    {
+        free(ptr);
+        return;
+    }
+    DeallocateClass(ptr, SizeClass(size));
+}
+
+size_t sylar::Alloc::UsableSize(const void *ptr)
+{
+    if (!Owns(ptr))
+    {
+        return malloc_usable_size(const_cast<void *>(ptr));
+    }
+    return ClassSize(SpanOf(ptr)->cls);
+}
+
+bool sylar::Alloc::Owns(const void *ptr)
+{
+    return g_arenaBase && static_cast<size_t>(static_cast<const char *>(ptr) - g_arenaBase) < kArenaSize;
+}
+
+void sylar::Alloc::FlushThreadCache()
+{
+    if (!t_cacheDestroyed)
+    {
+        t_cache.flush();
+    }
+}
+
+void sylar::Alloc::ReleaseFreeMemory()
+{
+    AllocState *state = State();
+    FutexMutex::Lock lock(state->pageLock);
+    for (Span *span = state->freeSpans; span; span = span->next)
+    {
+        if (!span->released)
+        {
+            madvise(SpanStart(span), kSpanSize, MADV_DONTNEED);
+            span->released = true;
+        }
+    }
+}
+
+sylar::Alloc::Stats sylar::Alloc::GetStats()
+{
+    AllocState *state = State();
+    Stats stats;
+    stats.reservedBytes = g_arenaBase ? kArenaSize : 0;
+    stats.transferObjects = 0;
+    for (size_t cls = 0; cls < kClasses; ++cls)
+    {
+        CentralClass &central = state->central[cls];
+        FutexMutex::Lock lock(central.transferLock);
+        stats.transferObjects += central.transferCount * BatchSize(cls);
+    }
+    FutexMutex::Lock lock(state->pageLock);
+    stats.spans = state->spanCount;
+    stats.spansInUse = state->spansInUse;
+    stats.freeSpans = state->freeSpanCount;
+    stats.releasedSpans = 0;
+    for (Span *span = state->freeSpans; span; span = span->next)
+    {
+        stats.releasedSpans += span->released;
+    }
+    return stats;
+}
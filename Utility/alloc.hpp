@@ -0,0 +1,140 @@
+#ifndef __SYLAR_ALLOC_H__
+#define __SYLAR_ALLOC_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace sylar
+{
+    /**
+     * @brief 线程缓存的小对象分配器
+     * @details 三层结构：
+     *          - 线程缓存：每个分级一个空闲链表，分配和释放只是链表操作，不加锁
+     *          - 中心缓存：每个分级一个传输缓存，线程缓存之间以整批为单位交换对象，一次加锁移动一批；
+     *            传输缓存空或满时再访问按span组织的中心空闲链表
+     *          - 页堆：启动时用mmap保留一段地址空间，切成64KB的span，每个span只存放一个分级的对象，
+     *            span中的对象全部释放后还给页堆，可以被其他分级复用
+     *          对象地址减去保留区起点就能找到span和分级，释放时不需要大小。
+     *          超过kMaxSmallSize的分配以及保留区用完后的分配交给malloc，释放时根据地址判断归属
+     */
+    class Alloc
+    {
+    public:
+        /// 小对象上限，更大的分配交给malloc
+        static const size_t kMaxSmallSize = 32 * 1024;
+        /// 分级数：1KB以内按16字节分级，1KB~32KB每次翻倍分8级
+        static const size_t kClasses = 64 + 5 * 8;
+        /// span大小
+        static const size_t kSpanShift = 16;
+        static const size_t kSpanSize = 1 << kSpanShift;
+
+        /// @brief 统计信息
+        struct Stats
+        {
+            /// 保留的地址空间
+            size_t reservedBytes;
+            /// 从保留区切出过的span数
+            size_t spans;
+            /// 正在存放对象的span数
+            size_t spansInUse;
+            /// 页堆中空闲的span数，其中已经归还物理内存的个数
+            size_t freeSpans;
+            size_t releasedSpans;
+            /// 传输缓存中的对象数
+            size_t transferObjects;
+        };
+
+        /// @brief 大小对应的分级，size不超过kMaxSmallSize
+        static constexpr size_t SizeClass(size_t size)
+        {
+            if (size <= 1024)
+            {
+                return size ? (size - 1) / 16 : 0;
+            }
+            // size在(2^k, 2^(k+1)]中，步长2^(k-3)
+            size_t k = 63 - __builtin_clzll(size - 1);
+            size_t step = (size_t)1 << (k - 3);
+            return 64 + (k - 10) * 8 + (size - ((size_t)1 << k) + step - 1) / step - 1;
+        }
+
+        /// @brief 分级的对象大小
+        static constexpr size_t ClassSize(size_t cls)
+        {
+            if (cls < 64)
+            {
+                return (cls + 1) * 16;
+            }
+            size_t k = (cls - 64) / 8 + 10;
+            return ((size_t)1 << k) + ((cls - 64) % 8 + 1) * ((size_t)1 << (k - 3));
+        }
+
+        /// @brief 线程缓存和中心缓存之间一次移动的对象数
+        static constexpr size_t BatchSize(size_t cls)
+        {
+            size_t n = kSpanSize / 2 / ClassSize(cls);
+            return n < 2 ? 2 : (n > 32 ? 32 : n);
+        }
+
+        /// @brief 分配size字节，至少16字节对齐，失败返回nullptr
+        static void *Allocate(size_t size);
+
+        /// @brief 按分级分配，调用方已经算好了分级
+        static void *AllocateClass(size_t cls);
+
+        /// @brief 释放，ptr可以是nullptr或者malloc分配的内存
+        static void Deallocate(void *ptr);
+
+        /// @brief 已知大小的释放，省去查找span
+        static void Deallocate(void *ptr, size_t size);
+
+        static void DeallocateClass(void *ptr, size_t cls);
+
+        /// @brief 实际可用的字节数
+        static size_t UsableSize(const void *ptr);
+
+        /// @brief ptr是否由本分配器的小对象部分分配
+        static bool Owns(const void *ptr);
+
+        /// @brief 把当前线程缓存的对象全部还给中心缓存
+        static void FlushThreadCache();
+
+        /// @brief 对页堆中的空闲span调用MADV_DONTNEED归还物理内存，地址空间保留
+        static void ReleaseFreeMemory();
+
+        static Stats GetStats();
+    };
+
+    /**
+     * @brief 按类型池化分配的CRTP基类
+     * @details class Foo : public AllocObject<Foo>，new/delete Foo时直接使用sizeof(Foo)在编译期算出的分级，
+     *          不需要查分级也不需要查span。派生类更大时按实际大小分配
+     */
+    template <class T>
+    class AllocObject
+    {
+    public:
+        static void *operator new(size_t size)
+        {
+            void *ptr = size == sizeof(T) && sizeof(T) <= Alloc::kMaxSmallSize ? Alloc::AllocateClass(Alloc::SizeClass(sizeof(T)))
+                                                                              : Alloc::Allocate(size);
+            if (!ptr)
+            {
+                throw std::bad_alloc();
+            }
+            return ptr;
+        }
+
+        static void operator delete(void *ptr, size_t size)
+        {
+            if (size == sizeof(T) && sizeof(T) <= Alloc::kMaxSmallSize)
+            {
+                Alloc::DeallocateClass(ptr, Alloc::SizeClass(sizeof(T)));
+                return;
+            }
+            Alloc::Deallocate(ptr, size);
+        }
+    };
+}
+
+#endif
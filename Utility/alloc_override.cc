@@ -0,0 +1,121 @@
+#include "alloc.hpp"
+#include <cstdlib>
+#include <new>
+
+// 用sylar::Alloc替换全局的operator new/delete，以cmake -DSYLAR_ALLOC_OVERRIDE=ON编译时链接进Utility。
+// 对齐要求超过16字节的分配交给aligned_alloc，释放时Alloc根据地址判断不是自己的内存，交给free
+
+static void *AllocOrThrow(size_t size)
+{
+    void *ptr = sylar::Alloc::Allocate(size);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+static void *AllocAligned(size_t size, std::align_val_t align)
+{
+    size_t alignment = static_cast<size_t>(align);
+    if (alignment <= 16)
+    {
+        return sylar::Alloc::Allocate(size);
+    }
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *operator new(size_t size)
+{
+    return AllocOrThrow(size);
+}
+
+void *operator new[](size_t size)
+{
+    return AllocOrThrow(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return sylar::Alloc::Allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return sylar::Alloc::Allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+    void *ptr = AllocAligned(size, align);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new[](size_t size, std::align_val_t align)
+{
+    return operator new(size, align);
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    return AllocAligned(size, align);
+}
+
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    return AllocAligned(size, align);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept
+{
+    sylar::Alloc::Deallocate(ptr, size);
+}
+
+void operator delete[](void *ptr, size_t size) noexcept
+{
+    sylar::Alloc::Deallocate(ptr, size);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept
+{
+    sylar::Alloc::Deallocate(ptr);
+}
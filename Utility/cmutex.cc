@@ -1,4 +1,19 @@
 #include "cmutex.hpp"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+int sylar::FutexWait(std::atomic<uint32_t> *addr, uint32_t val, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, val, timeout, nullptr, 0);
+}
+
+int sylar::FutexWake(std::atomic<uint32_t> *addr, int n)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+}
 
 sylar::Semaphore::Semaphore(uint32_t count)
 {
@@ -19,3 +34,99 @@ void sylar::Semaphore::notify()
 {
     sem_post(&m_semaphore);
 }
+
+int sylar::AdaptiveSpinCount()
+{
+    static const int s_spinCount = std::thread::hardware_concurrency() > 1 ? 100 : 0;
+    return s_spinCount;
+}
+
+void sylar::FutexMutex::lockSlow()
+{
+    int spin = AdaptiveSpinCount();
+    for (int i = 0; i < spin; ++i)
+    {
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+        if (state == 0 && m_state.compare_exchange_weak(state, 1, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            return;
+        }
+        if (state == 2)
+        {
+            // 已经有线程在睡眠，继续自旋意义不大
+            break;
+        }
+        CpuRelax();
+    }
+    // 标记为有等待者后睡眠，被唤醒后重新抢锁，抢到时保持状态2，保证解锁时会唤醒其他等待者
+    while (m_state.exchange(2, std::memory_order_acquire) != 0)
+    {
+        FutexWait(&m_state, 2, nullptr);
+    }
+}
+
+void sylar::FutexMutex::unlockSlow()
+{
+    FutexWake(&m_state, 1);
+}
+
+bool sylar::FutexSemaphore::waitFor(uint64_t timeoutMs)
+{
+    if (tryWait())
+    {
+        return true;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return waitSlow(&deadline);
+}
+
+bool sylar::FutexSemaphore::waitSlow(const struct timespec *deadline)
+{
+    int spin = AdaptiveSpinCount();
+    for (int i = 0; i < spin; ++i)
+    {
+        CpuRelax();
+        if (tryWait())
+        {
+            return true;
+        }
+    }
+
+    m_waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool acquired = false;
+    while (!(acquired = tryWait()))
+    {
+        struct timespec timeout;
+        struct timespec *ptimeout = nullptr;
+        if (deadline)
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            int64_t ns = (deadline->tv_sec - now.tv_sec) * 1000000000LL + (deadline->tv_nsec - now.tv_nsec);
+            if (ns <= 0)
+            {
+                break;
+            }
+            timeout.tv_sec = ns / 1000000000LL;
+            timeout.tv_nsec = ns % 1000000000LL;
+            ptimeout = &timeout;
+        }
+        // 计数为0时才睡眠，notify先增加计数再检查等待者，不会丢失唤醒
+        FutexWait(&m_count, 0, ptimeout);
+    }
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    return acquired;
+}
+
+void sylar::FutexSemaphore::notifySlow(uint32_t n)
+{
+    FutexWake(&m_count, n);
+}
@@ -6,12 +6,61 @@
 #include <memory>
 #include <pthread.h>
 #include <semaphore.h>
+#include <time.h>
 #include <stdint.h>
 #include <atomic>
 #include <list>
+#include <string>
+#include <cstring>
+#include <type_traits>
 #include "noncopyable.h"
+#include "lock_profile.hpp"
 namespace sylar
 {
+    /// @brief 自旋等待时提示CPU，降低功耗并让出超线程的执行资源
+    inline void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    /// @brief 竞争时睡眠前的自旋次数，单核机器上自旋只会推迟持有者运行，返回0
+    int AdaptiveSpinCount();
+
+    /// @brief 自旋等待的指数退避
+    /// @details 每次等待的pause次数翻倍，超过上限后改为让出CPU，
+    ///          线程数多于核数时避免自旋的线程把持锁线程挤出CPU
+    class SpinBackoff
+    {
+    public:
+        /// @brief 退避上限，超过后改为yield
+        static const uint32_t kMaxSpins = 1024;
+
+        void pause()
+        {
+            if (m_spins < kMaxSpins && AdaptiveSpinCount() > 0)
+            {
+                for (uint32_t i = 0; i < m_spins; ++i)
+                {
+                    CpuRelax();
+                }
+                m_spins <<= 1;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void reset() { m_spins = 1; }
+
+    private:
+        uint32_t m_spins = 1;
+    };
+
     /// @brief 信号量
     class Semaphore
     {
@@ -168,6 +217,7 @@ namespace sylar
     class Mutex : Noncopyable
     {
     public:
+        typedef ScopedLockImpl<Mutex> Lock;
         Mutex()
         {
             pthread_mutex_init(&m_mutex, nullptr);
@@ -176,20 +226,46 @@ namespace sylar
         {
             pthread_mutex_destroy(&m_mutex);
         }
-        void lock()
+        /// @brief 设置名称，用于锁竞争分析
+        void setName(const std::string &name)
+        {
+#ifdef SYLAR_LOCK_PROFILE
+            m_profile.setName(name);
+#else
+            (void)name;
+#endif
+        }
+        SYLAR_LOCK_PROFILE_NOINLINE void lock()
         {
+#ifdef SYLAR_LOCK_PROFILE
+            bool contended = pthread_mutex_trylock(&m_mutex) != 0;
+            uint64_t start = contended ? LockProfiler::Now() : 0;
+            if (contended)
+            {
+                pthread_mutex_lock(&m_mutex);
+            }
+            m_profile.acquired(contended, start, __builtin_return_address(0));
+#else
             pthread_mutex_lock(&m_mutex);
+#endif
         }
         void unlock()
         {
+#ifdef SYLAR_LOCK_PROFILE
+            m_profile.released();
+#endif
             pthread_mutex_unlock(&m_mutex);
         }
 
     private:
         pthread_mutex_t m_mutex;
+#ifdef SYLAR_LOCK_PROFILE
+        LockProfilePoint m_profile;
+#endif
     };
 
     /// @brief  读写锁
+    /// @details 锁竞争分析模式下读锁和写锁的持有时间都计入同一个直方图
     class RWMutex : Noncopyable
     {
     public:
@@ -209,23 +285,70 @@ namespace sylar
             pthread_rwlock_destroy(&m_rwlock);
         }
 
-        void rdlock()
+        /// @brief 设置名称，用于锁竞争分析
+        void setName(const std::string &name)
         {
+#ifdef SYLAR_LOCK_PROFILE
+            m_profile.setName(name);
+#else
+            (void)name;
+#endif
+        }
+
+        SYLAR_LOCK_PROFILE_NOINLINE void rdlock()
+        {
+#ifdef SYLAR_LOCK_PROFILE
+            bool contended = pthread_rwlock_tryrdlock(&m_rwlock) != 0;
+            uint64_t start = contended ? LockProfiler::Now() : 0;
+            if (contended)
+            {
+                pthread_rwlock_rdlock(&m_rwlock);
+            }
+            m_profile.sharedAcquired(contended, start, __builtin_return_address(0));
+#else
             pthread_rwlock_rdlock(&m_rwlock);
+#endif
         }
 
-        void wrlock()
+        SYLAR_LOCK_PROFILE_NOINLINE void wrlock()
         {
+#ifdef SYLAR_LOCK_PROFILE
+            bool contended = pthread_rwlock_trywrlock(&m_rwlock) != 0;
+            uint64_t start = contended ? LockProfiler::Now() : 0;
+            if (contended)
+            {
+                pthread_rwlock_wrlock(&m_rwlock);
+            }
+            m_profile.acquired(contended, start, __builtin_return_address(0));
+            m_writer = true;
+#else
             pthread_rwlock_wrlock(&m_rwlock);
+#endif
         }
 
         void unlock()
         {
+#ifdef SYLAR_LOCK_PROFILE
+            // 持有写锁时没有其他线程能修改m_writer
+            if (m_writer)
+            {
+                m_writer = false;
+                m_profile.released();
+            }
+            else
+            {
+                m_profile.sharedReleased();
+            }
+#endif
             pthread_rwlock_unlock(&m_rwlock);
         }
 
     private:
         pthread_rwlock_t m_rwlock;
+#ifdef SYLAR_LOCK_PROFILE
+        LockProfilePoint m_profile;
+        bool m_writer = false;
+#endif
     };
 
     /// @brief  自旋锁
@@ -245,19 +368,45 @@ namespace sylar
             pthread_spin_destroy(&m_spin);
         }
 
+        /// @brief 设置名称，用于锁竞争分析
+        void setName(const std::string &name)
+        {
+#ifdef SYLAR_LOCK_PROFILE
+            m_profile.setName(name);
+#else
+            (void)name;
+#endif
+        }
+
         /// @brief  获取锁
-        void lock()
+        SYLAR_LOCK_PROFILE_NOINLINE void lock()
         {
+#ifdef SYLAR_LOCK_PROFILE
+            bool contended = pthread_spin_trylock(&m_spin) != 0;
+            uint64_t start = contended ? LockProfiler::Now() : 0;
+            if (contended)
+            {
+                pthread_spin_lock(&m_spin);
+            }
+            m_profile.acquired(contended, start, __builtin_return_address(0));
+#else
             pthread_spin_lock(&m_spin);
+#endif
         }
 
         void unlock()
         {
+#ifdef SYLAR_LOCK_PROFILE
+            m_profile.released();
+#endif
             pthread_spin_unlock(&m_spin);
         }
 
     private:
         pthread_spinlock_t m_spin;
+#ifdef SYLAR_LOCK_PROFILE
+        LockProfilePoint m_profile;
+#endif
     };
 
     /// @brief  CAS锁
@@ -274,19 +423,584 @@ namespace sylar
 
         ~CASLock() {};
 
-        void lock()
+        /// @brief 设置名称，用于锁竞争分析
+        void setName(const std::string &name)
         {
+#ifdef SYLAR_LOCK_PROFILE
+            m_profile.setName(name);
+#else
+            (void)name;
+#endif
+        }
+
+        SYLAR_LOCK_PROFILE_NOINLINE void lock()
+        {
+#ifdef SYLAR_LOCK_PROFILE
+            bool contended = std::atomic_flag_test_and_set_explicit(&m_mutex, std::memory_order_acquire);
+            uint64_t start = contended ? LockProfiler::Now() : 0;
+            if (contended)
+            {
+                while (std::atomic_flag_test_and_set_explicit(&m_mutex, std::memory_order_acquire))
+                    ;
+            }
+            m_profile.acquired(contended, start, __builtin_return_address(0));
+#else
             while (std::atomic_flag_test_and_set_explicit(&m_mutex, std::memory_order_acquire))
                 ;
+#endif
         }
 
         void unlock()
         {
+#ifdef SYLAR_LOCK_PROFILE
+            m_profile.released();
+#endif
             std::atomic_flag_clear_explicit(&m_mutex, std::memory_order_release);
         }
 
     private:
         volatile std::atomic_flag m_mutex;
+#ifdef SYLAR_LOCK_PROFILE
+        LockProfilePoint m_profile;
+#endif
+    };
+
+    /// @brief TTAS锁
+    /// @details 先只读地等待锁空闲（等待期间只命中本地缓存），再用exchange抢锁，
+    ///          抢锁失败后指数退避，降低多个等待者同时抢同一缓存行的冲突
+    class TTASLock : Noncopyable
+    {
+    public:
+        typedef ScopedLockImpl<TTASLock> Lock;
+
+        TTASLock() : m_locked(false) {}
+
+        void lock()
+        {
+            SpinBackoff backoff;
+            while (true)
+            {
+                while (m_locked.load(std::memory_order_relaxed))
+                {
+                    CpuRelax();
+                }
+                if (!m_locked.exchange(true, std::memory_order_acquire))
+                {
+                    return;
+                }
+                backoff.pause();
+            }
+        }
+
+        void unlock()
+        {
+            m_locked.store(false, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<bool> m_locked;
+    };
+
+    /// @brief 排队自旋锁
+    /// @details 按取号顺序获得锁，保证公平；等待时间与前面排队的人数成正比地退避
+    class TicketLock : Noncopyable
+    {
+    public:
+        typedef ScopedLockImpl<TicketLock> Lock;
+
+        TicketLock() : m_next(0), m_serving(0) {}
+
+        void lock()
+        {
+            uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+            SpinBackoff backoff;
+            while (true)
+            {
+                uint32_t serving = m_serving.load(std::memory_order_acquire);
+                if (serving == ticket)
+                {
+                    return;
+                }
+                uint32_t ahead = ticket - serving;
+                if (ahead > 1 && AdaptiveSpinCount() > 0)
+                {
+                    // 前面还有多人排队，按人数退避，减少对m_serving所在缓存行的读取
+                    for (uint32_t i = 0; i < ahead * 32; ++i)
+                    {
+                        CpuRelax();
+                    }
+                }
+                backoff.pause();
+            }
+        }
+
+        void unlock()
+        {
+            m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        alignas(64) std::atomic<uint32_t> m_next;
+        alignas(64) std::atomic<uint32_t> m_serving;
+    };
+
+    /// @brief 线程局部的队列锁节点缓存
+    /// @details MCS/CLH锁每次加锁需要一个队列节点，节点从当前线程的缓存中取，用完放回，
+    ///          线程退出时释放缓存中的节点
+    template <class Node>
+    class QueueLockNodeCache
+    {
+    public:
+        static Node *Alloc()
+        {
+            Cache &cache = GetCache();
+            if (cache.size == 0)
+            {
+                return new Node;
+            }
+            return cache.nodes[--cache.size];
+        }
+
+        static void Free(Node *node)
+        {
+            Cache &cache = GetCache();
+            if (cache.size == kCapacity)
+            {
+                delete node;
+                return;
+            }
+            cache.nodes[cache.size++] = node;
+        }
+
+    private:
+        /// 每个线程缓存的节点数，等于同时持有的同类锁的数量上限，超出部分直接new/delete
+        static const size_t kCapacity = 16;
+
+        struct Cache
+        {
+            ~Cache()
+            {
+                for (size_t i = 0; i < size; ++i)
+                {
+                    delete nodes[i];
+                }
+            }
+            Node *nodes[kCapacity];
+            size_t size = 0;
+        };
+
+        static Cache &GetCache()
+        {
+            static thread_local Cache s_cache;
+            return s_cache;
+        }
+    };
+
+    /// @brief MCS队列锁
+    /// @details 等待者组成链表，每个等待者只在自己的节点上自旋，释放锁时直接通知后继，
+    ///          交接锁只涉及两个线程的缓存行，线程数增加时性能不会崩溃
+    class MCSLock : Noncopyable
+    {
+    public:
+        typedef ScopedLockImpl<MCSLock> Lock;
+
+        struct alignas(64) Node
+        {
+            std::atomic<Node *> next{nullptr};
+            std::atomic<bool> locked{false};
+        };
+
+        MCSLock() : m_tail(nullptr), m_holder(nullptr) {}
+
+        void lock()
+        {
+            Node *node = QueueLockNodeCache<Node>::Alloc();
+            node->next.store(nullptr, std::memory_order_relaxed);
+            node->locked.store(true, std::memory_order_relaxed);
+            Node *prev = m_tail.exchange(node, std::memory_order_acq_rel);
+            if (prev)
+            {
+                prev->next.store(node, std::memory_order_release);
+                SpinBackoff backoff;
+                while (node->locked.load(std::memory_order_acquire))
+                {
+                    backoff.pause();
+                }
+            }
+            m_holder = node;
+        }
+
+        void unlock()
+        {
+            Node *node = m_holder;
+            Node *next = node->next.load(std::memory_order_acquire);
+            if (!next)
+            {
+                Node *expected = node;
+                if (m_tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed))
+                {
+                    QueueLockNodeCache<Node>::Free(node);
+                    return;
+                }
+                // 后继已经入队但还没有链接上，等待链接完成
+                SpinBackoff backoff;
+                while (!(next = node->next.load(std::memory_order_acquire)))
+                {
+                    backoff.pause();
+                }
+            }
+            next->locked.store(false, std::memory_order_release);
+            QueueLockNodeCache<Node>::Free(node);
+        }
+
+    private:
+        alignas(64) std::atomic<Node *> m_tail;
+        /// 持有锁的线程的节点，只有持锁线程读写
+        Node *m_holder;
+    };
+
+    /// @brief CLH队列锁
+    /// @details 隐式队列，每个等待者在前驱的节点上自旋，释放锁时只写自己的节点，
+    ///          释放后回收前驱的节点供下次使用
+    class CLHLock : Noncopyable
+    {
+    public:
+        typedef ScopedLockImpl<CLHLock> Lock;
+
+        struct alignas(64) Node
+        {
+            std::atomic<bool> locked{false};
+        };
+
+        CLHLock() : m_tail(new Node), m_holder(nullptr), m_holderPred(nullptr) {}
+
+        ~CLHLock()
+        {
+            delete m_tail.load(std::memory_order_relaxed);
+        }
+
+        void lock()
+        {
+            Node *node = QueueLockNodeCache<Node>::Alloc();
+            node->locked.store(true, std::memory_order_relaxed);
+            Node *pred = m_tail.exchange(node, std::memory_order_acq_rel);
+            SpinBackoff backoff;
+            while (pred->locked.load(std::memory_order_acquire))
+            {
+                backoff.pause();
+            }
+            m_holder = node;
+            m_holderPred = pred;
+        }
+
+        void unlock()
+        {
+            Node *pred = m_holderPred;
+            m_holder->locked.store(false, std::memory_order_release);
+            // 前驱节点已经没有线程访问了，归当前线程所有
+            QueueLockNodeCache<Node>::Free(pred);
+        }
+
+    private:
+        alignas(64) std::atomic<Node *> m_tail;
+        /// 持有锁的线程的节点及其前驱，只有持锁线程读写
+        Node *m_holder;
+        Node *m_holderPred;
+    };
+
+    /// @brief futex等待，*addr等于val时睡眠，timeout为相对时间，为空时不超时
+    int FutexWait(std::atomic<uint32_t> *addr, uint32_t val, const struct timespec *timeout);
+
+    /// @brief 唤醒最多n个在addr上等待的线程
+    int FutexWake(std::atomic<uint32_t> *addr, int n);
+
+    /// @brief 基于futex的自适应互斥量
+    /// @details 无竞争时加锁解锁各只有一次原子操作，不进入内核；
+    ///          有竞争时先短暂自旋，仍然拿不到锁再在futex上睡眠。
+    ///          状态：0 未加锁，1 加锁且无等待者，2 加锁且可能有等待者
+    class FutexMutex : Noncopyable
+    {
+    public:
+        typedef ScopedLockImpl<FutexMutex> Lock;
+
+        FutexMutex() : m_state(0) {}
+
+        void lock()
+        {
+            uint32_t expected = 0;
+            if (m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                return;
+            }
+            lockSlow();
+        }
+
+        bool tryLock()
+        {
+            uint32_t expected = 0;
+            return m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        void unlock()
+        {
+            if (m_state.exchange(0, std::memory_order_release) == 2)
+            {
+                unlockSlow();
+            }
+        }
+
+    private:
+        void lockSlow();
+        void unlockSlow();
+
+    private:
+        std::atomic<uint32_t> m_state;
+    };
+
+    /// @brief 基于futex的信号量
+    /// @details 有可用计数时wait只有一次CAS；notify只在有等待者时才进入内核，
+    ///          notify(n)一次系统调用唤醒n个等待者
+    class FutexSemaphore : Noncopyable
+    {
+    public:
+        FutexSemaphore(uint32_t count = 0) : m_count(count), m_waiters(0) {}
+
+        /// @brief 获取信号量
+        void wait()
+        {
+            if (!tryWait())
+            {
+                waitSlow(nullptr);
+            }
+        }
+
+        /// @brief 在指定时间内获取信号量
+        /// @param timeoutMs 超时时间，单位毫秒
+        /// @return 超时返回false
+        bool waitFor(uint64_t timeoutMs);
+
+        /// @brief 不阻塞地尝试获取信号量
+        bool tryWait()
+        {
+            uint32_t count = m_count.load(std::memory_order_relaxed);
+            while (count > 0)
+            {
+                if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// @brief 释放n个信号量
+        void notify(uint32_t n = 1)
+        {
+            m_count.fetch_add(n, std::memory_order_seq_cst);
+            if (m_waiters.load(std::memory_order_seq_cst) > 0)
+            {
+                notifySlow(n);
+            }
+        }
+
+    private:
+        /// @brief 阻塞等待，deadline为空时不超时
+        bool waitSlow(const struct timespec *deadline);
+        void notifySlow(uint32_t n);
+
+    private:
+        std::atomic<uint32_t> m_count;
+        std::atomic<uint32_t> m_waiters;
+    };
+
+    /// @brief 顺序锁
+    /// @details 适合保存读多写极少的小块POD数据，比如日志器的级别和格式配置。
+    ///          读者不写任何共享数据：先读序号，拷贝数据，再检查序号没有变化，变化了就重试；
+    ///          写者之间用自旋锁互斥，写期间序号为奇数。
+    ///          数据按8字节拆成原子变量存储，并发读写不构成数据竞争。
+    ///          load()是无锁的快速路径；ReadLock会和写者互斥，只在需要持锁读取时使用
+    template <class T>
+    class SeqLock : Noncopyable
+    {
+    public:
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+        /// @brief 局部读锁
+        typedef ReadScopedLockImpl<SeqLock> ReadLock;
+
+        /// @brief 局部写锁
+        typedef WriteScopedLockImpl<SeqLock> WriteLock;
+
+        SeqLock(const T &value = T()) : m_seq(0)
+        {
+            set(value);
+        }
+
+        /// @brief 无锁读取一份一致的快照
+        T load() const
+        {
+            while (true)
+            {
+                uint64_t seq = m_seq.load(std::memory_order_acquire);
+                if (seq & 1)
+                {
+                    CpuRelax();
+                    continue;
+                }
+                T value = get();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (m_seq.load(std::memory_order_relaxed) == seq)
+                {
+                    return value;
+                }
+            }
+        }
+
+        /// @brief 写入新值
+        void store(const T &value)
+        {
+            WriteLock lock(*this);
+            set(value);
+        }
+
+        /// @brief 读取数据，不检查一致性，需要持有锁
+        T get() const
+        {
+            uint64_t words[kWords];
+            for (size_t i = 0; i < kWords; ++i)
+            {
+                words[i] = m_data[i].load(std::memory_order_relaxed);
+            }
+            T value;
+            memcpy(&value, words, sizeof(T));
+            return value;
+        }
+
+        /// @brief 写入数据，需要持有写锁
+        void set(const T &value)
+        {
+            uint64_t words[kWords] = {0};
+            memcpy(words, &value, sizeof(T));
+            for (size_t i = 0; i < kWords; ++i)
+            {
+                m_data[i].store(words[i], std::memory_order_relaxed);
+            }
+        }
+
+        void rdlock()
+        {
+            m_writer.lock();
+        }
+
+        void wrlock()
+        {
+            m_writer.lock();
+            m_seq.store(m_seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        void unlock()
+        {
+            // 只有写锁会让序号变成奇数
+            uint64_t seq = m_seq.load(std::memory_order_relaxed);
+            if (seq & 1)
+            {
+                m_seq.store(seq + 1, std::memory_order_release);
+            }
+            m_writer.unlock();
+        }
+
+    private:
+        static const size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint64_t> m_seq;
+        std::atomic<uint64_t> m_data[kWords];
+        TTASLock m_writer;
+    };
+
+    /// @brief 分布式读写锁
+    /// @details 每个线程固定映射到一个独占缓存行的读者计数槽，读者加锁只修改自己的槽，
+    ///          读者之间没有缓存行争用；写者设置写标志后等待所有槽归零，写锁代价与槽数成正比。
+    ///          适合每秒被读取数百万次、很少修改的配置类数据
+    class DistributedRWMutex : Noncopyable
+    {
+    public:
+        /// @brief 局部读锁
+        typedef ReadScopedLockImpl<DistributedRWMutex> ReadLock;
+
+        /// @brief 局部写锁
+        typedef WriteScopedLockImpl<DistributedRWMutex> WriteLock;
+
+        /// 读者槽数，线程数超过槽数时多个线程共享一个槽
+        static const size_t kSlots = 64;
+
+        DistributedRWMutex() : m_writing(false), m_owner(0) {}
+
+        void rdlock()
+        {
+            std::atomic<uint32_t> &slot = m_slots[GetSlotIndex()].readers;
+            while (true)
+            {
+                slot.fetch_add(1, std::memory_order_seq_cst);
+                if (!m_writing.load(std::memory_order_seq_cst))
+                {
+                    return;
+                }
+                // 有写者，撤销计数，等写者完成后重试
+                slot.fetch_sub(1, std::memory_order_release);
+                SpinBackoff backoff;
+                while (m_writing.load(std::memory_order_relaxed))
+                {
+                    backoff.pause();
+                }
+            }
+        }
+
+        void wrlock()
+        {
+            m_writerMutex.lock();
+            m_writing.store(true, std::memory_order_seq_cst);
+            for (size_t i = 0; i < kSlots; ++i)
+            {
+                SpinBackoff backoff;
+                while (m_slots[i].readers.load(std::memory_order_acquire) != 0)
+                {
+                    backoff.pause();
+                }
+            }
+            m_owner.store(pthread_self(), std::memory_order_relaxed);
+        }
+
+        void unlock()
+        {
+            if (m_writing.load(std::memory_order_relaxed) && pthread_equal(m_owner.load(std::memory_order_relaxed), pthread_self()))
+            {
+                m_owner.store(0, std::memory_order_relaxed);
+                m_writing.store(false, std::memory_order_release);
+                m_writerMutex.unlock();
+                return;
+            }
+            m_slots[GetSlotIndex()].readers.fetch_sub(1, std::memory_order_release);
+        }
+
+    private:
+        /// @brief 当前线程的读者槽下标，线程第一次使用时按顺序分配
+        static size_t GetSlotIndex()
+        {
+            static std::atomic<size_t> s_next{0};
+            static thread_local size_t s_index = s_next.fetch_add(1, std::memory_order_relaxed) % kSlots;
+            return s_index;
+        }
+
+        struct alignas(64) Slot
+        {
+            std::atomic<uint32_t> readers{0};
+        };
+
+        Slot m_slots[kSlots];
+        alignas(64) std::atomic<bool> m_writing;
+        std::atomic<pthread_t> m_owner;
+        FutexMutex m_writerMutex;
     };
 }
 
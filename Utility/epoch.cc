@@ -0,0 +1,237 @@
+#include "epoch.hpp"
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
+
+namespace sylar
+{
+    /// 存活的回收域id，线程退出时据此判断回收域是否已经销毁
+    /// 使用std::mutex，避免锁竞争分析模式下统计自身
+    struct EpochRegistry
+    {
+        std::mutex mutex;
+        std::unordered_set<uint64_t> alive;
+        uint64_t nextId = 1;
+    };
+
+    static EpochRegistry &GetEpochRegistry()
+    {
+        // 有意不释放，保证线程局部数据析构时仍然可用
+        static EpochRegistry *s_registry = new EpochRegistry;
+        return *s_registry;
+    }
+
+    /// 线程在各个回收域中的记录，只保留存活的回收域
+    struct EpochThreadCache
+    {
+        struct Entry
+        {
+            uint64_t id;
+            Epoch *epoch;
+            Epoch::Record *record;
+        };
+
+        ~EpochThreadCache()
+        {
+            EpochRegistry &registry = GetEpochRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (auto &i : entries)
+            {
+                if (registry.alive.count(i.id))
+                {
+                    i.epoch->releaseRecord(i.record);
+                }
+            }
+        }
+
+        std::vector<Entry> entries;
+    };
+
+    static thread_local EpochThreadCache t_epochCache;
+
+    Epoch::Epoch() : m_epoch(0), m_records(nullptr), m_pending(0), m_hasOrphans(false)
+    {
+        EpochRegistry &registry = GetEpochRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        m_id = registry.nextId++;
+        registry.alive.insert(m_id);
+    }
+
+    Epoch::~Epoch()
+    {
+        {
+            EpochRegistry &registry = GetEpochRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.alive.erase(m_id);
+        }
+        Record *record = m_records.load(std::memory_order_acquire);
+        while (record)
+        {
+            for (auto &i : record->retired)
+            {
+                i.deleter(i.ptr);
+            }
+            Record *next = record->next;
+            delete record;
+            record = next;
+        }
+        for (auto &i : m_orphans)
+        {
+            i.deleter(i.ptr);
+        }
+    }
+
+    Epoch &Epoch::Global()
+    {
+        // 有意不释放，进程退出时仍可能有线程在使用
+        static Epoch *s_global = new Epoch;
+        return *s_global;
+    }
+
+    Epoch::Record *Epoch::getRecord()
+    {
+        auto &entries = t_epochCache.entries;
+        for (auto &i : entries)
+        {
+            if (i.id == m_id)
+            {
+                return i.record;
+            }
+        }
+
+        // 优先复用已退出线程的记录
+        Record *record = m_records.load(std::memory_order_acquire);
+        for (; record; record = record->next)
+        {
+            bool expected = false;
+            if (!record->inUse.load(std::memory_order_relaxed) &&
+                record->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                break;
+            }
+        }
+        if (!record)
+        {
+            record = new Record;
+            record->inUse.store(true, std::memory_order_relaxed);
+            Record *head = m_records.load(std::memory_order_relaxed);
+            do
+            {
+                record->next = head;
+            } while (!m_records.compare_exchange_weak(head, record, std::memory_order_release, std::memory_order_relaxed));
+        }
+        {
+            // 本线程第一次使用这个回收域，顺便删掉已经销毁的回收域的记录，表项数不超过存活的回收域数
+            EpochRegistry &registry = GetEpochRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [&registry](const EpochThreadCache::Entry &entry)
+                                         { return !registry.alive.count(entry.id); }),
+                          entries.end());
+        }
+        entries.push_back(EpochThreadCache::Entry{m_id, this, record});
+        return record;
+    }
+
+    void Epoch::releaseRecord(Record *record)
+    {
+        if (!record->retired.empty())
+        {
+            Mutex::Lock lock(m_orphanMutex);
+            m_orphans.insert(m_orphans.end(), record->retired.begin(), record->retired.end());
+            m_hasOrphans.store(true, std::memory_order_release);
+        }
+        record->retired.clear();
+        record->nesting = 0;
+        record->state.store(0, std::memory_order_release);
+        record->inUse.store(false, std::memory_order_release);
+    }
+
+    void Epoch::pin()
+    {
+        Record *record = getRecord();
+        if (record->nesting++ > 0)
+        {
+            return;
+        }
+        uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+        while (true)
+        {
+            record->state.store((epoch << 1) | 1, std::memory_order_seq_cst);
+            // 发布状态之后纪元可能已经前进，重新发布最新的纪元，不让自己拖住纪元推进
+            uint64_t current = m_epoch.load(std::memory_order_seq_cst);
+            if (current == epoch)
+            {
+                break;
+            }
+            epoch = current;
+        }
+    }
+
+    void Epoch::unpin()
+    {
+        Record *record = getRecord();
+        if (--record->nesting == 0)
+        {
+            record->state.store(0, std::memory_order_release);
+        }
+    }
+
+    void Epoch::retire(void *ptr, Deleter deleter)
+    {
+        Record *record = getRecord();
+        record->retired.push_back(Retired{ptr, deleter, m_epoch.load(std::memory_order_seq_cst)});
+        m_pending.fetch_add(1, std::memory_order_relaxed);
+        if (record->retired.size() >= kBatchSize)
+        {
+            collect();
+        }
+    }
+
+    void Epoch::collect()
+    {
+        Record *record = getRecord();
+        tryAdvance();
+        uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+        m_pending.fetch_sub(reclaim(record->retired, epoch), std::memory_order_relaxed);
+
+        if (m_hasOrphans.load(std::memory_order_acquire))
+        {
+            Mutex::Lock lock(m_orphanMutex);
+            m_pending.fetch_sub(reclaim(m_orphans, epoch), std::memory_order_relaxed);
+            m_hasOrphans.store(!m_orphans.empty(), std::memory_order_relaxed);
+        }
+    }
+
+    bool Epoch::tryAdvance()
+    {
+        uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        for (Record *record = m_records.load(std::memory_order_acquire); record; record = record->next)
+        {
+            uint64_t state = record->state.load(std::memory_order_seq_cst);
+            if ((state & 1) && (state >> 1) != epoch)
+            {
+                return false;
+            }
+        }
+        return m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    size_t Epoch::reclaim(std::vector<Retired> &retired, uint64_t epoch)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < retired.size(); ++i)
+        {
+            if (retired[i].epoch + 2 <= epoch)
+            {
+                retired[i].deleter(retired[i].ptr);
+            }
+            else
+            {
+                retired[kept++] = retired[i];
+            }
+        }
+        size_t count = retired.size() - kept;
+        retired.resize(kept);
+        return count;
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef __SYLAR_EPOCH_H__
+#define __SYLAR_EPOCH_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "cmutex.hpp"
+#include "noncopyable.h"
+
+namespace sylar
+{
+    /**
+     * @brief 基于纪元的内存回收（EBR）
+     * @details 无锁结构的读者在访问共享节点前pin()，访问结束后unpin()；
+     *          写者把节点从结构中摘除后retire()，节点先放入当前线程的待回收列表。
+     *          全局纪元只有在所有pin住的线程都已经观察到当前纪元时才能前进，
+     *          在纪元e退休的节点在全局纪元到达e+2时，不可能再被任何读者引用，可以安全释放。
+     *          每个线程的待回收列表积累到kBatchSize个节点时才尝试推进纪元并批量释放。
+     *          pin/unpin只修改本线程的记录，适合读多、持有时间短的场景；
+     *          长时间持有引用会阻止纪元推进，这种情况应使用HazardPointerDomain
+     */
+    class Epoch : Noncopyable
+    {
+    public:
+        /// 每个线程待回收节点积累到该数量时尝试回收
+        static const size_t kBatchSize = 64;
+
+        /// 节点释放函数
+        typedef void (*Deleter)(void *);
+
+        /// @brief 局部pin，RAII
+        class Guard : Noncopyable
+        {
+        public:
+            Guard(Epoch &epoch) : m_epoch(epoch) { m_epoch.pin(); }
+            ~Guard() { m_epoch.unpin(); }
+
+        private:
+            Epoch &m_epoch;
+        };
+
+        Epoch();
+
+        /// @brief 析构函数，释放所有待回收节点，调用时不能再有线程使用该域
+        ~Epoch();
+
+        /// @brief 全局默认回收域
+        static Epoch &Global();
+
+        /// @brief 进入读临界区，可以嵌套
+        void pin();
+
+        /// @brief 离开读临界区
+        void unpin();
+
+        /// @brief 退休一个已经从共享结构中摘除的节点
+        void retire(void *ptr, Deleter deleter);
+
+        template <class T>
+        void retire(T *ptr)
+        {
+            retire(ptr, [](void *p)
+                   { delete static_cast<T *>(p); });
+        }
+
+        /// @brief 尝试推进纪元并释放当前线程可以回收的节点
+        void collect();
+
+        /// @brief 当前全局纪元
+        uint64_t getEpoch() const { return m_epoch.load(std::memory_order_relaxed); }
+
+        /// @brief 等待回收的节点数（近似值，用于诊断）
+        size_t getPendingCount() const { return m_pending.load(std::memory_order_relaxed); }
+
+    public:
+        struct Retired
+        {
+            void *ptr;
+            Deleter deleter;
+            uint64_t epoch;
+        };
+
+        /// 每个线程在每个回收域中的记录，线程退出后记录被标记为空闲，供新线程复用
+        struct alignas(64) Record
+        {
+            /// (纪元 << 1) | 是否pin住
+            std::atomic<uint64_t> state{0};
+            std::atomic<bool> inUse{false};
+            /// pin嵌套层数，只有所属线程访问
+            uint32_t nesting = 0;
+            /// 待回收节点，只有所属线程访问
+            std::vector<Retired> retired;
+            Record *next = nullptr;
+        };
+
+        /// @brief 线程退出时释放记录，把未回收的节点交给回收域
+        void releaseRecord(Record *record);
+
+    private:
+        /// @brief 获取当前线程的记录
+        Record *getRecord();
+
+        /// @brief 所有pin住的线程都观察到当前纪元时推进纪元
+        bool tryAdvance();
+
+        /// @brief 释放纪元足够旧的节点，返回释放的数量
+        size_t reclaim(std::vector<Retired> &retired, uint64_t epoch);
+
+    private:
+        /// 回收域的唯一id，用于线程局部缓存识别已经销毁的回收域
+        uint64_t m_id;
+        alignas(64) std::atomic<uint64_t> m_epoch;
+        std::atomic<Record *> m_records;
+        std::atomic<size_t> m_pending;
+        /// 已退出线程留下的待回收节点
+        Mutex m_orphanMutex;
+        std::vector<Retired> m_orphans;
+        std::atomic<bool> m_hasOrphans;
+    };
+}
+
+#endif
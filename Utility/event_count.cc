@@ -0,0 +1,51 @@
+#include "event_count.hpp"
+#include "cmutex.hpp"
+#include <errno.h>
+#include <time.h>
+
+void sylar::EventCount::wait(Key key)
+{
+    while (m_epoch.load(std::memory_order_acquire) == key)
+    {
+        FutexWait(&m_epoch, key, nullptr);
+    }
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool sylar::EventCount::waitFor(Key key, uint64_t timeoutMs)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    int64_t deadlineNs = deadline.tv_sec * 1000000000LL + deadline.tv_nsec + int64_t(timeoutMs) * 1000000LL;
+    bool woken = true;
+    while (m_epoch.load(std::memory_order_acquire) == key)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t ns = deadlineNs - (now.tv_sec * 1000000000LL + now.tv_nsec);
+        if (ns <= 0)
+        {
+            woken = false;
+            break;
+        }
+        struct timespec timeout;
+        timeout.tv_sec = ns / 1000000000LL;
+        timeout.tv_nsec = ns % 1000000000LL;
+        FutexWait(&m_epoch, key, &timeout);
+    }
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    return woken;
+}
+
+uint64_t sylar::EventCount::NowMs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+}
+
+void sylar::EventCount::notifySlow(int n)
+{
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    FutexWake(&m_epoch, n);
+}
@@ -0,0 +1,141 @@
+#ifndef __SYLAR_EVENT_COUNT_H__
+#define __SYLAR_EVENT_COUNT_H__
+
+#include <stdint.h>
+#include <atomic>
+#include "noncopyable.h"
+
+namespace sylar
+{
+    /**
+     * @brief 事件计数器，让无锁结构的消费者可以睡眠而不丢失唤醒
+     * @details 消费者的用法：
+     * @code
+     *     while (!queue.pop(value)) {
+     *         EventCount::Key key = ec.prepareWait();
+     *         if (queue.pop(value)) { ec.cancelWait(); break; }
+     *         ec.wait(key);
+     *     }
+     * @endcode
+     *          生产者修改完数据后调用notify()。没有等待者时notify()只有一次内存屏障和一次原子读，
+     *          不进入内核；prepareWait()之后发生的notify()一定会改变纪元，wait()不会错过它
+     */
+    class EventCount : Noncopyable
+    {
+    public:
+        typedef uint32_t Key;
+
+        EventCount() : m_epoch(0), m_waiters(0) {}
+
+        /// @brief 唤醒一个等待者
+        void notify()
+        {
+            // 与prepareWait()中对等待者计数的修改配对，保证要么看到等待者，要么等待者看到新数据
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_waiters.load(std::memory_order_relaxed) != 0)
+            {
+                notifySlow(1);
+            }
+        }
+
+        /// @brief 唤醒所有等待者
+        void notifyAll()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_waiters.load(std::memory_order_relaxed) != 0)
+            {
+                notifySlow(INT32_MAX);
+            }
+        }
+
+        /// @brief 登记为等待者，返回当前纪元；之后必须调用wait()或cancelWait()
+        Key prepareWait()
+        {
+            m_waiters.fetch_add(1, std::memory_order_seq_cst);
+            return m_epoch.load(std::memory_order_seq_cst);
+        }
+
+        /// @brief 条件已经满足，取消等待
+        void cancelWait()
+        {
+            m_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        /// @brief 纪元仍然等于key时睡眠
+        void wait(Key key);
+
+        /// @brief 最多等待timeoutMs毫秒
+        /// @return 被唤醒返回true，超时返回false
+        bool waitFor(Key key, uint64_t timeoutMs);
+
+        /// @brief 阻塞直到condition()返回true
+        template <class Condition>
+        void await(Condition condition)
+        {
+            if (condition())
+            {
+                return;
+            }
+            while (true)
+            {
+                Key key = prepareWait();
+                if (condition())
+                {
+                    cancelWait();
+                    return;
+                }
+                wait(key);
+                if (condition())
+                {
+                    return;
+                }
+            }
+        }
+
+        /// @brief 最多等待timeoutMs毫秒直到condition()返回true，被唤醒但条件仍不满足时按剩余时间继续等待
+        /// @return condition()返回true时返回true，超时返回false
+        template <class Condition>
+        bool awaitFor(Condition condition, uint64_t timeoutMs)
+        {
+            if (condition())
+            {
+                return true;
+            }
+            uint64_t deadline = NowMs() + timeoutMs;
+            while (true)
+            {
+                Key key = prepareWait();
+                if (condition())
+                {
+                    cancelWait();
+                    return true;
+                }
+                uint64_t now = NowMs();
+                if (now >= deadline)
+                {
+                    cancelWait();
+                    return false;
+                }
+                waitFor(key, deadline - now);
+                if (condition())
+                {
+                    return true;
+                }
+            }
+        }
+
+    private:
+        void notifySlow(int n);
+
+        /// @brief 单调时钟，单位毫秒
+        static uint64_t NowMs();
+
+    private:
+        /// 每次有等待者时的notify使纪元加一，等待者在纪元上futex睡眠
+        std::atomic<uint32_t> m_epoch;
+        /// 已经prepareWait()但还没有结束等待的线程数
+        std::atomic<uint32_t> m_waiters;
+    };
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "hazard_pointer.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace sylar
+{
+    HazardPointerDomain::Holder::Holder(HazardPointerDomain &domain)
+        : m_domain(domain), m_slot(domain.acquireSlot())
+    {
+    }
+
+    HazardPointerDomain::Holder::~Holder()
+    {
+        m_domain.releaseSlot(m_slot);
+    }
+
+    HazardPointerDomain::HazardPointerDomain()
+        : m_slots(nullptr), m_slotCount(0), m_retired(nullptr), m_retiredCount(0)
+    {
+    }
+
+    HazardPointerDomain::~HazardPointerDomain()
+    {
+        Retired *retired = m_retired.load(std::memory_order_acquire);
+        while (retired)
+        {
+            Retired *next = retired->next;
+            retired->deleter(retired->ptr);
+            delete retired;
+            retired = next;
+        }
+        Slot *slot = m_slots.load(std::memory_order_acquire);
+        while (slot)
+        {
+            Slot *next = slot->next;
+            delete slot;
+            slot = next;
+        }
+    }
+
+    HazardPointerDomain &HazardPointerDomain::Global()
+    {
+        // 有意不释放，进程退出时仍可能有线程在使用
+        static HazardPointerDomain *s_global = new HazardPointerDomain;
+        return *s_global;
+    }
+
+    HazardPointerDomain::Slot *HazardPointerDomain::acquireSlot()
+    {
+        for (Slot *slot = m_slots.load(std::memory_order_acquire); slot; slot = slot->next)
+        {
+            bool expected = false;
+            if (!slot->active.load(std::memory_order_relaxed) &&
+                slot->active.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                return slot;
+            }
+        }
+        Slot *slot = new Slot;
+        slot->active.store(true, std::memory_order_relaxed);
+        Slot *head = m_slots.load(std::memory_order_relaxed);
+        do
+        {
+            slot->next = head;
+        } while (!m_slots.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+        m_slotCount.fetch_add(1, std::memory_order_relaxed);
+        return slot;
+    }
+
+    void HazardPointerDomain::releaseSlot(Slot *slot)
+    {
+        slot->hazard.store(nullptr, std::memory_order_release);
+        slot->active.store(false, std::memory_order_release);
+    }
+
+    void HazardPointerDomain::retire(void *ptr, Deleter deleter)
+    {
+        Retired *retired = new Retired{ptr, deleter, m_retired.load(std::memory_order_relaxed)};
+        while (!m_retired.compare_exchange_weak(retired->next, retired, std::memory_order_release, std::memory_order_relaxed))
+            ;
+        size_t count = m_retiredCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        size_t threshold = kScanFactor * m_slotCount.load(std::memory_order_relaxed);
+        if (threshold < kMinScanThreshold)
+        {
+            threshold = kMinScanThreshold;
+        }
+        if (count >= threshold)
+        {
+            scan();
+        }
+    }
+
+    void HazardPointerDomain::scan()
+    {
+        // 整体取走待回收链表，其他线程可以继续退休节点
+        Retired *retired = m_retired.exchange(nullptr, std::memory_order_acquire);
+        if (!retired)
+        {
+            return;
+        }
+
+        std::vector<void *> hazards;
+        for (Slot *slot = m_slots.load(std::memory_order_acquire); slot; slot = slot->next)
+        {
+            void *hazard = slot->hazard.load(std::memory_order_seq_cst);
+            if (hazard)
+            {
+                hazards.push_back(hazard);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        Retired *keep = nullptr;
+        Retired *keepTail = nullptr;
+        size_t freed = 0;
+        while (retired)
+        {
+            Retired *next = retired->next;
+            if (std::binary_search(hazards.begin(), hazards.end(), retired->ptr))
+            {
+                retired->next = keep;
+                keep = retired;
+                if (!keepTail)
+                {
+                    keepTail = retired;
+                }
+            }
+            else
+            {
+                retired->deleter(retired->ptr);
+                delete retired;
+                ++freed;
+            }
+            retired = next;
+        }
+        m_retiredCount.fetch_sub(freed, std::memory_order_relaxed);
+
+        // 仍被保护的节点放回链表
+        if (keep)
+        {
+            keepTail->next = m_retired.load(std::memory_order_relaxed);
+            while (!m_retired.compare_exchange_weak(keepTail->next, keep, std::memory_order_release, std::memory_order_relaxed))
+                ;
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef __SYLAR_HAZARD_POINTER_H__
+#define __SYLAR_HAZARD_POINTER_H__
+
+#include <stdint.h>
+#include <cstddef>
+#include <atomic>
+#include "noncopyable.h"
+
+namespace sylar
+{
+    /**
+     * @brief 风险指针（hazard pointer）回收域
+     * @details 读者在解引用共享指针之前把它发布到一个风险指针槽中，并确认源指针没有变化；
+     *          写者退休节点后，只有在扫描所有槽都没有发现该节点时才释放。
+     *          与Epoch相比，长时间持有引用只会阻止被引用的那个节点回收，不会拖住其他节点，
+     *          代价是每次保护都需要一次seq_cst写和一次重读
+     */
+    class HazardPointerDomain : Noncopyable
+    {
+    public:
+        /// 节点释放函数
+        typedef void (*Deleter)(void *);
+
+        /// 待回收节点数超过 kScanFactor * 槽数 时扫描一次
+        static const size_t kScanFactor = 2;
+        /// 扫描的最小阈值
+        static const size_t kMinScanThreshold = 64;
+
+        /// 风险指针槽，槽只会被追加不会被释放，空闲后可以被其他Holder复用
+        struct alignas(64) Slot
+        {
+            std::atomic<void *> hazard{nullptr};
+            std::atomic<bool> active{false};
+            Slot *next = nullptr;
+        };
+
+        /// @brief 持有一个风险指针槽，RAII
+        class Holder : Noncopyable
+        {
+        public:
+            Holder(HazardPointerDomain &domain = HazardPointerDomain::Global());
+            ~Holder();
+
+            /// @brief 保护src当前指向的节点，返回受保护的指针
+            template <class T>
+            T *protect(const std::atomic<T *> &src)
+            {
+                T *ptr = src.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    m_slot->hazard.store(ptr, std::memory_order_seq_cst);
+                    T *current = src.load(std::memory_order_seq_cst);
+                    if (current == ptr)
+                    {
+                        return ptr;
+                    }
+                    ptr = current;
+                }
+            }
+
+            /// @brief 直接设置保护的指针，调用者需要自己保证指针仍然有效
+            void set(void *ptr) { m_slot->hazard.store(ptr, std::memory_order_seq_cst); }
+
+            /// @brief 取消保护
+            void reset() { m_slot->hazard.store(nullptr, std::memory_order_release); }
+
+        private:
+            HazardPointerDomain &m_domain;
+            Slot *m_slot;
+        };
+
+        HazardPointerDomain();
+
+        /// @brief 析构函数，释放所有待回收节点，调用时不能再有线程使用该域
+        ~HazardPointerDomain();
+
+        /// @brief 全局默认回收域
+        static HazardPointerDomain &Global();
+
+        /// @brief 退休一个已经从共享结构中摘除的节点
+        void retire(void *ptr, Deleter deleter);
+
+        template <class T>
+        void retire(T *ptr)
+        {
+            retire(ptr, [](void *p)
+                   { delete static_cast<T *>(p); });
+        }
+
+        /// @brief 扫描风险指针，释放没有被保护的节点
+        void scan();
+
+        /// @brief 等待回收的节点数（近似值，用于诊断）
+        size_t getPendingCount() const { return m_retiredCount.load(std::memory_order_relaxed); }
+
+    private:
+        struct Retired
+        {
+            void *ptr;
+            Deleter deleter;
+            Retired *next;
+        };
+
+        Slot *acquireSlot();
+        void releaseSlot(Slot *slot);
+
+    private:
+        std::atomic<Slot *> m_slots;
+        std::atomic<size_t> m_slotCount;
+        /// 待回收节点链表，无锁压栈，扫描时整体取走
+        std::atomic<Retired *> m_retired;
+        std::atomic<size_t> m_retiredCount;
+    };
+}
+
+#endif
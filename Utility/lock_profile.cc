@@ -0,0 +1,350 @@
+#include "lock_profile.hpp"
+#include <dlfcn.h>
+#include <time.h>
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sylar
+{
+    /// 单把锁的统计数据
+    struct LockStats
+    {
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        uint64_t waitTotalNs = 0;
+        uint64_t holdTotalNs = 0;
+        uint64_t waitHistogram[LockProfiler::kHistogramBuckets] = {0};
+        uint64_t holdHistogram[LockProfiler::kHistogramBuckets] = {0};
+        /// 调用位置 - 竞争次数
+        std::unordered_map<const void *, uint64_t> sites;
+
+        void merge(const LockStats &other)
+        {
+            acquisitions += other.acquisitions;
+            contended += other.contended;
+            waitTotalNs += other.waitTotalNs;
+            holdTotalNs += other.holdTotalNs;
+            for (size_t i = 0; i < LockProfiler::kHistogramBuckets; ++i)
+            {
+                waitHistogram[i] += other.waitHistogram[i];
+                holdHistogram[i] += other.holdHistogram[i];
+            }
+            for (auto &i : other.sites)
+            {
+                sites[i.first] += i.second;
+            }
+        }
+    };
+
+    typedef std::unordered_map<uint32_t, LockStats> LockStatsMap;
+
+    struct ThreadLockStats;
+
+    /// 全局注册表，有意不释放，保证线程局部数据析构时仍然可用
+    struct LockProfileRegistry
+    {
+        std::mutex mutex;
+        /// 下标为统计id
+        std::vector<std::string> names;
+        /// 名称 - 统计id
+        std::unordered_map<std::string, uint32_t> ids;
+        std::unordered_set<ThreadLockStats *> threads;
+        /// 已退出线程的汇总数据
+        LockStatsMap retired;
+    };
+
+    static LockProfileRegistry &GetRegistry()
+    {
+        static LockProfileRegistry *s_registry = new LockProfileRegistry;
+        return *s_registry;
+    }
+
+    /// 线程局部统计数据，导出时其他线程会读取，所以用一个几乎不会竞争的mutex保护
+    struct ThreadLockStats
+    {
+        ThreadLockStats()
+        {
+            LockProfileRegistry &registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.threads.insert(this);
+        }
+
+        ~ThreadLockStats()
+        {
+            LockProfileRegistry &registry = GetRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.threads.erase(this);
+            for (auto &i : stats)
+            {
+                registry.retired[i.first].merge(i.second);
+            }
+        }
+
+        std::mutex mutex;
+        LockStatsMap stats;
+    };
+
+    static ThreadLockStats &GetThreadStats()
+    {
+        static thread_local ThreadLockStats s_stats;
+        return s_stats;
+    }
+
+    static size_t HistogramBucket(uint64_t ns)
+    {
+        size_t bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+        return std::min(bucket, LockProfiler::kHistogramBuckets - 1);
+    }
+
+    const char *const LockProfiler::kUnnamed = "<unnamed>";
+
+    uint32_t LockProfiler::Register(const std::string &name)
+    {
+        LockProfileRegistry &registry = GetRegistry();
+        std::lock_guard<std::mutex> guard(registry.mutex);
+        auto it = registry.ids.find(name);
+        if (it != registry.ids.end())
+        {
+            return it->second;
+        }
+        uint32_t id = registry.names.size();
+        registry.names.push_back(name);
+        registry.ids[name] = id;
+        return id;
+    }
+
+    void LockProfiler::RecordAcquire(uint32_t id, bool contended, uint64_t waitNs, const void *site)
+    {
+        ThreadLockStats &thread = GetThreadStats();
+        std::lock_guard<std::mutex> guard(thread.mutex);
+        LockStats &stats = thread.stats[id];
+        ++stats.acquisitions;
+        if (contended)
+        {
+            ++stats.contended;
+            stats.waitTotalNs += waitNs;
+            ++stats.sites[site];
+        }
+        ++stats.waitHistogram[HistogramBucket(waitNs)];
+    }
+
+    void LockProfiler::RecordHold(uint32_t id, uint64_t holdNs)
+    {
+        ThreadLockStats &thread = GetThreadStats();
+        std::lock_guard<std::mutex> guard(thread.mutex);
+        LockStats &stats = thread.stats[id];
+        stats.holdTotalNs += holdNs;
+        ++stats.holdHistogram[HistogramBucket(holdNs)];
+    }
+
+    /// 一个线程同时持有的共享锁，嵌套超过kMaxSharedHolds层时不再记录持有时间
+    static const size_t kMaxSharedHolds = 16;
+
+    struct SharedHolds
+    {
+        uint32_t ids[kMaxSharedHolds];
+        uint64_t times[kMaxSharedHolds];
+        size_t count;
+    };
+
+    static thread_local SharedHolds t_sharedHolds;
+
+    void LockProfiler::SharedAcquired(uint32_t id, uint64_t now)
+    {
+        SharedHolds &holds = t_sharedHolds;
+        if (holds.count < kMaxSharedHolds)
+        {
+            holds.ids[holds.count] = id;
+            holds.times[holds.count] = now;
+            ++holds.count;
+        }
+    }
+
+    void LockProfiler::SharedReleased(uint32_t id)
+    {
+        SharedHolds &holds = t_sharedHolds;
+        // 通常按加锁的逆序释放，从后往前找
+        for (size_t i = holds.count; i > 0; --i)
+        {
+            if (holds.ids[i - 1] == id)
+            {
+                uint64_t holdNs = Now() - holds.times[i - 1];
+                --holds.count;
+                holds.ids[i - 1] = holds.ids[holds.count];
+                holds.times[i - 1] = holds.times[holds.count];
+                RecordHold(id, holdNs);
+                return;
+            }
+        }
+    }
+
+    uint64_t LockProfiler::Now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    /// @brief 调用位置转为可读的字符串，能解析出符号时附带符号名
+    static std::string SiteToString(const void *site)
+    {
+        std::stringstream ss;
+        ss << site;
+        Dl_info info = {};
+        if (dladdr(site, &info) && info.dli_sname)
+        {
+            ss << " " << info.dli_sname << "+0x" << std::hex
+               << (reinterpret_cast<uintptr_t>(site) - reinterpret_cast<uintptr_t>(info.dli_saddr));
+        }
+        else if (info.dli_fname)
+        {
+            // 没有导出符号时输出模块内偏移，可以用addr2line -e <模块> <偏移>定位
+            ss << " " << info.dli_fname << "+0x" << std::hex
+               << (reinterpret_cast<uintptr_t>(site) - reinterpret_cast<uintptr_t>(info.dli_fbase));
+        }
+        return ss.str();
+    }
+
+    static std::string JsonEscape(const std::string &str)
+    {
+        std::string out;
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out.push_back('\\');
+            }
+            out.push_back(c);
+        }
+        return out;
+    }
+
+    std::string LockProfiler::Dump(bool json)
+    {
+        LockStatsMap merged;
+        std::vector<std::string> names;
+        {
+            LockProfileRegistry &registry = GetRegistry();
+            std::lock_guard<std::mutex> guard(registry.mutex);
+            names = registry.names;
+            for (auto &i : registry.retired)
+            {
+                merged[i.first].merge(i.second);
+            }
+            for (auto thread : registry.threads)
+            {
+                std::lock_guard<std::mutex> lock(thread->mutex);
+                for (auto &i : thread->stats)
+                {
+                    merged[i.first].merge(i.second);
+                }
+            }
+        }
+
+        // 竞争次数多的锁排在前面
+        std::vector<std::pair<uint32_t, const LockStats *>> locks;
+        for (auto &i : merged)
+        {
+            locks.push_back(std::make_pair(i.first, &i.second));
+        }
+        std::sort(locks.begin(), locks.end(), [](const std::pair<uint32_t, const LockStats *> &a, const std::pair<uint32_t, const LockStats *> &b)
+                  { return a.second->contended > b.second->contended; });
+
+        std::stringstream ss;
+        if (json)
+        {
+            ss << "[";
+        }
+        for (size_t n = 0; n < locks.size(); ++n)
+        {
+            const LockStats &stats = *locks[n].second;
+            std::vector<std::pair<const void *, uint64_t>> sites(stats.sites.begin(), stats.sites.end());
+            std::sort(sites.begin(), sites.end(), [](const std::pair<const void *, uint64_t> &a, const std::pair<const void *, uint64_t> &b)
+                      { return a.second > b.second; });
+            if (sites.size() > kTopSites)
+            {
+                sites.resize(kTopSites);
+            }
+            const std::string &name = names[locks[n].first];
+
+            if (json)
+            {
+                ss << (n ? "," : "") << "{\"name\":\"" << JsonEscape(name) << "\""
+                   << ",\"acquisitions\":" << stats.acquisitions
+                   << ",\"contended\":" << stats.contended
+                   << ",\"wait_total_ns\":" << stats.waitTotalNs
+                   << ",\"hold_total_ns\":" << stats.holdTotalNs;
+                ss << ",\"wait_histogram\":[";
+                for (size_t i = 0; i < kHistogramBuckets; ++i)
+                {
+                    ss << (i ? "," : "") << stats.waitHistogram[i];
+                }
+                ss << "],\"hold_histogram\":[";
+                for (size_t i = 0; i < kHistogramBuckets; ++i)
+                {
+                    ss << (i ? "," : "") << stats.holdHistogram[i];
+                }
+                ss << "],\"top_sites\":[";
+                for (size_t i = 0; i < sites.size(); ++i)
+                {
+                    ss << (i ? "," : "") << "{\"site\":\"" << JsonEscape(SiteToString(sites[i].first))
+                       << "\",\"contended\":" << sites[i].second << "}";
+                }
+                ss << "]}";
+                continue;
+            }
+
+            ss << name << ": acquisitions=" << stats.acquisitions
+               << " contended=" << stats.contended
+               << " (" << std::fixed << std::setprecision(2)
+               << (stats.acquisitions ? 100.0 * stats.contended / stats.acquisitions : 0.0) << "%)"
+               << " avg_wait_ns=" << (stats.contended ? stats.waitTotalNs / stats.contended : 0)
+               << " avg_hold_ns=" << (stats.acquisitions ? stats.holdTotalNs / stats.acquisitions : 0)
+               << std::endl;
+            ss << "  wait histogram (ns <):";
+            for (size_t i = 0; i < kHistogramBuckets; ++i)
+            {
+                if (stats.waitHistogram[i])
+                {
+                    ss << " " << (1ULL << i) << ":" << stats.waitHistogram[i];
+                }
+            }
+            ss << std::endl
+               << "  hold histogram (ns <):";
+            for (size_t i = 0; i < kHistogramBuckets; ++i)
+            {
+                if (stats.holdHistogram[i])
+                {
+                    ss << " " << (1ULL << i) << ":" << stats.holdHistogram[i];
+                }
+            }
+            ss << std::endl;
+            for (auto &i : sites)
+            {
+                ss << "  site " << SiteToString(i.first) << " contended=" << i.second << std::endl;
+            }
+        }
+        if (json)
+        {
+            ss << "]";
+        }
+        return ss.str();
+    }
+
+    void LockProfiler::Reset()
+    {
+        LockProfileRegistry &registry = GetRegistry();
+        std::lock_guard<std::mutex> guard(registry.mutex);
+        registry.retired.clear();
+        for (auto thread : registry.threads)
+        {
+            std::lock_guard<std::mutex> lock(thread->mutex);
+            thread->stats.clear();
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef __SYLAR_LOCK_PROFILE_H__
+#define __SYLAR_LOCK_PROFILE_H__
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * 锁竞争分析
+ * 定义SYLAR_LOCK_PROFILE编译时（cmake -DSYLAR_LOCK_PROFILE=ON），Mutex/RWMutex/Spinlock/CASLock
+ * 会记录获取次数、竞争次数、等待时间和持有时间的直方图以及竞争最多的调用位置。
+ * 未定义时锁的实现与之前完全相同，没有任何额外开销。
+ */
+#ifdef SYLAR_LOCK_PROFILE
+/// 统计模式下加锁函数不内联，__builtin_return_address才能拿到真正的加锁位置
+#define SYLAR_LOCK_PROFILE_NOINLINE __attribute__((noinline))
+#else
+#define SYLAR_LOCK_PROFILE_NOINLINE
+#endif
+
+namespace sylar
+{
+    /// @brief 锁竞争统计
+    /// @details 统计数据保存在线程局部，记录时只有本线程访问；导出时合并所有线程的数据，
+    ///          退出的线程把数据合并到全局汇总中。内部使用std::mutex，避免统计自己
+    class LockProfiler
+    {
+    public:
+        /// 直方图桶数，第i个桶表示[2^(i-1), 2^i)纳秒
+        static const size_t kHistogramBuckets = 32;
+        /// 导出时每个锁显示的竞争调用位置数
+        static const size_t kTopSites = 5;
+
+        /// 未命名的锁共用的名称，用竞争调用位置区分
+        static const char *const kUnnamed;
+
+        /// @brief 按名称注册统计条目
+        /// @details 同名的锁共用一个条目，条目数只随不同名称的数量增长，锁的创建和销毁不会让注册表变大
+        /// @param name 锁的名称
+        /// @return 统计id
+        static uint32_t Register(const std::string &name);
+
+        /// @brief 记录一次获取
+        /// @param id 锁的统计id
+        /// @param contended 是否发生了竞争
+        /// @param waitNs 等待时间，单位纳秒
+        /// @param site 调用位置
+        static void RecordAcquire(uint32_t id, bool contended, uint64_t waitNs, const void *site);
+
+        /// @brief 记录一次持有时间
+        static void RecordHold(uint32_t id, uint64_t holdNs);
+
+        /// @brief 记录当前线程获得共享锁的时间
+        /// @details 共享锁同时有多个持有者，获得时间记在线程局部的表中，释放时按id取回
+        static void SharedAcquired(uint32_t id, uint64_t now);
+
+        /// @brief 当前线程释放共享锁，记录持有时间
+        static void SharedReleased(uint32_t id);
+
+        /// @brief 单调时钟，单位纳秒
+        static uint64_t Now();
+
+        /// @brief 导出所有锁的统计
+        /// @param json 为true时输出JSON，否则输出文本
+        static std::string Dump(bool json = false);
+
+        /// @brief 清空所有统计数据
+        static void Reset();
+    };
+
+    /// @brief 嵌入到锁里的统计点
+    class LockProfilePoint
+    {
+    public:
+        LockProfilePoint() : m_id(LockProfiler::Register(LockProfiler::kUnnamed)) {}
+
+        /// @brief 改为统计到name的条目，应在锁开始使用前调用
+        void setName(const std::string &name) { m_id = LockProfiler::Register(name); }
+
+        uint32_t getId() const { return m_id; }
+
+        /// @brief 获取到锁之后调用
+        /// @param contended 是否发生了竞争
+        /// @param waitStart 开始等待的时间，没有竞争时为0
+        /// @param site 调用位置
+        void acquired(bool contended, uint64_t waitStart, const void *site)
+        {
+            uint64_t now = LockProfiler::Now();
+            m_acquireTime = now;
+            LockProfiler::RecordAcquire(m_id, contended, contended ? now - waitStart : 0, site);
+        }
+
+        /// @brief 释放锁之前调用
+        void released()
+        {
+            LockProfiler::RecordHold(m_id, LockProfiler::Now() - m_acquireTime);
+        }
+
+        /// @brief 获取到共享锁之后调用，参数同acquired()
+        void sharedAcquired(bool contended, uint64_t waitStart, const void *site)
+        {
+            uint64_t now = LockProfiler::Now();
+            LockProfiler::SharedAcquired(m_id, now);
+            LockProfiler::RecordAcquire(m_id, contended, contended ? now - waitStart : 0, site);
+        }
+
+        /// @brief 释放共享锁之前调用
+        void sharedReleased() { LockProfiler::SharedReleased(m_id); }
+
+    private:
+        uint32_t m_id;
+        /// 持有者获得锁的时间，只有持有者读写
+        uint64_t m_acquireTime = 0;
+    };
+}
+
+#endif
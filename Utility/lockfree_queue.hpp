@@ -0,0 +1,620 @@
+#ifndef __SYLAR_LOCKFREE_QUEUE_H__
+#define __SYLAR_LOCKFREE_QUEUE_H__
+
+#include <stdint.h>
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <memory>
+#include <vector>
+#include "cmutex.hpp"
+#include "event_count.hpp"
+#include "noncopyable.h"
+
+namespace sylar
+{
+    /// 缓存行大小，用于隔离不同线程频繁修改的变量
+    static const size_t kCacheLineSize = 64;
+
+    /// @brief 把容量向上取整为2的幂
+    inline size_t RoundUpPowerOfTwo(size_t n)
+    {
+        size_t size = 2;
+        while (size < n)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    /**
+     * @brief 单生产者单消费者环形队列
+     * @details 生产者只写尾指针，消费者只写头指针，两者位于不同缓存行；
+     *          双方各自缓存对方的指针，只有在缓存的值显示队列满/空时才重新读取，
+     *          大部分操作不会访问对方所在的缓存行。支持批量入队出队
+     */
+    template <class T>
+    class SPSCQueue : Noncopyable
+    {
+    public:
+        /// @brief 构造函数
+        /// @param capacity 容量，向上取整为2的幂
+        explicit SPSCQueue(size_t capacity = 1024)
+            : m_capacity(RoundUpPowerOfTwo(capacity)), m_mask(m_capacity - 1),
+              m_buffer(static_cast<Storage *>(::operator new(sizeof(Storage) * m_capacity)))
+        {
+        }
+
+        ~SPSCQueue()
+        {
+            size_t tail = m_tail.load(std::memory_order_acquire);
+            for (size_t i = m_head.load(std::memory_order_relaxed); i != tail; ++i)
+            {
+                reinterpret_cast<T *>(&m_buffer[i & m_mask])->~T();
+            }
+            ::operator delete(m_buffer);
+        }
+
+        /// @brief 入队，队列满时返回false
+        template <class U>
+        bool push(U &&value)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_cachedHead == m_capacity)
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (tail - m_cachedHead == m_capacity)
+                {
+                    return false;
+                }
+            }
+            new (&m_buffer[tail & m_mask]) T(std::forward<U>(value));
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief 出队，队列空时返回false
+        bool pop(T &value)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_cachedTail)
+            {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head == m_cachedTail)
+                {
+                    return false;
+                }
+            }
+            T *slot = reinterpret_cast<T *>(&m_buffer[head & m_mask]);
+            value = std::move(*slot);
+            slot->~T();
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief 批量入队，一次发布尾指针
+        /// @return 实际入队的数量
+        size_t pushBatch(const T *values, size_t count)
+        {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t free = m_capacity - (tail - m_cachedHead);
+            if (free < count)
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                free = m_capacity - (tail - m_cachedHead);
+            }
+            count = count < free ? count : free;
+            for (size_t i = 0; i < count; ++i)
+            {
+                new (&m_buffer[(tail + i) & m_mask]) T(values[i]);
+            }
+            m_tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        /// @brief 批量出队，一次发布头指针
+        /// @return 实际出队的数量
+        size_t popBatch(T *values, size_t count)
+        {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            size_t ready = m_cachedTail - head;
+            if (ready < count)
+            {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                ready = m_cachedTail - head;
+            }
+            count = count < ready ? count : ready;
+            for (size_t i = 0; i < count; ++i)
+            {
+                T *slot = reinterpret_cast<T *>(&m_buffer[(head + i) & m_mask]);
+                values[i] = std::move(*slot);
+                slot->~T();
+            }
+            m_head.store(head + count, std::memory_order_release);
+            return count;
+        }
+
+        /// @brief 近似的元素数量
+        size_t size() const
+        {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t capacity() const { return m_capacity; }
+
+    private:
+        typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+        const size_t m_capacity;
+        const size_t m_mask;
+        Storage *const m_buffer;
+
+        /// 消费者写
+        alignas(kCacheLineSize) std::atomic<size_t> m_head{0};
+        /// 消费者缓存的尾指针
+        size_t m_cachedTail = 0;
+
+        /// 生产者写
+        alignas(kCacheLineSize) std::atomic<size_t> m_tail{0};
+        /// 生产者缓存的头指针
+        size_t m_cachedHead = 0;
+    };
+
+    /**
+     * @brief 有界多生产者多消费者队列（Vyukov）
+     * @details 每个槽带一个序号，生产者和消费者分别用CAS抢占入队/出队位置，
+     *          通过槽的序号判断槽是否可写/可读，不需要锁，也不存在ABA问题
+     */
+    template <class T>
+    class MPMCQueue : Noncopyable
+    {
+    public:
+        /// @brief 构造函数
+        /// @param capacity 容量，向上取整为2的幂
+        explicit MPMCQueue(size_t capacity = 1024)
+            : m_capacity(RoundUpPowerOfTwo(capacity)), m_mask(m_capacity - 1),
+              m_cells(static_cast<Cell *>(::operator new(sizeof(Cell) * m_capacity)))
+        {
+            for (size_t i = 0; i < m_capacity; ++i)
+            {
+                new (&m_cells[i].sequence) std::atomic<size_t>(i);
+            }
+        }
+
+        ~MPMCQueue()
+        {
+            size_t tail = m_enqueuePos.load(std::memory_order_acquire);
+            for (size_t i = m_dequeuePos.load(std::memory_order_relaxed); i != tail; ++i)
+            {
+                reinterpret_cast<T *>(&m_cells[i & m_mask].storage)->~T();
+            }
+            ::operator delete(m_cells);
+        }
+
+        /// @brief 入队，队列满时返回false
+        template <class U>
+        bool push(U &&value)
+        {
+            Cell *cell;
+            size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            new (&cell->storage) T(std::forward<U>(value));
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief 出队，队列空时返回false
+        bool pop(T &value)
+        {
+            Cell *cell;
+            size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            T *slot = reinterpret_cast<T *>(&cell->storage);
+            value = std::move(*slot);
+            slot->~T();
+            cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// @brief 近似的元素数量
+        size_t size() const
+        {
+            size_t enqueue = m_enqueuePos.load(std::memory_order_acquire);
+            size_t dequeue = m_dequeuePos.load(std::memory_order_acquire);
+            return enqueue > dequeue ? enqueue - dequeue : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t capacity() const { return m_capacity; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        };
+
+        const size_t m_capacity;
+        const size_t m_mask;
+        Cell *const m_cells;
+        alignas(kCacheLineSize) std::atomic<size_t> m_enqueuePos{0};
+        alignas(kCacheLineSize) std::atomic<size_t> m_dequeuePos{0};
+    };
+
+    /**
+     * @brief 工作窃取双端队列（Chase-Lev）
+     * @details 所有者在底部push/pop，其他线程从顶部steal，只有队列里剩最后一个元素时
+     *          所有者才需要与窃取者CAS竞争。容量不足时扩容为两倍，旧数组保留到队列析构，
+     *          正在读旧数组的窃取者不会访问已释放的内存。元素必须是可平凡拷贝的类型，通常是指针
+     */
+    template <class T>
+    class ChaseLevDeque : Noncopyable
+    {
+    public:
+        static_assert(std::is_trivially_copyable<T>::value, "ChaseLevDeque element must be trivially copyable");
+
+        explicit ChaseLevDeque(size_t capacity = 256)
+            : m_top(0), m_bottom(0)
+        {
+            Array *array = new Array(RoundUpPowerOfTwo(capacity));
+            m_arrays.emplace_back(array);
+            m_array.store(array, std::memory_order_relaxed);
+        }
+
+        /// @brief 所有者线程在底部压入
+        void push(T value)
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            int64_t top = m_top.load(std::memory_order_acquire);
+            Array *array = m_array.load(std::memory_order_relaxed);
+            if (bottom - top > static_cast<int64_t>(array->mask))
+            {
+                array = grow(array, top, bottom);
+            }
+            array->put(bottom, value);
+            m_bottom.store(bottom + 1, std::memory_order_release);
+        }
+
+        /// @brief 所有者线程从底部弹出，队列为空时返回false
+        bool pop(T &value)
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            Array *array = m_array.load(std::memory_order_relaxed);
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+            if (top > bottom)
+            {
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return false;
+            }
+            value = array->get(bottom);
+            if (top == bottom)
+            {
+                // 最后一个元素，和窃取者竞争
+                bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return won;
+            }
+            return true;
+        }
+
+        /// @brief 任意线程从顶部窃取，队列为空或竞争失败时返回false
+        bool steal(T &value)
+        {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = m_bottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+            {
+                return false;
+            }
+            Array *array = m_array.load(std::memory_order_acquire);
+            value = array->get(top);
+            return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        /// @brief 近似的元素数量
+        size_t size() const
+        {
+            int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+            return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+    private:
+        struct Array
+        {
+            explicit Array(size_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+
+            T get(int64_t index) const { return slots[index & mask].load(std::memory_order_relaxed); }
+
+            void put(int64_t index, T value) { slots[index & mask].store(value, std::memory_order_relaxed); }
+
+            size_t mask;
+            std::unique_ptr<std::atomic<T>[]> slots;
+        };
+
+        Array *grow(Array *old, int64_t top, int64_t bottom)
+        {
+            Array *array = new Array((old->mask + 1) * 2);
+            for (int64_t i = top; i < bottom; ++i)
+            {
+                array->put(i, old->get(i));
+            }
+            m_arrays.emplace_back(array);
+            m_array.store(array, std::memory_order_release);
+            return array;
+        }
+
+    private:
+        alignas(kCacheLineSize) std::atomic<int64_t> m_top;
+        alignas(kCacheLineSize) std::atomic<int64_t> m_bottom;
+        std::atomic<Array *> m_array;
+        /// 所有分配过的数组，只有所有者线程修改
+        std::vector<std::unique_ptr<Array>> m_arrays;
+    };
+
+    /// @brief 侵入式MPSC队列的节点，元素类型需要继承该类
+    struct MPSCNode
+    {
+        std::atomic<MPSCNode *> mpscNext{nullptr};
+    };
+
+    /**
+     * @brief 侵入式无界多生产者单消费者队列（Vyukov）
+     * @details 元素本身作为链表节点，入队只有一次exchange，不分配内存；
+     *          队列不拥有元素，元素的生命周期由调用者管理
+     */
+    template <class T>
+    class MPSCQueue : Noncopyable
+    {
+    public:
+        static_assert(std::is_base_of<MPSCNode, T>::value, "MPSCQueue element must derive from MPSCNode");
+
+        MPSCQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+        /// @brief 入队，任意线程可以调用，总是成功
+        bool push(T *node)
+        {
+            pushNode(node);
+            return true;
+        }
+
+        /// @brief 出队，只有消费者线程可以调用
+        /// @details 生产者交换了头指针但还没有链接上时，会暂时返回false
+        bool pop(T *&node)
+        {
+            MPSCNode *tail = m_tail;
+            MPSCNode *next = tail->mpscNext.load(std::memory_order_acquire);
+            if (tail == &m_stub)
+            {
+                if (!next)
+                {
+                    return false;
+                }
+                m_tail = next;
+                tail = next;
+                next = next->mpscNext.load(std::memory_order_acquire);
+            }
+            if (next)
+            {
+                m_tail = next;
+                node = static_cast<T *>(tail);
+                return true;
+            }
+            if (tail != m_head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            // 只剩最后一个节点，把stub放回队尾后才能取走它
+            pushNode(&m_stub);
+            next = tail->mpscNext.load(std::memory_order_acquire);
+            if (next)
+            {
+                m_tail = next;
+                node = static_cast<T *>(tail);
+                return true;
+            }
+            return false;
+        }
+
+        /// @brief 近似判断是否为空，只有消费者线程可以调用
+        bool empty() const
+        {
+            return m_tail == &m_stub && !m_stub.mpscNext.load(std::memory_order_acquire);
+        }
+
+    private:
+        void pushNode(MPSCNode *node)
+        {
+            node->mpscNext.store(nullptr, std::memory_order_relaxed);
+            MPSCNode *prev = m_head.exchange(node, std::memory_order_acq_rel);
+            prev->mpscNext.store(node, std::memory_order_release);
+        }
+
+    private:
+        alignas(kCacheLineSize) std::atomic<MPSCNode *> m_head;
+        alignas(kCacheLineSize) MPSCNode *m_tail;
+        MPSCNode m_stub;
+    };
+
+    /**
+     * @brief 阻塞队列适配器
+     * @details 在无锁队列外面加一个信号量计数可用元素，消费者没有元素时睡眠。
+     *          默认使用FutexSemaphore，没有等待者时notify不进入内核
+     * @tparam Queue SPSCQueue/MPMCQueue/MPSCQueue
+     * @tparam SemType 信号量类型
+     */
+    template <class Queue, class SemType = FutexSemaphore>
+    class BlockingQueue : Noncopyable
+    {
+    public:
+        template <class... Args>
+        explicit BlockingQueue(Args &&...args) : m_queue(std::forward<Args>(args)...) {}
+
+        /// @brief 入队并唤醒一个消费者，队列满时返回false
+        template <class U>
+        bool push(U &&value)
+        {
+            if (!m_queue.push(std::forward<U>(value)))
+            {
+                return false;
+            }
+            m_sem.notify();
+            return true;
+        }
+
+        /// @brief 出队，队列为空时阻塞
+        template <class U>
+        void pop(U &value)
+        {
+            m_sem.wait();
+            // 信号量保证已经有一个完整入队的元素属于自己，这里失败只可能是其他生产者还没有完成发布
+            while (!m_queue.pop(value))
+            {
+                CpuRelax();
+            }
+        }
+
+        /// @brief 不阻塞地出队
+        template <class U>
+        bool tryPop(U &value)
+        {
+            if (!m_sem.tryWait())
+            {
+                return false;
+            }
+            while (!m_queue.pop(value))
+            {
+                CpuRelax();
+            }
+            return true;
+        }
+
+        /// @brief 最多等待timeoutMs毫秒
+        template <class U>
+        bool popFor(U &value, uint64_t timeoutMs)
+        {
+            if (!m_sem.waitFor(timeoutMs))
+            {
+                return false;
+            }
+            while (!m_queue.pop(value))
+            {
+                CpuRelax();
+            }
+            return true;
+        }
+
+        Queue &getQueue() { return m_queue; }
+
+    private:
+        Queue m_queue;
+        SemType m_sem;
+    };
+
+    /**
+     * @brief 基于EventCount的阻塞队列适配器
+     * @details 消费者先直接出队，失败后才登记为等待者；生产者在没有等待者时
+     *          只多一次原子读，不修改任何共享变量
+     */
+    template <class Queue>
+    class EventCountQueue : Noncopyable
+    {
+    public:
+        template <class... Args>
+        explicit EventCountQueue(Args &&...args) : m_queue(std::forward<Args>(args)...) {}
+
+        /// @brief 入队并唤醒一个消费者，队列满时返回false
+        template <class U>
+        bool push(U &&value)
+        {
+            if (!m_queue.push(std::forward<U>(value)))
+            {
+                return false;
+            }
+            m_event.notify();
+            return true;
+        }
+
+        /// @brief 出队，队列为空时阻塞
+        template <class U>
+        void pop(U &value)
+        {
+            m_event.await([&]()
+                          { return m_queue.pop(value); });
+        }
+
+        /// @brief 不阻塞地出队
+        template <class U>
+        bool tryPop(U &value)
+        {
+            return m_queue.pop(value);
+        }
+
+        /// @brief 最多等待timeoutMs毫秒，被唤醒但元素被其他消费者取走时继续等待剩余的时间
+        template <class U>
+        bool popFor(U &value, uint64_t timeoutMs)
+        {
+            return m_event.awaitFor([&]()
+                                    { return m_queue.pop(value); },
+                                    timeoutMs);
+        }
+
+        Queue &getQueue() { return m_queue; }
+
+    private:
+        Queue m_queue;
+        EventCount m_event;
+    };
+}
+
+#endif
@@ -0,0 +1,545 @@
+#include "object_pool.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace sylar
+{
+    /**
+     * @brief 块头，块按m_blockSize对齐
+     */
+    struct ObjectPoolBase::Block
+    {
+        Block *prev;
+        Block *next;
+        Block *allPrev;
+        Block *allNext;
+        void *freelist;
+        /// 已经交出去的槽位数
+        uint32_t used;
+        /// 已经切出的槽位数
+        uint32_t carved;
+        /// 是否在m_partial中
+        bool listed;
+    };
+
+    struct ObjectPoolBase::Magazine
+    {
+        Magazine *next;
+        Magazine *allNext;
+        uint32_t count;
+        void *slots[kMagazineSize];
+    };
+
+    /**
+     * @brief 线程对一个池的缓存，没有构造和析构函数
+     * @details owner和池的m_id相同时loaded和previous一定不为空
+     */
+    struct ObjectPoolBase::ThreadCache
+    {
+        uint64_t owner;
+        Magazine *loaded;
+        Magazine *previous;
+        uint64_t allocations;
+        uint64_t frees;
+    };
+
+    /**
+     * @brief 所有存活的池，按下标对应线程缓存数组
+     */
+    struct PoolRegistry
+    {
+        FutexMutex lock;
+        ObjectPoolBase *pools[ObjectPoolBase::kMaxPools] = {};
+        uint64_t nextId = 0;
+    };
+
+    static PoolRegistry &Registry()
+    {
+        alignas(PoolRegistry) static char storage[sizeof(PoolRegistry)];
+        static PoolRegistry *registry = new (storage) PoolRegistry();
+        return *registry;
+    }
+
+    thread_local ObjectPoolBase::ThreadCache ObjectPoolBase::t_caches[ObjectPoolBase::kMaxPools];
+    static thread_local bool t_poolCachesDestroyed = false;
+
+    /// @brief 线程退出时把各个池的弹匣还回去
+    struct PoolCacheCleaner
+    {
+        ~PoolCacheCleaner()
+        {
+            t_poolCachesDestroyed = true;
+            PoolRegistry &registry = Registry();
+            FutexMutex::Lock lock(registry.lock);
+            for (size_t i = 0; i < ObjectPoolBase::kMaxPools; ++i)
+            {
+                ObjectPoolBase::ThreadCache &cache = ObjectPoolBase::t_caches[i];
+                ObjectPoolBase *pool = registry.pools[i];
+                // 缓存项的池已经析构时弹匣随池释放了，直接丢弃
+                if (cache.owner && pool && pool->m_id == cache.owner)
+                {
+                    FutexMutex::Lock poolLock(pool->m_lock);
+                    pool->releaseLocked(cache);
+                }
+                cache.owner = 0;
+            }
+        }
+    };
+
+    static thread_local PoolCacheCleaner t_poolCleaner;
+
+    static inline void *&NextOf(void *slot)
+    {
+        return *static_cast<void **>(slot);
+    }
+}
+
+sylar::ObjectPoolBase::ObjectPoolBase(size_t size, size_t align, size_t maxIdleMagazines)
+    : m_maxIdle(maxIdleMagazines)
+{
+    if (align < alignof(void *))
+    {
+        align = alignof(void *);
+    }
+    // 空闲槽位的开头存放下一个空闲槽位
+    m_slotSize = (std::max(size, sizeof(void *)) + align - 1) / align * align;
+    m_slotOffset = (sizeof(Block) + align - 1) / align * align;
+    m_blockSize = kMinBlockSize;
+    while (m_blockSize < m_slotOffset + 2 * kMagazineSize * m_slotSize)
+    {
+        m_blockSize <<= 1;
+    }
+    m_slotsPerBlock = (m_blockSize - m_slotOffset) / m_slotSize;
+
+    PoolRegistry &registry = Registry();
+    FutexMutex::Lock lock(registry.lock);
+    m_id = ++registry.nextId;
+    m_index = kMaxPools;
+    for (size_t i = 0; i < kMaxPools; ++i)
+    {
+        if (!registry.pools[i])
+        {
+            registry.pools[i] = this;
+            m_index = i;
+            break;
+        }
+    }
+}
+
+sylar::ObjectPoolBase::~ObjectPoolBase()
+{
+    {
+        PoolRegistry &registry = Registry();
+        FutexMutex::Lock lock(registry.lock);
+        if (m_index < kMaxPools)
+        {
+            registry.pools[m_index] = nullptr;
+        }
+    }
+    while (m_magazines)
+    {
+        Magazine *next = m_magazines->allNext;
+        delete m_magazines;
+        m_magazines = next;
+    }
+    while (m_blocks)
+    {
+        Block *next = m_blocks->allNext;
+        free(m_blocks);
+        m_blocks = next;
+    }
+}
+
+void *sylar::ObjectPoolBase::allocate()
+{
+    if (m_index < kMaxPools)
+    {
+        ThreadCache &cache = t_caches[m_index];
+        if (cache.owner == m_id && cache.loaded->count)
+        {
+            ++cache.allocations;
+            return cache.loaded->slots[--cache.loaded->count];
+        }
+    }
+    return allocateSlow();
+}
+
+void sylar::ObjectPoolBase::deallocate(void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (m_index < kMaxPools)
+    {
+        ThreadCache &cache = t_caches[m_index];
+        if (cache.owner == m_id && cache.loaded->count < kMagazineSize)
+        {
+            ++cache.frees;
+            cache.loaded->slots[cache.loaded->count++] = ptr;
+            return;
+        }
+    }
+    deallocateSlow(ptr);
+}
+
+void *sylar::ObjectPoolBase::allocateSlow()
+{
+    if (m_index >= kMaxPools || t_poolCachesDestroyed)
+    {
+        return allocateUncached();
+    }
+    ThreadCache &cache = t_caches[m_index];
+    if (cache.owner == m_id && cache.previous->count)
+    {
+        std::swap(cache.loaded, cache.previous);
+    }
+    else
+    {
+        FutexMutex::Lock lock(m_lock);
+        if (cache.owner != m_id && !bindLocked(cache))
+        {
+            ++m_allocations;
+            return allocFromBlocksLocked();
+        }
+        m_allocations += cache.allocations;
+        m_frees += cache.frees;
+        cache.allocations = cache.frees = 0;
+        if (m_full)
+        {
+            // 两个弹匣都是空的，用一个空弹匣换仓库的满弹匣
+            Magazine *full = m_full;
+            m_full = full->next;
+            --m_fullCount;
+            cache.previous->next = m_empty;
+            m_empty = cache.previous;
+            ++m_emptyCount;
+            cache.previous = cache.loaded;
+            cache.loaded = full;
+        }
+        else
+        {
+            fillLocked(cache.loaded);
+            if (!cache.loaded->count)
+            {
+                return nullptr;
+            }
+        }
+    }
+    ++cache.allocations;
+    return cache.loaded->slots[--cache.loaded->count];
+}
+
+void sylar::ObjectPoolBase::deallocateSlow(void *ptr)
+{
+    if (m_index >= kMaxPools || t_poolCachesDestroyed)
+    {
+        deallocateUncached(ptr);
+        return;
+    }
+    ThreadCache &cache = t_caches[m_index];
+    if (cache.owner == m_id && cache.previous->count < kMagazineSize)
+    {
+        std::swap(cache.loaded, cache.previous);
+    }
+    else
+    {
+        FutexMutex::Lock lock(m_lock);
+        if (cache.owner != m_id)
+        {
+            if (!bindLocked(cache))
+            {
+                ++m_frees;
+                freeToBlockLocked(ptr);
+                return;
+            }
+        }
+        else
+        {
+            // 两个弹匣都满了，把一个交给仓库换一个空弹匣
+            m_allocations += cache.allocations;
+            m_frees += cache.frees;
+            cache.allocations = cache.frees = 0;
+            Magazine *empty = emptyMagazineLocked();
+            if (!empty)
+            {
+                ++m_frees;
+                freeToBlockLocked(ptr);
+                return;
+            }
+            cache.previous->next = m_full;
+            m_full = cache.previous;
+            ++m_fullCount;
+            cache.previous = cache.loaded;
+            cache.loaded = empty;
+            // 空闲的满弹匣太多，说明分配方用不完，多余的还给块
+            while (m_fullCount > m_maxIdle)
+            {
+                Magazine *magazine = m_full;
+                m_full = magazine->next;
+                --m_fullCount;
+                drainLocked(magazine);
+                magazine->next = m_empty;
+                m_empty = magazine;
+                ++m_emptyCount;
+            }
+        }
+    }
+    ++cache.frees;
+    cache.loaded->slots[cache.loaded->count++] = ptr;
+}
+
+void *sylar::ObjectPoolBase::allocateUncached()
+{
+    FutexMutex::Lock lock(m_lock);
+    ++m_allocations;
+    if (m_full)
+    {
+        Magazine *full = m_full;
+        void *ptr = full->slots[--full->count];
+        if (!full->count)
+        {
+            m_full = full->next;
+            --m_fullCount;
+            full->next = m_empty;
+            m_empty = full;
+            ++m_emptyCount;
+        }
+        return ptr;
+    }
+    void *ptr = allocFromBlocksLocked();
+    if (!ptr)
+    {
+        --m_allocations;
+    }
+    return ptr;
+}
+
+void sylar::ObjectPoolBase::deallocateUncached(void *ptr)
+{
+    FutexMutex::Lock lock(m_lock);
+    ++m_frees;
+    freeToBlockLocked(ptr);
+}
+
+bool sylar::ObjectPoolBase::bindLocked(ThreadCache &cache)
+{
+    // 注册线程退出时的清理
+    (void)&t_poolCleaner;
+    cache.owner = 0;
+    cache.loaded = emptyMagazineLocked();
+    cache.previous = emptyMagazineLocked();
+    cache.allocations = cache.frees = 0;
+    if (!cache.loaded || !cache.previous)
+    {
+        for (Magazine *magazine : {cache.loaded, cache.previous})
+        {
+            if (magazine)
+            {
+                magazine->next = m_empty;
+                m_empty = magazine;
+                ++m_emptyCount;
+            }
+        }
+        return false;
+    }
+    cache.owner = m_id;
+    return true;
+}
+
+void sylar::ObjectPoolBase::releaseLocked(ThreadCache &cache)
+{
+    m_allocations += cache.allocations;
+    m_frees += cache.frees;
+    for (Magazine *magazine : {cache.loaded, cache.previous})
+    {
+        drainLocked(magazine);
+        magazine->next = m_empty;
+        m_empty = magazine;
+        ++m_emptyCount;
+    }
+    cache.owner = 0;
+    cache.loaded = cache.previous = nullptr;
+    cache.allocations = cache.frees = 0;
+}
+
+sylar::ObjectPoolBase::Magazine *sylar::ObjectPoolBase::emptyMagazineLocked()
+{
+    if (Magazine *magazine = m_empty)
+    {
+        m_empty = magazine->next;
+        --m_emptyCount;
+        return magazine;
+    }
+    Magazine *magazine = new (std::nothrow) Magazine;
+    if (magazine)
+    {
+        magazine->count = 0;
+        magazine->allNext = m_magazines;
+        m_magazines = magazine;
+    }
+    return magazine;
+}
+
+void sylar::ObjectPoolBase::fillLocked(Magazine *magazine)
+{
+    while (magazine->count < kMagazineSize)
+    {
+        void *ptr = allocFromBlocksLocked();
+        if (!ptr)
+        {
+            break;
+        }
+        magazine->slots[magazine->count++] = ptr;
+    }
+}
+
+void sylar::ObjectPoolBase::drainLocked(Magazine *magazine)
+{
+    while (magazine->count)
+    {
+        freeToBlockLocked(magazine->slots[--magazine->count]);
+    }
+}
+
+void *sylar::ObjectPoolBase::allocFromBlocksLocked()
+{
+    Block *block = m_partial;
+    if (!block)
+    {
+        block = static_cast<Block *>(aligned_alloc(m_blockSize, m_blockSize));
+        if (!block)
+        {
+            return nullptr;
+        }
+        block->freelist = nullptr;
+        block->used = 0;
+        block->carved = 0;
+        block->allPrev = nullptr;
+        block->allNext = m_blocks;
+        if (m_blocks)
+        {
+            m_blocks->allPrev = block;
+        }
+        m_blocks = block;
+        ++m_blockCount;
+        block->prev = nullptr;
+        block->next = nullptr;
+        block->listed = true;
+        m_partial = block;
+    }
+    void *ptr;
+    if (block->freelist)
+    {
+        ptr = block->freelist;
+        block->freelist = NextOf(ptr);
+    }
+    else
+    {
+        ptr = reinterpret_cast<char *>(block) + m_slotOffset + block->carved * m_slotSize;
+        ++block->carved;
+    }
+    ++block->used;
+    if (!block->freelist && block->carved == m_slotsPerBlock)
+    {
+        m_partial = block->next;
+        if (m_partial)
+        {
+            m_partial->prev = nullptr;
+        }
+        block->next = nullptr;
+        block->listed = false;
+    }
+    return ptr;
+}
+
+void sylar::ObjectPoolBase::freeToBlockLocked(void *ptr)
+{
+    Block *block = reinterpret_cast<Block *>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(m_blockSize - 1));
+    NextOf(ptr) = block->freelist;
+    block->freelist = ptr;
+    if (!block->listed)
+    {
+        block->prev = nullptr;
+        block->next = m_partial;
+        if (m_partial)
+        {
+            m_partial->prev = block;
+        }
+        m_partial = block;
+        block->listed = true;
+    }
+    if (--block->used)
+    {
+        return;
+    }
+    // 块中的槽位全部空闲，释放
+    if (block->prev)
+    {
+        block->prev->next = block->next;
+    }
+    else
+    {
+        m_partial = block->next;
+    }
+    if (block->next)
+    {
+        block->next->prev = block->prev;
+    }
+    if (block->allPrev)
+    {
+        block->allPrev->allNext = block->allNext;
+    }
+    else
+    {
+        m_blocks = block->allNext;
+    }
+    if (block->allNext)
+    {
+        block->allNext->allPrev = block->allPrev;
+    }
+    --m_blockCount;
+    free(block);
+}
+
+void sylar::ObjectPoolBase::flushThreadCache()
+{
+    if (m_index >= kMaxPools || t_poolCachesDestroyed)
+    {
+        return;
+    }
+    ThreadCache &cache = t_caches[m_index];
+    if (cache.owner != m_id)
+    {
+        return;
+    }
+    FutexMutex::Lock lock(m_lock);
+    releaseLocked(cache);
+}
+
+void sylar::ObjectPoolBase::trim()
+{
+    FutexMutex::Lock lock(m_lock);
+    while (Magazine *magazine = m_full)
+    {
+        m_full = magazine->next;
+        drainLocked(magazine);
+        magazine->next = m_empty;
+        m_empty = magazine;
+        ++m_emptyCount;
+    }
+    m_fullCount = 0;
+}
+
+sylar::ObjectPoolBase::Stats sylar::ObjectPoolBase::getStats()
+{
+    FutexMutex::Lock lock(m_lock);
+    Stats stats;
+    stats.allocations = m_allocations;
+    stats.frees = m_frees;
+    stats.blocks = m_blockCount;
+    stats.slots = m_blockCount * m_slotsPerBlock;
+    stats.fullMagazines = m_fullCount;
+    stats.emptyMagazines = m_emptyCount;
+    return stats;
+}
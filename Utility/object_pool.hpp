@@ -0,0 +1,255 @@
+#ifndef __SYLAR_OBJECT_POOL_H__
+#define __SYLAR_OBJECT_POOL_H__
+
+#include <stdint.h>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include "cmutex.hpp"
+#include "noncopyable.h"
+#include "../ptr/cunique_ptr.hpp"
+
+namespace sylar
+{
+    /**
+     * @brief 固定大小的对象池，与类型无关的部分
+     * @details 按弹匣（magazine）组织的缓存：
+     *          - 每个线程对每个池持有两个弹匣loaded和previous，分配从loaded弹出，释放压入loaded，
+     *            loaded空或满时和previous交换，都不加锁
+     *          - 两个弹匣都用完时加锁和中心仓库交换：分配时用空弹匣换一个满弹匣，释放时用满弹匣换一个空弹匣，
+     *            仓库没有满弹匣时从块中装填
+     *          - 块按块大小对齐，槽位地址向下取整就是块头；仓库中空闲的满弹匣超过上限、调用trim()、
+     *            线程退出时把槽位还给块，块中的槽位全部空闲时释放块
+     *          一个线程分配另一个线程释放时，释放方攒满的弹匣经仓库整个交给分配方，每个弹匣只加一次锁。
+     *          池可以在任意线程析构，但之后不能再有线程使用它分配的对象
+     */
+    class ObjectPoolBase : Noncopyable
+    {
+    public:
+        /// 每个弹匣的槽位数
+        static const size_t kMagazineSize = 32;
+        /// 仓库默认最多保留的满弹匣数
+        static const size_t kMaxIdleMagazines = 16;
+        /// 最小块大小
+        static const size_t kMinBlockSize = 64 * 1024;
+        /// 同时存在的池超过这个数时，之后创建的池没有线程缓存，每次分配释放都加锁
+        static const size_t kMaxPools = 64;
+
+        /// @brief 统计信息，分配和释放次数在线程和仓库交换弹匣时才累加，最多滞后每线程两个弹匣
+        struct Stats
+        {
+            uint64_t allocations;
+            uint64_t frees;
+            /// 块数和块中的槽位总数
+            size_t blocks;
+            size_t slots;
+            /// 仓库中的满弹匣和空弹匣
+            size_t fullMagazines;
+            size_t emptyMagazines;
+        };
+
+        /**
+         * @param size 对象大小
+         * @param align 对象对齐
+         * @param maxIdleMagazines 仓库最多保留的满弹匣数，超出的还给块
+         */
+        ObjectPoolBase(size_t size, size_t align, size_t maxIdleMagazines = kMaxIdleMagazines);
+        ~ObjectPoolBase();
+
+        /// @brief 取一个未构造的槽位，内存不足返回nullptr
+        void *allocate();
+
+        /// @brief 归还槽位，可以在任意线程调用
+        void deallocate(void *ptr);
+
+        /// @brief 把当前线程缓存的槽位还给块，并累加统计
+        void flushThreadCache();
+
+        /// @brief 把仓库中的满弹匣还给块，释放全部空闲的块
+        void trim();
+
+        Stats getStats();
+
+        size_t getSlotSize() const { return m_slotSize; }
+
+    private:
+        struct Block;
+        struct Magazine;
+        struct ThreadCache;
+        friend struct PoolCacheCleaner;
+
+        void *allocateSlow();
+        void deallocateSlow(void *ptr);
+        /// @brief 没有线程缓存可用（线程正在退出或池太多）时直接在锁内操作
+        void *allocateUncached();
+        void deallocateUncached(void *ptr);
+
+        /// @brief 给当前线程分配两个空弹匣，内存不足返回false
+        bool bindLocked(ThreadCache &cache);
+        /// @brief 线程退出或flush时归还两个弹匣
+        void releaseLocked(ThreadCache &cache);
+        Magazine *emptyMagazineLocked();
+        void fillLocked(Magazine *magazine);
+        void drainLocked(Magazine *magazine);
+        void *allocFromBlocksLocked();
+        void freeToBlockLocked(void *ptr);
+
+    private:
+        FutexMutex m_lock;
+        size_t m_slotSize;
+        size_t m_blockSize;
+        /// 块头之后第一个槽位的偏移
+        size_t m_slotOffset;
+        size_t m_slotsPerBlock;
+        size_t m_maxIdle;
+        /// 在线程缓存数组中的下标，kMaxPools表示没有线程缓存
+        size_t m_index;
+        /// 全局唯一的编号，线程缓存用它判断缓存项是否属于本池
+        uint64_t m_id;
+
+        /// 有空闲槽位的块
+        Block *m_partial = nullptr;
+        /// 全部块
+        Block *m_blocks = nullptr;
+        size_t m_blockCount = 0;
+
+        Magazine *m_full = nullptr;
+        size_t m_fullCount = 0;
+        Magazine *m_empty = nullptr;
+        size_t m_emptyCount = 0;
+        /// 创建过的全部弹匣，析构时释放
+        Magazine *m_magazines = nullptr;
+
+        uint64_t m_allocations = 0;
+        uint64_t m_frees = 0;
+
+        /// 线程对每个池的缓存，按m_index索引
+        static thread_local ThreadCache t_caches[kMaxPools];
+    };
+
+    /**
+     * @brief 类型T的对象池
+     * @details 槽位预先从块中切好放在弹匣里，create()只是弹出一个槽位再原地构造。
+     *          Instance()返回每个类型一个的全局池，永不析构，对象可以在静态析构和线程退出时释放
+     */
+    template <class T>
+    class ObjectPool : public ObjectPoolBase
+    {
+    public:
+        typedef std::shared_ptr<ObjectPool> ptr;
+
+        ObjectPool(size_t maxIdleMagazines = kMaxIdleMagazines) : ObjectPoolBase(sizeof(T), alignof(T), maxIdleMagazines) {}
+
+        static ObjectPool &Instance()
+        {
+            alignas(ObjectPool) static char storage[sizeof(ObjectPool)];
+            static ObjectPool *pool = new (storage) ObjectPool();
+            return *pool;
+        }
+
+        /// @brief 分配并构造对象，内存不足抛出std::bad_alloc
+        template <class... Args>
+        T *create(Args &&...args)
+        {
+            void *ptr = allocate();
+            if (!ptr)
+            {
+                throw std::bad_alloc();
+            }
+            try
+            {
+                return new (ptr) T(std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                deallocate(ptr);
+                throw;
+            }
+        }
+
+        /// @brief 析构并归还对象
+        void destroy(T *ptr)
+        {
+            if (ptr)
+            {
+                ptr->~T();
+                deallocate(ptr);
+            }
+        }
+    };
+
+    /**
+     * @brief 把对象还给ObjectPool<T>::Instance()的删除器，用于CUniquePtr和std::shared_ptr
+     */
+    template <class T>
+    struct PoolDeleter
+    {
+        void operator()(T *ptr) const
+        {
+            ObjectPool<T>::Instance().destroy(ptr);
+        }
+    };
+
+    template <class T>
+    using PoolUniquePtr = CUniquePtr<T, PoolDeleter<T>>;
+
+    /// @brief 从全局池构造对象，由CUniquePtr持有
+    template <class T, class... Args>
+    PoolUniquePtr<T> MakePoolUnique(Args &&...args)
+    {
+        return PoolUniquePtr<T>(ObjectPool<T>::Instance().create(std::forward<Args>(args)...));
+    }
+
+    /**
+     * @brief 从全局池分配单个对象的标准分配器
+     * @details 用于std::allocate_shared，控制块和对象在同一个槽位里，一次分配
+     */
+    template <class T>
+    struct PoolAllocator
+    {
+        typedef T value_type;
+
+        PoolAllocator() = default;
+        template <class U>
+        PoolAllocator(const PoolAllocator<U> &) {}
+
+        T *allocate(size_t n)
+        {
+            if (n != 1)
+            {
+                return static_cast<T *>(::operator new(n * sizeof(T)));
+            }
+            void *ptr = ObjectPool<T>::Instance().allocate();
+            if (!ptr)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T *>(ptr);
+        }
+
+        void deallocate(T *ptr, size_t n)
+        {
+            if (n != 1)
+            {
+                ::operator delete(ptr);
+                return;
+            }
+            ObjectPool<T>::Instance().deallocate(ptr);
+        }
+
+        template <class U>
+        bool operator==(const PoolAllocator<U> &) const { return true; }
+        template <class U>
+        bool operator!=(const PoolAllocator<U> &) const { return false; }
+    };
+
+    /// @brief 从全局池构造由std::shared_ptr持有的对象
+    template <class T, class... Args>
+    std::shared_ptr<T> MakePoolShared(Args &&...args)
+    {
+        return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+    }
+}
+
+#endif
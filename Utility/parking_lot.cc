@@ -0,0 +1,157 @@
+#include "parking_lot.hpp"
+#include "cmutex.hpp"
+#include "util.h"
+#include <time.h>
+
+namespace sylar
+{
+    namespace
+    {
+        /// 桶的数量，2的幂
+        static const size_t kParkingBuckets = 256;
+
+        struct ParkedThread
+        {
+            const void *key;
+            /// 0 睡眠中，1 已被唤醒
+            std::atomic<uint32_t> state{0};
+            ParkedThread *prev = nullptr;
+            ParkedThread *next = nullptr;
+        };
+
+        struct alignas(64) ParkingBucket
+        {
+            FutexMutex mutex;
+            /// 桶里的等待者数量，Unpark据此跳过空桶
+            std::atomic<size_t> count{0};
+            ParkedThread *head = nullptr;
+            ParkedThread *tail = nullptr;
+
+            void append(ParkedThread *thread)
+            {
+                thread->prev = tail;
+                thread->next = nullptr;
+                if (tail)
+                {
+                    tail->next = thread;
+                }
+                else
+                {
+                    head = thread;
+                }
+                tail = thread;
+            }
+
+            void remove(ParkedThread *thread)
+            {
+                if (thread->prev)
+                {
+                    thread->prev->next = thread->next;
+                }
+                else
+                {
+                    head = thread->next;
+                }
+                if (thread->next)
+                {
+                    thread->next->prev = thread->prev;
+                }
+                else
+                {
+                    tail = thread->prev;
+                }
+            }
+        };
+
+        /// 所有桶在程序生命周期内有效，不析构
+        static ParkingBucket *s_buckets = new ParkingBucket[kParkingBuckets];
+
+        static ParkingBucket &GetBucket(const void *key)
+        {
+            uintptr_t addr = reinterpret_cast<uintptr_t>(key);
+            return s_buckets[HashBytes(&addr, sizeof(addr)) & (kParkingBuckets - 1)];
+        }
+    }
+}
+
+sylar::ParkingLot::ParkResult sylar::ParkingLot::ParkImpl(const void *key, bool (*validate)(void *), void *arg, uint64_t timeoutMs)
+{
+    ParkingBucket &bucket = GetBucket(key);
+    ParkedThread self;
+    self.key = key;
+    {
+        FutexMutex::Lock lock(bucket.mutex);
+        // 先登记再校验，与Unpark中修改条件后读取count配对
+        bucket.count.fetch_add(1, std::memory_order_seq_cst);
+        if (!validate(arg))
+        {
+            bucket.count.fetch_sub(1, std::memory_order_relaxed);
+            return INVALID;
+        }
+        bucket.append(&self);
+    }
+
+    struct timespec deadline;
+    if (timeoutMs != UINT64_MAX)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+    }
+    while (self.state.load(std::memory_order_acquire) == 0)
+    {
+        if (timeoutMs == UINT64_MAX)
+        {
+            FutexWait(&self.state, 0, nullptr);
+            continue;
+        }
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t ns = int64_t(timeoutMs) * 1000000LL - ((now.tv_sec - deadline.tv_sec) * 1000000000LL + (now.tv_nsec - deadline.tv_nsec));
+        if (ns <= 0)
+        {
+            FutexMutex::Lock lock(bucket.mutex);
+            // 持有桶锁时状态仍为0，说明还在链表里，自己摘除；否则已经被唤醒
+            if (self.state.load(std::memory_order_acquire) == 0)
+            {
+                bucket.remove(&self);
+                bucket.count.fetch_sub(1, std::memory_order_relaxed);
+                return TIMEOUT;
+            }
+            break;
+        }
+        struct timespec timeout;
+        timeout.tv_sec = ns / 1000000000LL;
+        timeout.tv_nsec = ns % 1000000000LL;
+        FutexWait(&self.state, 0, &timeout);
+    }
+    return UNPARKED;
+}
+
+size_t sylar::ParkingLot::Unpark(const void *key, size_t count)
+{
+    ParkingBucket &bucket = GetBucket(key);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (bucket.count.load(std::memory_order_relaxed) == 0)
+    {
+        return 0;
+    }
+
+    size_t woken = 0;
+    FutexMutex::Lock lock(bucket.mutex);
+    ParkedThread *thread = bucket.head;
+    while (thread && woken < count)
+    {
+        ParkedThread *next = thread->next;
+        if (thread->key == key)
+        {
+            bucket.remove(thread);
+            bucket.count.fetch_sub(1, std::memory_order_relaxed);
+            // 等待者看到状态变化后可能立即返回，此时FutexWake作用于已失效的栈地址，
+            // 最多造成其他futex的一次伪唤醒，所有futex的使用者都会重新检查条件
+            thread->state.store(1, std::memory_order_release);
+            FutexWake(&thread->state, 1);
+            ++woken;
+        }
+        thread = next;
+    }
+    return woken;
+}
@@ -0,0 +1,78 @@
+#ifndef __SYLAR_PARKING_LOT_H__
+#define __SYLAR_PARKING_LOT_H__
+
+#include <stdint.h>
+#include <cstddef>
+#include <atomic>
+#include <type_traits>
+#include "noncopyable.h"
+
+namespace sylar
+{
+    /**
+     * @brief 全局停车场，按地址睡眠/唤醒
+     * @details 任意地址都可以作为等待的键，不需要在对象里预留futex字。
+     *          地址哈希到固定数量的桶，每个桶有一把锁和一条等待者链表，
+     *          等待者在自己栈上的futex字上睡眠。桶里没有等待者时Unpark只有一次原子读
+     */
+    class ParkingLot
+    {
+    public:
+        enum ParkResult
+        {
+            /// 被Unpark唤醒
+            UNPARKED,
+            /// 校验条件不满足，没有睡眠
+            INVALID,
+            /// 超时
+            TIMEOUT
+        };
+
+        /**
+         * @brief 在key上睡眠
+         * @param validate 持有桶锁时调用，返回false则不睡眠；
+         *                 修改条件后再Unpark的线程因此不会和睡眠产生竞争
+         * @param timeoutMs 超时时间，UINT64_MAX表示一直等待
+         */
+        template <class Validate>
+        static ParkResult Park(const void *key, Validate &&validate, uint64_t timeoutMs = UINT64_MAX)
+        {
+            return ParkImpl(key, &CallValidate<Validate>, &validate, timeoutMs);
+        }
+
+        /// @brief 唤醒最多count个在key上睡眠的线程，返回实际唤醒的数量
+        static size_t Unpark(const void *key, size_t count = 1);
+
+        /// @brief 唤醒所有在key上睡眠的线程
+        static size_t UnparkAll(const void *key) { return Unpark(key, SIZE_MAX); }
+
+    private:
+        template <class Validate>
+        static bool CallValidate(void *arg)
+        {
+            return (*static_cast<typename std::remove_reference<Validate>::type *>(arg))();
+        }
+
+        static ParkResult ParkImpl(const void *key, bool (*validate)(void *), void *arg, uint64_t timeoutMs);
+    };
+
+    /// @brief 等待原子变量不再等于old，适用于任意宽度的原子类型
+    template <class T>
+    void WaitOnAddress(const std::atomic<T> &value, T old)
+    {
+        while (value.load(std::memory_order_acquire) == old)
+        {
+            ParkingLot::Park(&value, [&]()
+                             { return value.load(std::memory_order_acquire) == old; });
+        }
+    }
+
+    /// @brief 修改原子变量后唤醒在它上面等待的线程
+    template <class T>
+    void WakeByAddress(const std::atomic<T> &value, bool all = true)
+    {
+        ParkingLot::Unpark(&value, all ? SIZE_MAX : 1);
+    }
+}
+
+#endif
@@ -0,0 +1,221 @@
+#include "thread.hpp"
+#include "util.h"
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <stdexcept>
+
+namespace sylar
+{
+    static thread_local Thread *t_thread = nullptr;
+
+    /// 节点掩码的位数，支持64个NUMA节点
+    static const unsigned long kMaxNumaNodes = 64;
+
+    static bool BuildCpuSet(const std::vector<int> &cpus, cpu_set_t &set)
+    {
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            if (cpu < 0 || cpu >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            CPU_SET(cpu, &set);
+        }
+        return true;
+    }
+
+    /// @brief 设置当前线程之后分配内存时优先使用的NUMA节点
+    static bool SetPreferredNode(int node)
+    {
+        unsigned long mask = 1UL << node;
+        return syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, kMaxNumaNodes + 1) == 0;
+    }
+}
+
+sylar::Thread::Thread(std::function<void()> cb, const std::string &name, const ThreadAttr &attr)
+    : m_cb(std::move(cb)), m_name(name.empty() ? "UNKNOW" : name)
+{
+    pthread_attr_t pattr;
+    pthread_attr_init(&pattr);
+    cpu_set_t set;
+    if (!attr.cpus.empty())
+    {
+        if (!BuildCpuSet(attr.cpus, set))
+        {
+            pthread_attr_destroy(&pattr);
+            throw std::invalid_argument("Thread: invalid cpu in affinity set, name=" + name);
+        }
+        int rt = pthread_attr_setaffinity_np(&pattr, sizeof(set), &set);
+        if (rt)
+        {
+            pthread_attr_destroy(&pattr);
+            throw std::logic_error("pthread_attr_setaffinity_np error, rt=" + std::to_string(rt) + " name=" + name);
+        }
+    }
+
+    size_t stackSize = attr.stackSize;
+    if (attr.numaLocal)
+    {
+        m_numaNode = GetNumaNodeOfCpu(attr.cpus.empty() ? sched_getcpu() : attr.cpus[0]);
+        if (stackSize == 0)
+        {
+            pthread_attr_getstacksize(&pattr, &stackSize);
+        }
+        if (allocStack(stackSize))
+        {
+            pthread_attr_setstack(&pattr, static_cast<char *>(m_stack) + getpagesize(), m_stackSize - getpagesize());
+        }
+        else
+        {
+            // 分配失败时退回到由pthread分配栈，仍然使用要求的栈大小
+            pthread_attr_setstacksize(&pattr, stackSize);
+        }
+    }
+    else if (stackSize)
+    {
+        pthread_attr_setstacksize(&pattr, stackSize);
+    }
+
+    int rt = pthread_create(&m_thread, &pattr, &Thread::run, this);
+    pthread_attr_destroy(&pattr);
+    if (rt)
+    {
+        if (m_stack)
+        {
+            munmap(m_stack, m_stackSize);
+        }
+        throw std::logic_error("pthread_create error, rt=" + std::to_string(rt) + " name=" + name);
+    }
+    m_semaphore.wait();
+}
+
+sylar::Thread::~Thread()
+{
+    if (m_thread)
+    {
+        if (m_stack)
+        {
+            // 线程还在使用这块栈，不能在detach后释放
+            pthread_join(m_thread, nullptr);
+        }
+        else
+        {
+            pthread_detach(m_thread);
+        }
+    }
+    if (m_stack)
+    {
+        munmap(m_stack, m_stackSize);
+    }
+}
+
+void sylar::Thread::join()
+{
+    if (m_thread)
+    {
+        int rt = pthread_join(m_thread, nullptr);
+        if (rt)
+        {
+            throw std::logic_error("pthread_join error, rt=" + std::to_string(rt) + " name=" + m_name);
+        }
+        m_thread = 0;
+    }
+}
+
+bool sylar::Thread::setAffinity(const std::vector<int> &cpus)
+{
+    cpu_set_t set;
+    if (!m_thread || !BuildCpuSet(cpus, set))
+    {
+        return false;
+    }
+    return pthread_setaffinity_np(m_thread, sizeof(set), &set) == 0;
+}
+
+sylar::Thread *sylar::Thread::GetThis()
+{
+    return t_thread;
+}
+
+const std::string &sylar::Thread::GetName()
+{
+    return GetThreadName();
+}
+
+void sylar::Thread::SetName(const std::string &name)
+{
+    if (name.empty())
+    {
+        return;
+    }
+    if (t_thread)
+    {
+        t_thread->m_name = name;
+    }
+    SetThreadName(name);
+}
+
+int sylar::Thread::GetCpuCount()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<int>(n) : 1;
+}
+
+int sylar::Thread::GetNumaNodeOfCpu(int cpu)
+{
+    // /sys/devices/system/cpu/cpuN/ 下有一个名为nodeM的链接
+    for (unsigned long node = 0; node < kMaxNumaNodes; ++node)
+    {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/node%lu", cpu, node);
+        if (access(path, F_OK) == 0)
+        {
+            return static_cast<int>(node);
+        }
+    }
+    return 0;
+}
+
+bool sylar::Thread::allocStack(size_t size)
+{
+    size_t page = getpagesize();
+    size = (size + page - 1) / page * page + page;
+    void *stack = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED)
+    {
+        return false;
+    }
+    // 栈向低地址增长，最低的一页作为保护页
+    mprotect(stack, page, PROT_NONE);
+    // 页面还没有分配，mbind只设置策略，首次访问时在该节点上分配；内核不支持NUMA时忽略失败
+    unsigned long mask = 1UL << m_numaNode;
+    syscall(SYS_mbind, stack, size, MPOL_PREFERRED, &mask, kMaxNumaNodes + 1, 0);
+    m_stack = stack;
+    m_stackSize = size;
+    return true;
+}
+
+void *sylar::Thread::run(void *arg)
+{
+    Thread *thread = static_cast<Thread *>(arg);
+    t_thread = thread;
+    thread->m_id = GetThreadId();
+    SetThreadName(thread->m_name);
+    if (thread->m_numaNode >= 0)
+    {
+        SetPreferredNode(thread->m_numaNode);
+    }
+
+    std::function<void()> cb;
+    cb.swap(thread->m_cb);
+    // 通知之后构造函数返回，不能再访问thread
+    thread->m_semaphore.notify();
+    cb();
+    return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef __SYLAR_THREAD_H__
+#define __SYLAR_THREAD_H__
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cmutex.hpp"
+#include "noncopyable.h"
+
+namespace sylar
+{
+    /// @brief 线程的创建参数
+    struct ThreadAttr
+    {
+        /// 绑定的CPU编号，为空时不绑定
+        std::vector<int> cpus;
+        /// 为true时栈分配在所绑定的第一个CPU所在的NUMA节点上，
+        /// 线程之后分配的内存（包括malloc的线程arena）也优先使用该节点
+        bool numaLocal = false;
+        /// 栈大小，0表示使用系统默认值
+        size_t stackSize = 0;
+    };
+
+    /**
+     * @brief 线程
+     * @details 构造函数在新线程真正开始运行、设置好名称和tid后才返回。
+     *          可以在创建前绑定CPU，线程从第一条指令起就运行在指定的CPU上，
+     *          栈和线程局部数据按首次访问分配在本地NUMA节点
+     */
+    class Thread : Noncopyable
+    {
+    public:
+        typedef std::shared_ptr<Thread> ptr;
+
+        /// @brief 创建并启动线程
+        /// @param cb 线程执行函数
+        /// @param name 线程名称
+        /// @param attr 创建参数
+        Thread(std::function<void()> cb, const std::string &name, const ThreadAttr &attr = ThreadAttr());
+
+        /// @brief 析构，未join的线程会被detach；使用自定义栈的线程会先join再释放栈
+        ~Thread();
+
+        /// @brief 线程的内核tid，不需要系统调用
+        pid_t getId() const { return m_id; }
+
+        const std::string &getName() const { return m_name; }
+
+        /// @brief 线程绑定的NUMA节点，未开启numaLocal时为-1
+        int getNumaNode() const { return m_numaNode; }
+
+        /// @brief 等待线程结束
+        void join();
+
+        /// @brief 修改线程绑定的CPU
+        /// @return 成功返回true
+        bool setAffinity(const std::vector<int> &cpus);
+
+        /// @brief 当前线程对应的Thread对象，不是由Thread创建的线程返回nullptr
+        static Thread *GetThis();
+
+        /// @brief 当前线程的名称
+        static const std::string &GetName();
+
+        /// @brief 设置当前线程的名称
+        static void SetName(const std::string &name);
+
+        /// @brief 在线CPU数量
+        static int GetCpuCount();
+
+        /// @brief CPU所在的NUMA节点，无法确定时返回0
+        static int GetNumaNodeOfCpu(int cpu);
+
+    private:
+        /// @brief 线程入口
+        static void *run(void *arg);
+
+        /// @brief 在m_numaNode上分配栈，失败时返回false并使用默认栈
+        bool allocStack(size_t size);
+
+    private:
+        pid_t m_id = -1;
+        pthread_t m_thread = 0;
+        std::function<void()> m_cb;
+        std::string m_name;
+        int m_numaNode = -1;
+        /// 自定义栈，包含底部的保护页
+        void *m_stack = nullptr;
+        size_t m_stackSize = 0;
+        /// 新线程完成初始化后通知构造函数返回
+        Semaphore m_semaphore;
+    };
+}
+
+#endif
@@ -0,0 +1,220 @@
+#include "thread_pool.hpp"
+#include "util.h"
+
+namespace sylar
+{
+    static thread_local ThreadPool *t_pool = nullptr;
+    static thread_local int t_workerIndex = -1;
+    /// 选择窃取对象的随机数状态
+    static thread_local uint64_t t_random = 0;
+
+    /// 注入队列的容量，满时提交者让出CPU等待
+    static const size_t kInjectCapacity = 8192;
+
+    static inline uint64_t NextRandom()
+    {
+        uint64_t &state = t_random;
+        if (state == 0)
+        {
+            state = 0x9E3779B97F4A7C15ULL * (GetThreadId() | 1);
+        }
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+}
+
+void sylar::TaskCompletion::setDone()
+{
+    if (m_state.exchange(1, std::memory_order_acq_rel) == 2)
+    {
+        FutexWake(&m_state, INT32_MAX);
+    }
+}
+
+void sylar::TaskCompletion::wait()
+{
+    uint32_t state = m_state.load(std::memory_order_acquire);
+    while (state != 1)
+    {
+        if (state == 2 || m_state.compare_exchange_weak(state, 2, std::memory_order_acq_rel))
+        {
+            FutexWait(&m_state, 2, nullptr);
+        }
+        state = m_state.load(std::memory_order_acquire);
+    }
+}
+
+sylar::ThreadPool::ThreadPool(size_t threads, const std::string &name, bool pinThreads)
+    : m_inject(kInjectCapacity)
+{
+    int cpus = Thread::GetCpuCount();
+    if (threads == 0)
+    {
+        threads = cpus;
+    }
+    for (size_t i = 0; i < threads; ++i)
+    {
+        m_workers.emplace_back(new Worker);
+    }
+    for (size_t i = 0; i < threads; ++i)
+    {
+        ThreadAttr attr;
+        if (pinThreads)
+        {
+            attr.cpus.push_back(i % cpus);
+            attr.numaLocal = true;
+        }
+        m_threads.emplace_back(new Thread(std::bind(&ThreadPool::run, this, static_cast<int>(i)), name + "_" + std::to_string(i), attr));
+    }
+}
+
+sylar::ThreadPool::~ThreadPool()
+{
+    m_stopping.store(true, std::memory_order_release);
+    m_idle.notifyAll();
+    for (auto &i : m_threads)
+    {
+        i->join();
+    }
+}
+
+void sylar::ThreadPool::execute(Task task)
+{
+    push(new Task(std::move(task)));
+}
+
+sylar::ThreadPool *sylar::ThreadPool::GetThis()
+{
+    return t_pool;
+}
+
+int sylar::ThreadPool::GetWorkerIndex()
+{
+    return t_workerIndex;
+}
+
+void sylar::ThreadPool::push(Task *task)
+{
+    if (t_pool == this)
+    {
+        m_workers[t_workerIndex]->deque.push(task);
+    }
+    else
+    {
+        while (!m_inject.push(task))
+        {
+            std::this_thread::yield();
+        }
+    }
+    m_idle.notify();
+}
+
+sylar::ThreadPool::Task *sylar::ThreadPool::steal(int index)
+{
+    size_t count = m_workers.size();
+    if (count == 0)
+    {
+        return nullptr;
+    }
+    Task *task = nullptr;
+    // 从随机位置开始把其他线程都试一遍
+    size_t start = NextRandom() % count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t victim = (start + i) % count;
+        if (static_cast<int>(victim) != index && m_workers[victim]->deque.steal(task))
+        {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+sylar::ThreadPool::Task *sylar::ThreadPool::take(int index)
+{
+    Task *task = nullptr;
+    if (index >= 0 && m_workers[index]->deque.pop(task))
+    {
+        return task;
+    }
+    if (m_inject.pop(task))
+    {
+        return task;
+    }
+    return steal(index);
+}
+
+bool sylar::ThreadPool::runOne()
+{
+    Task *task = take(t_pool == this ? t_workerIndex : -1);
+    if (!task)
+    {
+        return false;
+    }
+    (*task)();
+    delete task;
+    return true;
+}
+
+bool sylar::ThreadPool::shouldSplit() const
+{
+    return t_pool != this || m_workers[t_workerIndex]->deque.empty();
+}
+
+bool sylar::ThreadPool::hasWork() const
+{
+    if (!m_inject.empty())
+    {
+        return true;
+    }
+    for (auto &i : m_workers)
+    {
+        if (!i->deque.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void sylar::ThreadPool::waitFor(TaskCompletion &done)
+{
+    while (!done.isDone())
+    {
+        if (!runOne())
+        {
+            // 剩下的任务都在其他线程手里执行，睡眠等待完成
+            done.wait();
+        }
+    }
+}
+
+void sylar::ThreadPool::run(int index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    while (true)
+    {
+        if (runOne())
+        {
+            continue;
+        }
+        // 登记为等待者后再检查一次，之后提交的任务一定会唤醒本线程
+        EventCount::Key key = m_idle.prepareWait();
+        if (hasWork())
+        {
+            m_idle.cancelWait();
+            continue;
+        }
+        if (m_stopping.load(std::memory_order_acquire))
+        {
+            m_idle.cancelWait();
+            break;
+        }
+        m_idle.wait(key);
+    }
+    t_pool = nullptr;
+    t_workerIndex = -1;
+}
@@ -0,0 +1,342 @@
+#ifndef __SYLAR_THREAD_POOL_H__
+#define __SYLAR_THREAD_POOL_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "cmutex.hpp"
+#include "event_count.hpp"
+#include "lockfree_queue.hpp"
+#include "noncopyable.h"
+#include "thread.hpp"
+
+namespace sylar
+{
+    class ThreadPool;
+
+    /// @brief 任务完成标志，0 未完成，1 已完成，2 未完成且有线程在等待
+    class TaskCompletion
+    {
+    public:
+        bool isDone() const { return m_state.load(std::memory_order_acquire) == 1; }
+
+        /// @brief 标记完成，有等待者时唤醒
+        void setDone();
+
+        /// @brief 在futex上等待完成
+        void wait();
+
+    private:
+        std::atomic<uint32_t> m_state{0};
+    };
+
+    /// @brief submit()返回的结果共享状态
+    template <class T>
+    struct TaskState
+    {
+        typedef typename std::conditional<std::is_void<T>::value, char, T>::type ValueType;
+
+        TaskCompletion done;
+        ValueType value{};
+        std::exception_ptr error;
+    };
+
+    /**
+     * @brief 轻量的future，只能get()一次
+     * @details 在线程池的工作线程中等待时，会先帮忙执行池中的其他任务，
+     *          嵌套提交任务再等待结果不会死锁
+     */
+    template <class T>
+    class TaskFuture
+    {
+    public:
+        TaskFuture() = default;
+        TaskFuture(ThreadPool *pool, std::shared_ptr<TaskState<T>> state) : m_pool(pool), m_state(std::move(state)) {}
+
+        bool valid() const { return m_state != nullptr; }
+
+        bool isReady() const { return m_state && m_state->done.isDone(); }
+
+        /// @brief 等待任务完成
+        void wait() const;
+
+        /// @brief 等待并返回结果，任务抛出的异常在这里重新抛出
+        T get();
+
+    private:
+        ThreadPool *m_pool = nullptr;
+        std::shared_ptr<TaskState<T>> m_state;
+    };
+
+    /**
+     * @brief 工作窃取线程池
+     * @details 每个工作线程有一个Chase-Lev双端队列，工作线程内提交的任务压入自己的队列，
+     *          外部线程提交的任务进入共享的注入队列。线程没有任务时先取注入队列，
+     *          再随机选择其他线程窃取，都失败后在EventCount上睡眠，提交任务时没有睡眠者不进入内核
+     */
+    class ThreadPool : Noncopyable
+    {
+    public:
+        typedef std::shared_ptr<ThreadPool> ptr;
+        typedef std::function<void()> Task;
+
+        /// @brief 创建线程池
+        /// @param threads 工作线程数，0表示CPU数
+        /// @param name 线程名前缀
+        /// @param pinThreads 为true时第i个线程绑定到第i % CPU数个CPU
+        ThreadPool(size_t threads = 0, const std::string &name = "pool", bool pinThreads = false);
+
+        /// @brief 执行完所有已提交的任务后停止
+        ~ThreadPool();
+
+        /// @brief 提交任务，不关心结果
+        void execute(Task task);
+
+        /// @brief 提交任务，返回future
+        template <class Func>
+        TaskFuture<std::invoke_result_t<Func>> submit(Func &&func);
+
+        /**
+         * @brief 并行执行 func(b, e)，[b, e) 覆盖 [begin, end)
+         * @details 惰性二分：线程每处理一个粒度前，如果自己的队列已经空了（说明其他线程可能在等待任务），
+         *          就把剩余区间的后一半作为任务压入队列供窃取，否则直接顺序处理。
+         *          调用线程参与计算，返回时所有区间都已处理完；第一个异常在这里重新抛出
+         * @param grain 最小粒度，0表示按线程数自动选择
+         */
+        template <class Func>
+        void parallelFor(size_t begin, size_t end, Func &&func, size_t grain = 0);
+
+        /**
+         * @brief 并行归约，结果为 reduce(identity, map(b0, e0), map(b1, e1), ...)
+         * @details reduce需要满足结合律和交换律，每个线程在自己的槽里累积，最后合并
+         */
+        template <class T, class Map, class Reduce>
+        T parallelReduce(size_t begin, size_t end, T identity, Map &&map, Reduce &&reduce, size_t grain = 0);
+
+        size_t getThreadCount() const { return m_threads.size(); }
+
+        /// @brief 等待完成标志，期间帮忙执行任务
+        void waitFor(TaskCompletion &done);
+
+        /// @brief 当前线程所属的线程池，不是工作线程时返回nullptr
+        static ThreadPool *GetThis();
+
+        /// @brief 当前线程在所属线程池中的编号，不是工作线程时返回-1
+        static int GetWorkerIndex();
+
+    private:
+        struct Worker
+        {
+            ChaseLevDeque<Task *> deque;
+        };
+
+        template <class Func>
+        struct ForContext
+        {
+            ForContext(Func &f, size_t g, size_t count) : func(f), grain(g), remaining(count) {}
+
+            Func &func;
+            size_t grain;
+            std::atomic<size_t> remaining;
+            TaskCompletion done;
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+        };
+
+        /// @brief 压入任务：工作线程压入自己的队列，其他线程压入注入队列
+        void push(Task *task);
+
+        /// @brief 取出一个任务，依次尝试本地队列、注入队列和窃取
+        Task *take(int index);
+
+        /// @brief 随机选择其他线程窃取
+        Task *steal(int index);
+
+        /// @brief 执行一个任务，没有任务时返回false
+        bool runOne();
+
+        /// @brief 当前线程是本池的工作线程且本地队列为空时返回true，外部线程总是返回true
+        bool shouldSplit() const;
+
+        /// @brief 是否还有未执行的任务
+        bool hasWork() const;
+
+        /// @brief 工作线程主函数
+        void run(int index);
+
+        template <class Func>
+        void runRange(ForContext<Func> *ctx, size_t begin, size_t end);
+
+        template <class Func>
+        static void finishRange(ForContext<Func> *ctx, size_t count);
+
+    private:
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::vector<Thread::ptr> m_threads;
+        /// 外部线程提交的任务
+        MPMCQueue<Task *> m_inject;
+        /// 空闲线程睡眠在这里
+        EventCount m_idle;
+        std::atomic<bool> m_stopping{false};
+    };
+
+    template <class T>
+    void TaskFuture<T>::wait() const
+    {
+        if (m_state->done.isDone())
+        {
+            return;
+        }
+        if (m_pool)
+        {
+            m_pool->waitFor(m_state->done);
+        }
+        else
+        {
+            m_state->done.wait();
+        }
+    }
+
+    template <class T>
+    T TaskFuture<T>::get()
+    {
+        wait();
+        std::shared_ptr<TaskState<T>> state = std::move(m_state);
+        if (state->error)
+        {
+            std::rethrow_exception(state->error);
+        }
+        if constexpr (!std::is_void<T>::value)
+        {
+            return std::move(state->value);
+        }
+    }
+
+    template <class Func>
+    TaskFuture<std::invoke_result_t<Func>> ThreadPool::submit(Func &&func)
+    {
+        typedef std::invoke_result_t<Func> ResultType;
+        std::shared_ptr<TaskState<ResultType>> state = std::make_shared<TaskState<ResultType>>();
+        push(new Task([state, func = std::forward<Func>(func)]() mutable
+                      {
+            try
+            {
+                if constexpr (std::is_void<ResultType>::value)
+                {
+                    func();
+                }
+                else
+                {
+                    state->value = func();
+                }
+            }
+            catch (...)
+            {
+                state->error = std::current_exception();
+            }
+            state->done.setDone(); }));
+        return TaskFuture<ResultType>(this, state);
+    }
+
+    template <class Func>
+    void ThreadPool::finishRange(ForContext<Func> *ctx, size_t count)
+    {
+        if (ctx->remaining.fetch_sub(count, std::memory_order_acq_rel) == count)
+        {
+            ctx->done.setDone();
+        }
+    }
+
+    template <class Func>
+    void ThreadPool::runRange(ForContext<Func> *ctx, size_t begin, size_t end)
+    {
+        while (begin < end)
+        {
+            size_t count = end - begin;
+            if (count > ctx->grain && shouldSplit())
+            {
+                size_t mid = begin + count / 2;
+                push(new Task([this, ctx, mid, end]()
+                              { runRange(ctx, mid, end); }));
+                end = mid;
+                continue;
+            }
+            size_t stop = count > ctx->grain ? begin + ctx->grain : end;
+            if (!ctx->failed.load(std::memory_order_relaxed))
+            {
+                try
+                {
+                    ctx->func(begin, stop);
+                }
+                catch (...)
+                {
+                    if (!ctx->failed.exchange(true))
+                    {
+                        ctx->error = std::current_exception();
+                    }
+                }
+            }
+            finishRange(ctx, stop - begin);
+            begin = stop;
+        }
+    }
+
+    template <class Func>
+    void ThreadPool::parallelFor(size_t begin, size_t end, Func &&func, size_t grain)
+    {
+        if (begin >= end)
+        {
+            return;
+        }
+        if (grain == 0)
+        {
+            grain = (end - begin) / (m_threads.size() * 8);
+            grain = grain ? grain : 1;
+        }
+        ForContext<Func> ctx(func, grain, end - begin);
+        runRange(&ctx, begin, end);
+        waitFor(ctx.done);
+        if (ctx.error)
+        {
+            std::rethrow_exception(ctx.error);
+        }
+    }
+
+    template <class T, class Map, class Reduce>
+    T ThreadPool::parallelReduce(size_t begin, size_t end, T identity, Map &&map, Reduce &&reduce, size_t grain)
+    {
+        struct alignas(kCacheLineSize) Partial
+        {
+            T value;
+        };
+        // 槽0给本池之外的线程使用，用锁保护；工作线程i使用槽i + 1
+        std::vector<Partial> partials(m_threads.size() + 1, Partial{identity});
+        Spinlock externalMutex;
+        parallelFor(begin, end, [&](size_t b, size_t e)
+                    {
+            T value = map(b, e);
+            if (GetThis() == this)
+            {
+                Partial &partial = partials[GetWorkerIndex() + 1];
+                partial.value = reduce(std::move(partial.value), std::move(value));
+            }
+            else
+            {
+                Spinlock::Lock lock(externalMutex);
+                partials[0].value = reduce(std::move(partials[0].value), std::move(value));
+            } }, grain);
+        T result = std::move(identity);
+        for (auto &i : partials)
+        {
+            result = reduce(std::move(result), std::move(i.value));
+        }
+        return result;
+    }
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <signal.h> // for kill()
 #include <sys/syscall.h>
 #include <sys/stat.h>
+#include <pthread.h>
 namespace sylar
 {
     uint64_t GetElapsedMS()
@@ -14,23 +15,125 @@ namespace sylar
         clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
         return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
     }
-    pid_t GetThreadId()
+
+    uint64_t GetCoarseMS()
     {
+        struct timespec ts = {0};
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+    static thread_local pid_t t_threadId = 0;
+    static thread_local bool t_threadNameCached = false;
+    static thread_local std::string t_threadName;
 
-        return syscall(SYS_gettid);
+    /// @brief fork出的子进程中只剩调用fork的线程，它的tid已经变化，清掉缓存
+    static void ResetThreadIdAfterFork()
+    {
+        t_threadId = 0;
     }
-    std::string GetThreadName()
+
+    pid_t GetThreadId()
+    {
+        if (t_threadId == 0)
+        {
+            static int s_atfork = pthread_atfork(nullptr, nullptr, &ResetThreadIdAfterFork);
+            (void)s_atfork;
+            t_threadId = syscall(SYS_gettid);
+        }
+        return t_threadId;
+    }
+    const std::string &GetThreadName()
     {
-        char thread_name[16] = {0};
-        pthread_getname_np(pthread_self(), thread_name, 16);
-        return std::string(thread_name);
+        if (!t_threadNameCached)
+        {
+            char thread_name[16] = {0};
+            pthread_getname_np(pthread_self(), thread_name, 16);
+            t_threadName = thread_name;
+            t_threadNameCached = true;
+        }
+        return t_threadName;
     }
     void SetThreadName(const std::string &name)
     {
-        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        // 内核只保留15个字节，缓存截断后的名字，和pthread_getname_np保持一致
+        t_threadName = name.substr(0, 15);
+        pthread_setname_np(pthread_self(), t_threadName.c_str());
+        t_threadNameCached = true;
     }
+    static thread_local uint64_t t_fiberId = 0;
+
     uint64_t GetFiberId()
     {
-        return 0;
+        return t_fiberId;
+    }
+    void SetFiberId(uint64_t id)
+    {
+        t_fiberId = id;
+    }
+
+    static const uint64_t kHashPrime1 = 0x9E3779B185EBCA87ULL;
+    static const uint64_t kHashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    static const uint64_t kHashPrime3 = 0x165667B19E3779F9ULL;
+
+    static inline uint64_t HashRotl(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static inline uint64_t HashRound(uint64_t acc, uint64_t input)
+    {
+        acc += input * kHashPrime2;
+        acc = HashRotl(acc, 31);
+        return acc * kHashPrime1;
+    }
+
+    uint64_t HashBytes(const void *data, size_t len, uint64_t seed)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        const uint8_t *end = p + len;
+        uint64_t h;
+        if (len >= 32)
+        {
+            uint64_t lanes[4] = {seed + kHashPrime1 + kHashPrime2, seed + kHashPrime2, seed, seed - kHashPrime1};
+            do
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    uint64_t w;
+                    memcpy(&w, p + i * 8, 8);
+                    lanes[i] = HashRound(lanes[i], w);
+                }
+                p += 32;
+            } while (end - p >= 32);
+            h = HashRotl(lanes[0], 1) + HashRotl(lanes[1], 7) + HashRotl(lanes[2], 12) + HashRotl(lanes[3], 18);
+        }
+        else
+        {
+            h = seed + kHashPrime3;
+        }
+        h += len;
+
+        while (end - p >= 8)
+        {
+            uint64_t w;
+            memcpy(&w, p, 8);
+            h ^= HashRound(0, w);
+            h = HashRotl(h, 27) * kHashPrime1 + kHashPrime2;
+            p += 8;
+        }
+        while (p < end)
+        {
+            h ^= (*p) * kHashPrime3;
+            h = HashRotl(h, 11) * kHashPrime1;
+            ++p;
+        }
+
+        // 最终混淆，让每个输入位都影响输出的所有位
+        h ^= h >> 33;
+        h *= kHashPrime2;
+        h ^= h >> 29;
+        h *= kHashPrime3;
+        h ^= h >> 32;
+        return h;
     }
 }
\ No newline at end of file
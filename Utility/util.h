@@ -14,14 +14,33 @@ namespace sylar
     /// @return
     uint64_t GetElapsedMS();
 
-    pid_t GetThreadId();
-
+    /// @brief 返回粗粒度的单调时钟，单位毫秒
+    /// @details 读取内核在每个时钟中断更新的缓存时间（CLOCK_MONOTONIC_COARSE），通过vDSO只需一次内存读取，
+    ///          精度是一个时钟节拍（1~4ms），适合超时判断这类频繁调用又不要求精确的场景
+    uint64_t GetCoarseMS();
 
-    std::string GetThreadName();
+    /// @brief 返回当前线程的内核线程id
+    /// @details 第一次调用时通过系统调用获取并缓存在线程局部变量中，之后不再进入内核
+    pid_t GetThreadId();
 
+    /// @brief 返回当前线程的名称，同样缓存在线程局部变量中
+    const std::string &GetThreadName();
 
+    /// @brief 设置当前线程的名称，系统中的名称最多保留15个字符，GetThreadName()返回截断后的名称
     void SetThreadName(const std::string &name);
 
+    /// @brief 返回当前协程的id，不在协程中运行时返回0
     uint64_t GetFiberId();
+
+    /// @brief 设置当前线程上正在运行的协程id，由协程切换时调用
+    void SetFiberId(uint64_t id);
+
+    /// @brief 计算一段内存的64位哈希值
+    /// @details 每轮处理32字节，4条相互独立的计算通道便于编译器向量化，适合在热路径上比较日志内容
+    /// @param data 数据起始地址
+    /// @param len 数据长度
+    /// @param seed 哈希种子
+    /// @return 哈希值
+    uint64_t HashBytes(const void *data, size_t len, uint64_t seed = 0);
 }
 #endif
\ No newline at end of file
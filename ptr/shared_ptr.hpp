@@ -4,16 +4,49 @@
 #include <utility>
 #include <type_traits>
 #include <atomic>
+#include <cassert>
+// 控制块从ObjectPool分配，使用本头文件要链接Utility库（CMake目标ptr）
+#include "../Utility/object_pool.hpp"
+
+/// 删除器，默认delete
+template <typename T>
+void SpDefaultDelete(T *ptr)
+{
+    delete ptr;
+}
+
+/// 控制块大小固定、创建销毁频繁，从对象池分配；不能被继承，new的大小总是sizeof(SpControlBlock)
 template <typename T>
-struct SpControlBlock
+struct SpControlBlock final
 {
+    typedef void (*Deleter)(T *);
+
     T *ptr;
     std::atomic<int> refCount;
+    Deleter deleter;
 
-    explicit SpControlBlock(T *ptr) : ptr(ptr), refCount(1) {};
+    explicit SpControlBlock(T *ptr, Deleter deleter = &SpDefaultDelete<T>) : ptr(ptr), refCount(1), deleter(deleter) {};
     ~SpControlBlock()
     {
-        delete ptr;
+        deleter(ptr);
+    }
+
+    static void *operator new(size_t size)
+    {
+        // 池的槽位按sizeof(SpControlBlock)切分
+        assert(size == sizeof(SpControlBlock));
+        (void)size;
+        void *p = sylar::ObjectPool<SpControlBlock>::Instance().allocate();
+        if (!p)
+        {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    static void operator delete(void *p)
+    {
+        sylar::ObjectPool<SpControlBlock>::Instance().deallocate(p);
     }
 
     void incRefCount()
@@ -23,7 +56,8 @@ struct SpControlBlock
 
     void decRefCount()
     {
-        if (refCount.fetch_sub(1,std::memory_order_relaxed) == 1)
+        // 释放前要看到其他线程对对象的全部修改
+        if (refCount.fetch_sub(1,std::memory_order_acq_rel) == 1)
         {
             delete this;
         }
@@ -37,6 +71,9 @@ struct shared_ptr
 
     explicit shared_ptr(T *ptr) : m_cb(new SpControlBlock<T>(ptr)) {}
 
+    /// 自定义删除器，例如把对象还给对象池
+    shared_ptr(T *ptr, typename SpControlBlock<T>::Deleter deleter) : m_cb(new SpControlBlock<T>(ptr, deleter)) {}
+
     shared_ptr(const shared_ptr &other) : m_cb(other.m_cb)
     {
         m_cb->incRefCount();
@@ -68,4 +105,17 @@ shared_ptr<T> make_shared(Args &&...args)
 {
     return shared_ptr<T>(new T(std::forward<Args>(args)...));
 }
+
+template <class T>
+void SpPoolDelete(T *ptr)
+{
+    sylar::ObjectPool<T>::Instance().destroy(ptr);
+}
+
+/// 对象和控制块都从对象池分配
+template <class T, class... Args>
+shared_ptr<T> make_pooled_shared(Args &&...args)
+{
+    return shared_ptr<T>(sylar::ObjectPool<T>::Instance().create(std::forward<Args>(args)...), &SpPoolDelete<T>);
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include "../Logger/log.hpp"
+#include "../Utility/alloc.hpp"
+#include "../Utility/lockfree_queue.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// 同一份源码编译成bench_alloc和bench_alloc_override，后者链接了alloc_override.cc，全局new/delete使用sylar::Alloc
+
+/// 每个线程的分配次数，可以通过第一个命令行参数指定
+static int kOps = 1000000;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct MallocApi
+{
+    static const char *Name() { return "malloc"; }
+    static void *Allocate(size_t size) { return malloc(size); }
+    static void Deallocate(void *ptr) { free(ptr); }
+};
+
+struct SylarApi
+{
+    static const char *Name() { return "sylar::Alloc"; }
+    static void *Allocate(size_t size) { return sylar::Alloc::Allocate(size); }
+    static void Deallocate(void *ptr) { sylar::Alloc::Deallocate(ptr); }
+};
+
+/// @brief 16~512字节的伪随机大小
+static size_t NextSize(uint32_t &state)
+{
+    state = state * 1664525 + 1013904223;
+    return 16 + (state >> 8) % 497;
+}
+
+/// @brief 每个线程在本线程分配一批再释放
+template <class Api>
+static void BenchLocal(size_t threads)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([t]()
+                             {
+            uint32_t state = t + 1;
+            void *ptrs[64];
+            for (int i = 0; i < kOps; i += 64)
+            {
+                for (int j = 0; j < 64; ++j)
+                {
+                    ptrs[j] = Api::Allocate(NextSize(state));
+                    *static_cast<char *>(ptrs[j]) = 1;
+                }
+                for (int j = 0; j < 64; ++j)
+                {
+                    Api::Deallocate(ptrs[j]);
+                }
+            } });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    double seconds = Seconds(start);
+    std::cout << std::left << std::setw(14) << Api::Name() << "local      threads=" << std::setw(3) << threads << std::right
+              << std::fixed << std::setprecision(1) << std::setw(8) << threads * kOps / seconds / 1e6 << " M alloc+free/s" << std::endl;
+}
+
+/// @brief 生产者线程分配，经SPSC队列交给消费者线程释放，pairs对生产者消费者
+template <class Api>
+static void BenchCrossThread(size_t pairs)
+{
+    std::vector<std::unique_ptr<sylar::SPSCQueue<void *>>> queues;
+    for (size_t i = 0; i < pairs; ++i)
+    {
+        queues.emplace_back(new sylar::SPSCQueue<void *>(4096));
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t p = 0; p < pairs; ++p)
+    {
+        sylar::SPSCQueue<void *> *queue = queues[p].get();
+        workers.emplace_back([queue, p]()
+                             {
+            uint32_t state = p + 1;
+            for (int i = 0; i < kOps; ++i)
+            {
+                void *ptr = Api::Allocate(NextSize(state));
+                *static_cast<char *>(ptr) = 1;
+                while (!queue->push(ptr))
+                {
+                    std::this_thread::yield();
+                }
+            } });
+        workers.emplace_back([queue]()
+                             {
+            void *ptr;
+            for (int i = 0; i < kOps; ++i)
+            {
+                while (!queue->pop(ptr))
+                {
+                    std::this_thread::yield();
+                }
+                Api::Deallocate(ptr);
+            } });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    double seconds = Seconds(start);
+    std::cout << std::left << std::setw(14) << Api::Name() << "cross      pairs=  " << std::setw(3) << pairs << std::right
+              << std::fixed << std::setprecision(1) << std::setw(8) << pairs * kOps / seconds / 1e6 << " M alloc+free/s" << std::endl;
+}
+
+class NullLogAppender : public sylar::LogAppender
+{
+public:
+    NullLogAppender() : sylar::LogAppender(sylar::LogFormatter::ptr(new sylar::LogFormatter)) {}
+    void write(sylar::LogEvent::ptr, const std::string &) override {}
+    std::string toYamlString() override { return std::string(); }
+};
+
+/**
+ * @brief 日志路径：LogEvent和stringstream的缓冲区在生产者线程分配，在AsyncLogAppender的工作线程释放
+ */
+static void BenchLogging(size_t threads)
+{
+    sylar::Logger::ptr logger(new sylar::Logger("bench"));
+    sylar::AsyncLogAppender::ptr async(new sylar::AsyncLogAppender(sylar::LogAppender::ptr(new NullLogAppender), 2));
+    logger->addAppender(async);
+    const int events = kOps / 10;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&logger, events]()
+                             {
+            for (int i = 0; i < events; ++i)
+            {
+                SYLAR_LOG_INFO(logger) << "alloc benchmark message " << i << " value=" << i * 3.14;
+            } });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    async->flush();
+    double seconds = Seconds(start);
+#ifdef SYLAR_BENCH_ALLOC_OVERRIDE
+    const char *name = "new=Alloc";
+#else
+    const char *name = "new=glibc";
+#endif
+    std::cout << std::left << std::setw(14) << name << "logging    threads=" << std::setw(3) << threads << std::right
+              << std::fixed << std::setprecision(1) << std::setw(8) << threads * events / seconds / 1e3 << " K events/s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kOps = atoi(argv[1]);
+    }
+    for (size_t threads : {1, 4, 16})
+    {
+        BenchLocal<MallocApi>(threads);
+        BenchLocal<SylarApi>(threads);
+    }
+    for (size_t pairs : {1, 4, 8})
+    {
+        BenchCrossThread<MallocApi>(pairs);
+        BenchCrossThread<SylarApi>(pairs);
+    }
+    for (size_t threads : {1, 4, 16})
+    {
+        BenchLogging(threads);
+    }
+    sylar::Alloc::Stats stats = sylar::Alloc::GetStats();
+    std::cout << "spans=" << stats.spans << " in use=" << stats.spansInUse << " free=" << stats.freeSpans
+              << " transfer objects=" << stats.transferObjects << std::endl;
+    return 0;
+}
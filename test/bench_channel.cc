@@ -0,0 +1,156 @@
+#include "../Fiber/channel.hpp"
+#include "../Fiber/scheduler.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <thread>
+
+/// 往返次数，可以通过第一个命令行参数指定
+static int kRounds = 200000;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char *name, int rounds, double seconds)
+{
+    std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(0) << std::setw(8)
+              << seconds * 1e9 / rounds << " ns/round trip" << std::endl;
+}
+
+/// @brief 原来流水线各级之间传递任务的方式：链表+互斥量+信号量，等待时阻塞线程
+template <class T>
+class ListQueue
+{
+public:
+    void push(T value)
+    {
+        {
+            sylar::Mutex::Lock lock(m_mutex);
+            m_list.push_back(std::move(value));
+        }
+        m_sem.notify();
+    }
+
+    T pop()
+    {
+        m_sem.wait();
+        sylar::Mutex::Lock lock(m_mutex);
+        T value = std::move(m_list.front());
+        m_list.pop_front();
+        return value;
+    }
+
+private:
+    sylar::Mutex m_mutex;
+    sylar::Semaphore m_sem;
+    std::list<T> m_list;
+};
+
+/// @brief 两个协程通过一对通道来回传一个值
+static void BenchChannel(const char *name, size_t threads, size_t capacity)
+{
+    sylar::Channel<int> ping(capacity);
+    sylar::Channel<int> pong(capacity);
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(threads, false, "pingpong");
+        sc.start();
+        sc.schedule([&]()
+                    {
+            int v;
+            while (ping.recv(v))
+            {
+                pong.send(v + 1);
+            } });
+        sc.schedule([&]()
+                    {
+            int v = 0;
+            for (int i = 0; i < kRounds; ++i)
+            {
+                ping.send(v);
+                pong.recv(v);
+            }
+            ping.close(); });
+        sc.stop();
+    }
+    Report(name, kRounds, Seconds(start));
+}
+
+/// @brief 同样的往返用select接收
+static void BenchSelect(const char *name)
+{
+    sylar::Channel<int> ping;
+    sylar::Channel<int> pong;
+    sylar::Channel<int> quit;
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(1, false, "select");
+        sc.start();
+        sc.schedule([&]()
+                    {
+            int v = 0;
+            int q = 0;
+            sylar::Select sel;
+            sel.recv(ping, v).recv(quit, q);
+            while (sel.wait() == 0)
+            {
+                pong.send(v + 1);
+            } });
+        sc.schedule([&]()
+                    {
+            int v = 0;
+            for (int i = 0; i < kRounds; ++i)
+            {
+                ping.send(v);
+                pong.recv(v);
+            }
+            quit.close(); });
+        sc.stop();
+    }
+    Report(name, kRounds, Seconds(start));
+}
+
+/// @brief 两个线程通过一对ListQueue来回传一个值
+static void BenchListQueue(const char *name)
+{
+    ListQueue<int> ping;
+    ListQueue<int> pong;
+    auto start = std::chrono::steady_clock::now();
+    std::thread echo([&]()
+                     {
+        while (true)
+        {
+            int v = ping.pop();
+            if (v < 0)
+            {
+                break;
+            }
+            pong.push(v + 1);
+        } });
+    int v = 0;
+    for (int i = 0; i < kRounds; ++i)
+    {
+        ping.push(v);
+        v = pong.pop();
+    }
+    ping.push(-1);
+    echo.join();
+    Report(name, kRounds, Seconds(start));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kRounds = atoi(argv[1]);
+    }
+    BenchChannel("Channel unbuffered, 1 thread", 1, 0);
+    BenchChannel("Channel buffered(1), 1 thread", 1, 1);
+    BenchChannel("Channel unbuffered, 2 threads", 2, 0);
+    BenchSelect("Select unbuffered, 1 thread");
+    BenchListQueue("list+Mutex+Semaphore, 2 threads");
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "../Utility/event_count.hpp"
+#include "../Utility/parking_lot.hpp"
+#include "../Utility/cmutex.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+/// 循环次数，可以通过第一个命令行参数指定
+static int kIterations = 1000000;
+
+template <class Func>
+static void BenchNotify(const char *name, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i)
+    {
+        func();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / kIterations;
+    std::cout << std::left << std::setw(28) << name << std::fixed << std::setprecision(1) << ns << " ns/op" << std::endl;
+}
+
+/// @brief 多个消费者在EventCount上等待一个递增的计数，生产者逐个递增并唤醒
+static void TestEventCount(int consumers)
+{
+    sylar::EventCount ec;
+    std::atomic<int> available{0};
+    std::atomic<int> consumed{0};
+    const int total = kIterations / 10;
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&]()
+                             {
+            while (true)
+            {
+                bool stop = false;
+                ec.await([&]()
+                         {
+                    int n = available.load(std::memory_order_acquire);
+                    while (n > 0)
+                    {
+                        if (available.compare_exchange_weak(n, n - 1, std::memory_order_acq_rel))
+                        {
+                            return true;
+                        }
+                    }
+                    stop = n < 0;
+                    return stop; });
+                if (stop)
+                {
+                    return;
+                }
+                consumed.fetch_add(1, std::memory_order_relaxed);
+            } });
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < total; ++i)
+    {
+        available.fetch_add(1, std::memory_order_release);
+        ec.notify();
+    }
+    while (consumed.load(std::memory_order_relaxed) < total)
+    {
+        std::this_thread::yield();
+    }
+    auto end = std::chrono::steady_clock::now();
+    available.store(-1, std::memory_order_release);
+    ec.notifyAll();
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / total;
+    std::cout << "EventCount hand-off consumers=" << consumers << " " << std::fixed << std::setprecision(1) << ns << " ns/item" << std::endl;
+}
+
+/// @brief 用WaitOnAddress/WakeByAddress实现的屏障，校验每一轮所有线程都被唤醒
+static void TestParkingLot(int threads)
+{
+    std::atomic<uint64_t> generation{0};
+    std::atomic<int> arrived{0};
+    const int rounds = kIterations / 1000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+                             {
+            for (int r = 0; r < rounds; ++r)
+            {
+                uint64_t gen = generation.load(std::memory_order_acquire);
+                if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == threads)
+                {
+                    arrived.store(0, std::memory_order_relaxed);
+                    generation.fetch_add(1, std::memory_order_acq_rel);
+                    sylar::WakeByAddress(generation);
+                }
+                else
+                {
+                    sylar::WaitOnAddress(generation, gen);
+                }
+            } });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    std::cout << "ParkingLot barrier threads=" << threads << " rounds=" << rounds
+              << (generation.load() == uint64_t(rounds) ? " ok" : " FAILED") << std::endl;
+
+    int dummy = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto result = sylar::ParkingLot::Park(&dummy, []()
+                                          { return true; }, 20);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "ParkingLot timeout " << (result == sylar::ParkingLot::TIMEOUT ? "ok" : "FAILED") << " after " << ms << "ms" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kIterations = atoi(argv[1]);
+    }
+    std::cout << "== notify without waiters ==" << std::endl;
+    sylar::Semaphore sem;
+    sylar::FutexSemaphore futexSem;
+    sylar::EventCount ec;
+    int key = 0;
+    BenchNotify("Semaphore::notify", [&]()
+                { sem.notify(); });
+    BenchNotify("FutexSemaphore::notify", [&]()
+                { futexSem.notify(); });
+    BenchNotify("EventCount::notify", [&]()
+                { ec.notify(); });
+    BenchNotify("ParkingLot::Unpark", [&]()
+                { sylar::ParkingLot::Unpark(&key); });
+
+    std::cout << "== blocking ==" << std::endl;
+    TestEventCount(1);
+    TestEventCount(4);
+    TestParkingLot(2);
+    TestParkingLot(8);
+    return 0;
+}
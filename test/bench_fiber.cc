@@ -0,0 +1,117 @@
+#include "../Fiber/fiber.hpp"
+#include <ucontext.h>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+/// 切换次数，可以通过第一个命令行参数指定
+static int kIterations = 1000000;
+
+static void Report(const char *name, std::chrono::steady_clock::time_point start, int switches)
+{
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / switches;
+    std::cout << std::left << std::setw(24) << name << std::fixed << std::setprecision(1) << ns << " ns/switch" << std::endl;
+}
+
+/// @brief resume + yield 往返，每次往返两次切换
+static void BenchFiber()
+{
+    sylar::Fiber::GetThis();
+    sylar::Fiber::ptr fiber(new sylar::Fiber([]()
+                                             {
+        for (int i = 0; i < kIterations; ++i)
+        {
+            sylar::Fiber::GetThis()->yield();
+        } }));
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i)
+    {
+        fiber->resume();
+    }
+    Report("Fiber resume/yield", start, kIterations * 2);
+    // 让协程执行完，释放它持有的自身引用
+    fiber->resume();
+}
+
+/// @brief 只测汇编上下文切换本身
+static sylar::FiberContext s_mainCtx;
+static sylar::FiberContext s_peerCtx;
+
+static void PeerEntry(void *)
+{
+    while (true)
+    {
+        sylar::SwitchFiberContext(&s_peerCtx, s_mainCtx);
+    }
+}
+
+static void BenchRawContext()
+{
+    size_t size = 64 * 1024;
+    char *stack = new char[size];
+    s_peerCtx = sylar::MakeFiberContext(stack, size, &PeerEntry, nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i)
+    {
+        sylar::SwitchFiberContext(&s_mainCtx, s_peerCtx);
+    }
+    Report("SwitchFiberContext", start, kIterations * 2);
+    delete[] stack;
+}
+
+/// @brief 对照组：ucontext，每次swapcontext都会调用sigprocmask
+static ucontext_t s_mainUctx;
+static ucontext_t s_peerUctx;
+
+static void PeerUcontext()
+{
+    while (true)
+    {
+        swapcontext(&s_peerUctx, &s_mainUctx);
+    }
+}
+
+static void BenchUcontext()
+{
+    size_t size = 64 * 1024;
+    char *stack = new char[size];
+    getcontext(&s_peerUctx);
+    s_peerUctx.uc_stack.ss_sp = stack;
+    s_peerUctx.uc_stack.ss_size = size;
+    s_peerUctx.uc_link = nullptr;
+    makecontext(&s_peerUctx, &PeerUcontext, 0);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i)
+    {
+        swapcontext(&s_mainUctx, &s_peerUctx);
+    }
+    Report("ucontext swapcontext", start, kIterations * 2);
+    delete[] stack;
+}
+
+/// @brief 创建、运行到结束、销毁一个协程的开销
+static void BenchCreate()
+{
+    int count = kIterations / 10;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        sylar::Fiber::ptr fiber(new sylar::Fiber([]() {}));
+        fiber->resume();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+    std::cout << std::left << std::setw(24) << "Fiber create+run" << std::fixed << std::setprecision(1) << ns << " ns/fiber" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kIterations = atoi(argv[1]);
+    }
+    BenchRawContext();
+    BenchFiber();
+    BenchUcontext();
+    BenchCreate();
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include "../Fiber/fiber.hpp"
+#include "../Fiber/stack_allocator.hpp"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+/// 同时存在的协程数，可以通过第一个命令行参数指定。带保护页时每个栈占两个VMA，注意vm.max_map_count
+static int kFibers = 20000;
+/// 分配释放循环次数
+static const int kChurn = 1000000;
+static const size_t kStackSize = 128 * 1024;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// @brief 当前进程的常驻内存，MB
+static double RssMB()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t size, resident;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+/// @brief 模拟协程只用到栈顶附近：写栈顶的2KB
+static void TouchTop(void *stack, size_t size)
+{
+    memset((char *)stack + size - 2048, 1, 2048);
+    // 防止编译器把malloc/free整个优化掉
+    asm volatile("" : : "r"(stack) : "memory");
+}
+
+/// @brief 反复分配释放同一大小的栈
+static void BenchChurn()
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kChurn; ++i)
+    {
+        void *stack = malloc(kStackSize);
+        TouchTop(stack, kStackSize);
+        free(stack);
+    }
+    std::cout << std::left << std::setw(28) << "malloc/free churn" << std::fixed << std::setprecision(1)
+              << Seconds(start) * 1e9 / kChurn << " ns/op" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kChurn; ++i)
+    {
+        void *stack = sylar::FiberStackPool::Alloc(kStackSize);
+        TouchTop(stack, kStackSize);
+        sylar::FiberStackPool::Dealloc(stack, kStackSize);
+    }
+    std::cout << std::left << std::setw(28) << "pool alloc/dealloc churn" << std::fixed << std::setprecision(1)
+              << Seconds(start) * 1e9 / kChurn << " ns/op" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kChurn; ++i)
+    {
+        sylar::Fiber::ptr fiber(new sylar::Fiber([]() {}));
+        fiber->resume();
+    }
+    std::cout << std::left << std::setw(28) << "fiber create/run/destroy" << std::fixed << std::setprecision(1)
+              << Seconds(start) * 1e9 / kChurn << " ns/op" << std::endl;
+}
+
+/// @brief kFibers个栈同时存在，统计分配耗时和常驻内存
+static void BenchConcurrent()
+{
+    std::vector<void *> stacks(kFibers);
+    double rss = RssMB();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kFibers; ++i)
+    {
+        stacks[i] = malloc(kStackSize);
+        TouchTop(stacks[i], kStackSize);
+    }
+    std::cout << std::left << std::setw(28) << "malloc stacks" << kFibers << " x 128KB: " << std::fixed << std::setprecision(1)
+              << Seconds(start) * 1e3 << " ms, rss +" << RssMB() - rss << " MB" << std::endl;
+    for (int i = 0; i < kFibers; ++i)
+    {
+        free(stacks[i]);
+    }
+
+    sylar::FiberStackPool::Trim();
+    rss = RssMB();
+    start = std::chrono::steady_clock::now();
+    std::vector<sylar::Fiber::ptr> fibers(kFibers);
+    for (int i = 0; i < kFibers; ++i)
+    {
+        fibers[i].reset(new sylar::Fiber([]()
+                                         {
+            volatile char buf[2048];
+            memset((char *)buf, 1, sizeof(buf));
+            sylar::Fiber::GetThis()->yield(); }));
+        fibers[i]->resume();
+    }
+    sylar::FiberStackPool::Stats stats = sylar::FiberStackPool::GetStats();
+    std::cout << std::left << std::setw(28) << "pooled fibers" << kFibers << " x 128KB: " << std::fixed << std::setprecision(1)
+              << Seconds(start) * 1e3 << " ms, rss +" << RssMB() - rss << " MB, mapped " << stats.mappedBytes / 1048576 << " MB"
+              << ", high water " << fibers[0]->getStackHighWaterMark() << " bytes" << std::endl;
+    for (auto &i : fibers)
+    {
+        i->resume();
+    }
+    fibers.clear();
+    stats = sylar::FiberStackPool::GetStats();
+    std::cout << "after destroy: rss " << RssMB() << " MB, mapped stacks " << stats.mappedStacks << ", depot " << stats.depotStacks << std::endl;
+}
+
+/// @brief 开启哨兵，统计不同递归深度的栈使用量
+static int Recurse(int depth)
+{
+    volatile char buf[256];
+    buf[0] = depth;
+    return depth ? Recurse(depth - 1) + buf[0] : 0;
+}
+
+static void BenchHighWater()
+{
+    sylar::FiberStackPool::Trim();
+    sylar::FiberStackPool::SetCanary(true);
+    for (int depth : {10, 100, 300})
+    {
+        sylar::Fiber::ptr fiber(new sylar::Fiber([depth]()
+                                                 { Recurse(depth); }));
+        fiber->resume();
+        std::cout << "recursion depth " << std::setw(4) << depth << ": stack high water " << fiber->getStackHighWaterMark() << " bytes" << std::endl;
+    }
+    std::cout << "max high water of released stacks " << sylar::FiberStackPool::GetStats().maxHighWater << " bytes" << std::endl;
+    sylar::FiberStackPool::SetCanary(false);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kFibers = atoi(argv[1]);
+    }
+    sylar::Fiber::GetThis();
+    BenchChurn();
+    BenchConcurrent();
+    BenchHighWater();
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include "../Fiber/fiber_sync.hpp"
+#include "../Fiber/scheduler.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+/// 协程数
+static const int kFibers = 10000;
+/// 每个协程加锁次数，可以通过第一个命令行参数指定
+static int kLoops = 100;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief kFibers个协程竞争同一把锁，两次加锁之间yield一次
+ * @param yieldInside 在临界区内yield（模拟持锁做IO），线程锁在这种情况下会阻塞整个线程乃至死锁，只测协程锁
+ */
+template <class MutexType>
+static void Bench(const char *name, size_t threads, bool yieldInside)
+{
+    MutexType mutex;
+    uint64_t counter = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(threads, false, "bench");
+        sc.start();
+        for (int i = 0; i < kFibers; ++i)
+        {
+            sc.schedule([&mutex, &counter, yieldInside]()
+                        {
+                sylar::Scheduler *sched = sylar::Scheduler::GetThis();
+                sylar::Fiber::ptr self = sylar::Fiber::GetThis();
+                for (int j = 0; j < kLoops; ++j)
+                {
+                    {
+                        typename MutexType::Lock lock(mutex);
+                        ++counter;
+                        if (yieldInside)
+                        {
+                            sched->schedule(self);
+                            self->yield();
+                        }
+                    }
+                    sched->schedule(self);
+                    self->yield();
+                } });
+        }
+        sc.stop();
+    }
+    double seconds = Seconds(start);
+    std::cout << std::left << std::setw(28) << name << "threads=" << std::setw(3) << threads << std::right << std::fixed
+              << std::setprecision(2) << std::setw(8) << counter / seconds / 1e6 << " M locks/s" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kLoops = atoi(argv[1]);
+    }
+    int cpus = sylar::Thread::GetCpuCount();
+    size_t maxThreads = cpus < 4 ? 4 : cpus;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        Bench<sylar::Mutex>("Mutex", threads, false);
+        Bench<sylar::FutexMutex>("FutexMutex", threads, false);
+        Bench<sylar::FiberMutex>("FiberMutex", threads, false);
+        Bench<sylar::FiberMutex>("FiberMutex yield inside", threads, true);
+    }
+    return 0;
+}
@@ -0,0 +1,280 @@
+#include "../Fiber/iomanager.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/// 并发的客户端协程数
+static int kClients = 64;
+/// 每个客户端的请求数，可以通过第一个命令行参数指定
+static int kRequests = 2000;
+/// 每个客户端建立的短连接数
+static int kConnections = 100;
+/// 请求大小
+static const size_t kMessageSize = 64;
+
+static void SetNonBlock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/// @brief 等待fd上的事件，挂起当前协程直到事件就绪
+static bool WaitEvent(int fd, sylar::IOManager::Event event)
+{
+    if (sylar::IOManager::GetThis()->addEvent(fd, event))
+    {
+        return false;
+    }
+    sylar::Fiber::GetThis()->yield();
+    return true;
+}
+
+/// @brief 读满len字节，对端关闭或出错返回false
+static bool ReadFull(int fd, char *buf, size_t len)
+{
+    size_t off = 0;
+    while (off < len)
+    {
+        ssize_t n = read(fd, buf + off, len - off);
+        if (n > 0)
+        {
+            off += n;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            if (!WaitEvent(fd, sylar::IOManager::READ))
+            {
+                return false;
+            }
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool WriteFull(int fd, const char *buf, size_t len)
+{
+    size_t off = 0;
+    while (off < len)
+    {
+        ssize_t n = write(fd, buf + off, len - off);
+        if (n >= 0)
+        {
+            off += n;
+        }
+        else if (errno == EAGAIN)
+        {
+            if (!WaitEvent(fd, sylar::IOManager::WRITE))
+            {
+                return false;
+            }
+        }
+        else if (errno != EINTR)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int Connect(const sockaddr_in &addr)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    SetNonBlock(fd);
+    int rt = connect(fd, (const sockaddr *)&addr, sizeof(addr));
+    if (rt && errno == EINPROGRESS)
+    {
+        WaitEvent(fd, sylar::IOManager::WRITE);
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len);
+        rt = error ? -1 : 0;
+    }
+    if (rt)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/// @brief 回显服务器，每个连接一个协程
+class EchoServer
+{
+public:
+    EchoServer(sylar::IOManager *iom)
+        : m_iom(iom)
+    {
+        m_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        memset(&m_addr, 0, sizeof(m_addr));
+        m_addr.sin_family = AF_INET;
+        m_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        m_addr.sin_port = 0;
+        bind(m_fd, (sockaddr *)&m_addr, sizeof(m_addr));
+        socklen_t len = sizeof(m_addr);
+        getsockname(m_fd, (sockaddr *)&m_addr, &len);
+        listen(m_fd, 4096);
+        SetNonBlock(m_fd);
+        m_iom->schedule(std::bind(&EchoServer::acceptLoop, this));
+    }
+
+    /// @brief 停止接受连接：设置标志后自己连一次，唤醒accept协程
+    ~EchoServer()
+    {
+        m_stopping = true;
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        connect(fd, (sockaddr *)&m_addr, sizeof(m_addr));
+        m_stopped.wait();
+        close(fd);
+        close(m_fd);
+    }
+
+    const sockaddr_in &getAddr() const { return m_addr; }
+
+private:
+    void acceptLoop()
+    {
+        while (true)
+        {
+            int client = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0)
+            {
+                if (errno == EAGAIN)
+                {
+                    WaitEvent(m_fd, sylar::IOManager::READ);
+                }
+                continue;
+            }
+            if (m_stopping)
+            {
+                close(client);
+                break;
+            }
+            SetNonBlock(client);
+            m_iom->schedule([client]()
+                            {
+                char buf[kMessageSize];
+                while (ReadFull(client, buf, sizeof(buf)) && WriteFull(client, buf, sizeof(buf)))
+                    ;
+                close(client); });
+        }
+        m_stopped.notify();
+    }
+
+private:
+    sylar::IOManager *m_iom;
+    int m_fd;
+    sockaddr_in m_addr;
+    std::atomic<bool> m_stopping{false};
+    sylar::Semaphore m_stopped;
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// @brief 启动kClients个客户端协程执行func，等待全部结束
+static double RunClients(sylar::IOManager &iom, std::function<void()> func)
+{
+    sylar::Semaphore done;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kClients; ++i)
+    {
+        iom.schedule([&func, &done]()
+                     {
+            func();
+            done.notify(); });
+    }
+    for (int i = 0; i < kClients; ++i)
+    {
+        done.wait();
+    }
+    return Seconds(start);
+}
+
+static void Bench(size_t threads)
+{
+    sylar::IOManager iom(threads, false, "echo");
+    std::atomic<uint64_t> ok{0};
+    double seconds;
+    {
+        EchoServer server(&iom);
+        sockaddr_in addr = server.getAddr();
+
+        // 短连接：连接、一次请求应答、关闭
+        seconds = RunClients(iom, [&]()
+                             {
+            char buf[kMessageSize] = {0};
+            for (int i = 0; i < kConnections; ++i)
+            {
+                int fd = Connect(addr);
+                if (fd < 0)
+                {
+                    continue;
+                }
+                if (WriteFull(fd, buf, sizeof(buf)) && ReadFull(fd, buf, sizeof(buf)))
+                {
+                    ok.fetch_add(1, std::memory_order_relaxed);
+                }
+                close(fd);
+            } });
+        std::cout << "threads=" << std::setw(3) << std::left << threads << std::fixed << std::setprecision(0)
+                  << std::setw(12) << std::right << ok / seconds << " connections/s" << std::endl;
+
+        // 长连接：每个客户端一个连接，串行请求应答
+        ok = 0;
+        seconds = RunClients(iom, [&]()
+                             {
+            char buf[kMessageSize] = {0};
+            int fd = Connect(addr);
+            if (fd < 0)
+            {
+                return;
+            }
+            for (int i = 0; i < kRequests; ++i)
+            {
+                if (!WriteFull(fd, buf, sizeof(buf)) || !ReadFull(fd, buf, sizeof(buf)))
+                {
+                    break;
+                }
+                ok.fetch_add(1, std::memory_order_relaxed);
+            }
+            close(fd); });
+        std::cout << "threads=" << std::setw(3) << std::left << threads << std::fixed << std::setprecision(0)
+                  << std::setw(12) << std::right << ok / seconds << " requests/s" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kRequests = atoi(argv[1]);
+    }
+    int cpus = sylar::Thread::GetCpuCount();
+    size_t maxThreads = cpus < 4 ? 4 : cpus;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        Bench(threads);
+    }
+    return 0;
+}
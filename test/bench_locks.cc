@@ -0,0 +1,108 @@
+#include "../Utility/cmutex.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+/// 每个线程的加锁次数，可以通过第一个命令行参数指定
+static int kIterations = 100000;
+
+/// @brief 模拟临界区内的工作量
+static inline void Work(int n, uint64_t &sink)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        sink = sink * 31 + i;
+    }
+}
+
+/// @brief 多个线程争用同一把锁，输出每次加锁解锁的平均耗时
+template <class LockType>
+static void BenchLock(const char *name, int threads, int csLength)
+{
+    LockType mutex;
+    uint64_t shared = 0;
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+                             {
+            uint64_t local = 0;
+            for (int i = 0; i < kIterations; ++i)
+            {
+                typename LockType::Lock lock(mutex);
+                Work(csLength, shared);
+                lock.unlock();
+                Work(csLength, local);
+            } });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / (double(kIterations) * threads);
+    std::cout << std::left << std::setw(16) << name << "threads=" << std::setw(4) << threads
+              << "cs=" << std::setw(6) << csLength << std::fixed << std::setprecision(1) << ns << " ns/op" << std::endl;
+}
+
+/// @brief 生产者消费者通过信号量交接，输出每次交接的平均耗时
+template <class SemType>
+static void BenchSemaphore(const char *name, int consumers)
+{
+    SemType sem;
+    std::vector<std::thread> workers;
+    const int total = kIterations;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < consumers; ++t)
+    {
+        workers.emplace_back([&, t]()
+                             {
+            int n = total / consumers + (t < total % consumers ? 1 : 0);
+            for (int i = 0; i < n; ++i)
+            {
+                sem.wait();
+            } });
+    }
+    for (int i = 0; i < total; ++i)
+    {
+        sem.notify();
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / total;
+    std::cout << std::left << std::setw(16) << name << "consumers=" << std::setw(4) << consumers
+              << std::fixed << std::setprecision(1) << ns << " ns/op" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kIterations = atoi(argv[1]);
+    }
+    for (int csLength : {0, 10, 100})
+    {
+        for (int threads : {1, 2, 4, 8, 16})
+        {
+            BenchLock<sylar::Mutex>("Mutex", threads, csLength);
+            BenchLock<sylar::FutexMutex>("FutexMutex", threads, csLength);
+            BenchLock<sylar::Spinlock>("Spinlock", threads, csLength);
+            BenchLock<sylar::CASLock>("CASLock", threads, csLength);
+            BenchLock<sylar::TTASLock>("TTASLock", threads, csLength);
+            BenchLock<sylar::TicketLock>("TicketLock", threads, csLength);
+            BenchLock<sylar::MCSLock>("MCSLock", threads, csLength);
+            BenchLock<sylar::CLHLock>("CLHLock", threads, csLength);
+        }
+    }
+    for (int consumers : {1, 2, 4})
+    {
+        BenchSemaphore<sylar::Semaphore>("Semaphore", consumers);
+        BenchSemaphore<sylar::FutexSemaphore>("FutexSemaphore", consumers);
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "../Logger/log.hpp"
+#include <chrono>
+
+/// 只统计字节数的输出目标，排除IO对格式化吞吐的影响
+class NullLogAppender : public sylar::LogAppender
+{
+public:
+    typedef std::shared_ptr<NullLogAppender> ptr;
+    NullLogAppender() : sylar::LogAppender(sylar::LogFormatter::ptr(new sylar::LogFormatter)) {}
+
+    void write(sylar::LogEvent::ptr, const std::string &formatted) override
+    {
+        m_bytes += formatted.size();
+    }
+
+    std::string toYamlString() override { return std::string(); }
+
+    uint64_t getBytes() const { return m_bytes; }
+
+private:
+    uint64_t m_bytes = 0;
+};
+
+static const int kEvents = 200000;
+
+/// @brief 运行一轮，workers为0表示在调用线程中同步格式化
+static void run(size_t workers)
+{
+    sylar::Logger::ptr logger(new sylar::Logger("bench"));
+    NullLogAppender::ptr sink(new NullLogAppender);
+    sylar::AsyncLogAppender::ptr async;
+    if (workers)
+    {
+        async.reset(new sylar::AsyncLogAppender(sink, workers));
+        logger->addAppender(async);
+    }
+    else
+    {
+        logger->addAppender(sink);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kEvents; ++i)
+    {
+        SYLAR_LOG_INFO(logger) << "pipeline benchmark message " << i << " value=" << i * 3.14;
+    }
+    if (async)
+    {
+        async->flush();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double sec = std::chrono::duration<double>(end - start).count();
+    std::cout << (workers ? "workers=" + std::to_string(workers) : std::string("sync     "))
+              << "\t" << kEvents / sec / 1000 << " K events/s"
+              << "\t" << sink->getBytes() / sec / 1024 / 1024 << " MB/s" << std::endl;
+}
+
+int main()
+{
+    run(0);
+    for (size_t workers : {1, 2, 4, 8})
+    {
+        run(workers);
+    }
+    return 0;
+}
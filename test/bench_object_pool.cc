@@ -0,0 +1,198 @@
+#include "../Logger/log.hpp"
+#include "../Utility/alloc.hpp"
+#include "../Utility/lockfree_queue.hpp"
+#include "../Utility/object_pool.hpp"
+#include "../ptr/shared_ptr.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/// 每个线程的操作次数，可以通过第一个命令行参数指定
+static int kOps = 1000000;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// 框架中常见大小的对象
+struct Object
+{
+    Object(int v) : value(v) {}
+    int value;
+    char payload[60];
+};
+
+struct AllocatedObject : public sylar::AllocObject<AllocatedObject>
+{
+    AllocatedObject(int v) : value(v) {}
+    int value;
+    char payload[60];
+};
+
+struct NewApi
+{
+    static const char *Name() { return "new/delete"; }
+    static Object *Create(int v) { return new Object(v); }
+    static void Destroy(Object *ptr) { delete ptr; }
+};
+
+struct AllocApi
+{
+    static const char *Name() { return "AllocObject"; }
+    static AllocatedObject *Create(int v) { return new AllocatedObject(v); }
+    static void Destroy(AllocatedObject *ptr) { delete ptr; }
+};
+
+struct PoolApi
+{
+    static const char *Name() { return "ObjectPool"; }
+    static Object *Create(int v) { return sylar::ObjectPool<Object>::Instance().create(v); }
+    static void Destroy(Object *ptr) { sylar::ObjectPool<Object>::Instance().destroy(ptr); }
+};
+
+static void Report(const char *name, const char *kind, size_t threads, double seconds)
+{
+    std::cout << std::left << std::setw(20) << name << std::setw(8) << kind << "threads=" << std::setw(3) << threads << std::right
+              << std::fixed << std::setprecision(1) << std::setw(8) << threads * kOps / seconds / 1e6 << " M create+destroy/s" << std::endl;
+}
+
+/// @brief 每个线程创建一批再销毁
+template <class Api>
+static void BenchLocal(size_t threads)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([]()
+                             {
+            decltype(Api::Create(0)) ptrs[64];
+            for (int i = 0; i < kOps; i += 64)
+            {
+                for (int j = 0; j < 64; ++j)
+                {
+                    ptrs[j] = Api::Create(j);
+                }
+                for (int j = 0; j < 64; ++j)
+                {
+                    Api::Destroy(ptrs[j]);
+                }
+            } });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    Report(Api::Name(), "local", threads, Seconds(start));
+}
+
+/// @brief 生产者创建，经SPSC队列交给消费者销毁，pairs对生产者消费者
+template <class Api>
+static void BenchCrossThread(size_t pairs)
+{
+    typedef decltype(Api::Create(0)) Ptr;
+    std::vector<std::unique_ptr<sylar::SPSCQueue<Ptr>>> queues;
+    for (size_t p = 0; p < pairs; ++p)
+    {
+        queues.emplace_back(new sylar::SPSCQueue<Ptr>(1024));
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t p = 0; p < pairs; ++p)
+    {
+        sylar::SPSCQueue<Ptr> *queue = queues[p].get();
+        workers.emplace_back([queue]()
+                             {
+            for (int i = 0; i < kOps; ++i)
+            {
+                Ptr ptr = Api::Create(i);
+                while (!queue->push(ptr))
+                {
+                    std::this_thread::yield();
+                }
+            } });
+        workers.emplace_back([queue]()
+                             {
+            for (int i = 0; i < kOps; ++i)
+            {
+                Ptr ptr;
+                while (!queue->pop(ptr))
+                {
+                    std::this_thread::yield();
+                }
+                Api::Destroy(ptr);
+            } });
+    }
+    for (auto &i : workers)
+    {
+        i.join();
+    }
+    Report(Api::Name(), "cross", pairs, Seconds(start));
+}
+
+/// @brief 智能指针：创建一个对象、拷贝一次、全部释放
+template <class Make>
+static void BenchShared(const char *name, Make make)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kOps; ++i)
+    {
+        auto ptr = make(i);
+        auto copy = ptr;
+        (void)copy;
+    }
+    Report(name, "shared", 1, Seconds(start));
+}
+
+/// @brief 日志事件的创建和销毁，不经过日志器
+static void BenchLogEvent(const char *name, bool pooled)
+{
+    std::string loggerName = "bench";
+    std::string threadName = "main";
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kOps; ++i)
+    {
+        sylar::LogEvent::ptr event = pooled ? sylar::LogEvent::Create(loggerName, sylar::LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, threadName, 0)
+                                            : std::make_shared<sylar::LogEvent>(loggerName, sylar::LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, threadName, 0);
+        event->getSS() << i;
+    }
+    Report(name, "event", 1, Seconds(start));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kOps = atoi(argv[1]);
+    }
+    for (size_t threads : {1, 4, 16})
+    {
+        BenchLocal<NewApi>(threads);
+        BenchLocal<AllocApi>(threads);
+        BenchLocal<PoolApi>(threads);
+    }
+    for (size_t pairs : {1, 4, 8})
+    {
+        BenchCrossThread<NewApi>(pairs);
+        BenchCrossThread<AllocApi>(pairs);
+        BenchCrossThread<PoolApi>(pairs);
+    }
+    BenchShared("std::make_shared", [](int v)
+                { return std::make_shared<Object>(v); });
+    BenchShared("MakePoolShared", [](int v)
+                { return sylar::MakePoolShared<Object>(v); });
+    BenchShared("shared_ptr(new)", [](int v)
+                { return shared_ptr<Object>(new Object(v)); });
+    BenchShared("make_pooled_shared", [](int v)
+                { return make_pooled_shared<Object>(v); });
+    BenchLogEvent("make_shared", false);
+    BenchLogEvent("LogEvent::Create", true);
+
+    sylar::ObjectPoolBase::Stats stats = sylar::ObjectPool<Object>::Instance().getStats();
+    std::cout << "ObjectPool<Object>: allocations=" << stats.allocations << " frees=" << stats.frees << " blocks=" << stats.blocks
+              << " full magazines=" << stats.fullMagazines << " empty magazines=" << stats.emptyMagazines << std::endl;
+    return 0;
+}
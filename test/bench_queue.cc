@@ -0,0 +1,255 @@
+#include "../Utility/lockfree_queue.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <vector>
+
+/// 每个生产者入队的元素个数，可以通过第一个命令行参数指定
+static int kIterations = 200000;
+
+/// @brief 对照组：互斥锁保护的std::list
+template <class T>
+class LockedQueue
+{
+public:
+    typedef sylar::Mutex MutexType;
+
+    LockedQueue(size_t = 0) {}
+
+    template <class U>
+    bool push(U &&value)
+    {
+        MutexType::Lock lock(m_mutex);
+        m_list.push_back(std::forward<U>(value));
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        MutexType::Lock lock(m_mutex);
+        if (m_list.empty())
+        {
+            return false;
+        }
+        value = std::move(m_list.front());
+        m_list.pop_front();
+        return true;
+    }
+
+private:
+    MutexType m_mutex;
+    std::list<T> m_list;
+};
+
+struct Item : public sylar::MPSCNode
+{
+    uint64_t value = 0;
+};
+
+static void Report(const char *name, int producers, int consumers, double ns, uint64_t total)
+{
+    std::cout << std::left << std::setw(20) << name << "p=" << std::setw(3) << producers << "c=" << std::setw(3) << consumers
+              << std::fixed << std::setprecision(1) << std::setw(10) << ns / total << "ns/item "
+              << std::setprecision(2) << total / (ns / 1e3) << " Mitems/s" << std::endl;
+}
+
+/// @brief 吞吐测试：多个生产者往阻塞队列里放整数，多个消费者取出并校验总和
+template <class QueueType>
+static void BenchThroughput(const char *name, int producers, int consumers)
+{
+    QueueType queue(4096);
+    const uint64_t total = uint64_t(kIterations) * producers;
+    std::atomic<uint64_t> sum{0};
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&, c]()
+                             {
+            uint64_t n = total / consumers + (uint64_t(c) < total % consumers ? 1 : 0);
+            uint64_t local = 0;
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                uint64_t value;
+                queue.pop(value);
+                local += value;
+            }
+            sum.fetch_add(local); });
+    }
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&]()
+                             {
+            for (int i = 1; i <= kIterations; ++i)
+            {
+                while (!queue.push(uint64_t(i)))
+                {
+                    std::this_thread::yield();
+                }
+            } });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sum != uint64_t(kIterations) * (kIterations + 1) / 2 * producers)
+    {
+        std::cout << name << " checksum mismatch" << std::endl;
+    }
+    Report(name, producers, consumers, std::chrono::duration<double, std::nano>(end - start).count(), total);
+}
+
+/// @brief 侵入式MPSC队列的吞吐测试，节点预先分配好
+static void BenchIntrusive(int producers)
+{
+    sylar::BlockingQueue<sylar::MPSCQueue<Item>> queue;
+    std::vector<Item> items(size_t(kIterations) * producers);
+    const uint64_t total = items.size();
+    std::vector<std::thread> threads;
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    threads.emplace_back([&]()
+                         {
+        for (uint64_t i = 0; i < total; ++i)
+        {
+            Item *item;
+            queue.pop(item);
+            sum += item->value;
+        } });
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]()
+                             {
+            Item *base = &items[size_t(p) * kIterations];
+            for (int i = 0; i < kIterations; ++i)
+            {
+                base[i].value = i + 1;
+                queue.push(&base[i]);
+            } });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    if (sum != uint64_t(kIterations) * (kIterations + 1) / 2 * producers)
+    {
+        std::cout << "MPSCQueue checksum mismatch" << std::endl;
+    }
+    Report("MPSCQueue", producers, 1, std::chrono::duration<double, std::nano>(end - start).count(), total);
+}
+
+/// @brief SPSC批量接口的吞吐测试，消费者空转轮询
+static void BenchSPSCBatch(size_t batch)
+{
+    sylar::SPSCQueue<uint64_t> queue(4096);
+    const uint64_t total = kIterations;
+    uint64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]()
+                         {
+        std::vector<uint64_t> out(batch);
+        uint64_t received = 0;
+        while (received < total)
+        {
+            size_t n = queue.popBatch(out.data(), batch);
+            if (n == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                sum += out[i];
+            }
+            received += n;
+        } });
+    std::vector<uint64_t> in(batch);
+    for (uint64_t i = 1; i <= total;)
+    {
+        size_t n = 0;
+        for (; n < batch && i + n <= total; ++n)
+        {
+            in[n] = i + n;
+        }
+        size_t pushed = queue.pushBatch(in.data(), n);
+        if (pushed == 0)
+        {
+            std::this_thread::yield();
+        }
+        i += pushed;
+    }
+    consumer.join();
+    auto end = std::chrono::steady_clock::now();
+    if (sum != total * (total + 1) / 2)
+    {
+        std::cout << "SPSC batch checksum mismatch" << std::endl;
+    }
+    std::string name = "SPSCBatch/" + std::to_string(batch);
+    Report(name.c_str(), 1, 1, std::chrono::duration<double, std::nano>(end - start).count(), total);
+}
+
+/// @brief 延迟测试：两个线程通过两个队列来回传递一个令牌，输出单程平均耗时
+template <class QueueType>
+static void BenchPingPong(const char *name)
+{
+    QueueType ping(64), pong(64);
+    const int rounds = kIterations / 10;
+    std::thread peer([&]()
+                     {
+        for (int i = 0; i < rounds; ++i)
+        {
+            uint64_t value;
+            ping.pop(value);
+            pong.push(value + 1);
+        } });
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+    {
+        uint64_t value;
+        ping.push(uint64_t(i));
+        pong.pop(value);
+    }
+    auto end = std::chrono::steady_clock::now();
+    peer.join();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / (2.0 * rounds);
+    std::cout << std::left << std::setw(20) << name << "one-way " << std::fixed << std::setprecision(1) << ns << " ns" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kIterations = atoi(argv[1]);
+    }
+    typedef sylar::BlockingQueue<LockedQueue<uint64_t>, sylar::Semaphore> Locked;
+    typedef sylar::BlockingQueue<sylar::SPSCQueue<uint64_t>> SPSC;
+    typedef sylar::BlockingQueue<sylar::MPMCQueue<uint64_t>> MPMC;
+    typedef sylar::EventCountQueue<sylar::MPMCQueue<uint64_t>> MPMCEvent;
+
+    std::cout << "== throughput ==" << std::endl;
+    BenchThroughput<Locked>("Mutex+list", 1, 1);
+    BenchThroughput<SPSC>("SPSCQueue", 1, 1);
+    BenchThroughput<MPMC>("MPMCQueue", 1, 1);
+    BenchThroughput<MPMCEvent>("MPMC+EventCount", 1, 1);
+    BenchSPSCBatch(1);
+    BenchSPSCBatch(16);
+    BenchSPSCBatch(256);
+    for (int threads : {2, 4, 8})
+    {
+        BenchThroughput<Locked>("Mutex+list", threads, threads);
+        BenchThroughput<MPMC>("MPMCQueue", threads, threads);
+        BenchThroughput<MPMCEvent>("MPMC+EventCount", threads, threads);
+        BenchThroughput<Locked>("Mutex+list", threads, 1);
+        BenchIntrusive(threads);
+    }
+
+    std::cout << "== latency ==" << std::endl;
+    BenchPingPong<Locked>("Mutex+list");
+    BenchPingPong<SPSC>("SPSCQueue");
+    BenchPingPong<MPMC>("MPMCQueue");
+    BenchPingPong<MPMCEvent>("MPMC+EventCount");
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "../Utility/cmutex.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+/// 读多写少的配置数据，模拟日志器级别和格式配置
+struct Config
+{
+    int level;
+    int flags;
+    uint64_t version;
+};
+
+static const int kReads = 1000000;
+
+/// @brief 读者线程不停读取，一个写者线程每毫秒修改一次，输出每次读取的平均耗时
+template <class ReadFunc, class WriteFunc>
+static void Bench(const char *name, int readers, ReadFunc read, WriteFunc write)
+{
+    std::atomic<bool> stop(false);
+    std::thread writer([&]()
+                       {
+        uint64_t version = 0;
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            write(++version);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } });
+
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> sink(0);
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < readers; ++t)
+    {
+        threads.emplace_back([&]()
+                             {
+            uint64_t local = 0;
+            for (int i = 0; i < kReads; ++i)
+            {
+                local += read();
+            }
+            sink += local; });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    stop = true;
+    writer.join();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / kReads;
+    std::cout << std::left << std::setw(22) << name << "readers=" << std::setw(4) << readers
+              << std::fixed << std::setprecision(1) << ns << " ns/read (wall time per reader iteration)" << std::endl;
+}
+
+int main()
+{
+    for (int readers : {1, 2, 4, 8, 16})
+    {
+        {
+            sylar::RWMutex mutex;
+            Config config = {0, 0, 0};
+            Bench(
+                "RWMutex", readers, [&]()
+                { sylar::RWMutex::ReadLock lock(mutex); return config.level + config.version; },
+                [&](uint64_t v)
+                { sylar::RWMutex::WriteLock lock(mutex); config.version = v; });
+        }
+        {
+            sylar::DistributedRWMutex mutex;
+            Config config = {0, 0, 0};
+            Bench(
+                "DistributedRWMutex", readers, [&]()
+                { sylar::DistributedRWMutex::ReadLock lock(mutex); return config.level + config.version; },
+                [&](uint64_t v)
+                { sylar::DistributedRWMutex::WriteLock lock(mutex); config.version = v; });
+        }
+        {
+            sylar::SeqLock<Config> seqlock(Config{0, 0, 0});
+            Bench(
+                "SeqLock", readers, [&]()
+                { Config c = seqlock.load(); return c.level + c.version; },
+                [&](uint64_t v)
+                { sylar::SeqLock<Config>::WriteLock lock(seqlock); Config c = seqlock.get(); c.version = v; seqlock.set(c); });
+        }
+    }
+    return 0;
+}
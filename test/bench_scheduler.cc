@@ -0,0 +1,193 @@
+#include "../Fiber/scheduler.hpp"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <list>
+
+/// 任务数，可以通过第一个命令行参数指定
+static int kTasks = 1000000;
+
+/// @brief 对照组：一个互斥锁保护的全局队列，工作线程直接执行回调
+class GlobalQueuePool
+{
+public:
+    GlobalQueuePool(size_t threads)
+    {
+        for (size_t i = 0; i < threads; ++i)
+        {
+            m_threads.emplace_back(new sylar::Thread(std::bind(&GlobalQueuePool::run, this), "global_" + std::to_string(i)));
+        }
+    }
+
+    ~GlobalQueuePool()
+    {
+        {
+            sylar::Mutex::Lock lock(m_mutex);
+            m_stopping = true;
+        }
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            m_sem.notify();
+        }
+        for (auto &i : m_threads)
+        {
+            i->join();
+        }
+    }
+
+    void schedule(std::function<void()> cb)
+    {
+        {
+            sylar::Mutex::Lock lock(m_mutex);
+            m_tasks.push_back(std::move(cb));
+        }
+        m_sem.notify();
+    }
+
+private:
+    void run()
+    {
+        while (true)
+        {
+            m_sem.wait();
+            std::function<void()> cb;
+            {
+                sylar::Mutex::Lock lock(m_mutex);
+                if (m_tasks.empty())
+                {
+                    if (m_stopping)
+                    {
+                        return;
+                    }
+                    continue;
+                }
+                cb.swap(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            cb();
+        }
+    }
+
+private:
+    sylar::Mutex m_mutex;
+    sylar::Semaphore m_sem;
+    std::list<std::function<void()>> m_tasks;
+    std::vector<sylar::Thread::ptr> m_threads;
+    bool m_stopping = false;
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char *name, size_t threads, uint64_t tasks, double seconds)
+{
+    std::cout << std::left << std::setw(22) << name << "threads=" << std::setw(3) << threads
+              << std::fixed << std::setprecision(2) << tasks / seconds / 1e6 << " M tasks/s" << std::endl;
+}
+
+/// @brief 外部线程逐个调度小任务
+static void BenchExternal(size_t threads)
+{
+    std::atomic<uint64_t> done{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(threads, false, "ext");
+        sc.start();
+        for (int i = 0; i < kTasks; ++i)
+        {
+            sc.schedule([&done]()
+                        { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        sc.stop();
+    }
+    Report("external schedule", threads, done, Seconds(start));
+}
+
+/// @brief 工作线程内部扇出：每个种子任务在工作线程里再调度一批子任务，走本地队列和窃取
+static void BenchFanout(size_t threads)
+{
+    std::atomic<uint64_t> done{0};
+    const int seeds = 64;
+    const int children = kTasks / seeds;
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(threads, false, "fan");
+        sc.start();
+        for (int s = 0; s < seeds; ++s)
+        {
+            sc.schedule([&done, children]()
+                        {
+                sylar::Scheduler *self = sylar::Scheduler::GetThis();
+                for (int i = 0; i < children; ++i)
+                {
+                    self->schedule([&done]()
+                                   { done.fetch_add(1, std::memory_order_relaxed); });
+                } });
+        }
+        sc.stop();
+    }
+    Report("fan-out in workers", threads, done, Seconds(start));
+}
+
+/// @brief 协程不断重新调度自己再yield，测试协程切换加调度的开销
+static void BenchYield(size_t threads)
+{
+    std::atomic<uint64_t> done{0};
+    const int fibers = 100;
+    const int rounds = kTasks / fibers;
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(threads, false, "yield");
+        sc.start();
+        for (int f = 0; f < fibers; ++f)
+        {
+            sc.schedule([&done, rounds]()
+                        {
+                sylar::Fiber::ptr self = sylar::Fiber::GetThis();
+                sylar::Scheduler *sched = sylar::Scheduler::GetThis();
+                for (int i = 0; i < rounds; ++i)
+                {
+                    done.fetch_add(1, std::memory_order_relaxed);
+                    sched->schedule(self);
+                    self->yield();
+                } });
+        }
+        sc.stop();
+    }
+    Report("fiber yield", threads, done, Seconds(start));
+}
+
+static void BenchGlobalQueue(size_t threads)
+{
+    std::atomic<uint64_t> done{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        GlobalQueuePool pool(threads);
+        for (int i = 0; i < kTasks; ++i)
+        {
+            pool.schedule([&done]()
+                          { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+    }
+    Report("global mutex queue", threads, done, Seconds(start));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kTasks = atoi(argv[1]);
+    }
+    int cpus = sylar::Thread::GetCpuCount();
+    size_t maxThreads = cpus < 4 ? 4 : cpus;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        BenchGlobalQueue(threads);
+        BenchExternal(threads);
+        BenchFanout(threads);
+        BenchYield(threads);
+    }
+    return 0;
+}
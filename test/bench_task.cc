@@ -0,0 +1,221 @@
+#include "../Fiber/task.hpp"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+/// 空闲连接数，受RLIMIT_NOFILE限制，可以通过第一个命令行参数指定
+static int kConnections = 8000;
+/// 切换测试中每个协程的切换次数
+static const int kSwitches = 20000;
+/// 切换测试中的协程数
+static const int kSwitchers = 100;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// @brief 当前进程的虚拟内存和常驻内存，字节
+static void Memory(double &virt, double &rss)
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t size, resident;
+    statm >> size >> resident;
+    virt = (double)size * sysconf(_SC_PAGESIZE);
+    rss = (double)resident * sysconf(_SC_PAGESIZE);
+}
+
+static void IdleFiber(int fd, std::atomic<int> &ready, std::atomic<int> &done)
+{
+    sylar::IOManager::GetThis()->addEvent(fd, sylar::IOManager::READ);
+    ++ready;
+    sylar::Fiber::GetThis()->yield();
+    char c;
+    read(fd, &c, 1);
+    ++done;
+}
+
+static sylar::Task<void> IdleTask(int fd, std::atomic<int> &ready, std::atomic<int> &done)
+{
+    ++ready;
+    co_await sylar::WaitEvent(fd, sylar::IOManager::READ);
+    char c;
+    read(fd, &c, 1);
+    ++done;
+}
+
+/**
+ * @brief kConnections个连接各有一个协程等待读事件，统计每个连接增加的内存，再唤醒全部连接
+ */
+static void BenchIdle(const char *name, bool stackless, const std::vector<int> &fds)
+{
+    std::atomic<int> ready{0};
+    std::atomic<int> done{0};
+    double virt, rss;
+    Memory(virt, rss);
+    double virtPerConnection = 0;
+    double rssPerConnection = 0;
+    double wakeSeconds = 0;
+    {
+        sylar::IOManager iom(1, false, "idle");
+        for (int i = 0; i < kConnections; ++i)
+        {
+            int fd = fds[i * 2];
+            if (stackless)
+            {
+                sylar::Spawn(IdleTask(fd, ready, done), &iom);
+            }
+            else
+            {
+                iom.schedule([fd, &ready, &done]()
+                             { IdleFiber(fd, ready, done); });
+            }
+        }
+        while (ready < kConnections)
+        {
+            usleep(1000);
+        }
+        usleep(50000);
+        double virtNow, rssNow;
+        Memory(virtNow, rssNow);
+        virtPerConnection = (virtNow - virt) / kConnections;
+        rssPerConnection = (rssNow - rss) / kConnections;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kConnections; ++i)
+        {
+            write(fds[i * 2 + 1], "x", 1);
+        }
+        while (done < kConnections)
+        {
+            sched_yield();
+        }
+        wakeSeconds = Seconds(start);
+    }
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(8) << rssPerConnection << " bytes rss/connection, " << std::setw(8) << virtPerConnection
+              << " bytes virtual/connection, wake all " << std::setprecision(1)
+              << wakeSeconds * 1e3 << " ms" << std::endl;
+}
+
+static sylar::Task<void> YieldTask(int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        co_await sylar::Yield();
+    }
+}
+
+/// @brief kSwitchers个协程在一个线程上轮流让出执行权
+static void BenchSwitch(const char *name, bool stackless)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(1, false, "switch");
+        sc.start();
+        for (int i = 0; i < kSwitchers; ++i)
+        {
+            if (stackless)
+            {
+                sylar::Spawn(YieldTask(kSwitches), &sc);
+            }
+            else
+            {
+                sc.schedule([]()
+                            {
+                    sylar::Scheduler *sched = sylar::Scheduler::GetThis();
+                    sylar::Fiber::ptr self = sylar::Fiber::GetThis();
+                    for (int j = 0; j < kSwitches; ++j)
+                    {
+                        sched->schedule(self);
+                        self->yield();
+                    } });
+            }
+        }
+        sc.stop();
+    }
+    double seconds = Seconds(start);
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(0) << std::setw(8)
+              << seconds * 1e9 / ((double)kSwitchers * kSwitches) << " ns/switch" << std::endl;
+}
+
+static sylar::Task<void> EmptyTask(std::atomic<int> &count)
+{
+    ++count;
+    co_return;
+}
+
+/// @brief 创建、执行、销毁大量只执行一次的协程，分批创建，避免同时存在的协程栈太多
+static void BenchSpawn(const char *name, bool stackless)
+{
+    const int n = 1000000;
+    const int batch = 10000;
+    std::atomic<int> count{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        sylar::Scheduler sc(1, false, "spawn");
+        sc.start();
+        for (int i = 0; i < n; i += batch)
+        {
+            for (int j = 0; j < batch; ++j)
+            {
+                if (stackless)
+                {
+                    sylar::Spawn(EmptyTask(count), &sc);
+                }
+                else
+                {
+                    // 回调会复用线程缓存的协程，这里显式创建协程
+                    sc.schedule(std::make_shared<sylar::Fiber>([&count]()
+                                                               { ++count; }));
+                }
+            }
+            while (count < i + batch)
+            {
+                sched_yield();
+            }
+        }
+        sc.stop();
+    }
+    double seconds = Seconds(start);
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(0) << std::setw(8)
+              << seconds * 1e9 / n << " ns/spawn" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kConnections = atoi(argv[1]);
+    }
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if ((rlim_t)kConnections * 2 + 64 > limit.rlim_cur)
+    {
+        kConnections = (limit.rlim_cur - 64) / 2;
+    }
+    std::vector<int> fds(kConnections * 2);
+    for (int i = 0; i < kConnections; ++i)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, &fds[i * 2]);
+    }
+
+    std::cout << kConnections << " idle connections" << std::endl;
+    BenchIdle("Task", true, fds);
+    BenchIdle("Fiber", false, fds);
+    BenchSwitch("Task", true);
+    BenchSwitch("Fiber", false);
+    BenchSpawn("Task", true);
+    BenchSpawn("Fiber", false);
+
+    for (int fd : fds)
+    {
+        close(fd);
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "../Utility/thread_pool.hpp"
+#include "../Utility/util.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+/// 数据规模倍数，可以通过第一个命令行参数指定
+static int kScale = 1;
+
+static double NowMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// @brief 模拟日志段的压缩/索引：对每个4KB块计算哈希
+static uint64_t HashBlocks(const std::vector<char> &data, size_t begin, size_t end)
+{
+    uint64_t h = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        h ^= sylar::HashBytes(&data[i * 4096], 4096, i);
+    }
+    return h;
+}
+
+/// @brief 递归提交任务，测试在工作线程中等待future时帮忙执行任务
+static uint64_t Fib(sylar::ThreadPool &pool, int n)
+{
+    if (n < 20)
+    {
+        uint64_t a = 0, b = 1;
+        for (int i = 0; i < n; ++i)
+        {
+            uint64_t c = a + b;
+            a = b;
+            b = c;
+        }
+        return a;
+    }
+    auto left = pool.submit([&pool, n]()
+                            { return Fib(pool, n - 1); });
+    uint64_t right = Fib(pool, n - 2);
+    return left.get() + right;
+}
+
+struct Result
+{
+    double forMs;
+    double reduceMs;
+    double submitMs;
+    double fibMs;
+};
+
+static Result RunOnce(size_t threads, const std::vector<char> &data, uint64_t expectHash, uint64_t expectSum)
+{
+    sylar::ThreadPool pool(threads, "bench");
+    const size_t blocks = data.size() / 4096;
+    Result r;
+
+    double start = NowMs();
+    std::vector<uint64_t> hashes(blocks);
+    pool.parallelFor(0, blocks, [&](size_t b, size_t e)
+                     {
+        for (size_t i = b; i < e; ++i)
+        {
+            hashes[i] = HashBlocks(data, i, i + 1);
+        } });
+    uint64_t h = 0;
+    for (auto i : hashes)
+    {
+        h ^= i;
+    }
+    r.forMs = NowMs() - start;
+    if (h != expectHash)
+    {
+        std::cout << "parallelFor mismatch" << std::endl;
+    }
+
+    start = NowMs();
+    const size_t n = 20000000ULL * kScale;
+    uint64_t sum = pool.parallelReduce(size_t(0), n, uint64_t(0), [](size_t b, size_t e)
+                                       {
+        uint64_t s = 0;
+        for (size_t i = b; i < e; ++i)
+        {
+            s += i * i % 7;
+        }
+        return s; }, [](uint64_t a, uint64_t b)
+                                       { return a + b; });
+    r.reduceMs = NowMs() - start;
+    if (sum != expectSum)
+    {
+        std::cout << "parallelReduce mismatch" << std::endl;
+    }
+
+    start = NowMs();
+    const int tasks = 100000 * kScale;
+    std::vector<sylar::TaskFuture<int>> futures;
+    futures.reserve(tasks);
+    for (int i = 0; i < tasks; ++i)
+    {
+        futures.push_back(pool.submit([i]()
+                                      { return i & 1; }));
+    }
+    int odd = 0;
+    for (auto &i : futures)
+    {
+        odd += i.get();
+    }
+    r.submitMs = NowMs() - start;
+    if (odd != tasks / 2)
+    {
+        std::cout << "submit mismatch" << std::endl;
+    }
+
+    start = NowMs();
+    uint64_t fib = pool.submit([&pool]()
+                               { return Fib(pool, 30); })
+                       .get();
+    r.fibMs = NowMs() - start;
+    if (fib != 832040)
+    {
+        std::cout << "fib mismatch " << fib << std::endl;
+    }
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kScale = atoi(argv[1]);
+    }
+    std::vector<char> data(size_t(64) * 1024 * 1024 * kScale);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = char(i * 131 + (i >> 12));
+    }
+
+    // 单线程的参考结果
+    double start = NowMs();
+    uint64_t expectHash = 0;
+    for (size_t i = 0; i < data.size() / 4096; ++i)
+    {
+        expectHash ^= HashBlocks(data, i, i + 1);
+    }
+    double serialFor = NowMs() - start;
+    uint64_t expectSum = 0;
+    start = NowMs();
+    for (size_t i = 0; i < 20000000ULL * kScale; ++i)
+    {
+        expectSum += i * i % 7;
+    }
+    double serialReduce = NowMs() - start;
+    std::cout << "serial      for=" << std::fixed << std::setprecision(1) << serialFor << "ms reduce=" << serialReduce << "ms" << std::endl;
+
+    int cpus = sylar::Thread::GetCpuCount();
+    int maxThreads = cpus < 4 ? 4 : cpus;
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        Result r = RunOnce(threads, data, expectHash, expectSum);
+        std::cout << "threads=" << std::setw(3) << std::left << threads
+                  << " for=" << r.forMs << "ms (x" << std::setprecision(2) << serialFor / r.forMs << std::setprecision(1) << ")"
+                  << " reduce=" << r.reduceMs << "ms (x" << std::setprecision(2) << serialReduce / r.reduceMs << std::setprecision(1) << ")"
+                  << " submit+get=" << r.submitMs << "ms"
+                  << " fib(30)=" << r.fibMs << "ms" << std::endl;
+    }
+    if (cpus < maxThreads)
+    {
+        std::cout << "only " << cpus << " cpu(s) online, results above " << cpus << " threads measure oversubscription" << std::endl;
+    }
+    return 0;
+}
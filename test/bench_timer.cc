@@ -0,0 +1,183 @@
+#include "../Fiber/timer.hpp"
+#include "../Utility/util.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <unistd.h>
+
+/// 定时器数，可以通过第一个命令行参数指定
+static int kTimers = 1000000;
+
+/// @brief 对照组：std::set按到期时间排序的定时器，添加、取消、刷新都是O(log n)
+class SetTimerManager
+{
+public:
+    struct Timer
+    {
+        typedef std::shared_ptr<Timer> ptr;
+        uint64_t ms;
+        uint64_t next;
+        std::function<void()> cb;
+    };
+
+    struct Comparator
+    {
+        bool operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const
+        {
+            if (lhs->next != rhs->next)
+            {
+                return lhs->next < rhs->next;
+            }
+            return lhs.get() < rhs.get();
+        }
+    };
+
+    Timer::ptr addTimer(uint64_t ms, std::function<void()> cb)
+    {
+        Timer::ptr timer(new Timer{ms, sylar::GetCoarseMS() + ms, std::move(cb)});
+        sylar::Mutex::Lock lock(m_mutex);
+        m_timers.insert(timer);
+        return timer;
+    }
+
+    bool cancel(const Timer::ptr &timer)
+    {
+        sylar::Mutex::Lock lock(m_mutex);
+        auto it = m_timers.find(timer);
+        if (it == m_timers.end())
+        {
+            return false;
+        }
+        m_timers.erase(it);
+        return true;
+    }
+
+    bool refresh(const Timer::ptr &timer)
+    {
+        sylar::Mutex::Lock lock(m_mutex);
+        auto it = m_timers.find(timer);
+        if (it == m_timers.end())
+        {
+            return false;
+        }
+        m_timers.erase(it);
+        timer->next = sylar::GetCoarseMS() + timer->ms;
+        m_timers.insert(timer);
+        return true;
+    }
+
+    void listExpiredCb(std::vector<std::function<void()>> &cbs)
+    {
+        uint64_t now = sylar::GetCoarseMS();
+        sylar::Mutex::Lock lock(m_mutex);
+        auto it = m_timers.begin();
+        while (it != m_timers.end() && (*it)->next <= now)
+        {
+            cbs.push_back(std::move((*it)->cb));
+            ++it;
+        }
+        m_timers.erase(m_timers.begin(), it);
+    }
+
+private:
+    sylar::Mutex m_mutex;
+    std::set<Timer::ptr, Comparator> m_timers;
+};
+
+class WheelTimerManager : public sylar::TimerManager
+{
+protected:
+    void onTimerInsertedAtFront() override {}
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void Report(const char *name, const char *op, uint64_t ops, double seconds)
+{
+    std::cout << std::left << std::setw(8) << name << std::setw(10) << op << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << seconds * 1e9 / ops << " ns/op" << std::endl;
+}
+
+/**
+ * @brief 模拟连接超时：添加kTimers个1~30秒的超时，全部刷新一次，取消其中90%，
+ *        剩下的和另外kTimers个100ms内的短超时一起到期
+ */
+template <class Manager, class Add, class Refresh, class Cancel>
+static void Bench(const char *name, Add add, Refresh refresh, Cancel cancel)
+{
+    Manager manager;
+    std::mt19937 rng(1);
+    uint64_t fired = 0;
+    auto cb = [&fired]()
+    { ++fired; };
+
+    std::vector<decltype(add(manager, 0, cb))> timers;
+    timers.reserve(kTimers);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kTimers; ++i)
+    {
+        timers.push_back(add(manager, 1000 + rng() % 29000, cb));
+    }
+    Report(name, "add", kTimers, Seconds(start));
+
+    start = std::chrono::steady_clock::now();
+    for (auto &timer : timers)
+    {
+        refresh(manager, timer);
+    }
+    Report(name, "refresh", kTimers, Seconds(start));
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < timers.size(); ++i)
+    {
+        if (i % 10)
+        {
+            cancel(manager, timers[i]);
+        }
+    }
+    Report(name, "cancel", kTimers - kTimers / 10, Seconds(start));
+
+    for (int i = 0; i < kTimers; ++i)
+    {
+        add(manager, rng() % 100, cb);
+    }
+    usleep(150 * 1000);
+    std::vector<std::function<void()>> cbs;
+    start = std::chrono::steady_clock::now();
+    manager.listExpiredCb(cbs);
+    for (auto &i : cbs)
+    {
+        i();
+    }
+    Report(name, "expire", fired, Seconds(start));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kTimers = atoi(argv[1]);
+    }
+    Bench<SetTimerManager>(
+        "set",
+        [](SetTimerManager &m, uint64_t ms, std::function<void()> cb)
+        { return m.addTimer(ms, cb); },
+        [](SetTimerManager &m, const SetTimerManager::Timer::ptr &t)
+        { m.refresh(t); },
+        [](SetTimerManager &m, const SetTimerManager::Timer::ptr &t)
+        { m.cancel(t); });
+    Bench<WheelTimerManager>(
+        "wheel",
+        [](WheelTimerManager &m, uint64_t ms, std::function<void()> cb)
+        { return m.addTimer(ms, cb); },
+        [](WheelTimerManager &, const sylar::Timer::ptr &t)
+        { t->refresh(); },
+        [](WheelTimerManager &, const sylar::Timer::ptr &t)
+        { t->cancel(); });
+    return 0;
+}
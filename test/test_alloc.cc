@@ -0,0 +1,204 @@
+#include "../Utility/alloc.hpp"
+#include "../Utility/lockfree_queue.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/// 小对象分配器测试，建议以 -DSYLAR_SANITIZER=address 或 -DSYLAR_SANITIZER=thread 编译运行
+/// 检查不依赖assert，Release编译同样生效
+static void Check(bool cond, const char *what)
+{
+    if (!cond)
+    {
+        std::cerr << "check failed: " << what << std::endl;
+        abort();
+    }
+}
+
+static std::atomic<int64_t> s_alive(0);
+
+struct Base : public sylar::AllocObject<Base>
+{
+    Base(int v) : value(v) { ++s_alive; }
+    virtual ~Base() { --s_alive; }
+    int value;
+};
+
+/// 比基类大的派生类，按实际大小分配
+struct Derived : public Base
+{
+    Derived(int v) : Base(v) { memset(payload, v, sizeof(payload)); }
+    char payload[200];
+};
+
+/// @brief 只释放不分配的线程退出时要归还缓存，span回到分配前的数量
+static void TestThreadExit()
+{
+    // 只有这个测试使用2KB的分级，span的变化都来自这里
+    const size_t size = 2048;
+    const size_t cls = sylar::Alloc::SizeClass(size);
+    // 不超过线程缓存的上限，释放线程不会中途把对象还给中心缓存
+    const size_t count = 2 * sylar::Alloc::BatchSize(cls);
+    // 以-DSYLAR_ALLOC_OVERRIDE=ON编译时vector也从本分配器分配，先分配好再记录基准
+    std::vector<void *> objects;
+    objects.reserve(count);
+    sylar::Alloc::FlushThreadCache();
+    size_t baseline = sylar::Alloc::GetStats().spansInUse;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        objects.push_back(sylar::Alloc::Allocate(size));
+        Check(sylar::Alloc::Owns(objects.back()), "object from the arena");
+    }
+    sylar::Alloc::FlushThreadCache();
+    Check(sylar::Alloc::GetStats().spansInUse > baseline, "spans in use while objects are alive");
+
+    std::thread freer([&objects]()
+                      {
+        for (void *ptr : objects)
+        {
+            sylar::Alloc::Deallocate(ptr);
+        } });
+    freer.join();
+    // 创建线程时本线程也可能从新的span取了一批对象
+    sylar::Alloc::FlushThreadCache();
+    size_t after = sylar::Alloc::GetStats().spansInUse;
+    Check(after == baseline, "free-only thread returned its cache on exit");
+    std::cout << "thread exit ok, spans in use " << baseline << " -> " << after << std::endl;
+}
+
+/// @brief 每个分级的大小16字节对齐，大小和分级互相转换一致
+static void TestSizeClasses()
+{
+    for (size_t cls = 0; cls < sylar::Alloc::kClasses; ++cls)
+    {
+        size_t size = sylar::Alloc::ClassSize(cls);
+        Check(size % 16 == 0, "class size is a multiple of 16");
+        Check(sylar::Alloc::SizeClass(size) == cls, "SizeClass(ClassSize(cls)) == cls");
+        if (cls > 0)
+        {
+            Check(sylar::Alloc::SizeClass(sylar::Alloc::ClassSize(cls - 1) + 1) == cls, "size just above the previous class");
+        }
+        Check(sylar::Alloc::BatchSize(cls) >= 2, "batch size");
+    }
+    Check(sylar::Alloc::ClassSize(sylar::Alloc::kClasses - 1) == sylar::Alloc::kMaxSmallSize, "largest class");
+    for (size_t size = 1; size <= sylar::Alloc::kMaxSmallSize; ++size)
+    {
+        Check(sylar::Alloc::ClassSize(sylar::Alloc::SizeClass(size)) >= size, "class fits the size");
+    }
+
+    for (size_t cls = 0; cls < sylar::Alloc::kClasses; ++cls)
+    {
+        size_t size = sylar::Alloc::ClassSize(cls);
+        void *ptr = sylar::Alloc::Allocate(size);
+        Check(reinterpret_cast<uintptr_t>(ptr) % 16 == 0, "16 byte alignment");
+        Check(sylar::Alloc::Owns(ptr), "small object owned by the arena");
+        Check(sylar::Alloc::UsableSize(ptr) == size, "UsableSize is the class size");
+        memset(ptr, 0xab, size);
+        if (cls % 2)
+        {
+            sylar::Alloc::Deallocate(ptr);
+        }
+        else
+        {
+            sylar::Alloc::Deallocate(ptr, size);
+        }
+    }
+    std::cout << "size classes ok" << std::endl;
+}
+
+/// @brief 超过kMaxSmallSize的分配交给malloc，释放时根据地址判断归属
+static void TestLarge()
+{
+    size_t size = sylar::Alloc::kMaxSmallSize + 1;
+    void *ptr = sylar::Alloc::Allocate(size);
+    Check(ptr != nullptr, "large allocation");
+    Check(!sylar::Alloc::Owns(ptr), "large object not owned by the arena");
+    Check(sylar::Alloc::UsableSize(ptr) >= size, "large UsableSize");
+    memset(ptr, 0, size);
+    sylar::Alloc::Deallocate(ptr);
+
+    ptr = sylar::Alloc::Allocate(size);
+    sylar::Alloc::Deallocate(ptr, size);
+
+    // malloc分配的内存也可以交给Deallocate
+    ptr = malloc(64);
+    Check(!sylar::Alloc::Owns(ptr), "malloc memory not owned by the arena");
+    sylar::Alloc::Deallocate(ptr);
+    sylar::Alloc::Deallocate(nullptr);
+    std::cout << "large ok" << std::endl;
+}
+
+/// @brief 生产者分配，消费者释放
+static void TestCrossThread(int ops)
+{
+    sylar::SPSCQueue<char *> queue(1024);
+    std::thread producer([&]()
+                         {
+        for (int i = 0; i < ops; ++i)
+        {
+            size_t size = 16 + (i % 64) * 16;
+            char *ptr = static_cast<char *>(sylar::Alloc::Allocate(size));
+            ptr[0] = static_cast<char>(i);
+            ptr[size - 1] = static_cast<char>(i);
+            while (!queue.push(ptr))
+            {
+                std::this_thread::yield();
+            }
+        } });
+    std::thread consumer([&]()
+                         {
+        for (int i = 0; i < ops; ++i)
+        {
+            char *ptr;
+            while (!queue.pop(ptr))
+            {
+                std::this_thread::yield();
+            }
+            size_t size = 16 + (i % 64) * 16;
+            Check(sylar::Alloc::UsableSize(ptr) == size, "cross thread size");
+            Check(ptr[0] == static_cast<char>(i) && ptr[size - 1] == static_cast<char>(i), "cross thread content");
+            sylar::Alloc::Deallocate(ptr);
+        } });
+    producer.join();
+    consumer.join();
+    std::cout << "cross thread ok" << std::endl;
+}
+
+/// @brief AllocObject按sizeof(T)直接算分级，更大的派生类按实际大小分配
+static void TestAllocObject()
+{
+    std::vector<Base *> objects;
+    for (int i = 0; i < 1000; ++i)
+    {
+        objects.push_back(i % 2 ? new Derived(i) : new Base(i));
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        Base *object = objects[i];
+        Check(object->value == i, "object value");
+        Check(sylar::Alloc::UsableSize(object) >= (i % 2 ? sizeof(Derived) : sizeof(Base)), "object size");
+        if (i % 2)
+        {
+            Check(static_cast<Derived *>(object)->payload[sizeof(Derived::payload) - 1] == static_cast<char>(i), "derived payload");
+        }
+        delete object;
+    }
+    Check(s_alive == 0, "all objects destroyed");
+    std::cout << "AllocObject ok" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int ops = argc > 1 ? atoi(argv[1]) : 1000000;
+    TestThreadExit();
+    TestSizeClasses();
+    TestLarge();
+    TestCrossThread(ops);
+    TestAllocObject();
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
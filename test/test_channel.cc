@@ -0,0 +1,159 @@
+#include "../Fiber/channel.hpp"
+#include "../Fiber/iomanager.hpp"
+#include <string>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/// 每个生产者发送的值的个数，可以通过第一个命令行参数指定
+static int kCount = 10000;
+
+/// @brief 多个生产者多个消费者，检查收到的值的总和
+static void TestProducerConsumer(size_t capacity)
+{
+    sylar::Channel<int> ch(capacity);
+    sylar::Channel<int> done;
+    std::atomic<int64_t> sum{0};
+    const int producers = 4;
+    const int consumers = 4;
+    {
+        sylar::Scheduler sc(4, false, "pc");
+        sc.start();
+        for (int i = 0; i < consumers; ++i)
+        {
+            sc.schedule([&]()
+                        {
+                int v;
+                while (ch.recv(v))
+                {
+                    sum += v;
+                }
+                done.send(0); });
+        }
+        for (int i = 0; i < producers; ++i)
+        {
+            sc.schedule([&]()
+                        {
+                for (int j = 1; j <= kCount; ++j)
+                {
+                    ch.send(j);
+                }
+                done.send(1); });
+        }
+        // 在普通线程中接收，所有生产者结束后关闭通道让消费者退出
+        int v;
+        for (int i = 0; i < producers; ++i)
+        {
+            done.recv(v);
+        }
+        ch.close();
+        for (int i = 0; i < consumers; ++i)
+        {
+            done.recv(v);
+        }
+        sc.stop();
+    }
+    int64_t expect = (int64_t)kCount * (kCount + 1) / 2 * producers;
+    SYLAR_LOG_INFO(g_logger) << "capacity=" << capacity << " sum=" << sum << " expect=" << expect;
+}
+
+/// @brief 关闭后缓冲区中剩下的值仍然可以接收，发送失败
+static void TestClose()
+{
+    sylar::Channel<std::string> ch(4);
+    ch.send("a");
+    ch.send("b");
+    ch.close();
+    std::string a, b, c;
+    bool ok1 = ch.recv(a);
+    bool ok2 = ch.recv(b);
+    bool ok3 = ch.recv(c);
+    bool sent = ch.send("c");
+    SYLAR_LOG_INFO(g_logger) << "close recv=" << ok1 << ok2 << ok3 << " " << a << b << " send after close=" << sent;
+
+    // 挂起的接收方被关闭唤醒
+    sylar::Channel<int> empty;
+    bool recvOk = true;
+    {
+        sylar::Scheduler sc(1, false, "close");
+        sc.start();
+        sc.schedule([&]()
+                    {
+            int v;
+            recvOk = empty.recv(v); });
+        usleep(10000);
+        empty.close();
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "blocked recv woken by close, ok=" << recvOk;
+}
+
+/// @brief select在两个通道上接收，第三个通道发送，最后超时
+static void TestSelect()
+{
+    sylar::Channel<int> ints;
+    sylar::Channel<std::string> strs;
+    sylar::Channel<int> out(1);
+    sylar::IOManager iom(2, false, "select");
+    iom.schedule([&]()
+                 {
+        for (int i = 0; i < 3; ++i)
+        {
+            ints.send(i);
+        }
+        strs.send("hello"); });
+    iom.schedule([&]()
+                 {
+        int i = -1;
+        std::string s;
+        int o = 100;
+        int got = 0;
+        sylar::Select sel;
+        sel.recv(ints, i).recv(strs, s).send(out, o);
+        uint64_t start = sylar::GetCoarseMS();
+        while (true)
+        {
+            int index = sel.wait(50);
+            if (index == -1)
+            {
+                break;
+            }
+            ++got;
+            SYLAR_LOG_INFO(g_logger) << "select index=" << index << " ok=" << sel.ok() << " i=" << i << " s=" << s;
+        }
+        SYLAR_LOG_INFO(g_logger) << "select got=" << got << " (expect 5), timed out after " << sylar::GetCoarseMS() - start << "ms";
+
+        // 不挂起的select
+        sylar::Select poll;
+        int v = 0;
+        poll.recv(out, v);
+        int first = poll.tryWait();
+        int second = poll.tryWait();
+        SYLAR_LOG_INFO(g_logger) << "tryWait " << first << " v=" << v << ", then " << second; });
+}
+
+/// @brief 在普通线程中带超时的select
+static void TestSelectThread()
+{
+    sylar::Channel<int> ch;
+    int v = 0;
+    sylar::Select sel;
+    sel.recv(ch, v);
+    uint64_t start = sylar::GetCoarseMS();
+    int index = sel.wait(20);
+    SYLAR_LOG_INFO(g_logger) << "thread select index=" << index << " after " << sylar::GetCoarseMS() - start << "ms";
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kCount = atoi(argv[1]);
+    }
+    TestProducerConsumer(0);
+    TestProducerConsumer(64);
+    TestClose();
+    TestSelect();
+    TestSelectThread();
+    SYLAR_LOG_INFO(g_logger) << "test channel end";
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "../Fiber/fiber.hpp"
+#include "../Utility/thread.hpp"
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static void RunInFiber()
+{
+    SYLAR_LOG_INFO(g_logger) << "run_in_fiber begin, trace=" << sylar::TraceContext::GetTraceId();
+    sylar::TraceScope scope("req-fiber", true);
+    SYLAR_LOG_DEBUG(g_logger) << "forced debug inside fiber";
+    sylar::Fiber::GetThis()->yield();
+    SYLAR_LOG_INFO(g_logger) << "run_in_fiber resumed, trace=" << sylar::TraceContext::GetTraceId();
+    sylar::Fiber::GetThis()->yield();
+    SYLAR_LOG_INFO(g_logger) << "run_in_fiber end";
+}
+
+/// @brief 协程内再resume另一个协程，yield回到各自的resumer
+static void Nested()
+{
+    sylar::Fiber::ptr inner(new sylar::Fiber([]()
+                                             {
+        SYLAR_LOG_INFO(g_logger) << "inner fiber id=" << sylar::GetFiberId();
+        sylar::Fiber::GetThis()->yield();
+        SYLAR_LOG_INFO(g_logger) << "inner fiber end"; }));
+    inner->resume();
+    SYLAR_LOG_INFO(g_logger) << "outer fiber id=" << sylar::GetFiberId() << " back from inner";
+    inner->resume();
+    SYLAR_LOG_INFO(g_logger) << "inner state=" << inner->getState();
+}
+
+static void TestFiber()
+{
+    sylar::Fiber::GetThis();
+    sylar::TraceScope scope("req-main");
+    SYLAR_LOG_INFO(g_logger) << "main begin";
+    sylar::Fiber::ptr fiber(new sylar::Fiber(&RunInFiber));
+    fiber->resume();
+    // 协程里设置的强制调试不会泄漏到主协程
+    SYLAR_LOG_INFO(g_logger) << "main after resume, trace=" << sylar::TraceContext::GetTraceId()
+                             << " forceDebug=" << sylar::TraceContext::IsForceDebug();
+    fiber->resume();
+    SYLAR_LOG_INFO(g_logger) << "main after resume2";
+    fiber->resume();
+    SYLAR_LOG_INFO(g_logger) << "fiber state=" << fiber->getState();
+
+    fiber->reset(&Nested);
+    fiber->resume();
+    SYLAR_LOG_INFO(g_logger) << "main end";
+}
+
+int main(int argc, char **argv)
+{
+    g_logger->setLevel(sylar::LogLevel::INFO);
+    TestFiber();
+    std::vector<sylar::Thread::ptr> threads;
+    for (int i = 0; i < 3; ++i)
+    {
+        threads.emplace_back(new sylar::Thread(&TestFiber, "name_" + std::to_string(i)));
+    }
+    for (auto &i : threads)
+    {
+        i->join();
+    }
+    SYLAR_LOG_INFO(g_logger) << "total fibers=" << sylar::Fiber::TotalFibers();
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include "../Fiber/fiber_sync.hpp"
+#include "../Fiber/iomanager.hpp"
+#include <vector>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/// 竞争同一把锁的协程数，可以通过第一个命令行参数指定
+static int kFibers = 10000;
+
+/// @brief 协程在临界区内yield，其他协程排队挂起而不是阻塞线程
+static void TestMutex()
+{
+    sylar::FiberMutex mutex;
+    int counter = 0;
+    const int loops = 10;
+    {
+        sylar::Scheduler sc(4, false, "mutex");
+        sc.start();
+        for (int i = 0; i < kFibers; ++i)
+        {
+            sc.schedule([&mutex, &counter]()
+                        {
+                for (int j = 0; j < loops; ++j)
+                {
+                    sylar::FiberMutex::Lock lock(mutex);
+                    int v = counter;
+                    if (j == 0)
+                    {
+                        sylar::Scheduler::GetThis()->schedule(sylar::Fiber::GetThis());
+                        sylar::Fiber::GetThis()->yield();
+                    }
+                    counter = v + 1;
+                } });
+        }
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "mutex counter=" << counter << " expect=" << kFibers * loops;
+}
+
+/// @brief 持有锁时sleep（hook后挂起协程），单线程上其他不需要锁的协程照常运行
+static void TestHoldAcrossSleep()
+{
+    sylar::FiberMutex mutex;
+    std::atomic<int> others{0};
+    uint64_t start = sylar::GetCoarseMS();
+    uint64_t othersDone = 0;
+    {
+        sylar::IOManager iom(1, false, "sleep", true);
+        for (int i = 0; i < 50; ++i)
+        {
+            iom.schedule([&mutex]()
+                         {
+                sylar::FiberMutex::Lock lock(mutex);
+                usleep(2000); });
+        }
+        for (int i = 0; i < 1000; ++i)
+        {
+            iom.schedule([&others, &othersDone, start]()
+                         {
+                if (++others == 1000)
+                {
+                    othersDone = sylar::GetCoarseMS() - start;
+                } });
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "lock holders done in " << sylar::GetCoarseMS() - start << "ms, 1000 other fibers done in " << othersDone << "ms";
+}
+
+/// @brief 生产者消费者
+static void TestSemaphore()
+{
+    sylar::FiberSemaphore items;
+    sylar::FiberSemaphore done;
+    std::atomic<int> consumed{0};
+    {
+        sylar::Scheduler sc(2, false, "sem");
+        sc.start();
+        for (int i = 0; i < 100; ++i)
+        {
+            sc.schedule([&]()
+                        {
+                items.wait();
+                ++consumed;
+                done.notify(); });
+        }
+        for (int i = 0; i < 10; ++i)
+        {
+            items.notify(10);
+        }
+        // 在普通线程里等待，退化为futex睡眠
+        for (int i = 0; i < 100; ++i)
+        {
+            done.wait();
+        }
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "semaphore consumed=" << consumed;
+}
+
+static void TestCondition()
+{
+    sylar::FiberMutex mutex;
+    sylar::FiberCondition cond;
+    bool ready = false;
+    std::atomic<int> woken{0};
+    {
+        sylar::Scheduler sc(2, false, "cond");
+        sc.start();
+        for (int i = 0; i < 100; ++i)
+        {
+            sc.schedule([&]()
+                        {
+                sylar::FiberMutex::Lock lock(mutex);
+                cond.wait(mutex, [&ready]()
+                          { return ready; });
+                ++woken; });
+        }
+        sc.schedule([&]()
+                    {
+            sylar::FiberMutex::Lock lock(mutex);
+            ready = true;
+            cond.notifyAll(); });
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "condition woken=" << woken;
+}
+
+/// @brief 读者之间可以并发，写者独占
+static void TestRWMutex()
+{
+    sylar::FiberRWMutex rwmutex;
+    std::atomic<int> readers{0};
+    std::atomic<int> writers{0};
+    std::atomic<int> errors{0};
+    {
+        sylar::Scheduler sc(4, false, "rw");
+        sc.start();
+        for (int i = 0; i < 2000; ++i)
+        {
+            bool write = i % 10 == 0;
+            sc.schedule([&, write]()
+                        {
+                if (write)
+                {
+                    sylar::FiberRWMutex::WriteLock lock(rwmutex);
+                    if (++writers != 1 || readers != 0)
+                    {
+                        ++errors;
+                    }
+                    sylar::Scheduler::GetThis()->schedule(sylar::Fiber::GetThis());
+                    sylar::Fiber::GetThis()->yield();
+                    --writers;
+                }
+                else
+                {
+                    sylar::FiberRWMutex::ReadLock lock(rwmutex);
+                    ++readers;
+                    if (writers != 0)
+                    {
+                        ++errors;
+                    }
+                    sylar::Scheduler::GetThis()->schedule(sylar::Fiber::GetThis());
+                    sylar::Fiber::GetThis()->yield();
+                    --readers;
+                } });
+        }
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "rwmutex errors=" << errors;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kFibers = atoi(argv[1]);
+    }
+    TestMutex();
+    TestHoldAcrossSleep();
+    TestSemaphore();
+    TestCondition();
+    TestRWMutex();
+    SYLAR_LOG_INFO(g_logger) << "test fiber sync end";
+    return 0;
+}
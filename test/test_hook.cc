@@ -0,0 +1,138 @@
+#include "../Fiber/hook.hpp"
+#include "../Fiber/iomanager.hpp"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/time.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/// 并发的阻塞客户端数
+static const int kClients = 1000;
+/// 每个客户端的请求数
+static const int kRequests = 20;
+
+/// @brief 两个协程在同一个线程里sleep，总耗时取最长的一个而不是两者之和
+static void TestSleep()
+{
+    uint64_t start = sylar::GetCoarseMS();
+    {
+        sylar::IOManager iom(1, false, "sleep", true);
+        iom.schedule([start]()
+                     {
+            sleep(1);
+            SYLAR_LOG_INFO(g_logger) << "sleep 1s done, elapsed=" << sylar::GetCoarseMS() - start; });
+        iom.schedule([start]()
+                     {
+            usleep(500 * 1000);
+            SYLAR_LOG_INFO(g_logger) << "usleep 500ms done, elapsed=" << sylar::GetCoarseMS() - start; });
+    }
+    SYLAR_LOG_INFO(g_logger) << "test sleep total elapsed=" << sylar::GetCoarseMS() - start;
+}
+
+/// @brief 用阻塞写法的回显服务器和客户端，kClients个连接在一个线程上并发
+static void TestEcho()
+{
+    sylar::IOManager iom(1, false, "echo", true);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    sylar::Semaphore ready;
+    sylar::Semaphore done;
+    static std::atomic<int> s_ok{0};
+    iom.schedule([&addr, &ready, &iom]()
+                 {
+        int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        bind(listen_fd, (sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd, (sockaddr *)&addr, &len);
+        listen(listen_fd, 4096);
+        ready.notify();
+        for (int i = 0; i < kClients; ++i)
+        {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0)
+            {
+                SYLAR_LOG_ERROR(g_logger) << "accept errno=" << errno;
+                continue;
+            }
+            iom.schedule([fd]()
+                         {
+                char buf[64];
+                ssize_t n;
+                while ((n = read(fd, buf, sizeof(buf))) > 0)
+                {
+                    write(fd, buf, n);
+                }
+                close(fd); });
+        }
+        close(listen_fd); });
+    ready.wait();
+
+    uint64_t start = sylar::GetCoarseMS();
+    for (int i = 0; i < kClients; ++i)
+    {
+        iom.schedule([&addr, &done]()
+                     {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0)
+            {
+                char buf[64] = "ping";
+                for (int j = 0; j < kRequests; ++j)
+                {
+                    if (send(fd, buf, sizeof(buf), 0) != sizeof(buf) || recv(fd, buf, sizeof(buf), MSG_WAITALL) != sizeof(buf))
+                    {
+                        break;
+                    }
+                    ++s_ok;
+                }
+            }
+            close(fd);
+            done.notify(); });
+    }
+    for (int i = 0; i < kClients; ++i)
+    {
+        done.wait();
+    }
+    uint64_t elapsed = sylar::GetCoarseMS() - start;
+    SYLAR_LOG_INFO(g_logger) << kClients << " blocking clients on 1 thread: " << s_ok << " requests in " << elapsed << "ms";
+}
+
+/// @brief SO_RCVTIMEO超时后返回ETIMEDOUT；用户看到的仍是阻塞fd
+static void TestTimeout()
+{
+    sylar::IOManager iom(1, false, "timeout", true);
+    iom.schedule([]()
+                 {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int flags = fcntl(fd, F_GETFL, 0);
+        SYLAR_LOG_INFO(g_logger) << "user sees O_NONBLOCK=" << !!(flags & O_NONBLOCK);
+
+        timeval tv{0, 100 * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd, (sockaddr *)&addr, sizeof(addr));
+        listen(fd, 1);
+        uint64_t start = sylar::GetCoarseMS();
+        int rt = accept(fd, nullptr, nullptr);
+        SYLAR_LOG_INFO(g_logger) << "accept rt=" << rt << " errno=" << strerror(errno)
+                                 << " elapsed=" << sylar::GetCoarseMS() - start;
+        close(fd); });
+}
+
+int main(int argc, char **argv)
+{
+    TestSleep();
+    TestEcho();
+    TestTimeout();
+    SYLAR_LOG_INFO(g_logger) << "test hook end";
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "../Fiber/iomanager.hpp"
+#include "../Utility/util.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <set>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static int s_sock[2];
+static int s_cancelSock[2];
+
+/// @brief 协程等待读事件，另一个任务写入后恢复
+static void TestReadEvent()
+{
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    iom->schedule([]()
+                  {
+        sleep(1);
+        SYLAR_LOG_INFO(g_logger) << "write";
+        write(s_sock[1], "hello", 5); });
+
+    char buf[16] = {0};
+    while (read(s_sock[0], buf, sizeof(buf)) < 0 && errno == EAGAIN)
+    {
+        SYLAR_LOG_INFO(g_logger) << "wait read";
+        iom->addEvent(s_sock[0], sylar::IOManager::READ);
+        sylar::Fiber::GetThis()->yield();
+    }
+    SYLAR_LOG_INFO(g_logger) << "read: " << buf;
+}
+
+/// @brief 回调形式的事件，以及cancelEvent触发事件、delEvent不触发
+static void TestCancel()
+{
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    iom->addEvent(s_cancelSock[0], sylar::IOManager::READ, []()
+                  { SYLAR_LOG_INFO(g_logger) << "read event canceled"; });
+    iom->cancelEvent(s_cancelSock[0], sylar::IOManager::READ);
+
+    iom->addEvent(s_cancelSock[0], sylar::IOManager::READ, []()
+                  { SYLAR_LOG_ERROR(g_logger) << "deleted event should not run"; });
+    iom->delEvent(s_cancelSock[0], sylar::IOManager::READ);
+}
+
+/// @brief 指定线程的任务要唤醒在epoll_wait中睡眠的目标线程，不能等到epoll_wait超时
+/// @return 每次唤醒都及时时返回true
+static bool TestPinnedWakeup()
+{
+    const size_t kThreads = 3;
+    sylar::IOManager iom(kThreads, false, "pinned");
+    // 同时调度几个会阻塞的任务，空闲线程各自取走一个，得到所有工作线程的id
+    std::set<pid_t> seen;
+    sylar::Mutex mutex;
+    std::set<pid_t> ids;
+    for (int round = 0; round < 20 && ids.size() < kThreads; ++round)
+    {
+        for (size_t i = 0; i < kThreads; ++i)
+        {
+            iom.schedule([&seen, &mutex]()
+                         {
+                usleep(50 * 1000);
+                sylar::Mutex::Lock lock(mutex);
+                seen.insert(sylar::GetThreadId()); });
+        }
+        usleep(200 * 1000);
+        sylar::Mutex::Lock lock(mutex);
+        ids = seen;
+    }
+    if (ids.size() < kThreads)
+    {
+        SYLAR_LOG_ERROR(g_logger) << "only saw " << ids.size() << " worker threads";
+        return false;
+    }
+
+    uint64_t maxLatency = 0;
+    for (int round = 0; round < 5; ++round)
+    {
+        for (pid_t id : ids)
+        {
+            // 等所有线程都回到epoll_wait中
+            usleep(20 * 1000);
+            std::atomic<uint64_t> ranAt(0);
+            uint64_t start = sylar::GetElapsedMS();
+            iom.schedule([&ranAt]()
+                         { ranAt = sylar::GetElapsedMS(); },
+                         id);
+            while (!ranAt && sylar::GetElapsedMS() - start < 5000)
+            {
+                usleep(1000);
+            }
+            if (!ranAt)
+            {
+                SYLAR_LOG_ERROR(g_logger) << "pinned task on thread " << id << " did not run";
+                return false;
+            }
+            maxLatency = std::max(maxLatency, ranAt - start);
+        }
+    }
+    SYLAR_LOG_INFO(g_logger) << "pinned wakeup max latency " << maxLatency << "ms";
+    // epoll_wait最长等待3秒，没有唤醒目标线程时延迟接近这个值
+    return maxLatency < 1000;
+}
+
+int main(int argc, char **argv)
+{
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, s_sock);
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, s_cancelSock);
+    {
+        sylar::IOManager iom(2, true, "io");
+        iom.schedule(&TestReadEvent);
+        iom.schedule(&TestCancel);
+    }
+    close(s_sock[0]);
+    close(s_sock[1]);
+    close(s_cancelSock[0]);
+    close(s_cancelSock[1]);
+    if (!TestPinnedWakeup())
+    {
+        SYLAR_LOG_ERROR(g_logger) << "pinned wakeup failed";
+        return 1;
+    }
+    SYLAR_LOG_INFO(g_logger) << "test iomanager end";
+    return 0;
+}
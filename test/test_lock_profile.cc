@@ -0,0 +1,159 @@
+#include "../Utility/cmutex.hpp"
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/// 需要以 -DSYLAR_LOCK_PROFILE=ON 编译才会有统计输出
+sylar::Mutex g_mutex;
+sylar::Spinlock g_spinlock;
+sylar::RWMutex g_rwmutex;
+uint64_t g_counter = 0;
+
+void hotPath()
+{
+    sylar::Mutex::Lock lock(g_mutex);
+    for (int i = 0; i < 100; ++i)
+    {
+        ++g_counter;
+    }
+}
+
+void coldPath()
+{
+    sylar::Spinlock::Lock lock(g_spinlock);
+    ++g_counter;
+}
+
+void readPath()
+{
+    sylar::RWMutex::ReadLock lock(g_rwmutex);
+}
+
+#ifdef SYLAR_LOCK_PROFILE
+/// 检查不依赖assert，Release编译同样生效
+static void Check(bool cond, const char *what)
+{
+    if (!cond)
+    {
+        std::cerr << "check failed: " << what << std::endl;
+        exit(1);
+    }
+}
+
+/// @brief 从文本导出中取出一把锁的统计
+/// @return 导出中没有这把锁时返回false
+static bool GetStats(const std::string &dump, const std::string &name, uint64_t &acquisitions, uint64_t &contended, uint64_t &avgWaitNs)
+{
+    size_t pos = dump.find(name + ": acquisitions=");
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    unsigned long long a = 0, c = 0, w = 0;
+    double percent = 0;
+    if (sscanf(dump.c_str() + pos + name.size(), ": acquisitions=%llu contended=%llu (%lf%%) avg_wait_ns=%llu", &a, &c, &percent, &w) != 4)
+    {
+        return false;
+    }
+    acquisitions = a;
+    contended = c;
+    avgWaitNs = w;
+    return true;
+}
+
+/// @brief 持有者睡眠期间另一个线程加锁，一定发生竞争；只在一个线程中使用的锁没有竞争
+static void TestContention()
+{
+    sylar::Mutex contendedMutex;
+    contendedMutex.setName("test::contended");
+    sylar::Mutex quietMutex;
+    quietMutex.setName("test::quiet");
+
+    std::atomic<bool> held(false);
+    std::thread holder([&]()
+                       {
+        sylar::Mutex::Lock lock(contendedMutex);
+        held = true;
+        usleep(50 * 1000); });
+    while (!held)
+    {
+        usleep(1000);
+    }
+    {
+        // holder还要睡眠约50ms，这里一定要等待
+        sylar::Mutex::Lock lock(contendedMutex);
+    }
+    holder.join();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        sylar::Mutex::Lock lock(quietMutex);
+        ++g_counter;
+    }
+
+    std::string dump = sylar::LockProfiler::Dump();
+    uint64_t acquisitions = 0, contended = 0, avgWaitNs = 0;
+    Check(GetStats(dump, "test::contended", acquisitions, contended, avgWaitNs), "contended lock in the dump");
+    Check(acquisitions == 2, "contended lock acquired twice");
+    Check(contended >= 1 && avgWaitNs > 0, "contended lock shows contention and wait time");
+    Check(GetStats(dump, "test::quiet", acquisitions, contended, avgWaitNs), "uncontended lock in the dump");
+    Check(acquisitions == 1000, "uncontended lock acquisitions");
+    Check(contended == 0 && avgWaitNs == 0, "uncontended lock shows no contention");
+    std::cout << "contention ok" << std::endl;
+}
+
+/// @brief 同名的锁共用一个统计条目，反复创建销毁锁不会增加条目
+static void TestSameName()
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        sylar::Mutex mutex;
+        mutex.setName("test::shared");
+        sylar::Mutex::Lock lock(mutex);
+    }
+    uint64_t acquisitions = 0, contended = 0, avgWaitNs = 0;
+    Check(GetStats(sylar::LockProfiler::Dump(), "test::shared", acquisitions, contended, avgWaitNs), "shared name in the dump");
+    Check(acquisitions == 1000, "locks with the same name share one entry");
+    std::cout << "same name ok" << std::endl;
+}
+
+#endif
+
+int main()
+{
+#ifdef SYLAR_LOCK_PROFILE
+    TestContention();
+    TestSameName();
+    sylar::LockProfiler::Reset();
+#endif
+    g_mutex.setName("g_mutex");
+    g_spinlock.setName("g_spinlock");
+    g_rwmutex.setName("g_rwmutex");
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([]()
+                             {
+            for (int i = 0; i < 100000; ++i)
+            {
+                hotPath();
+                if (i % 10 == 0)
+                {
+                    coldPath();
+                    readPath();
+                }
+            } });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    std::cout << sylar::LockProfiler::Dump() << std::endl;
+    std::cout << sylar::LockProfiler::Dump(true) << std::endl;
+    return 0;
+}
@@ -1,8 +1,257 @@
 #include "../Logger/log.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
 
 sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT(); // 默认INFO级别
+
+/// 检查不依赖assert，Release编译同样生效，失败时进程返回非0
+static void Check(bool cond, const char *what)
+{
+    if (!cond)
+    {
+        std::cerr << "check failed: " << what << std::endl;
+        exit(1);
+    }
+}
+
+/// 把格式化后的日志保存下来供检查
+class CaptureAppender : public sylar::LogAppender
+{
+public:
+    typedef std::shared_ptr<CaptureAppender> ptr;
+
+    CaptureAppender(const std::string &pattern = "%m%n") : sylar::LogAppender(sylar::LogFormatter::ptr(new sylar::LogFormatter(pattern))) {}
+
+    void write(sylar::LogEvent::ptr, const std::string &formatted) override
+    {
+        // 暂停时模拟下游卡住
+        while (m_paused.load())
+        {
+            usleep(1000);
+        }
+        MutexType::Lock lock(m_mutex);
+        m_lines.push_back(formatted);
+    }
+
+    std::vector<std::string> lines()
+    {
+        MutexType::Lock lock(m_mutex);
+        return m_lines;
+    }
+
+    void setPaused(bool paused) { m_paused = paused; }
+
+    std::string toYamlString() override { return std::string(); }
+
+private:
+    std::vector<std::string> m_lines;
+    std::atomic<bool> m_paused{false};
+};
+
+/// 统计格式化次数的格式器
+class CountingFormatter : public sylar::LogFormatter
+{
+public:
+    typedef std::shared_ptr<CountingFormatter> ptr;
+
+    CountingFormatter() : sylar::LogFormatter("%m%n") {}
+
+    std::string format(sylar::LogEvent::ptr event) override
+    {
+        ++count;
+        return sylar::LogFormatter::format(event);
+    }
+
+    std::atomic<int> count{0};
+};
+
+/// @brief 每个输出目标有自己的级别，共用格式器的输出目标每条日志只格式化一次
+static void TestAppenderLevels()
+{
+    sylar::Logger::ptr logger(new sylar::Logger("appender_levels"));
+    logger->setLevel(sylar::LogLevel::DEBUG);
+    CountingFormatter::ptr formatter(new CountingFormatter);
+    CaptureAppender::ptr all(new CaptureAppender);
+    CaptureAppender::ptr warn(new CaptureAppender);
+    all->setFormatter(formatter);
+    warn->setFormatter(formatter);
+    warn->setLevel(sylar::LogLevel::WARN);
+    logger->addAppender(all);
+    logger->addAppender(warn);
+
+    SYLAR_LOG_INFO(logger) << "info";
+    SYLAR_LOG_ERROR(logger) << "error";
+    Check(all->lines() == std::vector<std::string>{"info\n", "error\n"}, "DEBUG appender receives both events");
+    Check(warn->lines() == std::vector<std::string>{"error\n"}, "WARN appender filters the INFO event");
+    Check(formatter->count == 2, "shared formatter formats each event once");
+    std::cout << "appender levels ok" << std::endl;
+}
+
+/// @brief 重复日志抑制
+static void TestDedup()
+{
+    // 后台线程只处理LoggerManager中的日志器
+    sylar::Logger::ptr logger = SYLAR_LOG("dedup");
+    CaptureAppender::ptr capture(new CaptureAppender);
+    logger->addAppender(capture);
+
+    // 1000条相同的日志只输出第一条和一条汇总
+    logger->setDedupWindow(1000);
+    for (int i = 0; i < 1000; ++i)
+    {
+        SYLAR_LOG_ERROR(logger) << "downstream unavailable";
+    }
+    SYLAR_LOG_ERROR(logger) << "downstream recovered";
+    Check(capture->lines() == std::vector<std::string>{"downstream unavailable\n", "last message repeated 999 times\n", "downstream recovered\n"},
+          "1000 identical messages produce one line and one summary");
+
+    // 重复停止后没有新日志，窗口结束后由后台线程输出汇总
+    CaptureAppender::ptr flood(new CaptureAppender("%N: %m%n"));
+    logger->clearAppenders();
+    logger->addAppender(flood);
+    logger->setDedupWindow(200);
+    for (int i = 0; i < 100; ++i)
+    {
+        SYLAR_LOG_ERROR(logger) << "flood then silence";
+    }
+    uint64_t start = sylar::GetElapsedMS();
+    while (flood->lines().size() < 2 && sylar::GetElapsedMS() - start < 2000)
+    {
+        usleep(10 * 1000);
+    }
+    std::vector<std::string> lines = flood->lines();
+    Check(lines.size() == 2 && lines[1] == "log_repeat: last message repeated 99 times\n", "background thread prints the summary after silence");
+    logger->setDedupWindow(0);
+    Check(flood->lines().size() == 2, "no extra summary when the window is turned off");
+    std::cout << "dedup ok" << std::endl;
+}
+
+/// @brief 只对单个请求强制打开DEBUG日志，%X输出跟踪id
+static void TestTrace()
+{
+    sylar::Logger::ptr logger(new sylar::Logger("trace"));
+    logger->setLevel(sylar::LogLevel::WARN);
+    CaptureAppender::ptr capture(new CaptureAppender("[%X] %p %m%n"));
+    logger->addAppender(capture);
+    {
+        sylar::TraceScope scope("req-42", true);
+        SYLAR_LOG_DEBUG(logger) << "debug msg of traced request";
+    }
+    SYLAR_LOG_DEBUG(logger) << "debug msg";
+    Check(capture->lines() == std::vector<std::string>{"[req-42] DEBUG debug msg of traced request\n"},
+          "traced DEBUG passes a WARN logger with its trace id, untraced DEBUG is filtered");
+    std::cout << "trace ok" << std::endl;
+}
+
+/// @brief 飞行记录器，被过滤掉的低级别日志在出现错误时一起输出
+static void TestFlightRecorder()
+{
+    sylar::Logger::ptr logger(new sylar::Logger("flight"));
+    logger->setLevel(sylar::LogLevel::WARN);
+    CaptureAppender::ptr capture(new CaptureAppender("%p %m%n"));
+    logger->addAppender(capture);
+    sylar::FlightRecorder::Clear();
+    sylar::FlightRecorder::SetEnabled(true);
+    for (int i = 0; i < 3; ++i)
+    {
+        SYLAR_LOG_DEBUG(logger) << "flight record " << i;
+    }
+    SYLAR_LOG_ERROR(logger) << "error with flight records";
+    sylar::FlightRecorder::SetEnabled(false);
+    Check(capture->lines() == std::vector<std::string>{"DEBUG flight record 0\n", "DEBUG flight record 1\n", "DEBUG flight record 2\n",
+                                                       "ERROR error with flight records\n"},
+          "flight recorder replays the three DEBUG records before the ERROR");
+    std::cout << "flight recorder ok" << std::endl;
+}
+
+/// @brief 多个线程经多个工作线程异步输出，每个线程的日志保持提交顺序，在途日志有上限
+static void TestAsyncAppender()
+{
+    const int kThreads = 4;
+    const int kEvents = 2000;
+    sylar::Logger::ptr logger(new sylar::Logger("async"));
+    CaptureAppender::ptr sink(new CaptureAppender);
+    // 上限远小于日志总数，生产者会被阻塞
+    sylar::AsyncLogAppender::ptr async(new sylar::AsyncLogAppender(sink, 4, 64));
+    logger->addAppender(async);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([logger, t]()
+                             {
+            for (int i = 0; i < kEvents; ++i)
+            {
+                SYLAR_LOG_INFO(logger) << t << " " << i;
+            } });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    async->flush();
+    std::vector<std::string> lines = sink->lines();
+    Check(lines.size() == (size_t)kThreads * kEvents, "flush returns after every event was written");
+    std::vector<int> next(kThreads, 0);
+    for (auto &line : lines)
+    {
+        int t = -1, i = -1;
+        Check(sscanf(line.c_str(), "%d %d", &t, &i) == 2 && t >= 0 && t < kThreads, "async line format");
+        Check(i == next[t]++, "events of one thread keep their order");
+    }
+
+    // 下游卡住时flush()一直等待
+    sink->setPaused(true);
+    for (int i = 0; i < 10; ++i)
+    {
+        SYLAR_LOG_INFO(logger) << "paused " << i;
+    }
+    std::atomic<bool> flushed(false);
+    std::thread flusher([&]()
+                        {
+        async->flush();
+        flushed = true; });
+    usleep(50 * 1000);
+    Check(!flushed, "flush waits while the sink is stuck");
+    sink->setPaused(false);
+    flusher.join();
+    Check(sink->lines().size() == (size_t)kThreads * kEvents + 10, "flush returns once the sink catches up");
+
+    // 格式器转交给下游输出目标
+    sylar::LogFormatter::ptr formatter(new sylar::LogFormatter("[%p] %m%n"));
+    async->setFormatter(formatter);
+    Check(sink->getFormatter() == formatter && async->getFormatter() == formatter, "setFormatter forwards to the sink");
+    SYLAR_LOG_INFO(logger) << "formatted";
+    async->flush();
+    Check(sink->lines().back() == "[INFO] formatted\n", "async output uses the forwarded formatter");
+
+    // DROP策略：下游卡住时只接收capacity条，其余丢弃并计数
+    CaptureAppender::ptr slow(new CaptureAppender);
+    slow->setPaused(true);
+    sylar::AsyncLogAppender::ptr dropping(new sylar::AsyncLogAppender(slow, 2, 8, sylar::AsyncLogAppender::DROP));
+    sylar::Logger::ptr dropLogger(new sylar::Logger("async_drop"));
+    dropLogger->addAppender(dropping);
+    for (int i = 0; i < 100; ++i)
+    {
+        SYLAR_LOG_INFO(dropLogger) << "drop " << i;
+    }
+    Check(dropping->getDropped() == 92, "events over capacity are dropped and counted");
+    slow->setPaused(false);
+    dropping->flush();
+    Check(slow->lines().size() == 8, "accepted events are all written");
+    std::cout << "async appender ok" << std::endl;
+}
+
 int main()
 {
+    TestAppenderLevels();
+    TestDedup();
+    TestTrace();
+    TestFlightRecorder();
+    TestAsyncAppender();
+
     SYLAR_LOG_FATAL(g_logger) << "fatal msg";
     SYLAR_LOG_ERROR(g_logger) << "err msg";
     SYLAR_LOG_INFO(g_logger) << "info msg";
@@ -17,5 +266,6 @@ int main()
     SYLAR_LOG_ERROR(g_logger) << "err msg";
     SYLAR_LOG_INFO(g_logger) << "info msg";
     SYLAR_LOG_DEBUG(g_logger) << "debug msg";
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "../Utility/object_pool.hpp"
+#include "../Utility/lockfree_queue.hpp"
+#include "../ptr/shared_ptr.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/// 对象池测试，建议以 -DSYLAR_SANITIZER=address 或 -DSYLAR_SANITIZER=thread 编译运行
+/// 检查不依赖assert，Release编译同样生效
+static void Check(bool cond, const char *what)
+{
+    if (!cond)
+    {
+        std::cerr << "check failed: " << what << std::endl;
+        abort();
+    }
+}
+
+static std::atomic<int64_t> s_alive(0);
+
+struct Item
+{
+    Item(int v) : value(v) { ++s_alive; }
+    ~Item() { --s_alive; }
+    int value;
+    char payload[52];
+};
+
+struct Throwing
+{
+    Throwing(bool fail)
+    {
+        if (fail)
+        {
+            throw std::runtime_error("construct failed");
+        }
+    }
+};
+
+/// @brief 同一线程分配释放，检查槽位不重叠、不同大小的分配都对齐
+static void TestLocal()
+{
+    sylar::ObjectPool<Item> pool;
+    std::vector<Item *> items;
+    for (int i = 0; i < 10000; ++i)
+    {
+        items.push_back(pool.create(i));
+        Check(reinterpret_cast<uintptr_t>(items.back()) % alignof(Item) == 0, "slot alignment");
+    }
+    for (int i = 0; i < 10000; ++i)
+    {
+        Check(items[i]->value == i, "items[i]->value == i");
+        pool.destroy(items[i]);
+    }
+    Check(s_alive == 0, "s_alive == 0");
+    pool.flushThreadCache();
+    pool.trim();
+    sylar::ObjectPoolBase::Stats stats = pool.getStats();
+    Check(stats.allocations == 10000 && stats.frees == 10000, "allocations and frees counted");
+    // 槽位全部空闲，块都还回去了
+    Check(stats.blocks == 0, "stats.blocks == 0");
+
+    try
+    {
+        sylar::ObjectPool<Throwing>::Instance().create(true);
+        Check(false, "constructor exception propagates");
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+    std::cout << "local ok" << std::endl;
+}
+
+/// @brief 生产者分配，消费者释放，释放方的满弹匣经仓库回到生产者
+static void TestCrossThread(int ops)
+{
+    sylar::ObjectPool<Item> pool(4);
+    sylar::SPSCQueue<Item *> queue(1024);
+    std::thread producer([&]()
+                         {
+        for (int i = 0; i < ops; ++i)
+        {
+            Item *item = pool.create(i);
+            while (!queue.push(item))
+            {
+                std::this_thread::yield();
+            }
+        } });
+    std::thread consumer([&]()
+                         {
+        for (int i = 0; i < ops; ++i)
+        {
+            Item *item;
+            while (!queue.pop(item))
+            {
+                std::this_thread::yield();
+            }
+            Check(item->value == i, "item->value == i");
+            pool.destroy(item);
+        } });
+    producer.join();
+    consumer.join();
+    Check(s_alive == 0, "s_alive == 0");
+    // 两个线程都已退出，缓存的槽位在线程退出时还回去了
+    sylar::ObjectPoolBase::Stats stats = pool.getStats();
+    Check(stats.allocations == (uint64_t)ops && stats.frees == (uint64_t)ops, "allocations and frees counted");
+    pool.trim();
+    stats = pool.getStats();
+    Check(stats.blocks == 0, "stats.blocks == 0");
+    std::cout << "cross thread ok, magazines full=" << stats.fullMagazines << " empty=" << stats.emptyMagazines << std::endl;
+}
+
+/// @brief 池数超过线程缓存数组，之后的池退化为加锁分配
+static void TestManyPools()
+{
+    std::vector<std::unique_ptr<sylar::ObjectPool<Item>>> pools;
+    for (size_t i = 0; i < sylar::ObjectPoolBase::kMaxPools + 8; ++i)
+    {
+        pools.emplace_back(new sylar::ObjectPool<Item>());
+    }
+    for (auto &pool : pools)
+    {
+        Item *item = pool->create(1);
+        pool->destroy(item);
+    }
+    // 析构后下标可以被新池复用，旧的线程缓存项不会被误用
+    pools.clear();
+    sylar::ObjectPool<Item> pool;
+    Item *item = pool.create(2);
+    Check(item->value == 2, "item->value == 2");
+    pool.destroy(item);
+    Check(s_alive == 0, "s_alive == 0");
+    std::cout << "many pools ok" << std::endl;
+}
+
+/// @brief 和CUniquePtr、std::shared_ptr以及ptr/shared_ptr.hpp配合
+static void TestSmartPointers()
+{
+    {
+        sylar::PoolUniquePtr<Item> unique = sylar::MakePoolUnique<Item>(1);
+        Check(unique->value == 1, "unique->value == 1");
+        std::shared_ptr<Item> shared = sylar::MakePoolShared<Item>(2);
+        std::shared_ptr<Item> copy = shared;
+        Check(copy->value == 2, "copy->value == 2");
+        shared_ptr<Item> pooled = make_pooled_shared<Item>(3);
+        shared_ptr<Item> pooledCopy(pooled);
+        Check(pooledCopy->value == 3, "pooledCopy->value == 3");
+        shared_ptr<Item> plain(new Item(4));
+        Check(plain->value == 4, "plain->value == 4");
+        Check(s_alive == 4, "s_alive == 4");
+    }
+    Check(s_alive == 0, "s_alive == 0");
+
+    // 多个线程共享同一个对象，最后一个释放的线程归还槽位
+    for (int round = 0; round < 100; ++round)
+    {
+        shared_ptr<Item> item = make_pooled_shared<Item>(round);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([item]()
+                                 { Check(item->value >= 0, "item->value >= 0"); });
+        }
+        for (auto &i : threads)
+        {
+            i.join();
+        }
+    }
+    Check(s_alive == 0, "s_alive == 0");
+    std::cout << "smart pointers ok" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    int ops = argc > 1 ? atoi(argv[1]) : 1000000;
+    TestLocal();
+    TestCrossThread(ops);
+    TestManyPools();
+    TestSmartPointers();
+    std::cout << "all tests passed" << std::endl;
+    return 0;
+}
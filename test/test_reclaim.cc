@@ -0,0 +1,185 @@
+#include "../Utility/epoch.hpp"
+#include "../Utility/hazard_pointer.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/// 回收压力测试，建议以 -DSYLAR_SANITIZER=address 或 -DSYLAR_SANITIZER=thread 编译运行
+static std::atomic<int64_t> s_alive(0);
+
+/// 检查不依赖assert，Release编译同样生效
+static void Check(bool cond, const char *what)
+{
+    if (!cond)
+    {
+        std::cerr << "check failed: " << what << std::endl;
+        exit(1);
+    }
+}
+
+struct Node
+{
+    Node(int v) : value(v) { ++s_alive; }
+    ~Node() { --s_alive; }
+    int value;
+    Node *next = nullptr;
+};
+
+/// 使用EBR回收节点的无锁栈
+class EpochStack
+{
+public:
+    EpochStack(sylar::Epoch &epoch) : m_epoch(epoch), m_head(nullptr) {}
+
+    ~EpochStack()
+    {
+        Node *node = m_head.load();
+        while (node)
+        {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    void push(int v)
+    {
+        Node *node = new Node(v);
+        node->next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    bool pop(int &v)
+    {
+        sylar::Epoch::Guard guard(m_epoch);
+        Node *node = m_head.load(std::memory_order_acquire);
+        while (node && !m_head.compare_exchange_weak(node, node->next, std::memory_order_acquire, std::memory_order_acquire))
+            ;
+        if (!node)
+        {
+            return false;
+        }
+        v = node->value;
+        m_epoch.retire(node);
+        return true;
+    }
+
+private:
+    sylar::Epoch &m_epoch;
+    std::atomic<Node *> m_head;
+};
+
+/// 使用风险指针回收节点的无锁栈
+class HazardStack
+{
+public:
+    HazardStack(sylar::HazardPointerDomain &domain) : m_domain(domain), m_head(nullptr) {}
+
+    ~HazardStack()
+    {
+        Node *node = m_head.load();
+        while (node)
+        {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    void push(int v)
+    {
+        Node *node = new Node(v);
+        node->next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    bool pop(int &v)
+    {
+        sylar::HazardPointerDomain::Holder holder(m_domain);
+        while (true)
+        {
+            Node *node = holder.protect(m_head);
+            if (!node)
+            {
+                return false;
+            }
+            Node *next = node->next;
+            if (m_head.compare_exchange_strong(node, next, std::memory_order_acquire, std::memory_order_relaxed))
+            {
+                v = node->value;
+                holder.reset();
+                m_domain.retire(node);
+                return true;
+            }
+        }
+    }
+
+private:
+    sylar::HazardPointerDomain &m_domain;
+    std::atomic<Node *> m_head;
+};
+
+template <class Stack>
+static void Stress(const char *name, Stack &stack)
+{
+    const int kThreads = 4;
+    const int kOps = 100000;
+    std::atomic<int64_t> pushed(0), popped(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            for (int i = 0; i < kOps; ++i)
+            {
+                stack.push(t * kOps + i);
+                pushed += t * kOps + i;
+                int v;
+                if (stack.pop(v))
+                {
+                    popped += v;
+                }
+            } });
+    }
+    for (auto &i : threads)
+    {
+        i.join();
+    }
+    int v;
+    while (stack.pop(v))
+    {
+        popped += v;
+    }
+    Check(pushed == popped, "every pushed value popped once");
+    std::cout << name << ": pushed sum=" << pushed << " popped sum=" << popped << std::endl;
+}
+
+int main()
+{
+    {
+        sylar::Epoch epoch;
+        EpochStack stack(epoch);
+        Stress("Epoch", stack);
+        std::cout << "Epoch: epoch=" << epoch.getEpoch() << " pending=" << epoch.getPendingCount() << std::endl;
+    }
+    Check(s_alive == 0, "epoch domain reclaimed all nodes");
+    {
+        sylar::HazardPointerDomain domain;
+        HazardStack stack(domain);
+        Stress("HazardPointer", stack);
+        std::cout << "HazardPointer: pending=" << domain.getPendingCount() << std::endl;
+    }
+    Check(s_alive == 0, "hazard pointer domain reclaimed all nodes");
+    // 同一个线程依次使用很多个短命的回收域
+    for (int i = 0; i < 1000; ++i)
+    {
+        sylar::Epoch epoch;
+        sylar::Epoch::Guard guard(epoch);
+        epoch.retire(new Node(i));
+    }
+    Check(s_alive == 0, "short-lived epoch domains reclaimed all nodes");
+    std::cout << "all nodes reclaimed" << std::endl;
+    return 0;
+}
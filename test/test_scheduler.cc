@@ -0,0 +1,49 @@
+#include "../Fiber/scheduler.hpp"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> s_count{5};
+
+/// @brief 协程重新调度自己并指定在当前线程执行
+static void TestFiber()
+{
+    SYLAR_LOG_INFO(g_logger) << "test in fiber s_count=" << s_count;
+    if (--s_count > 0)
+    {
+        sylar::Scheduler::GetThis()->schedule(&TestFiber, sylar::GetThreadId());
+    }
+}
+
+/// @brief 协程yield之后由其他任务重新调度
+static void TestYield()
+{
+    sylar::Fiber::ptr self = sylar::Fiber::GetThis();
+    for (int i = 0; i < 3; ++i)
+    {
+        SYLAR_LOG_INFO(g_logger) << "yield loop " << i;
+        sylar::Scheduler::GetThis()->schedule(self);
+        self->yield();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    SYLAR_LOG_INFO(g_logger) << "main";
+    sylar::Scheduler sc(3, true, "test");
+    sc.start();
+    SYLAR_LOG_INFO(g_logger) << "schedule";
+    sc.schedule(&TestFiber);
+    sc.schedule(&TestYield);
+
+    std::atomic<int> total{0};
+    std::vector<std::function<void()>> batch;
+    for (int i = 0; i < 100; ++i)
+    {
+        batch.push_back([&total]()
+                        { ++total; });
+    }
+    sc.schedule(batch.begin(), batch.end());
+    sc.stop();
+    SYLAR_LOG_INFO(g_logger) << "over total=" << total << (total == 100 && s_count == 0 ? " ok" : " FAILED");
+    return 0;
+}
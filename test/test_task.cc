@@ -0,0 +1,186 @@
+#include "../Fiber/task.hpp"
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/// 竞争同一把锁的协程数，可以通过第一个命令行参数指定
+static int kTasks = 1000;
+
+// 协程的参数保存在帧里，lambda的捕获在lambda对象里，lambda对象销毁后就失效了，所以下面的协程都写成函数
+
+static sylar::Task<int> Add(int a, int b)
+{
+    co_return a + b;
+}
+
+static sylar::Task<int> Sum(int n)
+{
+    int sum = 0;
+    for (int i = 1; i <= n; ++i)
+    {
+        sum = co_await Add(sum, i);
+    }
+    co_return sum;
+}
+
+static sylar::Task<int> Throw()
+{
+    throw std::runtime_error("boom");
+    co_return 0;
+}
+
+static sylar::Task<void> Nested(int &sum, std::string &error)
+{
+    sum = co_await Sum(100);
+    try
+    {
+        co_await Throw();
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+    }
+}
+
+/// @brief 嵌套co_await的返回值和异常
+static void TestNested()
+{
+    int sum = 0;
+    std::string error;
+    {
+        sylar::Scheduler sc(1, false, "nested");
+        sc.start();
+        sylar::Spawn(Nested(sum, error), &sc);
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "nested sum=" << sum << " (expect 5050) exception=" << error;
+}
+
+static sylar::Task<void> LockLoop(sylar::FiberMutex &mutex, int &counter, int loops)
+{
+    for (int j = 0; j < loops; ++j)
+    {
+        co_await sylar::AwaitLock(mutex);
+        int v = counter;
+        co_await sylar::Yield();
+        counter = v + 1;
+        mutex.unlock();
+    }
+}
+
+/// @brief 无栈协程和有栈协程竞争同一把FiberMutex，在临界区内让出执行权
+static void TestLock()
+{
+    sylar::FiberMutex mutex;
+    int counter = 0;
+    const int loops = 10;
+    {
+        sylar::Scheduler sc(4, false, "lock");
+        sc.start();
+        for (int i = 0; i < kTasks; ++i)
+        {
+            sylar::Spawn(LockLoop(mutex, counter, loops), &sc);
+            sc.schedule([&]()
+                        {
+                for (int j = 0; j < loops; ++j)
+                {
+                    sylar::FiberMutex::Lock lock(mutex);
+                    int v = counter;
+                    sylar::Scheduler::GetThis()->schedule(sylar::Fiber::GetThis());
+                    sylar::Fiber::GetThis()->yield();
+                    counter = v + 1;
+                } });
+        }
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "lock counter=" << counter << " expect=" << kTasks * loops * 2;
+}
+
+static sylar::Task<void> Consume(sylar::FiberSemaphore &items, std::atomic<int> &consumed)
+{
+    co_await sylar::AwaitSemaphore(items);
+    ++consumed;
+}
+
+/// @brief 生产者是有栈协程，消费者是无栈协程
+static void TestSemaphore()
+{
+    sylar::FiberSemaphore items;
+    std::atomic<int> consumed{0};
+    {
+        sylar::Scheduler sc(2, false, "sem");
+        sc.start();
+        for (int i = 0; i < 100; ++i)
+        {
+            sylar::Spawn(Consume(items, consumed), &sc);
+        }
+        sc.schedule([&]()
+                    {
+            for (int i = 0; i < 10; ++i)
+            {
+                items.notify(10);
+                sylar::Scheduler::GetThis()->schedule(sylar::Fiber::GetThis());
+                sylar::Fiber::GetThis()->yield();
+            } });
+        sc.stop();
+    }
+    SYLAR_LOG_INFO(g_logger) << "semaphore consumed=" << consumed;
+}
+
+static sylar::Task<void> DelayedWrite(int fd, uint64_t ms)
+{
+    co_await sylar::SleepFor(ms);
+    write(fd, "x", 1);
+}
+
+static sylar::Task<void> SleepAndRead(int rfd, int wfd)
+{
+    uint64_t start = sylar::GetCoarseMS();
+    co_await sylar::SleepFor(20);
+    SYLAR_LOG_INFO(g_logger) << "slept " << sylar::GetCoarseMS() - start << "ms";
+
+    bool ready = co_await sylar::WaitEvent(rfd, sylar::IOManager::READ, 30);
+    SYLAR_LOG_INFO(g_logger) << "wait with nothing to read ready=" << ready << " timedout=" << (errno == ETIMEDOUT);
+
+    sylar::Spawn(DelayedWrite(wfd, 10));
+    ready = co_await sylar::WaitEvent(rfd, sylar::IOManager::READ, 1000);
+    char c = 0;
+    read(rfd, &c, 1);
+    SYLAR_LOG_INFO(g_logger) << "wait with data ready=" << ready << " read=" << c;
+
+    // 其他协程取消fd上的事件，等待方得到false
+    sylar::IOManager *iom = sylar::IOManager::GetThis();
+    iom->addTimer(10, [iom, rfd]()
+                  { iom->cancelAll(rfd); });
+    ready = co_await sylar::WaitEvent(rfd, sylar::IOManager::READ);
+    SYLAR_LOG_INFO(g_logger) << "wait cancelled ready=" << ready << " canceled=" << (errno == ECANCELED);
+}
+
+/// @brief 定时器和IO事件，包括IO超时
+static void TestIO()
+{
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    {
+        sylar::IOManager iom(2, false, "io");
+        sylar::Spawn(SleepAndRead(fds[0], fds[1]), &iom);
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        kTasks = atoi(argv[1]);
+    }
+    TestNested();
+    TestLock();
+    TestSemaphore();
+    TestIO();
+    SYLAR_LOG_INFO(g_logger) << "test task end";
+    return 0;
+}
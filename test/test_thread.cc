@@ -0,0 +1,73 @@
+#include "../Logger/log.hpp"
+#include "../Utility/thread.hpp"
+#include <chrono>
+#include <sched.h>
+#include <sys/syscall.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::atomic<int> g_count{0};
+
+static void Work()
+{
+    sylar::Thread *self = sylar::Thread::GetThis();
+    SYLAR_LOG_INFO(g_logger) << "name=" << sylar::Thread::GetName()
+                             << " this.name=" << self->getName()
+                             << " id=" << sylar::GetThreadId()
+                             << " this.id=" << self->getId()
+                             << " gettid=" << syscall(SYS_gettid)
+                             << " cpu=" << sched_getcpu()
+                             << " numa=" << self->getNumaNode();
+    for (int i = 0; i < 100000; ++i)
+    {
+        g_count.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/// @brief 对比缓存的tid与每次系统调用的开销
+static void BenchThreadId()
+{
+    const int n = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    pid_t sink = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        sink += sylar::GetThreadId();
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i)
+    {
+        sink += syscall(SYS_gettid);
+    }
+    auto end = std::chrono::steady_clock::now();
+    SYLAR_LOG_INFO(g_logger) << "GetThreadId " << std::chrono::duration<double, std::nano>(mid - start).count() / n
+                             << " ns, syscall(SYS_gettid) " << std::chrono::duration<double, std::nano>(end - mid).count() / n
+                             << " ns (" << (sink != 0) << ")";
+}
+
+int main(int argc, char **argv)
+{
+    int cpus = sylar::Thread::GetCpuCount();
+    SYLAR_LOG_INFO(g_logger) << "cpus=" << cpus << " numa(cpu0)=" << sylar::Thread::GetNumaNodeOfCpu(0);
+
+    std::vector<sylar::Thread::ptr> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        sylar::ThreadAttr attr;
+        // 每个线程绑定到一个CPU，栈和线程内存分配在本地节点
+        attr.cpus.push_back(i % cpus);
+        attr.numaLocal = i % 2 == 0;
+        attr.stackSize = 256 * 1024;
+        threads.emplace_back(new sylar::Thread(&Work, "worker_" + std::to_string(i), attr));
+        // 构造函数返回时线程已经开始运行，tid已经可用
+        SYLAR_LOG_INFO(g_logger) << "started " << threads.back()->getName() << " id=" << threads.back()->getId();
+    }
+    for (auto &i : threads)
+    {
+        i->join();
+    }
+    SYLAR_LOG_INFO(g_logger) << "count=" << g_count << (g_count == 400000 ? " ok" : " FAILED");
+
+    BenchThreadId();
+    return 0;
+}
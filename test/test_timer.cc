@@ -0,0 +1,93 @@
+#include "../Fiber/iomanager.hpp"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/// 不应该执行的回调实际执行的次数
+static std::atomic<int> s_unexpected(0);
+
+/// 不需要唤醒等待线程的定时器管理器
+class PlainTimerManager : public sylar::TimerManager
+{
+protected:
+    void onTimerInsertedAtFront() override {}
+};
+
+int main(int argc, char **argv)
+{
+    std::shared_ptr<int> cond(new int(0));
+    {
+        sylar::IOManager iom(2, true, "timer");
+        uint64_t start = sylar::GetCoarseMS();
+
+        iom.addTimer(500, [start]()
+                     { SYLAR_LOG_INFO(g_logger) << "one shot 500ms, elapsed=" << sylar::GetCoarseMS() - start; });
+
+        // 循环定时器触发3次后取消自己
+        static sylar::Timer::ptr s_timer;
+        static int s_count = 0;
+        s_timer = iom.addTimer(200, [start]()
+                               {
+            SYLAR_LOG_INFO(g_logger) << "recurring 200ms count=" << s_count << " elapsed=" << sylar::GetCoarseMS() - start;
+            if (++s_count == 3)
+            {
+                s_timer->reset(100, true);
+            }
+            if (s_count == 5)
+            {
+                s_timer->cancel();
+                s_timer.reset();
+            } }, true);
+
+        // 条件对象释放后回调不再执行
+        iom.addConditionTimer(300, []()
+                              { SYLAR_LOG_INFO(g_logger) << "condition alive"; }, cond);
+        iom.addConditionTimer(300, []()
+                              {
+            ++s_unexpected;
+            SYLAR_LOG_ERROR(g_logger) << "condition released, should not run"; }, std::shared_ptr<int>(new int(0)));
+
+        // 取消的定时器不会触发，刷新的定时器推迟触发
+        sylar::Timer::ptr canceled = iom.addTimer(100, []()
+                                                  {
+            ++s_unexpected;
+            SYLAR_LOG_ERROR(g_logger) << "canceled timer should not run"; });
+        canceled->cancel();
+        sylar::Timer::ptr refreshed = iom.addTimer(300, [start]()
+                                                   { SYLAR_LOG_INFO(g_logger) << "refreshed timer elapsed=" << sylar::GetCoarseMS() - start; });
+        iom.schedule([refreshed]()
+                     {
+            usleep(200 * 1000);
+            refreshed->refresh(); });
+
+        // 超过第0层范围的定时器经过重新分配后按时触发
+        iom.addTimer(1300, [start]()
+                     { SYLAR_LOG_INFO(g_logger) << "long 1300ms, elapsed=" << sylar::GetCoarseMS() - start; });
+    }
+
+    // 管理器析构后，用户手里的定时器不再访问它
+    sylar::Timer::ptr pending, fired;
+    {
+        PlainTimerManager manager;
+        pending = manager.addTimer(60 * 1000, []()
+                                   { ++s_unexpected; });
+        fired = manager.addTimer(0, []() {});
+        usleep(20 * 1000);
+        std::vector<std::function<void()>> cbs;
+        manager.listExpiredCb(cbs);
+    }
+    if (pending->cancel() || pending->refresh() || pending->reset(100, true) || fired->cancel())
+    {
+        SYLAR_LOG_ERROR(g_logger) << "timer outlived its manager but cancel/refresh/reset succeeded";
+        return 1;
+    }
+    SYLAR_LOG_INFO(g_logger) << "timers detached from destroyed manager";
+
+    if (s_unexpected)
+    {
+        SYLAR_LOG_ERROR(g_logger) << s_unexpected << " callbacks that should not run did run";
+        return 1;
+    }
+
+    SYLAR_LOG_INFO(g_logger) << "test timer end";
+    return 0;
+}